@@ -5,12 +5,23 @@
 #include "vcg/complex/algorithms/clean.h"
 #include "vcg/complex/algorithms/clustering.h"
 #include "VCG_CMesh0_Helper.h"
+#include "NormalEngine.h"
 
 struct LODMaker
 {
-    static void decimateMesh(int targetFaceNb, CMeshO &mesh);
+    // preserveBoundary locks the border vertices, e.g. to keep the seams between patches decimated apart.
+    static void decimateMesh(int targetFaceNb, CMeshO &mesh, bool preserveBoundary = false);
 
     static void repairAndPrepareForDecimation(CMeshO &mesh);
+
+    // Coarse stand-in of mesh in proxy: vertex clustering on a grid of about cellNb cells.
+    static void clusterMesh(CMeshO &mesh, int cellNb, CMeshO &proxy);
+
+    // Sequential LOD of a point set: order lists its vertices so that each prefix ending at levelEnds[k] is
+    // a Poisson disk sample of radius radii[k], the radius halving from a level to the next; the last level
+    // is the remaining vertices, shuffled, its radius extrapolated. Deterministic.
+    static void sequentialPointOrder(CMeshO &mesh, std::vector<uint32_t> &order, std::vector<uint32_t> &levelEnds,
+                                     std::vector<float> &radii);
 };
 
 
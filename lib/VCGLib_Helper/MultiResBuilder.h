@@ -0,0 +1,47 @@
+#ifndef MULTIRESBUILDER_H
+#define MULTIRESBUILDER_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "../../src/Point3D.h"
+#include "../../src/Point3D.inl.h"
+
+// Offline builder of a multiresolution file (.mrm): a binary hierarchy of patches of about
+// patchFaceNb faces. The leaves split the input mesh by median cuts of the face barycenters; every
+// other node is the union of its two children decimated back to patchFaceNb faces by LODMaker with its
+// border locked, so any cut of the hierarchy joins without cracks.
+//
+// File layout: MultiResHeader, nodeNb MultiResNode (node 0 is the root), then the patches. A patch is
+// uint32 vertexNb, uint32 faceNb, vertexNb*3 float positions, faceNb*3 float face normals and faceNb*3
+// uint32 indices.
+struct MultiResHeader
+{
+    uint32_t magic;       // 'mrm1'
+    uint32_t nodeNb;
+    uint32_t patchFaceNb;
+    uint32_t reserved;
+};
+
+struct MultiResNode
+{
+    int32_t children[2];  // -1 for the leaves
+    float error;          // object space, max distance of the full resolution surface from the patch
+    float center[3];      // bounding sphere of the patch and of its whole subtree
+    float radius;
+    uint32_t faceNb;
+    uint64_t offset;      // patch position in the file
+    uint64_t size;        // patch size in bytes
+};
+
+struct MultiResBuilder
+{
+    static const uint32_t Magic = 0x316d726d;
+
+    // Returns false when the file can not be written.
+    static bool build(const std::vector<uint32_t> &indices, const std::vector<Point3D> &vertices,
+                      const std::string &path, uint32_t patchFaceNb = 4096);
+};
+
+
+#endif //MULTIRESBUILDER_H
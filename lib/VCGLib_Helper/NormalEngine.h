@@ -0,0 +1,44 @@
+#ifndef NORMALENGINE_H
+#define NORMALENGINE_H
+
+#include <vector>
+#include <cstdint>
+#include "cmesh.h"
+#include "../../src/Point3D.h"
+#include "../../src/Point3D.inl.h"
+
+// Fused face + vertex normal computation.
+// Face normals and per-corner weights are computed in one parallel pass over the faces, then every
+// vertex gathers its own incident corners through a vertex->corner table, so no two threads ever
+// write the same vertex and the result does not depend on the number of threads.
+struct NormalEngine
+{
+    enum Weighting { AngleWeighted, AreaWeighted };
+
+    // Vertex -> incident face corners, stored as CSR.
+    // The corners of vertex v are corners[offsets[v]] .. corners[offsets[v+1]-1], a corner being face*3+wedge.
+    struct VertexCorners
+    {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> corners;
+
+        void build(const std::vector<uint32_t> &indices, size_t vertexNb);
+    };
+
+    static void computeFaceNormals(const std::vector<uint32_t> &indices, const std::vector<Point3D> &vertices, std::vector<Point3D> &faceNormals);
+
+    static void computeNormals(const std::vector<uint32_t> &indices, const std::vector<Point3D> &vertices,
+                               std::vector<Point3D> &faceNormals, std::vector<Point3D> &vertexNormals,
+                               Weighting weighting = AngleWeighted);
+
+    // Replaces PerFaceNormalized + PerVertexAngleWeighted (or area weighted) + NormalizePerVertex.
+    static void computeNormals(CMeshO &mesh, Weighting weighting = AngleWeighted);
+
+    // Oriented normals of a point cloud without faces: k-NN plane fitting then orientation propagation
+    // (vcg::tri::PointCloudNormal). blockOrientation selects the parallel per-block orientation.
+    static void computePointCloudNormals(const std::vector<Point3D> &vertices, std::vector<Point3D> &vertexNormals,
+                                         int neighborNb = 10, bool blockOrientation = true);
+};
+
+
+#endif //NORMALENGINE_H
@@ -7,6 +7,7 @@
 #include "../../src/Point3D.h"
 #include "../../src/Point3D.inl.h"
 #include <unordered_map>
+#include <limits>
 
 struct VCG_CMesh0_Helper {
 
@@ -18,7 +19,8 @@ struct VCG_CMesh0_Helper {
         std::size_t operator()(const std::pair<T1, T2> &p) const {
             auto h1 = std::hash<T1>{}(p.first);
             auto h2 = std::hash<T2>{}(p.second);
-            return h1 ^ h2;
+            // h1 ^ h2 collides for all the edges of nearby vertices (i^j is small): mix as hash_combine does
+            return h1 ^ (h2 + 0x9e3779b9 + (h1 << 6) + (h1 >> 2));
         }
     };
 
@@ -32,6 +34,9 @@ struct VCG_CMesh0_Helper {
     static CMeshO constructCMesh(const std::vector<uint32_t> &indices, const std::vector<Point3D> &vertices, const std::vector<Point3D> &faceNormals);
 
     static void retrieveCMeshData(CMeshO &mesh, std::vector<uint32_t> &indices, std::vector<Point3D> &vertices, std::vector<Point3D> &faceNormals);
+
+    // Same result as vcg::tri::UpdateBounding<CMeshO>::Box, streaming the coords and flags spans.
+    static void updateBoundingBox(CMeshO &mesh);
 };
 
 
@@ -24,6 +24,7 @@
 #ifndef CMESH_H
 #define CMESH_H
 
+#include <type_traits>
 #include "vcg/complex/complex.h"
 
 #define MESHLAB_SCALAR float
@@ -48,6 +49,14 @@ template <class T> class Normal3m: public Normal<vcg::Point3<Scalarm>, T> {
 public:	static void Name(std::vector<std::string> & name){name.push_back(std::string("Normal3m"));T::Name(name);}
 };
 
+template <class T> class Coord3mOcf: public CoordOcf<vcg::Point3<Scalarm>, T> {
+public:	static void Name(std::vector<std::string> & name){name.push_back(std::string("Coord3mOcf"));T::Name(name);}
+};
+
+template <class T> class Normal3mOcf: public NormalOcf<vcg::Point3<Scalarm>, T> {
+public:	static void Name(std::vector<std::string> & name){name.push_back(std::string("Normal3mOcf"));T::Name(name);}
+};
+
 template <class T> class Qualitym: public Quality<Scalarm, T> {
 public: static void Name(std::vector<std::string> & name){name.push_back(std::string("Qualitym"));T::Name(name);}
 };
@@ -93,12 +102,21 @@ class CUsedTypesO: public vcg::UsedTypes < vcg::Use<CVertexO>::AsVertexType,
 // The Main Vertex Class
 // Most of the attributes are optional and must be enabled before use.
 // Each vertex needs 40 byte, on 32bit arch. and 44 byte on 64bit arch.
+// When CMESHO_SOA is defined the hot components (coord, flags and normal) are kept in contiguous
+// arrays of the vertex vector instead (see CMeshO::vertCoords()), and each vertex needs 12/16 byte.
+// The normals are always enabled in that mode.
 
 class CVertexO  : public vcg::Vertex< CUsedTypesO,
 		vcg::vertex::InfoOcf,           /*  4b */
+#ifdef CMESHO_SOA
+		vcg::vertex::Coord3mOcf,        /*  0b */
+		vcg::vertex::BitFlagsOcf,       /*  0b */
+		vcg::vertex::Normal3mOcf,       /*  0b */
+#else
 		vcg::vertex::Coord3m,           /* 12b */
 		vcg::vertex::BitFlags,          /*  4b */
 		vcg::vertex::Normal3m,          /* 12b */
+#endif
 		vcg::vertex::Qualitym,          /*  4b */
 		vcg::vertex::Color4b,           /*  4b */
 		vcg::vertex::VFAdjOcf,          /*  0b */
@@ -135,6 +153,27 @@ class CFaceO    : public vcg::Face<  CUsedTypesO,
 
 typedef vcg::tri::TriMesh< vcg::vertex::vector_ocf<CVertexO>, vcg::face::vector_ocf<CFaceO> > vcgTriMesh;
 
+// View over one component of all the vertices of a CMeshO (deleted ones included): contiguous in the
+// CMESHO_SOA layout, strided by the vertex size otherwise. data() is only valid when contiguous().
+template <class T>
+class ComponentSpan
+{
+	typedef typename std::conditional<std::is_const<T>::value, const char, char>::type ByteType;
+public:
+	ComponentSpan(T *first, size_t count, size_t stride) : first_(first), count_(count), stride_(stride) {}
+
+	T &operator[](size_t i) const { return *reinterpret_cast<T *>(reinterpret_cast<ByteType *>(first_) + i * stride_); }
+	size_t size() const { return count_; }
+	bool empty() const { return count_ == 0; }
+	bool contiguous() const { return stride_ == sizeof(T); }
+	T *data() const { assert(contiguous()); return first_; }
+
+private:
+	T *first_;
+	size_t count_;
+	size_t stride_;
+};
+
 class CMeshO    : public vcgTriMesh
 {
 public :
@@ -151,6 +190,19 @@ public :
 	friend void swap(CMeshO& m1, CMeshO& m2);
 	
 	Box3m trBB() const;
+
+#ifdef CMESHO_SOA
+	static constexpr bool hotSoA = true;
+#else
+	static constexpr bool hotSoA = false;
+#endif
+
+	ComponentSpan<Point3m>       vertCoords()        { return span<Point3m>(vert.empty() ? nullptr : &vert[0].P()); }
+	ComponentSpan<const Point3m> vertCoords() const  { return span<const Point3m>(vert.empty() ? nullptr : &vert[0].cP()); }
+	ComponentSpan<Point3m>       vertNormals()       { return span<Point3m>(vert.empty() ? nullptr : &vert[0].N()); }
+	ComponentSpan<const Point3m> vertNormals() const { return span<const Point3m>(vert.empty() ? nullptr : &vert[0].N()); }
+	ComponentSpan<int>           vertFlags()         { return span<int>(vert.empty() ? nullptr : &vert[0].Flags()); }
+	ComponentSpan<const int>     vertFlags() const   { return span<const int>(vert.empty() ? nullptr : &vert[0].Flags()); }
 	
 	int sfn;    //The number of selected faces.
 	int svn;    //The number of selected vertices.
@@ -162,6 +214,9 @@ public :
 
 private:
 	void enableComponentsFromOtherMesh(const CMeshO& oth);
+
+	template <class T>
+	ComponentSpan<T> span(T *first) const { return ComponentSpan<T>(first, vert.size(), hotSoA ? sizeof(T) : sizeof(CVertexO)); }
 };
 
 //must be inlined
@@ -1,14 +1,18 @@
 #include "../LODMaker.h"
+#include <random>
+#include "vcg/complex/algorithms/point_sampling.h"
 
 
-void LODMaker::decimateMesh(int targetFaceNb, CMeshO &mesh)
+void LODMaker::decimateMesh(int targetFaceNb, CMeshO &mesh, bool preserveBoundary)
 {
     mesh.vert.EnableVFAdjacency();
     mesh.face.EnableVFAdjacency();
     vcg::tri::UpdateTopology<CMeshO>::VertexFace(mesh);
     mesh.vert.EnableMark();
 
-    //vcg::tri::UpdateFlags<CMeshO>::FaceBorderFromVF(mesh);
+    if(preserveBoundary) {
+        vcg::tri::UpdateFlags<CMeshO>::FaceBorderFromVF(mesh);
+    }
     vcg::tri::TriEdgeCollapseQuadricParameter params;
 
     params.BoundaryQuadricWeight = 0.5;
@@ -23,7 +27,7 @@ void LODMaker::decimateMesh(int targetFaceNb, CMeshO &mesh)
     params.OptimalPlacement =true;
     //params.SVDPlacement = false;
     params.PreserveTopology = false;
-    params.PreserveBoundary = false;
+    params.PreserveBoundary = preserveBoundary;
     //params.QuadricEpsilon = 1e-15;
     params.QualityCheck = true;
     params.QualityThr =.3;     // Collapsed that generate faces with quality LOWER than this value are penalized. So higher the value -> better the quality of the accepted triangles
@@ -47,15 +51,10 @@ void LODMaker::decimateMesh(int targetFaceNb, CMeshO &mesh)
         vcg::tri::Allocator<CMeshO>::CompactFaceVector(mesh);
     }
 
-    vcg::tri::UpdateBounding<CMeshO>::Box(mesh);
+    VCG_CMesh0_Helper::updateBoundingBox(mesh);
     if(mesh.fn > 0) {
-        vcg::tri::UpdateNormal<CMeshO>::PerFaceNormalized(mesh);
-        vcg::tri::UpdateNormal<CMeshO>::PerVertexAngleWeighted(mesh);
+        NormalEngine::computeNormals(mesh, NormalEngine::AngleWeighted);
     }
-
-    vcg::tri::UpdateNormal<CMeshO>::NormalizePerFace(mesh);
-    vcg::tri::UpdateNormal<CMeshO>::PerVertexFromCurrentFaceNormal(mesh);
-    vcg::tri::UpdateNormal<CMeshO>::NormalizePerVertex(mesh);
 }
 
 void LODMaker::repairAndPrepareForDecimation(CMeshO &mesh)
@@ -77,13 +76,92 @@ void LODMaker::repairAndPrepareForDecimation(CMeshO &mesh)
         ClusteringGrid.ExtractMesh(mesh);
     }
 
-    vcg::tri::UpdateBounding<CMeshO>::Box(mesh);
+    VCG_CMesh0_Helper::updateBoundingBox(mesh);
     if(mesh.fn>0) {
-        vcg::tri::UpdateNormal<CMeshO>::PerFaceNormalized(mesh);
-        vcg::tri::UpdateNormal<CMeshO>::PerVertexAngleWeighted(mesh);
+        NormalEngine::computeNormals(mesh, NormalEngine::AngleWeighted);
     }
 
     //m.clearDataMask(MeshModel::MM_FACEFACETOPO);
 
     std::cout << maxVal << "\n";
-}
\ No newline at end of file
+}
+
+void LODMaker::clusterMesh(CMeshO &mesh, int cellNb, CMeshO &proxy)
+{
+    VCG_CMesh0_Helper::updateBoundingBox(mesh);
+    vcg::tri::Clustering<CMeshO, vcg::tri::AverageColorCell<CMeshO>> ClusteringGrid(mesh.bbox, cellNb);
+    if(mesh.FN() == 0) {
+        ClusteringGrid.AddPointSet(mesh);
+        ClusteringGrid.ExtractPointSet(proxy);
+    }
+    else {
+        ClusteringGrid.AddMesh(mesh);
+        ClusteringGrid.ExtractMesh(proxy);
+    }
+    VCG_CMesh0_Helper::updateBoundingBox(proxy);
+}
+
+namespace
+{
+    // Collects the vertices PoissonDiskPruning keeps, each once: the ones of the previous levels come again.
+    struct OrderSampler
+    {
+        CMeshO &mesh;
+        std::vector<uint32_t> &order;
+        std::vector<char> &taken;
+
+        void AddVert(const CVertexO &v)
+        {
+            size_t i = vcg::tri::Index(mesh, v);
+            if(taken[i]) return;
+            taken[i] = 1;
+            order.push_back((uint32_t) i);
+        }
+    };
+}
+
+void LODMaker::sequentialPointOrder(CMeshO &mesh, std::vector<uint32_t> &order, std::vector<uint32_t> &levelEnds,
+                                    std::vector<float> &radii)
+{
+    typedef vcg::tri::SurfaceSampling<CMeshO, OrderSampler> Sampling;
+
+    vcg::tri::Allocator<CMeshO>::CompactVertexVector(mesh);
+    VCG_CMesh0_Helper::updateBoundingBox(mesh);
+    size_t n = mesh.vert.size();
+    order.clear();
+    levelEnds.clear();
+    radii.clear();
+    if(n == 0) return;
+    order.reserve(n);
+    std::vector<char> taken(n, 0);
+
+    // the samples of the previous levels are fixed: each level only adds points farther than its radius from them
+    CMeshO::PerVertexAttributeHandle<bool> fixed = vcg::tri::Allocator<CMeshO>::GetPerVertexAttribute<bool>(mesh, "fixed");
+    Sampling::PoissonDiskParam pp;
+    pp.preGenFlag = true;
+    pp.bestSampleChoiceFlag = false;
+    pp.parallelFlag = true;
+    pp.randomSeed = 1;
+    OrderSampler sampler{mesh, order, taken};
+    // beyond half of the points a level keeps about all of the rest
+    for(float radius = mesh.bbox.Diag() / 8; radius > 0 && order.size() < n / 2 && levelEnds.size() < 24; radius /= 2) {
+        for(size_t i = 0; i < n; ++i) fixed[i] = taken[i] != 0;
+        Sampling::PoissonDiskPruning(sampler, mesh, radius, pp);
+        if(order.size() == (levelEnds.empty() ? 0 : levelEnds.back())) continue;
+        levelEnds.push_back((uint32_t) order.size());
+        radii.push_back(radius);
+    }
+    vcg::tri::Allocator<CMeshO>::DeletePerVertexAttribute(mesh, fixed);
+
+    if(order.size() < n) {
+        size_t first = order.size();
+        for(size_t i = 0; i < n; ++i) {
+            if(!taken[i]) order.push_back((uint32_t) i);
+        }
+        std::shuffle(order.begin() + first, order.end(), std::mt19937(1));
+        // uniform on a surface: the spacing goes as one over the square root of the count
+        float radius = radii.empty() ? mesh.bbox.Diag() / 8 : radii.back() * std::sqrt(float(levelEnds.back()) / n);
+        levelEnds.push_back((uint32_t) n);
+        radii.push_back(radius);
+    }
+}
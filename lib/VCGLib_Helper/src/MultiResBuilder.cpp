@@ -0,0 +1,252 @@
+#include "../MultiResBuilder.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <vcg/complex/algorithms/closest.h>
+#include <vcg/space/index/grid_static_ptr.h>
+#include "../LODMaker.h"
+
+namespace
+{
+    struct Patch
+    {
+        std::vector<Point3D> vertices;
+        std::vector<uint32_t> indices;
+        std::vector<Point3D> normals;   // per face
+    };
+
+    struct PositionHash
+    {
+        std::size_t operator()(const Point3D &p) const
+        {
+            uint32_t b[3];
+            std::memcpy(&b[0], &p.x, 4);
+            std::memcpy(&b[1], &p.y, 4);
+            std::memcpy(&b[2], &p.z, 4);
+            return (std::size_t(b[0]) * 73856093u) ^ (std::size_t(b[1]) * 19349663u) ^ (std::size_t(b[2]) * 83492791u);
+        }
+    };
+
+    struct PositionEqual
+    {
+        bool operator()(const Point3D &a, const Point3D &b) const { return a.x == b.x && a.y == b.y && a.z == b.z; }
+    };
+
+    struct Builder
+    {
+        const std::vector<uint32_t> &indices;
+        const std::vector<Point3D> &vertices;
+        uint32_t patchFaceNb;
+        FILE *file;
+        std::vector<MultiResNode> nodes;
+        std::vector<uint32_t> faces;
+        std::vector<Point3D> barycenters;
+
+        Builder(const std::vector<uint32_t> &_indices, const std::vector<Point3D> &_vertices, uint32_t _patchFaceNb, FILE *_file)
+            : indices(_indices), vertices(_vertices), patchFaceNb(_patchFaceNb), file(_file) {}
+
+        int buildNode(size_t begin, size_t end, Patch &patch);
+        void leafPatch(size_t begin, size_t end, Patch &patch);
+        float mergeAndDecimate(const Patch &p0, const Patch &p1, Patch &patch);
+        bool writePatch(const Patch &patch, MultiResNode &node);
+    };
+
+    void boundingSphere(const std::vector<Point3D> &points, float center[3], float &radius)
+    {
+        vcg::Box3f box;
+        for (const Point3D &p : points) {
+            box.Add(vcg::Point3f(p.x, p.y, p.z));
+        }
+        vcg::Point3f c = box.Center();
+        float r2 = 0;
+        for (const Point3D &p : points) {
+            r2 = std::max(r2, (vcg::Point3f(p.x, p.y, p.z) - c).SquaredNorm());
+        }
+        for (int k = 0; k < 3; ++k) center[k] = c[k];
+        radius = std::sqrt(r2);
+    }
+
+    // Smallest sphere around the spheres of the children, grown to the (possibly moved) patch
+    // vertices: a node is never closer to the viewer than one of its children.
+    void nodeSphere(MultiResNode &node, const MultiResNode &c0, const MultiResNode &c1, const std::vector<Point3D> &points)
+    {
+        vcg::Point3f p0(c0.center[0], c0.center[1], c0.center[2]);
+        vcg::Point3f p1(c1.center[0], c1.center[1], c1.center[2]);
+        float d = (p1 - p0).Norm();
+        vcg::Point3f c;
+        float r;
+        if (d + c1.radius <= c0.radius) {
+            c = p0;
+            r = c0.radius;
+        } else if (d + c0.radius <= c1.radius) {
+            c = p1;
+            r = c1.radius;
+        } else {
+            r = (d + c0.radius + c1.radius) / 2;
+            c = p0 + (p1 - p0) * ((r - c0.radius) / d);
+        }
+        for (const Point3D &p : points) {
+            r = std::max(r, (vcg::Point3f(p.x, p.y, p.z) - c).Norm());
+        }
+        for (int k = 0; k < 3; ++k) node.center[k] = c[k];
+        node.radius = r;
+    }
+}
+
+void Builder::leafPatch(size_t begin, size_t end, Patch &patch)
+{
+    std::unordered_map<uint32_t, uint32_t> local;
+    for (size_t k = begin; k < end; ++k) {
+        uint32_t f = faces[k];
+        for (int j = 0; j < 3; ++j) {
+            uint32_t v = indices[f*3+j];
+            auto it = local.find(v);
+            if (it == local.end()) {
+                it = local.emplace(v, (uint32_t) patch.vertices.size()).first;
+                patch.vertices.push_back(vertices[v]);
+            }
+            patch.indices.push_back(it->second);
+        }
+    }
+    NormalEngine::computeFaceNormals(patch.indices, patch.vertices, patch.normals);
+}
+
+float Builder::mergeAndDecimate(const Patch &p0, const Patch &p1, Patch &patch)
+{
+    // The children share the vertices of their common border bit for bit: welding them makes that
+    // border interior to the union, only the border of the node stays locked.
+    std::vector<Point3D> merged;
+    std::vector<uint32_t> mergedIndices;
+    std::unordered_map<Point3D, uint32_t, PositionHash, PositionEqual> weld;
+    for (const Patch *p : {&p0, &p1}) {
+        std::vector<uint32_t> remap(p->vertices.size());
+        for (size_t v = 0; v < p->vertices.size(); ++v) {
+            auto it = weld.emplace(p->vertices[v], (uint32_t) merged.size()).first;
+            if (it->second == merged.size()) merged.push_back(p->vertices[v]);
+            remap[v] = it->second;
+        }
+        for (uint32_t i : p->indices) {
+            mergedIndices.push_back(remap[i]);
+        }
+    }
+
+    std::vector<Point3D> normals;
+    NormalEngine::computeFaceNormals(mergedIndices, merged, normals);
+    CMeshO m = VCG_CMesh0_Helper::constructCMesh(mergedIndices, merged, normals);
+    LODMaker::decimateMesh(patchFaceNb, m, true);
+
+    // Error: how far the merged (finer) vertices are from the decimated patch.
+    float error = 0;
+    if (m.fn > 0) {
+        m.face.EnableMark();
+        vcg::GridStaticPtr<CFaceO, Scalarm> grid;
+        grid.Set(m.face.begin(), m.face.end());
+        float maxDist = m.bbox.Diag();
+        for (const Point3D &p : merged) {
+            Scalarm dist;
+            Point3m closest;
+            if (vcg::tri::GetClosestFaceBase(m, grid, Point3m(p.x, p.y, p.z), maxDist, dist, closest)) {
+                error = std::max(error, (float) dist);
+            }
+        }
+    }
+
+    // retrieveCMeshData leaves the normals of the decimated faces stale (and the array oversized)
+    VCG_CMesh0_Helper::retrieveCMeshData(m, patch.indices, patch.vertices, patch.normals);
+    NormalEngine::computeFaceNormals(patch.indices, patch.vertices, patch.normals);
+    return error;
+}
+
+bool Builder::writePatch(const Patch &patch, MultiResNode &node)
+{
+    uint32_t counts[2] = {(uint32_t) patch.vertices.size(), (uint32_t) (patch.indices.size() / 3)};
+    node.offset = (uint64_t) ftell(file);
+    node.faceNb = counts[1];
+
+    std::vector<float> floats;
+    floats.reserve((counts[0] + counts[1]) * 3);
+    for (const Point3D &p : patch.vertices) {
+        floats.insert(floats.end(), {p.x, p.y, p.z});
+    }
+    for (const Point3D &n : patch.normals) {
+        floats.insert(floats.end(), {n.x, n.y, n.z});
+    }
+    bool ok = fwrite(counts, sizeof(uint32_t), 2, file) == 2 &&
+              fwrite(floats.data(), sizeof(float), floats.size(), file) == floats.size() &&
+              fwrite(patch.indices.data(), sizeof(uint32_t), patch.indices.size(), file) == patch.indices.size();
+    node.size = (uint64_t) ftell(file) - node.offset;
+    return ok;
+}
+
+int Builder::buildNode(size_t begin, size_t end, Patch &patch)
+{
+    int id = (int) nodes.size();
+    nodes.push_back(MultiResNode());
+    MultiResNode node;
+    node.children[0] = node.children[1] = -1;
+    node.error = 0;
+
+    if (end - begin <= patchFaceNb) {
+        leafPatch(begin, end, patch);
+        boundingSphere(patch.vertices, node.center, node.radius);
+    } else {
+        vcg::Box3f box;
+        for (size_t k = begin; k < end; ++k) {
+            const Point3D &b = barycenters[faces[k]];
+            box.Add(vcg::Point3f(b.x, b.y, b.z));
+        }
+        int axis = box.MaxDim();
+        size_t mid = begin + (end - begin) / 2;
+        std::nth_element(faces.begin() + begin, faces.begin() + mid, faces.begin() + end, [&](uint32_t a, uint32_t b) {
+            return barycenters[a][axis] < barycenters[b][axis];
+        });
+
+        Patch p0, p1;
+        node.children[0] = buildNode(begin, mid, p0);
+        node.children[1] = buildNode(mid, end, p1);
+        if (node.children[0] < 0 || node.children[1] < 0) return -1;
+        const MultiResNode &c0 = nodes[node.children[0]];
+        const MultiResNode &c1 = nodes[node.children[1]];
+
+        node.error = std::max(c0.error, c1.error) + mergeAndDecimate(p0, p1, patch);
+        nodeSphere(node, c0, c1, patch.vertices);
+    }
+
+    if (!writePatch(patch, node)) return -1;
+    nodes[id] = node;
+    return id;
+}
+
+bool MultiResBuilder::build(const std::vector<uint32_t> &indices, const std::vector<Point3D> &vertices,
+                            const std::string &path, uint32_t patchFaceNb)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+
+    Builder b(indices, vertices, std::max(patchFaceNb, 16u), file);
+    size_t faceNb = indices.size() / 3;
+    b.faces.resize(faceNb);
+    b.barycenters.resize(faceNb);
+    for (size_t f = 0; f < faceNb; ++f) {
+        b.faces[f] = (uint32_t) f;
+        b.barycenters[f] = (vertices[indices[f*3]] + vertices[indices[f*3+1]] + vertices[indices[f*3+2]]) / 3;
+    }
+
+    // The node count is only known at the end: the patches go after room for the worst case table of
+    // a balanced tree, and the header and table are written last.
+    size_t leafNb = std::max<size_t>(1, (faceNb + b.patchFaceNb - 1) / b.patchFaceNb);
+    size_t maxNodeNb = 4 * leafNb;
+    long patchStart = (long) (sizeof(MultiResHeader) + maxNodeNb * sizeof(MultiResNode));
+    bool ok = fseek(file, patchStart, SEEK_SET) == 0;
+
+    Patch root;
+    ok = ok && faceNb > 0 && b.buildNode(0, faceNb, root) == 0 && b.nodes.size() <= maxNodeNb;
+
+    MultiResHeader header = {Magic, (uint32_t) b.nodes.size(), b.patchFaceNb, 0};
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 &&
+         fwrite(&header, sizeof(header), 1, file) == 1 &&
+         fwrite(b.nodes.data(), sizeof(MultiResNode), b.nodes.size(), file) == b.nodes.size();
+    ok = (fclose(file) == 0) && ok;
+    return ok;
+}
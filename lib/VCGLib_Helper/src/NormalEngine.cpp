@@ -0,0 +1,180 @@
+#include "../NormalEngine.h"
+#include <algorithm>
+#include <vcg/complex/algorithms/pointcloud_normal.h>
+
+namespace
+{
+    inline float cornerAngle(const Point3D &a, const Point3D &b)
+    {
+        return std::acos(std::min(1.0f, std::max(-1.0f, Dot(a, b))));
+    }
+
+    // One pass over the faces: normalized face normal + the weight of each of the 3 corners.
+    template <class PosFn>
+    void faceNormalsAndWeights(const std::vector<uint32_t> &indices, PosFn pos, NormalEngine::Weighting weighting,
+                               std::vector<Point3D> &faceNormals, std::vector<float> &cornerWeights)
+    {
+        int faceNb = (int) (indices.size() / 3);
+        faceNormals.resize(faceNb);
+        cornerWeights.resize(indices.size());
+
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < faceNb; ++i) {
+            Point3D p0 = pos(indices[i*3]);
+            Point3D p1 = pos(indices[i*3+1]);
+            Point3D p2 = pos(indices[i*3+2]);
+
+            Point3D n = (p1-p0)^(p2-p0);
+            float doubleArea = Norm(n);
+            if (doubleArea > 0) n /= doubleArea;
+            faceNormals[i] = n;
+
+            if (weighting == NormalEngine::AreaWeighted) {
+                cornerWeights[i*3] = cornerWeights[i*3+1] = cornerWeights[i*3+2] = doubleArea;
+            } else {
+                Point3D e0 = (p1-p0).Normalized();
+                Point3D e1 = (p2-p1).Normalized();
+                Point3D e2 = (p0-p2).Normalized();
+                cornerWeights[i*3]   = cornerAngle(e0, -e2);
+                cornerWeights[i*3+1] = cornerAngle(-e0, e1);
+                cornerWeights[i*3+2] = cornerAngle(-e1, e2);
+            }
+        }
+    }
+
+    // Each vertex sums its own corners: conflict-free, and deterministic whatever the thread count.
+    void gatherVertexNormals(const NormalEngine::VertexCorners &vc, const std::vector<Point3D> &faceNormals,
+                             const std::vector<float> &cornerWeights, std::vector<Point3D> &vertexNormals)
+    {
+        int vertexNb = (int) vc.offsets.size() - 1;
+        vertexNormals.resize(vertexNb);
+
+#pragma omp parallel for schedule(static)
+        for (int v = 0; v < vertexNb; ++v) {
+            float nx = 0, ny = 0, nz = 0;
+            for (uint32_t c = vc.offsets[v]; c < vc.offsets[v+1]; ++c) {
+                uint32_t corner = vc.corners[c];
+                const Point3D &fn = faceNormals[corner/3];
+                float w = cornerWeights[corner];
+                nx += fn.x * w;
+                ny += fn.y * w;
+                nz += fn.z * w;
+            }
+            float len = std::sqrt(nx*nx + ny*ny + nz*nz);
+            float inv = len > 0 ? 1.0f/len : 0.0f;
+            vertexNormals[v] = Point3D(nx*inv, ny*inv, nz*inv);
+        }
+    }
+}
+
+void NormalEngine::VertexCorners::build(const std::vector<uint32_t> &indices, size_t vertexNb)
+{
+    offsets.assign(vertexNb + 1, 0);
+    corners.resize(indices.size());
+
+    for (uint32_t idx : indices) {
+        ++offsets[idx + 1];
+    }
+    for (size_t v = 0; v < vertexNb; ++v) {
+        offsets[v + 1] += offsets[v];
+    }
+
+    std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (uint32_t c = 0; c < indices.size(); ++c) {
+        corners[cursor[indices[c]]++] = c;
+    }
+}
+
+void NormalEngine::computeFaceNormals(const std::vector<uint32_t> &indices, const std::vector<Point3D> &vertices, std::vector<Point3D> &faceNormals)
+{
+    int faceNb = (int) (indices.size() / 3);
+    faceNormals.resize(faceNb);
+
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < faceNb; ++i) {
+        const Point3D &v1 = vertices[indices[i*3]];
+        const Point3D &v2 = vertices[indices[i*3+1]];
+        const Point3D &v3 = vertices[indices[i*3+2]];
+        Point3D n = (v2-v1)^(v3-v1);
+        n.Normalize();
+        faceNormals[i] = n;
+    }
+}
+
+void NormalEngine::computeNormals(const std::vector<uint32_t> &indices, const std::vector<Point3D> &vertices,
+                                  std::vector<Point3D> &faceNormals, std::vector<Point3D> &vertexNormals,
+                                  Weighting weighting)
+{
+    std::vector<float> cornerWeights;
+    faceNormalsAndWeights(indices, [&](uint32_t v) { return vertices[v]; }, weighting, faceNormals, cornerWeights);
+
+    VertexCorners vc;
+    vc.build(indices, vertices.size());
+    gatherVertexNormals(vc, faceNormals, cornerWeights, vertexNormals);
+}
+
+void NormalEngine::computeNormals(CMeshO &mesh, Weighting weighting)
+{
+    std::vector<uint32_t> indices;
+    indices.reserve(mesh.FN() * 3);
+    for (const CFaceO &f : mesh.face) {
+        if (f.IsD()) continue;
+        for (int j = 0; j < 3; j++) {
+            indices.push_back((uint32_t) vcg::tri::Index(mesh, f.cV(j)));
+        }
+    }
+
+    std::vector<Point3D> faceNormals, vertexNormals;
+    std::vector<float> cornerWeights;
+    ComponentSpan<const Point3m> coords = static_cast<const CMeshO &>(mesh).vertCoords();
+    faceNormalsAndWeights(indices, [&](uint32_t v) {
+        const Point3m &p = coords[v];
+        return Point3D(p[0], p[1], p[2]);
+    }, weighting, faceNormals, cornerWeights);
+
+    VertexCorners vc;
+    vc.build(indices, mesh.vert.size());
+    gatherVertexNormals(vc, faceNormals, cornerWeights, vertexNormals);
+
+    int faceNb = (int) mesh.face.size();
+    int fi = 0;
+    for (int i = 0; i < faceNb; ++i) {
+        if (mesh.face[i].IsD()) continue;
+        const Point3D &n = faceNormals[fi++];
+        mesh.face[i].N() = Point3m(n.x, n.y, n.z);
+    }
+
+    ComponentSpan<Point3m> normals = mesh.vertNormals();
+    ComponentSpan<const int> flags = static_cast<const CMeshO &>(mesh).vertFlags();
+    int vertexNb = (int) mesh.vert.size();
+#pragma omp parallel for schedule(static)
+    for (int v = 0; v < vertexNb; ++v) {
+        if (flags[v] & CVertexO::DELETED) continue;
+        const Point3D &n = vertexNormals[v];
+        normals[v] = Point3m(n.x, n.y, n.z);
+    }
+}
+
+void NormalEngine::computePointCloudNormals(const std::vector<Point3D> &vertices, std::vector<Point3D> &vertexNormals,
+                                            int neighborNb, bool blockOrientation)
+{
+    CMeshO cloud;
+    vcg::tri::Allocator<CMeshO>::AddVertices(cloud, vertices.size());
+    int vertexNb = (int) vertices.size();
+#pragma omp parallel for schedule(static)
+    for (int v = 0; v < vertexNb; ++v) {
+        cloud.vert[v].P() = Point3m(vertices[v].x, vertices[v].y, vertices[v].z);
+    }
+
+    vcg::tri::PointCloudNormal<CMeshO>::Param param;
+    param.fittingAdjNum = neighborNb;
+    param.blockOrientation = blockOrientation;
+    vcg::tri::PointCloudNormal<CMeshO>::Compute(cloud, param);
+
+    vertexNormals.resize(vertexNb);
+#pragma omp parallel for schedule(static)
+    for (int v = 0; v < vertexNb; ++v) {
+        const Point3m &n = cloud.vert[v].cN();
+        vertexNormals[v] = Point3D(n[0], n[1], n[2]);
+    }
+}
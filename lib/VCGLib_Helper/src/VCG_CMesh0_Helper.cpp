@@ -88,9 +88,10 @@ void VCG_CMesh0_Helper::retrieveCMeshData(CMeshO &mesh, std::vector<uint32_t> &i
     indices.resize(mesh.FN()*3);
     faceNormals.resize(mesh.VN() * 3);
 
+    ComponentSpan<const Point3m> coords = static_cast<const CMeshO &>(mesh).vertCoords();
     for (int i = 0; i < mesh.VN(); i++) {
-        Point3D v = {mesh.vert[i].P()[0], mesh.vert[i].P()[1],mesh.vert[i].P()[2]};
-        vertices[i] = v;
+        const Point3m &p = coords[i];
+        vertices[i] = Point3D(p[0], p[1], p[2]);
     }
 
     for (int i = 0; i < mesh.FN(); i++) {
@@ -103,4 +104,29 @@ void VCG_CMesh0_Helper::retrieveCMeshData(CMeshO &mesh, std::vector<uint32_t> &i
         Point3D n = {mesh.face[i].N()[0], mesh.face[i].N()[1],mesh.face[i].N()[2]};
         faceNormals[i] = n;
     }
-}
\ No newline at end of file
+}
+
+void VCG_CMesh0_Helper::updateBoundingBox(CMeshO &mesh)
+{
+    ComponentSpan<const Point3m> coords = static_cast<const CMeshO &>(mesh).vertCoords();
+    ComponentSpan<const int> flags = static_cast<const CMeshO &>(mesh).vertFlags();
+
+    Point3m bbMin(std::numeric_limits<Scalarm>::max(), std::numeric_limits<Scalarm>::max(), std::numeric_limits<Scalarm>::max());
+    Point3m bbMax = -bbMin;
+    bool empty = true;
+    for (size_t i = 0; i < coords.size(); ++i) {
+        if (flags[i] & CVertexO::DELETED) continue;
+        const Point3m &p = coords[i];
+        for (int k = 0; k < 3; ++k) {
+            bbMin[k] = std::min(bbMin[k], p[k]);
+            bbMax[k] = std::max(bbMax[k], p[k]);
+        }
+        empty = false;
+    }
+
+    mesh.bbox.SetNull();
+    if (!empty) {
+        mesh.bbox.min = bbMin;
+        mesh.bbox.max = bbMax;
+    }
+}
@@ -27,12 +27,18 @@ CMeshO::CMeshO() :
 	vcgTriMesh(),
 	sfn(0), svn(0), pvn(0), pfn(0), Tr(Matrix44m::Identity())
 {
+#ifdef CMESHO_SOA
+	vert.EnableNormal();
+#endif
 }
 
 CMeshO::CMeshO(const CMeshO& oth) :
 	vcgTriMesh(), sfn(oth.sfn), svn(oth.svn),
 	pvn(oth.pvn), pfn(oth.pfn), Tr(oth.Tr)
 {
+#ifdef CMESHO_SOA
+	vert.EnableNormal();
+#endif
 	enableComponentsFromOtherMesh(oth);
 	vcg::tri::Append<vcgTriMesh, vcgTriMesh>::MeshAppendConst(*this, oth);
 	textures = oth.textures;
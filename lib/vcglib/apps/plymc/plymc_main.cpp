@@ -57,6 +57,9 @@ void usage()
       " -p       use vertex splatting instead face rasterizing\n"
       " -d#     set <n> as verbose level (default 0)\n"
       " -D#     save <n> debug slices during processing\n"
+      " -j#     process up to <n> subvolumes concurrently (default 1)\n"
+      " -m#     memory budget in MB that limits the number of concurrent subvolumes\n"
+      " -J      weld all the computed subvolumes into a single 'basename.ply'\n"
 
       "\nNotes:\n\n"
       "The Quality threshold can be expressed in voxel unit or in absolute units.\n"
@@ -196,6 +199,9 @@ int main(int argc, char *argv[])
 	case 'd' : p.VerboseLevel=atoi(argv[i]+2);printf("Enabling VerboseLevel= %i )\n",p.VerboseLevel);break;
   case 'D' : p.VerboseLevel=1; p.SliceNum=atoi(argv[i]+2);printf("Enabling Debug Volume saving of %i slices (VerboseLevel=1)\n",p.SliceNum);break;
 	case 'M' :	p.SimplificationFlag =true; printf("Enabling PostReconstruction simplification\n"); break;
+	case 'j' :	p.ThreadNum =atoi(argv[i]+2); printf("Processing up to %i subvolumes concurrently\n",p.ThreadNum); break;
+	case 'm' :	p.MemoryBudgetMB =atoi(argv[i]+2); printf("Setting memory budget to %i MB\n",p.MemoryBudgetMB); break;
+	case 'J' :	p.WeldBlocksFlag =true; printf("Enabling welding of the subvolumes\n"); break;
 		default : {printf("Error unable to parse option '%s'\n",argv[i]); exit(0);}
     }
     ++i;
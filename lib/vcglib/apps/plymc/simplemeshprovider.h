@@ -15,10 +15,11 @@ template<class TriMeshType>
     class Pair
     {
     public:
-        Pair(){used=0;}
+        Pair(){used=0;pinned=0;}
         TriMeshType *M;
         std::string Name;
         int used; // 'data' dell'ultimo accesso. si butta fuori quello lru
+        int pinned; // number of Acquire() not yet released; a pinned mesh is never recycled
     };
 
     std::list<Pair> MV;
@@ -43,11 +44,11 @@ public:
     int last;
 
     last = std::numeric_limits<int>::max();
-    oldest = MV.begin();
+    oldest = MV.end();
 
     for(mi=MV.begin();mi!=MV.end();++mi)
         {
-            if((*mi).used<last)
+            if((*mi).pinned==0 && (*mi).used<last)
             {
                 last=(*mi).used;
                 oldest=mi;
@@ -62,7 +63,7 @@ public:
     // we have not found the requested mesh
     // either allocate a new mesh or give back a previous mesh.
 
-    if(MV.size()>MaxSize)	{
+    if(MV.size()>MaxSize && oldest!=MV.end())	{
         sm=(*oldest).M;
         (*oldest).used=0;
         (*oldest).Name=name;
@@ -75,6 +76,24 @@ public:
     return false;
 }
 
+// Come Find, ma la mesh resta in cache finche' non viene chiamata Release().
+// Le chiamate devono essere serializzate dal chiamante.
+    bool Acquire(std::string &name,  TriMeshType * &sm)
+    {
+        bool found = Find(name,sm);
+        for(typename std::list<Pair>::iterator mi=MV.begin();mi!=MV.end();++mi)
+            if((*mi).M==sm) (*mi).pinned++;
+        return found;
+    }
+
+    void Release(std::string &name)
+    {
+        for(typename std::list<Pair>::iterator mi=MV.begin();mi!=MV.end();++mi)
+            if((*mi).Name==name && (*mi).pinned>0) {
+                (*mi).pinned--;
+                return;
+            }
+    }
 
     size_t MaxSize;
     size_t size() const {return MV.size();}
@@ -154,6 +173,16 @@ template<class TriMeshType>
         return MC.Find(meshnames[i],sm);
     }
 
+    bool Acquire(int i, TriMeshType * &sm)
+    {
+        return MC.Acquire(meshnames[i],sm);
+    }
+
+    void Release(int i)
+    {
+        MC.Release(meshnames[i]);
+    }
+
     bool InitBBox()
     {
       fullBBox.SetNull();
@@ -21,6 +21,7 @@ SUBDIRS = \
 	trimesh_attribute_saving \
 	trimesh_ball_pivoting \
 	trimesh_base  \
+	trimesh_bench \
 	trimesh_closest \
 	trimesh_clustering \
 	trimesh_color \
@@ -33,6 +34,7 @@ SUBDIRS = \
 	trimesh_geodesic \
 	trimesh_harmonic \
 	trimesh_hole \
+	trimesh_hole_pinched \
 	trimesh_implicit_smooth \
 	trimesh_indexing \
 	trimesh_inertia \
@@ -45,12 +47,16 @@ SUBDIRS = \
 	trimesh_normal \
 	trimesh_optional \
 	trimesh_pointmatching \
+	trimesh_pointcloud_normal \
 	trimesh_pointcloud_sampling \
 	trimesh_ray \
 	trimesh_refine \
 	trimesh_remeshing \
+	trimesh_remeshing_parallel \
+	trimesh_resampler_sparse \
 	trimesh_sampling \
 	trimesh_select \
+	trimesh_selfintersection_bvh \
 	trimesh_smooth \
 	trimesh_split_vertex \
 	trimesh_texture \
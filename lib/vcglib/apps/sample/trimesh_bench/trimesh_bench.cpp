@@ -0,0 +1,199 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+/*! \file trimesh_bench.cpp
+\ingroup code_sample
+
+\brief timings of the parallel Poisson disk sampling, curvature and smoothing against the serial ones
+
+Usage: trimesh_bench poisson [montecarlo sample number, default 10M]
+       trimesh_bench curvature [vertex number, default 10M]
+       trimesh_bench smooth [torus subdivision, default 1024] [steps, default 50]
+
+All run on a torus with radii 4 and 1. Set OMP_NUM_THREADS to compare the thread counts.
+- poisson: the Montecarlo pool is pruned to about one sample every 40; the parallel result only depends on the seed.
+- curvature: FF/VF adjacency against a flat OneRing; the analytic Gaussian curvature is in -1/3 .. 1/5.
+- smooth: face scanning Laplacian and Taubin against a OneRing built once; the difference is the
+  largest vertex displacement between the two.
+*/
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include <vcg/complex/complex.h>
+
+#include <vcg/complex/algorithms/create/platonic.h>
+#include <vcg/complex/algorithms/point_sampling.h>
+#include <vcg/complex/algorithms/update/curvature.h>
+#include <vcg/complex/algorithms/smooth.h>
+
+class MyFace;
+class MyVertex;
+struct MyUsedTypes : public vcg::UsedTypes<	vcg::Use<MyVertex>   ::AsVertexType,
+                                            vcg::Use<MyFace>     ::AsFaceType>{};
+
+class MyVertex  : public vcg::Vertex<MyUsedTypes, vcg::vertex::Coord3f, vcg::vertex::Normal3f, vcg::vertex::VFAdj, vcg::vertex::CurvatureDirf, vcg::vertex::BitFlags  >{};
+class MyFace    : public vcg::Face< MyUsedTypes, vcg::face::FFAdj, vcg::face::VFAdj, vcg::face::Normal3f, vcg::face::VertexRef, vcg::face::BitFlags > {};
+class MyMesh    : public vcg::tri::TriMesh< std::vector<MyVertex>, std::vector<MyFace> > {};
+
+typedef vcg::tri::UpdateCurvature<MyMesh> Curvature;
+typedef vcg::tri::Smooth<MyMesh> Smooth;
+
+static double elapsed(std::chrono::steady_clock::time_point t0)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static void Poisson(MyMesh &m, int montecarloNum, bool parallel)
+{
+  typedef vcg::tri::SurfaceSampling<MyMesh, vcg::tri::MeshSampler<MyMesh> > MontecarloSampling;
+  typedef vcg::tri::SurfaceSampling<MyMesh, vcg::tri::TrivialSampler<MyMesh> > PoissonSampling;
+  const unsigned int seed = 1234;
+  float radius = PoissonSampling::ComputePoissonDiskRadius(m, montecarloNum / 40);
+
+  MyMesh montecarloMesh;
+  vcg::tri::MeshSampler<MyMesh> mcSampler(montecarloMesh);
+  auto t0 = std::chrono::steady_clock::now();
+  if(parallel)
+    MontecarloSampling::MontecarloParallel(m, mcSampler, montecarloNum, seed);
+  else
+  {
+    MontecarloSampling::SamplingRandomGenerator().initialize(seed);
+    MontecarloSampling::Montecarlo(m, mcSampler, montecarloNum);
+  }
+  vcg::tri::UpdateBounding<MyMesh>::Box(montecarloMesh);
+  double tMC = elapsed(t0);
+
+  std::vector<vcg::Point3f> samples;
+  vcg::tri::TrivialSampler<MyMesh> pdSampler(samples);
+  PoissonSampling::PoissonDiskParam pp;
+  pp.randomSeed = seed;
+  pp.parallelFlag = parallel;
+  t0 = std::chrono::steady_clock::now();
+  PoissonSampling::PoissonDiskPruning(pdSampler, montecarloMesh, radius, pp);
+  printf("%s  montecarlo %7.3fs  pruning %7.3fs  samples %zu\n", parallel ? "Parallel" : "Serial  ",
+         tMC, elapsed(t0), samples.size());
+}
+
+static void CurvatureBench(MyMesh &m)
+{
+  auto KH = vcg::tri::Allocator<MyMesh>::GetPerVertexAttribute<float>(m, std::string("KH"));
+  auto KG = vcg::tri::Allocator<MyMesh>::GetPerVertexAttribute<float>(m, std::string("KG"));
+
+  auto t0 = std::chrono::steady_clock::now();
+  vcg::tri::UpdateTopology<MyMesh>::FaceFace(m);
+  vcg::tri::UpdateTopology<MyMesh>::VertexFace(m);
+  Curvature::MeanAndGaussian(m);
+  double tMG = elapsed(t0);
+  std::vector<float> kh(m.vert.size()), kg(m.vert.size());
+  for(size_t i = 0; i < m.vert.size(); ++i) { kh[i] = KH[i]; kg[i] = KG[i]; }
+  t0 = std::chrono::steady_clock::now();
+  Curvature::PrincipalDirections(m);
+  printf("Adjacency  mean/gaussian %7.3fs  principal directions %7.3fs\n", tMG, elapsed(t0));
+
+  t0 = std::chrono::steady_clock::now();
+  vcg::tri::OneRing<MyMesh> ring(m);
+  Curvature::MeanAndGaussian(m, ring);
+  tMG = elapsed(t0);
+  t0 = std::chrono::steady_clock::now();
+  Curvature::PrincipalDirectionsOneRing(m, ring);
+  printf("One-ring   mean/gaussian %7.3fs  principal directions %7.3fs\n", tMG, elapsed(t0));
+
+  float maxDiffH = 0, maxDiffG = 0;
+  for(size_t i = 0; i < m.vert.size(); ++i)
+  {
+    maxDiffH = std::max(maxDiffH, std::abs(KH[i] - kh[i]));
+    maxDiffG = std::max(maxDiffG, std::abs(KG[i] - kg[i]));
+  }
+  printf("Max difference mean %g gaussian %g\n", maxDiffH, maxDiffG);
+}
+
+static void SmoothBench(MyMesh &base, int steps)
+{
+  // some noise to smooth away
+  srand(0);
+  for(size_t i = 0; i < base.vert.size(); ++i)
+    base.vert[i].P() += vcg::Point3f(rand() % 100, rand() % 100, rand() % 100) * 0.0002f;
+  vcg::tri::UpdateTopology<MyMesh>::FaceFace(base);
+  vcg::tri::UpdateFlags<MyMesh>::FaceBorderFromFF(base);
+
+  MyMesh a, b;
+  vcg::tri::Append<MyMesh, MyMesh>::MeshCopy(b, base);
+  vcg::tri::OneRing<MyMesh> ring(b);
+  for(int k = 0; k < 2; ++k)
+  {
+    vcg::tri::Append<MyMesh, MyMesh>::MeshCopy(a, base);
+    vcg::tri::Append<MyMesh, MyMesh>::MeshCopy(b, base);
+    auto t0 = std::chrono::steady_clock::now();
+    if(k == 0) Smooth::VertexCoordLaplacian(a, steps);
+    else       Smooth::VertexCoordTaubin(a, steps, 0.5f, -0.53f);
+    double tFace = elapsed(t0);
+    t0 = std::chrono::steady_clock::now();
+    if(k == 0) Smooth::VertexCoordLaplacian(b, ring, steps);
+    else       Smooth::VertexCoordTaubin(b, ring, steps, 0.5f, -0.53f);
+    double tRing = elapsed(t0);
+    float d = 0;
+    for(size_t i = 0; i < a.vert.size(); ++i)
+      d = std::max(d, vcg::Distance(a.vert[i].cP(), b.vert[i].cP()));
+    printf("%s  faces %7.3fs  ring %7.3fs  max difference %g\n", k == 0 ? "Laplacian" : "Taubin   ", tFace, tRing, d);
+  }
+}
+
+int main( int argc, char **argv )
+{
+  if(argc < 2)
+  {
+    printf("Usage trimesh_bench poisson|curvature|smooth [size] [steps]\n");
+    return -1;
+  }
+  MyMesh m;
+  if(strcmp(argv[1], "poisson") == 0)
+  {
+    int montecarloNum = argc > 2 ? atoi(argv[2]) : 10000000;
+    vcg::tri::Torus(m, 4, 1, 256, 64);
+    printf("Torus fn:%i  montecarlo samples %i\n", m.FN(), montecarloNum);
+    Poisson(m, montecarloNum, false);
+    Poisson(m, montecarloNum, true);
+  }
+  else if(strcmp(argv[1], "curvature") == 0)
+  {
+    int vertNum = argc > 2 ? atoi(argv[2]) : 10000000;
+    int vRes = std::max(3, int(sqrt(vertNum / 4.0)));
+    vcg::tri::Torus(m, 4, 1, std::max(3, vertNum / vRes), vRes);
+    printf("Torus vn:%i fn:%i\n", m.VN(), m.FN());
+    CurvatureBench(m);
+  }
+  else if(strcmp(argv[1], "smooth") == 0)
+  {
+    int subdiv = argc > 2 ? atoi(argv[2]) : 1024;
+    int steps = argc > 3 ? atoi(argv[3]) : 50;
+    vcg::tri::Torus(m, 4, 1, subdiv, subdiv / 4);
+    printf("Torus fn:%i  steps %i\n", m.FN(), steps);
+    SmoothBench(m, steps);
+  }
+  else
+  {
+    printf("Unknown benchmark %s\n", argv[1]);
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,3 @@
+include(../common.pri)
+TARGET = trimesh_bench
+SOURCES += trimesh_bench.cpp
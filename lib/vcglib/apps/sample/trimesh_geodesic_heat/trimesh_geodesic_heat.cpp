@@ -7,6 +7,7 @@
 #include <vcg/complex/algorithms/update/color.h>
 
 #include <iostream>
+#include <chrono>
 
 
 using namespace vcg;
@@ -77,5 +78,44 @@ int main( int argc, char **argv )
     printf("Cached Time    : %6.3f\n",float(t2-t1)/CLOCKS_PER_SEC);
     tri::io::ExporterPLY<MyMesh>::Save(m,"base_m1.ply",tri::io::Mask::IOM_VERTCOLOR | tri::io::Mask::IOM_VERTQUALITY);
 
+    // many queries on the same mesh: factorize once, then solve a batch of seeds in parallel
+    tri::GeodesicHeatEngine<MyMesh> engine;
+    std::chrono::steady_clock::time_point s0=std::chrono::steady_clock::now();
+    engine.Update(m, 0);
+    std::chrono::steady_clock::time_point s1=std::chrono::steady_clock::now();
+    std::vector<std::vector<int> > seedSets;
+    for(int i=0;i<16;++i)
+        seedSets.push_back(std::vector<int>(1, (i*m.VN())/16));
+    std::vector<Eigen::VectorXd> distances;
+    engine.ComputeBatch(seedSets, distances);
+    std::chrono::steady_clock::time_point s2=std::chrono::steady_clock::now();
+    Eigen::VectorXd approx;
+    engine.ComputeFastMarching(seedSets[0], approx);
+    std::chrono::steady_clock::time_point s3=std::chrono::steady_clock::now();
+    typedef std::chrono::duration<double> Seconds;
+    printf("Engine Update  : %6.3f\n",Seconds(s1-s0).count());
+    printf("Engine %2i seeds: %6.3f\n",int(seedSets.size()),Seconds(s2-s1).count());
+    printf("Fast Marching  : %6.3f (max diff from heat %f)\n",Seconds(s3-s2).count(),(approx-distances[0]).cwiseAbs().maxCoeff());
+
+    // sources that are not vertex indices are rejected, not read out of bounds
+    Eigen::VectorXd rejected;
+    if(engine.Compute(std::vector<int>(1, m.VN()), rejected) || engine.ComputeFastMarching(std::vector<int>(1, -1), rejected))
+    {
+        printf("out of range source accepted\n");
+        return 1;
+    }
+    // a mesh with deleted elements is rejected, not compacted under the caller
+    tri::Allocator<MyMesh>::DeleteFace(m, m.face[0]);
+    try
+    {
+        engine.Update(m, 1);
+        printf("mesh with deleted faces accepted\n");
+        return 1;
+    }
+    catch(const MissingCompactnessException &)
+    {
+        printf("Engine rejects meshes with deleted elements\n");
+    }
+
     return 0;
 }
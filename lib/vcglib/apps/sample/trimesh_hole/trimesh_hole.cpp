@@ -89,13 +89,14 @@ int main(int argc,char ** argv){
             " 2) Minimum weight Ear \n"
             " 3) Selfintersection Ear \n"
             " 4) Minimum weight \n"
+            " 5) Minimum weight up to 8 edges, Minimum weight Ear above, in parallel \n"
             );
         exit(0);
     }
 
     int algorithm = atoi(argv[1]);
     int holeSize  = atoi(argv[2]);
-    if(algorithm < 0 && algorithm > 4)
+    if(algorithm < 1 || algorithm > 5)
     {
     printf("Error in algorithm's selection %i\n",algorithm);
         exit(0);
@@ -136,6 +137,17 @@ int main(int argc,char ** argv){
   case 2:   	tri::Hole<MyMesh>::EarCuttingFill<tri::MinimumWeightEar< MyMesh> >(m,holeSize,false,callback);          break;
   case 3: 		tri::Hole<MyMesh>::EarCuttingIntersectionFill<tri::SelfIntersectionEar< MyMesh> >(m,holeSize,false);		break;
   case 4: 		tri::Hole<MyMesh>::MinimumWeightFill(m,holeSize, false); tri::UpdateTopology<MyMesh>::FaceFace(m);      break;
+  case 5:
+    {
+      tri::Hole<MyMesh>::FillParam pp;
+      pp.maxHoleSize = holeSize;
+      pp.minimumWeightMaxSize = 8;
+      tri::Hole<MyMesh>::FillStats st;
+      tri::Hole<MyMesh>::Fill<tri::MinimumWeightEar< MyMesh> >(m,pp,&st);
+      printf("Filled %i of %i holes (%i minimum weight, %i ear cutting, %i serial), %i faces in %5.3f sec, %8.0f holes/sec\n",
+             st.filledNum,st.holeNum,st.minimumWeightNum,st.earCuttingNum,st.serialNum,st.faceNum,st.sec,st.HolesPerSec());
+    }
+    break;
     }
 
     tri::UpdateFlags<MyMesh>::FaceBorderFromFF(m);
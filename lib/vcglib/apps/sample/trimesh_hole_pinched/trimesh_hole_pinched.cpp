@@ -0,0 +1,94 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+/*! \file trimesh_hole_pinched.cpp
+\ingroup code_sample
+
+\brief Hole::Fill on holes whose boundary loop passes twice through the same vertex.
+
+Two cells of a grid that only share a corner are removed, so that their two squares make a single
+boundary loop of 8 edges and 7 vertices; a third cell away from them makes a plain hole. After
+Hole::Fill there must be no degenerate face, the FF adjacency must be consistent and the same of a
+FaceFace rebuild, and only the outer border of the grid must be left. The program fails otherwise.
+*/
+#include<vcg/complex/complex.h>
+#include<vcg/complex/algorithms/create/platonic.h>
+#include<vcg/complex/algorithms/hole.h>
+
+using namespace vcg;
+using namespace std;
+
+class MyFace;
+class MyVertex;
+struct MyUsedTypes : public UsedTypes<	Use<MyVertex>   ::AsVertexType,
+                                        Use<MyFace>     ::AsFaceType>{};
+
+class MyVertex  : public Vertex<MyUsedTypes, vertex::Coord3f, vertex::Normal3f, vertex::Mark, vertex::BitFlags  >{};
+class MyFace    : public Face< MyUsedTypes, face::VertexRef, face::FFAdj, face::Mark, face::Normal3f, face::BitFlags > {};
+class MyMesh    : public tri::TriMesh< vector<MyVertex>, vector<MyFace> > {};
+
+int main( int argc, char **argv )
+{
+  const int w = 8;
+  MyMesh m;
+  tri::Grid(m, w, w, 1.0f, 1.0f);
+  // the two faces of the cell (i,j) share its (i,j)-(i+1,j+1) diagonal
+  const int cells[3][2] = {{2,2}, {3,3}, {5,1}};
+  for(int c=0;c<3;++c)
+    for(int k=0;k<2;++k)
+      tri::Allocator<MyMesh>::DeleteFace(m, m.face[2*(cells[c][0]*(w-1)+cells[c][1])+k]);
+  tri::Allocator<MyMesh>::CompactEveryVector(m);
+  tri::UpdateTopology<MyMesh>::FaceFace(m);
+  tri::UpdateFlags<MyMesh>::FaceBorderFromFF(m);
+  tri::UpdateNormal<MyMesh>::PerVertexPerFace(m);
+
+  tri::Hole<MyMesh>::FillParam pp;
+  pp.maxHoleSize = 20;   // not the outer border
+  pp.minimumWeightMaxSize = 8;
+  tri::Hole<MyMesh>::FillStats st;
+  tri::Hole<MyMesh>::Fill<tri::MinimumWeightEar<MyMesh> >(m, pp, &st);
+  printf("Filled %i of %i holes (%i minimum weight, %i ear cutting), %i faces\n",
+         st.filledNum, st.holeNum, st.minimumWeightNum, st.earCuttingNum, st.faceNum);
+
+  int degenerate = 0;
+  for(MyMesh::FaceIterator fi=m.face.begin();fi!=m.face.end();++fi) if(!fi->IsD())
+    if(fi->V(0)==fi->V(1) || fi->V(1)==fi->V(2) || fi->V(2)==fi->V(0)) ++degenerate;
+  bool consistent = tri::Clean<MyMesh>::IsFFAdjacencyConsistent(m);
+
+  std::vector<MyFace *> ff;
+  for(MyMesh::FaceIterator fi=m.face.begin();fi!=m.face.end();++fi)
+    for(int z=0;z<3;++z) ff.push_back(fi->IsD() ? 0 : fi->FFp(z));
+  tri::UpdateTopology<MyMesh>::FaceFace(m);
+  int differentFF = 0, borderEdges = 0;
+  size_t k = 0;
+  for(MyMesh::FaceIterator fi=m.face.begin();fi!=m.face.end();++fi)
+    for(int z=0;z<3;++z, ++k) if(!fi->IsD())
+    {
+      if(ff[k] != fi->FFp(z)) ++differentFF;
+      if(face::IsBorder(*fi,z)) ++borderEdges;
+    }
+
+  printf("%i degenerate faces, FF %s, %i FF links different from a rebuild, %i border edges (outer border %i)\n",
+         degenerate, consistent ? "consistent" : "inconsistent", differentFF, borderEdges, 4*(w-1));
+  bool fail = st.filledNum != 2 || st.minimumWeightNum != 1 || degenerate > 0 || !consistent || differentFF > 0 || borderEdges != 4*(w-1);
+  return fail ? 1 : 0;
+}
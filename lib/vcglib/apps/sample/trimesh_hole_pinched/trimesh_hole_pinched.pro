@@ -0,0 +1,3 @@
+include(../common.pri)
+TARGET = trimesh_hole_pinched
+SOURCES += trimesh_hole_pinched.cpp
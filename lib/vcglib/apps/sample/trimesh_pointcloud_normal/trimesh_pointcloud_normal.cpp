@@ -0,0 +1,93 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+/*! \file trimesh_pointcloud_normal.cpp
+\ingroup code_sample
+
+\brief Plane fitting normals of a point cloud far from the origin.
+
+A random sample of a tilted unit square is moved farther and farther from the origin and
+its normals are fitted with PointCloudNormal and, as reference, with FitPlaneToPointSet
+over the same neighborhoods. The normals off by more than 8 degrees are counted;
+the program fails when the fitting loses precision with the offset.
+*/
+#include<vcg/complex/complex.h>
+#include<vcg/complex/algorithms/pointcloud_normal.h>
+#include<vcg/math/random_generator.h>
+
+using namespace vcg;
+using namespace std;
+
+class MyEdge;
+class MyFace;
+class MyVertex;
+struct MyUsedTypes : public UsedTypes<	Use<MyVertex>   ::AsVertexType,
+                                        Use<MyEdge>     ::AsEdgeType,
+                                        Use<MyFace>     ::AsFaceType>{};
+
+class MyVertex  : public Vertex<MyUsedTypes, vertex::Coord3d, vertex::Normal3d, vertex::BitFlags  >{};
+class MyFace    : public Face< MyUsedTypes, face::VertexRef, face::BitFlags > {};
+class MyEdge    : public Edge<MyUsedTypes>{};
+class MyMesh    : public tri::TriMesh< vector<MyVertex>, vector<MyFace> , vector<MyEdge>  > {};
+
+int main( int argc, char **argv )
+{
+  int pointNum = argc>1 ? atoi(argv[1]) : 20000;
+  const int nn = 10;
+  const double maxAngle = math::ToRad(8.0);
+  const Point3d planeN = Point3d(1,2,3).Normalize();
+  Point3d u = (planeN ^ Point3d(0,0,1)).Normalize();
+  Point3d v = planeN ^ u;
+
+  const double offsets[] = {0, 1e3, 1e5, 1e6};
+  bool fail=false;
+  for(double off : offsets)
+  {
+    MyMesh m;
+    math::MarsenneTwisterRNG rnd(1);
+    tri::Allocator<MyMesh>::AddVertices(m,pointNum);
+    for(int i=0;i<pointNum;++i)
+      m.vert[i].P() = Point3d(off,off,off) + u*rnd.generate01() + v*rnd.generate01();
+
+    VertexConstDataWrapper<MyMesh> DW(m);
+    KdTree<double> tree(DW);
+    std::vector<unsigned int> nOffsets, neighbors;
+    std::vector<double> sqDists;
+    tree.doQueryKBatch(DW,nn,nOffsets,neighbors,sqDists);
+
+    tri::PointCloudNormal<MyMesh>::ComputeUndirectedNormal(m,std::numeric_limits<double>::max(),nOffsets,neighbors,sqDists);
+    int badFit=0, badRef=0;
+    for(int i=0;i<pointNum;++i)
+    {
+      std::vector<Point3d> ptVec;
+      for(unsigned int j=nOffsets[i];j<nOffsets[i+1];++j)
+        ptVec.push_back(m.vert[neighbors[j]].cP());
+      Plane3d plane;
+      FitPlaneToPointSet(ptVec,plane);
+      if(AngleN(m.vert[i].cN(),planeN) > maxAngle && AngleN(-m.vert[i].cN(),planeN) > maxAngle) ++badFit;
+      if(AngleN(plane.Direction(),planeN) > maxAngle && AngleN(-plane.Direction(),planeN) > maxAngle) ++badRef;
+    }
+    printf("offset %8.0e: %5i / %i normals off by more than 8 deg (FitPlaneToPointSet %i)\n",off,badFit,pointNum,badRef);
+    if(badFit>badRef) fail=true;
+  }
+  return fail ? 1 : 0;
+}
@@ -0,0 +1,3 @@
+include(../common.pri)
+TARGET = trimesh_pointcloud_normal
+SOURCES += trimesh_pointcloud_normal.cpp ../../../wrap/ply/plylib.cpp
@@ -0,0 +1,182 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+/*! \file trimesh_remeshing_parallel.cpp
+\ingroup code_sample
+
+\brief IsotropicRemeshing with and without Params::parallelFlag on the same mesh, and the quality of the two results.
+
+A bumpy torus is remeshed to an edge length of 1% of its bbox diagonal, once serially and once with
+the parallel valence improvement, smoothing and projection (split and collapse are serial in both).
+The two results are not the same mesh: the parallel swaps are decided in rounds. For each the program
+prints the edge length deviation from the target, the triangle quality (inradius over circumradius),
+the share of vertices of valence 6 and the largest distance of the input vertices from the result,
+and fails when the parallel result is worse than the serial one by more than a small tolerance.
+
+Usage: trimesh_remeshing_parallel [iterations, default 10]
+*/
+#include <chrono>
+#include <cstdlib>
+
+#include<vcg/complex/complex.h>
+#include<vcg/complex/algorithms/create/platonic.h>
+#include<vcg/complex/algorithms/isotropic_remeshing.h>
+
+using namespace vcg;
+using namespace std;
+
+class MyEdge;
+class MyFace;
+class MyVertex;
+struct MyUsedTypes : public UsedTypes<	Use<MyVertex>   ::AsVertexType,
+        Use<MyEdge>     ::AsEdgeType,
+        Use<MyFace>     ::AsFaceType>{};
+
+class MyVertex  : public Vertex<MyUsedTypes, vertex::Coord3f, vertex::Normal3f, vertex::VFAdj, vertex::Qualityf, vertex::BitFlags,  vertex::Mark>{};
+class MyFace    : public Face< MyUsedTypes, face::Mark,  face::VertexRef, face::VFAdj, face::FFAdj, face::Normal3f, face::BitFlags > {};
+class MyEdge    : public Edge<MyUsedTypes>{};
+class MyMesh    : public tri::TriMesh< vector<MyVertex>, vector<MyFace> , vector<MyEdge>  > {};
+
+typedef tri::IsotropicRemeshing<MyMesh> Remeshing;
+
+struct MeshQuality
+{
+  float lengthMean, lengthDev;   // relative to the target length
+  float qualityMin, qualityMean;
+  float lowQuality;              // share of the faces of quality below 0.5
+  float valence6;                // share of the vertices of valence 6
+  float maxDist;                 // of the input vertices from the result, relative to the target length
+  double seconds;
+};
+
+static MeshQuality Measure(MyMesh &m, MyMesh &original, float target)
+{
+  MeshQuality q;
+  tri::UpdateTopology<MyMesh>::FaceFace(m);
+  double sum = 0, sum2 = 0;
+  int edgeNum = 0;
+  q.qualityMin = 1;
+  double qualitySum = 0;
+  int lowNum = 0;
+  std::vector<int> valence(m.vert.size(), 0);
+  for(MyFace &f : m.face)
+  {
+    if(f.IsD()) continue;
+    float quality = QualityRadii(f.cP(0), f.cP(1), f.cP(2));
+    q.qualityMin = std::min(q.qualityMin, quality);
+    qualitySum += quality;
+    if(quality < 0.5f) ++lowNum;
+    for(int i = 0; i < 3; ++i)
+    {
+      // every edge once
+      if(face::IsBorder(f, i) || &f < f.FFp(i))
+      {
+        double l = Distance(f.cP(i), f.cP1(i)) / target;
+        sum += l;
+        sum2 += l * l;
+        ++edgeNum;
+        ++valence[tri::Index(m, f.cV(i))];
+        ++valence[tri::Index(m, f.cV1(i))];
+      }
+    }
+  }
+  q.lengthMean = float(sum / edgeNum);
+  q.lengthDev = float(sqrt(std::max(0.0, sum2 / edgeNum - q.lengthMean * q.lengthMean)));
+  q.qualityMean = float(qualitySum / m.FN());
+  q.lowQuality = float(lowNum) / m.FN();
+  int valence6 = 0;
+  for(int v : valence) if(v == 6) ++valence6;
+  q.valence6 = float(valence6) / m.VN();
+
+  // the vertices of the result are projected on the input: measure the other way
+  MyMesh::ScalarType maxDist = 0;
+  tri::UpdateNormal<MyMesh>::PerFaceNormalized(m);
+  GridStaticPtr<MyFace, MyMesh::ScalarType> grid;
+  grid.Set(m.face.begin(), m.face.end());
+  for(MyVertex &v : original.vert)
+  {
+    MyMesh::ScalarType dist = 0;
+    Point3f closest;
+    tri::GetClosestFaceBase(m, grid, v.cP(), original.bbox.Diag(), dist, closest);
+    maxDist = std::max(maxDist, dist);
+  }
+  q.maxDist = maxDist / target;
+  return q;
+}
+
+static void Print(const char *name, const MyMesh &m, const MeshQuality &q)
+{
+  printf("%-8s %6i v %6i f %6.2fs  length %.3f +- %.3f  quality min %.3f mean %.3f, %.2f%% below 0.5  valence 6 %.1f%%  max dist %.4f\n",
+         name, m.VN(), m.FN(), q.seconds, q.lengthMean, q.lengthDev, q.qualityMin, q.qualityMean, 100 * q.lowQuality,
+         100 * q.valence6, q.maxDist);
+}
+
+int main( int argc, char **argv )
+{
+  int iterNum = argc > 1 ? atoi(argv[1]) : 10;
+
+  // a coarse torus with bumps, well below the target resolution in places
+  MyMesh original;
+  tri::Torus(original, 4, 1, 96, 32);
+  for(MyVertex &v : original.vert)
+  {
+    Point3f p = v.P();
+    v.P() += Point3f(0, 0, 0.3f * sin(3 * atan2(p[1], p[0])) * cos(2 * p[2]));
+  }
+  tri::UpdateBounding<MyMesh>::Box(original);
+  tri::UpdateNormal<MyMesh>::PerVertexNormalizedPerFaceNormalized(original);
+  float target = original.bbox.Diag() / 100;
+
+  MyMesh results[2];
+  MeshQuality quality[2];
+  for(int k = 0; k < 2; ++k)
+  {
+    MyMesh &m = results[k];
+    tri::Append<MyMesh, MyMesh>::MeshCopy(m, original);
+    tri::UpdateNormal<MyMesh>::PerVertexNormalizedPerFaceNormalized(m);
+    tri::UpdateBounding<MyMesh>::Box(m);
+    tri::UpdateTopology<MyMesh>::FaceFace(m);
+
+    Remeshing::Params params;
+    params.SetTargetLen(target);
+    params.SetFeatureAngleDeg(30);
+    params.iter = iterNum;
+    params.surfDistCheck = true;
+    params.maxSurfDist = target / 10;
+    params.parallelFlag = (k == 1);
+
+    auto t0 = std::chrono::steady_clock::now();
+    Remeshing::Do(m, original, params);
+    quality[k] = Measure(m, original, target);
+    quality[k].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    Print(k == 0 ? "serial" : "parallel", m, quality[k]);
+  }
+
+  const MeshQuality &s = quality[0], &p = quality[1];
+  bool ok = true;
+  if(fabs(p.lengthMean - s.lengthMean) > 0.02f || p.lengthDev > s.lengthDev + 0.02f) { printf("edge lengths differ\n"); ok = false; }
+  if(p.qualityMean < s.qualityMean - 0.01f || p.lowQuality > s.lowQuality + 0.005f) { printf("worse triangles\n"); ok = false; }
+  if(p.valence6 < s.valence6 - 0.02f) { printf("worse valences\n"); ok = false; }
+  if(p.maxDist > 1.5f * s.maxDist + 0.01f) { printf("further from the input\n"); ok = false; }
+  printf(ok ? "the parallel result is as good as the serial one\n" : "FAILED\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,3 @@
+include(../common.pri)
+TARGET = trimesh_remeshing_parallel
+SOURCES += trimesh_remeshing_parallel.cpp
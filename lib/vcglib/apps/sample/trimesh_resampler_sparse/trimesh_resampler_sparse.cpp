@@ -0,0 +1,140 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+/*! \file trimesh_resampler_sparse.cpp
+\ingroup code_sample
+
+\brief SparseResampler and Resampler on the same meshes, and the comparison of the two surfaces.
+
+A torus and a sphere displaced by Perlin noise are resampled by both resamplers with the same box,
+grid size and maximum distance; the sphere also with an offset and a brick size that does not divide
+the grid. SparseResampler evaluates the same distance field only in the bricks near the surface, so
+the two results must be the same surface: the program compares the vertex and face counts, the vertex
+positions and the faces (as triples of positions, orientation kept) after sorting, and the areas, and
+fails when any of them differ.
+
+Usage: trimesh_resampler_sparse
+*/
+#include <algorithm>
+#include <array>
+#include <chrono>
+
+#include <vcg/complex/complex.h>
+#include <vcg/math/perlin_noise.h>
+#include <vcg/complex/algorithms/create/platonic.h>
+#include <vcg/complex/algorithms/create/resampler.h>
+#include <vcg/complex/algorithms/create/sparse_resampler.h>
+#include <vcg/complex/algorithms/stat.h>
+
+using namespace std;
+using namespace vcg;
+
+class MyFace;
+class MyVertex;
+
+struct MyUsedTypes : public UsedTypes<	Use<MyVertex>::AsVertexType,
+                                        Use<MyFace>  ::AsFaceType>{};
+
+class MyVertex     : public Vertex< MyUsedTypes, vertex::Coord3f, vertex::Normal3f, vertex::BitFlags>{};
+class MyFace       : public Face< MyUsedTypes, face::VertexRef, face::Normal3f, face::BitFlags> {};
+
+class MyMesh       : public tri::TriMesh< std::vector< MyVertex>, std::vector< MyFace > > {};
+
+typedef std::array<Point3f,3> FacePos;
+
+// The faces as position triples, rotated to start from the smallest position so that the orientation is kept.
+static std::vector<FacePos> SortedFaces(MyMesh &m)
+{
+  std::vector<FacePos> faces;
+  for(MyMesh::FaceIterator fi=m.face.begin();fi!=m.face.end();++fi) if(!fi->IsD())
+  {
+    FacePos f = {{fi->P(0),fi->P(1),fi->P(2)}};
+    std::rotate(f.begin(),std::min_element(f.begin(),f.end()),f.end());
+    faces.push_back(f);
+  }
+  std::sort(faces.begin(),faces.end());
+  return faces;
+}
+
+static std::vector<Point3f> SortedVertices(MyMesh &m)
+{
+  std::vector<Point3f> verts;
+  for(MyMesh::VertexIterator vi=m.vert.begin();vi!=m.vert.end();++vi) if(!vi->IsD())
+    verts.push_back(vi->P());
+  std::sort(verts.begin(),verts.end());
+  return verts;
+}
+
+static bool Compare(const char *name, MyMesh &base, float cellNum, float thr, int blockSize)
+{
+  tri::UpdateBounding<MyMesh>::Box(base);
+  tri::UpdateNormal<MyMesh>::PerFaceNormalized(base);
+  Box3f bb = base.bbox;
+  float cell_side = bb.Diag()/cellNum;
+  bb.Offset(cell_side+fabs(thr));
+  Point3i box_size(bb.DimX()/cell_side,bb.DimY()/cell_side,bb.DimZ()/cell_side);
+
+  MyMesh dense,sparse;
+  auto t0 = std::chrono::steady_clock::now();
+  tri::Resampler<MyMesh,MyMesh>::Resample(base,dense,bb,box_size,cell_side*5,thr);
+  auto t1 = std::chrono::steady_clock::now();
+  int bricks = tri::SparseResampler<MyMesh,MyMesh>::Resample(base,sparse,bb,box_size,cell_side*5,thr,false,false,false,0,blockSize);
+  auto t2 = std::chrono::steady_clock::now();
+
+  const float denseArea  = tri::Stat<MyMesh>::ComputeMeshArea(dense);
+  const float sparseArea = tri::Stat<MyMesh>::ComputeMeshArea(sparse);
+  const bool sameCount = dense.VN()==sparse.VN() && dense.FN()==sparse.FN();
+  const bool sameVert  = sameCount && SortedVertices(dense)==SortedVertices(sparse);
+  const bool sameFace  = sameCount && SortedFaces(dense)==SortedFaces(sparse);
+  const bool sameArea  = fabs(denseArea-sparseArea) <= 1e-5f*denseArea;
+  const bool ok = dense.FN()>0 && sameCount && sameVert && sameFace && sameArea;
+
+  printf("%s: grid %ix%ix%i, offset %g, bricks of %i^3\n",name,box_size[0],box_size[1],box_size[2],thr,blockSize);
+  printf("  dense  %7i v %7i f area %10.4f %7.1f ms\n",dense.VN(),dense.FN(),denseArea,
+         std::chrono::duration<double,std::milli>(t1-t0).count());
+  printf("  sparse %7i v %7i f area %10.4f %7.1f ms, %i active bricks\n",sparse.VN(),sparse.FN(),sparseArea,
+         std::chrono::duration<double,std::milli>(t2-t1).count(),bricks);
+  printf("  counts %s, vertices %s, faces %s, area %s: %s\n",sameCount?"same":"DIFFER",sameVert?"same":"DIFFER",
+         sameFace?"same":"DIFFER",sameArea?"same":"DIFFER",ok?"ok":"FAILED");
+  return ok;
+}
+
+int main(int /*argc*/ , char **/*argv*/)
+{
+  MyMesh torus;
+  tri::Torus(torus,10,3);
+
+  MyMesh bumpy;
+  tri::Sphere(bumpy,5);
+  for(MyMesh::VertexIterator vi=bumpy.vert.begin();vi!=bumpy.vert.end();++vi)
+  {
+    Point3f p = vi->P()*3.0f;
+    vi->P() *= 1.0f+0.15f*float(math::Perlin::Noise(p[0],p[1],p[2]));
+  }
+
+  bool ok = Compare("torus",torus,100,0,8);
+  ok = Compare("bumpy sphere",bumpy,70,0,8) && ok;
+  ok = Compare("bumpy sphere",bumpy,70,0.02f,5) && ok;
+
+  printf(ok ? "passed\n" : "FAILED\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,3 @@
+include(../common.pri)
+TARGET = trimesh_resampler_sparse
+SOURCES += trimesh_resampler_sparse.cpp
@@ -0,0 +1,160 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+/*! \file trimesh_selfintersection_bvh.cpp
+\ingroup code_sample
+
+\brief Clean::SelfIntersections and Clean::SelectIntersectingFaces against the grid based versions they replaced.
+
+The two functions find their candidate pairs with a BoxBVH. This sample keeps the previous
+implementation, a uniform grid queried with the box of every face, and runs both on a sphere folded
+by Perlin noise merged with a second sphere that crosses it, with a few deleted faces. It fails when
+the self intersecting faces, or the faces selected against a third mesh and their pair count, differ.
+
+Usage: trimesh_selfintersection_bvh
+*/
+#include <set>
+
+#include <vcg/complex/complex.h>
+#include <vcg/math/perlin_noise.h>
+#include <vcg/complex/append.h>
+#include <vcg/complex/algorithms/clean.h>
+#include <vcg/complex/algorithms/create/platonic.h>
+
+using namespace std;
+using namespace vcg;
+
+class MyFace;
+class MyVertex;
+
+struct MyUsedTypes : public UsedTypes<	Use<MyVertex>::AsVertexType,
+                                        Use<MyFace>  ::AsFaceType>{};
+
+class MyVertex  : public Vertex< MyUsedTypes, vertex::Coord3f, vertex::Normal3f, vertex::BitFlags>{};
+class MyFace    : public Face< MyUsedTypes, face::Mark, face::VertexRef, face::Normal3f, face::BitFlags> {};
+
+class MyMesh    : public tri::TriMesh< vector<MyVertex>, vector<MyFace> > {};
+
+typedef GridStaticPtr<MyFace, float> MyGrid;
+
+// The grid based Clean::SelfIntersections, with the faces collected in a set.
+static std::set<MyFace*> GridSelfIntersections(MyMesh &m)
+{
+  std::set<MyFace*> ret;
+  int referredBit = MyFace::NewBitFlag();
+  tri::UpdateFlags<MyMesh>::FaceClear(m,referredBit);
+
+  MyGrid gM;
+  gM.Set(m.face.begin(),m.face.end());
+
+  for(MyMesh::FaceIterator fi=m.face.begin();fi!=m.face.end();++fi) if(!(*fi).IsD())
+  {
+    (*fi).SetUserBit(referredBit);
+    Box3f bbox;
+    (*fi).GetBBox(bbox);
+    std::vector<MyFace*> inBox;
+    tri::GetInBoxFace(m, gM, bbox,inBox);
+    for(size_t i=0;i<inBox.size();++i)
+      if(!inBox[i]->IsUserBit(referredBit) && inBox[i]!=&*fi)
+        if(tri::Clean<MyMesh>::TestFaceFaceIntersection(&*fi,inBox[i]))
+        {
+          ret.insert(inBox[i]);
+          ret.insert(&*fi);
+        }
+  }
+  MyFace::DeleteBitFlag(referredBit);
+  return ret;
+}
+
+// The grid based Clean::SelectIntersectingFaces.
+static int GridSelectIntersectingFaces(MyMesh &m1, MyMesh &m2)
+{
+  tri::UpdateSelection<MyMesh>::FaceClear(m1);
+  MyGrid gM;
+  gM.Set(m2.face.begin(),m2.face.end());
+  int selCnt=0;
+  for(MyMesh::FaceIterator fi=m1.face.begin();fi!=m1.face.end();++fi)
+  {
+    Box3f bbox;
+    (*fi).GetBBox(bbox);
+    std::vector<MyFace*> inBox;
+    tri::GetInBoxFace(m2, gM, bbox,inBox);
+    for(size_t i=0;i<inBox.size();++i)
+      if(tri::Clean<MyMesh>::TestFaceFaceIntersection(&*fi,inBox[i]))
+      {
+        fi->SetS();
+        ++selCnt;
+      }
+  }
+  return selCnt;
+}
+
+static std::set<MyFace*> Selected(MyMesh &m)
+{
+  std::set<MyFace*> sel;
+  for(MyMesh::FaceIterator fi=m.face.begin();fi!=m.face.end();++fi)
+    if(!fi->IsD() && fi->IsS()) sel.insert(&*fi);
+  return sel;
+}
+
+int main(int /*argc*/, char ** /*argv*/)
+{
+  MyMesh m;
+  tri::Sphere(m,5);
+  for(MyMesh::VertexIterator vi=m.vert.begin();vi!=m.vert.end();++vi)
+  {
+    Point3f p = vi->P()*4.0f;
+    vi->P() *= 1.0f+0.4f*float(math::Perlin::Noise(p[0],p[1],p[2]));
+  }
+  MyMesh crossing;
+  tri::Sphere(crossing,4);
+  tri::UpdatePosition<MyMesh>::Scale(crossing,0.6f);
+  tri::UpdatePosition<MyMesh>::Translate(crossing,Point3f(0.7f,0.1f,0.0f));
+  tri::Append<MyMesh,MyMesh>::Mesh(m,crossing);
+  for(int i=0;i<m.FN();i+=97)
+    tri::Allocator<MyMesh>::DeleteFace(m,m.face[i]);
+  tri::UpdateBounding<MyMesh>::Box(m);
+
+  std::vector<MyFace*> bvhVec;
+  tri::Clean<MyMesh>::SelfIntersections(m,bvhVec);
+  const std::set<MyFace*> bvhSet(bvhVec.begin(),bvhVec.end());
+  const std::set<MyFace*> gridSet = GridSelfIntersections(m);
+  const bool sameSelf = bvhSet==gridSet && bvhSet.size()==bvhVec.size() && !bvhSet.empty();
+  printf("self intersections: bvh %i faces, grid %i faces: %s\n",int(bvhSet.size()),int(gridSet.size()),sameSelf?"same":"DIFFER");
+
+  // SelectIntersectingFaces needs compact meshes
+  tri::Allocator<MyMesh>::CompactEveryVector(m);
+  MyMesh other;
+  tri::Torus(other,1.0f,0.3f);
+  tri::UpdateBounding<MyMesh>::Box(other);
+  const int bvhCnt = tri::Clean<MyMesh>::SelectIntersectingFaces(m,other);
+  const std::set<MyFace*> bvhSel = Selected(m);
+  const int gridCnt = GridSelectIntersectingFaces(m,other);
+  const std::set<MyFace*> gridSel = Selected(m);
+  const bool sameSel = bvhCnt==gridCnt && bvhSel==gridSel && bvhCnt>0;
+  printf("intersecting faces: bvh %i pairs %i selected, grid %i pairs %i selected: %s\n",
+         bvhCnt,int(bvhSel.size()),gridCnt,int(gridSel.size()),sameSel?"same":"DIFFER");
+
+  const bool ok = sameSelf && sameSel;
+  printf(ok ? "passed\n" : "FAILED\n");
+  return ok ? 0 : 1;
+}
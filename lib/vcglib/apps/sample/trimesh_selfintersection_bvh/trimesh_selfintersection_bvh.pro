@@ -0,0 +1,3 @@
+include(../common.pri)
+TARGET = trimesh_selfintersection_bvh
+SOURCES += trimesh_selfintersection_bvh.cpp
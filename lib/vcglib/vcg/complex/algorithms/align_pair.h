@@ -241,7 +241,7 @@ public:
 	{
 	public:
 		enum MatchModeEnum  {MMSimilarity, MMRigid};
-		enum SampleModeEnum {SMRandom, SMNormalEqualized};
+		enum SampleModeEnum {SMRandom, SMNormalEqualized, SMNormalStratified};
 
 		Param()
 		{
@@ -261,6 +261,9 @@ public:
 			MatchMode         = MMRigid;
 			SampleMode        = SMNormalEqualized;
 			UGExpansionFactor = 10;
+			UseVertexOnly     = false;
+			StratifiedGridSize = 8;
+			ParallelFlag      = true;
 		}
 
 		int SampleNum;        //! The intial number of samples that are chosen on the fix mesh.
@@ -286,6 +289,11 @@ public:
 
 		bool UseVertexOnly;     //! if true all the Alignment pipeline ignores faces and works over point clouds.
 
+		int StratifiedGridSize; //! SMNormalStratified: the mov bbox is split in StratifiedGridSize^3 cells, and each cell in normal buckets.
+
+		bool ParallelFlag;      //! if true the closest point search of each ICP iteration runs on all the OpenMP threads.
+		                        //! The fix grid is only read and the pairs are gathered in sample order, so the result does not change.
+
 		double MaxShear;
 		double MaxScale;
 		MatchModeEnum MatchMode;
@@ -425,7 +433,8 @@ public:
 	inline bool sampleMovVert(
 			std::vector<A2Vertex> &vert,
 			int sampleNum,
-			AlignPair::Param::SampleModeEnum sampleMode)
+			AlignPair::Param::SampleModeEnum sampleMode,
+			int stratifiedGridSize = 8)
 	{
 		switch (sampleMode)
 		{
@@ -433,6 +442,8 @@ public:
 			return SampleMovVertRandom(vert, sampleNum);
 		case AlignPair::Param::SMNormalEqualized:
 			return SampleMovVertNormalEqualized(vert, sampleNum);
+		case AlignPair::Param::SMNormalStratified:
+			return SampleMovVertNormalStratified(vert, sampleNum, stratifiedGridSize);
 		default:
 			assert(0);
 			return false;
@@ -490,6 +501,83 @@ public:
 		return true;
 	}
 
+	/*
+	Stratified normal space sampling: the vertices are split in strata, a cell of a
+	gridSize^3 grid over their bbox times a normal bucket, and the samples are taken
+	one per stratum in turn, so that small features and rare orientations get the same
+	share of samples as the large flat regions, whatever the size of the scan.
+	The strata are built in linear time; the cost of the ICP iterations then only
+	depends on sampleNum.
+	*/
+	bool SampleMovVertNormalStratified(std::vector<A2Vertex> &vert, int sampleNum, int gridSize)
+	{
+		if (int(vert.size()) <= sampleNum)
+			return true;
+		gridSize = std::max(gridSize, 1);
+
+		std::vector<Point3d> NV;
+		GenNormal<double>::Fibonacci(30, NV);
+		const int normalNum = int(NV.size());
+
+		Box3d bb;
+		for (size_t i = 0; i < vert.size(); ++i)
+			bb.Add(vert[i].cP());
+		Point3d cellScale;
+		for (int k = 0; k < 3; ++k)
+			cellScale[k] = bb.Dim()[k] > 0 ? gridSize / bb.Dim()[k] : 0;
+
+		const int vn = int(vert.size());
+		std::vector<int> stratum(vn);
+#pragma omp parallel for schedule(static)
+		for (int i = 0; i < vn; ++i) {
+			int c[3];
+			for (int k = 0; k < 3; ++k)
+				c[k] = std::min(int((vert[i].cP()[k] - bb.min[k]) * cellScale[k]), gridSize - 1);
+			int cell = (c[0] * gridSize + c[1]) * gridSize + c[2];
+			stratum[i] = cell * normalNum + GenNormal<double>::BestMatchingNormal(vert[i].cN(), NV);
+		}
+
+		// counting sort of the vertices by stratum
+		const int stratumNum = gridSize * gridSize * gridSize * normalNum;
+		std::vector<int> offsets(stratumNum + 1, 0);
+		for (int i = 0; i < vn; ++i)
+			++offsets[stratum[i] + 1];
+		for (int s = 0; s < stratumNum; ++s)
+			offsets[s + 1] += offsets[s];
+		std::vector<int> sorted(vn);
+		std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+		for (int i = 0; i < vn; ++i)
+			sorted[cursor[stratum[i]]++] = i;
+
+		// non empty strata, visited in a random order, the same at every round
+		std::vector<int> active;
+		for (int s = 0; s < stratumNum; ++s)
+			if (offsets[s + 1] > offsets[s])
+				active.push_back(s);
+		for (int j = int(active.size()) - 1; j > 0; --j)
+			std::swap(active[j], active[myrnd.generate(j + 1)]);
+
+		std::vector<A2Vertex> chosen;
+		chosen.reserve(sampleNum);
+		for (int round = 0; int(chosen.size()) < sampleNum; ++round) {
+			size_t stillActive = 0;
+			for (size_t j = 0; j < active.size() && int(chosen.size()) < sampleNum; ++j) {
+				const int s = active[j];
+				const int sz = offsets[s + 1] - offsets[s];
+				// partial Fisher-Yates inside the stratum
+				int *bucket = &sorted[offsets[s]];
+				std::swap(bucket[round], bucket[round + myrnd.generate(sz - round)]);
+				chosen.push_back(vert[bucket[round]]);
+				if (round + 1 < sz)
+					active[stillActive++] = s;
+			}
+			active.resize(stillActive);
+		}
+		vert.swap(chosen);
+
+		return true;
+	}
+
 	/*
 	This function is used to choose remove outliers after each ICP iteration.
 	All the points with a distance over the given Percentile are discarded.
@@ -671,55 +759,45 @@ in
 				fixbox = uv.bbox;
 			else
 				fixbox = u.bbox;
-			for (i = 0; i < LocSampleNum; ++i) {
-				if (beyondCntVec[i] < maxBeyondCnt) {
-					if (fixbox.IsIn(movvert[i])) {
-						double error = startMinDist;
-						Point3d closestPoint, closestNormal;
-						double maxd = startMinDist;
-						ii.SampleTested++;
-						if (u.Empty()) {  // using the point cloud grid 
-							A2Mesh::VertexPointer vp = tri::GetClosestVertex(*fix, uv, movvert[i], maxd, error);
-							if (error >= startMinDist) {
-								ii.DistanceDiscarded++; ++beyondCntVec[i]; continue;
-							}
-							if (movnorm[i].dot(vp->N()) < cosAngleThr) {
-								ii.AngleDiscarded++; continue;
-							}
-							closestPoint = vp->P();
-							closestNormal = vp->N();
-						}
-						else {			// using the standard faces and grid
-							A2Mesh::FacePointer f = vcg::tri::GetClosestFaceBase<vcg::AlignPair::A2Mesh, vcg::AlignPair::A2Grid >(*fix, u, movvert[i], maxd, error, closestPoint);
-							if (error >= startMinDist) {
-								ii.DistanceDiscarded++; ++beyondCntVec[i]; continue;
-							}
-							if (movnorm[i].dot(f->N()) < cosAngleThr) {
-								ii.AngleDiscarded++; continue;
-							}
-							Point3d ip;
-							InterpolationParameters<A2Face, double>(*f, f->N(), closestPoint, ip);
-							const double IP_EPS = 0.00001;
-							// If ip[i] == 0 it means that we are on the edge opposite to i
-							if ((fabs(ip[0]) <= IP_EPS && f->IsB(1)) || (fabs(ip[1]) <= IP_EPS && f->IsB(2)) || (fabs(ip[2]) <= IP_EPS && f->IsB(0))){
-								ii.BorderDiscarded++;  continue;
-							}
-							closestNormal = f->N();
-						}
-						// The sample was accepted. Store it.
-						pmov.push_back(movvert[i]);
-						opmov.push_back((*mov)[i].P());
-						onmov.push_back((*mov)[i].N());
-						nfix.push_back(closestNormal);
-						pfix.push_back(closestPoint);
-						h.Add(float(error));
-						ii.SampleUsed++;
-					}
-					else {
-						beyondCntVec[i] = maxBeyondCnt + 1;
-					}
+			// Every sample only touches its own slot (and its own beyondCntVec entry), so the
+			// search can run in parallel against the shared grid; the accepted pairs and the
+			// histogram are then gathered in sample order, exactly as the serial loop did.
+			std::vector<Match> matchVec(LocSampleNum);
+			int sampleTested = 0, distanceDiscarded = 0, angleDiscarded = 0, borderDiscarded = 0;
+#pragma omp parallel for schedule(dynamic, 64) if(ap.ParallelFlag) reduction(+: sampleTested, distanceDiscarded, angleDiscarded, borderDiscarded)
+			for (int i = 0; i < LocSampleNum; ++i) {
+				if (beyondCntVec[i] >= maxBeyondCnt)
+					continue;
+				if (!fixbox.IsIn(movvert[i])) {
+					beyondCntVec[i] = maxBeyondCnt + 1;
+					continue;
+				}
+				sampleTested++;
+				switch (findMatch(u, uv, movvert[i], movnorm[i], startMinDist, cosAngleThr, matchVec[i])) {
+				case Match::DISTANCE: distanceDiscarded++; ++beyondCntVec[i]; break;
+				case Match::ANGLE:    angleDiscarded++;    break;
+				case Match::BORDER:   borderDiscarded++;   break;
+				default: break;
 				}
-			} // End for each pmov
+			}
+			ii.SampleTested      = sampleTested;
+			ii.DistanceDiscarded = distanceDiscarded;
+			ii.AngleDiscarded    = angleDiscarded;
+			ii.BorderDiscarded   = borderDiscarded;
+
+			for (i = 0; i < LocSampleNum; ++i) {
+				const Match &m = matchVec[i];
+				if (m.result != Match::USED)
+					continue;
+				// The sample was accepted. Store it.
+				pmov.push_back(movvert[i]);
+				opmov.push_back((*mov)[i].P());
+				onmov.push_back((*mov)[i].N());
+				nfix.push_back(m.closestNormal);
+				pfix.push_back(m.closestPoint);
+				h.Add(float(m.error));
+				ii.SampleUsed++;
+			}
 			int tts1 = clock();
 			printf("Found %d pairs\n",(int)pfix.size());
 			if (!choosePoints(pfix, nfix, pmov, opmov, ap.PassHiFilter, h)) {
@@ -801,6 +879,64 @@ in
 		return true;
 	}
 
+	// Outcome of the closest point search of a single mov sample.
+	struct Match
+	{
+		enum Result { NONE, USED, DISTANCE, ANGLE, BORDER };
+
+		Result  result = NONE;
+		double  error  = 0;
+		Point3d closestPoint;
+		Point3d closestNormal;
+	};
+
+	/*
+	 * Searches the fix mesh (through the face grid, or the vertex grid when the face one is empty)
+	 * for the point closest to p, and checks it against the distance, angle and border criteria.
+	 * Only reads the grids and the fix mesh: the face marks are not used (EmptyTMark) so that
+	 * it can be called concurrently. Skipping the marks only means that a face spanning several
+	 * cells may be tested more than once, the closest point found is the same.
+	*/
+	inline Match::Result findMatch(
+			A2Grid &u,
+			A2GridVert &uv,
+			const Point3d &p,
+			const Point3d &n,
+			double startMinDist,
+			double cosAngleThr,
+			Match &m) const
+	{
+		double maxd = startMinDist;
+		m.error = startMinDist;
+		if (u.Empty()) {  // using the point cloud grid
+			A2Mesh::VertexPointer vp = tri::GetClosestVertex(*fix, uv, p, maxd, m.error);
+			if (m.error >= startMinDist)
+				return m.result = Match::DISTANCE;
+			if (n.dot(vp->N()) < cosAngleThr)
+				return m.result = Match::ANGLE;
+			m.closestPoint = vp->P();
+			m.closestNormal = vp->N();
+		}
+		else {			// using the standard faces and grid
+			tri::EmptyTMark<A2Mesh> mf;
+			mf.SetMesh(fix);
+			face::PointDistanceBaseFunctor<double> PDistFunct;
+			A2Mesh::FacePointer f = u.GetClosest(PDistFunct, mf, p, maxd, m.error, m.closestPoint);
+			if (m.error >= startMinDist)
+				return m.result = Match::DISTANCE;
+			if (n.dot(f->N()) < cosAngleThr)
+				return m.result = Match::ANGLE;
+			Point3d ip;
+			InterpolationParameters<A2Face, double>(*f, f->N(), m.closestPoint, ip);
+			const double IP_EPS = 0.00001;
+			// If ip[i] == 0 it means that we are on the edge opposite to i
+			if ((fabs(ip[0]) <= IP_EPS && f->IsB(1)) || (fabs(ip[1]) <= IP_EPS && f->IsB(2)) || (fabs(ip[2]) <= IP_EPS && f->IsB(0)))
+				return m.result = Match::BORDER;
+			m.closestNormal = f->N();
+		}
+		return m.result = Match::USED;
+	}
+
 	/*
 	 * Function called by Align at every cycle.
 	 * It fills the <MovVert> and <MovNorm> vectors with the coordinates and normals
@@ -814,21 +950,22 @@ in
 			Box3d &movbox,
 			const Matrix44d &in	)
 	{
-		Point3d pp, nn;
-
-		movvert.clear();
-		movnorm.clear();
+		const int vn = int(mov->size());
+		movvert.resize(vn);
+		movnorm.resize(vn);
 		movbox.SetNull();
 
-		A2Mesh::VertexIterator vi;
-		for (vi = mov->begin(); vi != mov->end(); vi++) {
-			pp = in*(*vi).P();
-			nn = in*Point3d((*vi).P() + (*vi).N()) - pp;
+#pragma omp parallel for schedule(static) if(ap.ParallelFlag && vn > 4096)
+		for (int i = 0; i < vn; ++i) {
+			const A2Vertex &v = (*mov)[i];
+			Point3d pp = in*v.cP();
+			Point3d nn = in*Point3d(v.cP() + v.cN()) - pp;
 			nn.Normalize();
-			movvert.push_back(pp);
-			movnorm.push_back(nn);
-			movbox.Add(pp);
+			movvert[i] = pp;
+			movnorm[i] = nn;
 		}
+		for (int i = 0; i < vn; ++i)
+			movbox.Add(movvert[i]);
 		return true;
 	}
 
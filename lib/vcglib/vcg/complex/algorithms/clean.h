@@ -31,6 +31,7 @@
 #include <vcg/complex/algorithms/closest.h>
 #include <vcg/space/index/grid_static_ptr.h>
 #include <vcg/space/index/spatial_hashing.h>
+#include <vcg/space/index/box_bvh.h>
 #include <vcg/complex/algorithms/update/normal.h>
 #include <vcg/space/triangle3.h>
 #include <vcg/complex/append.h>
@@ -1716,40 +1717,28 @@ public:
 		return total;
 	}
 
+	/**
+	  Collects in ret the faces that intersect some other face of the mesh (adjacent faces only count if
+	  they overlap beyond their shared vertices or edge, see TestFaceFaceIntersection).
+	  Candidate pairs come from a parallel traversal of a bounding volume hierarchy of the face boxes,
+	  each unordered pair is tested once. The faces are returned once each, in mesh order.
+	  */
 	static bool SelfIntersections(MeshType &m, std::vector<FaceType*> &ret)
 	{
-		RequirePerFaceMark(m);
 		ret.clear();
-		int referredBit = FaceType::NewBitFlag();
-		tri::UpdateFlags<MeshType>::FaceClear(m,referredBit);
-
-		TriMeshGrid gM;
-		gM.Set(m.face.begin(),m.face.end());
-
-		for(FaceIterator fi=m.face.begin();fi!=m.face.end();++fi) if(!(*fi).IsD())
-		{
-			(*fi).SetUserBit(referredBit);
-			Box3< ScalarType> bbox;
-			(*fi).GetBBox(bbox);
-			std::vector<FaceType*> inBox;
-			vcg::tri::GetInBoxFace(m, gM, bbox,inBox);
-			bool Intersected=false;
-			typename std::vector<FaceType*>::iterator fib;
-			for(fib=inBox.begin();fib!=inBox.end();++fib)
-			{
-				if(!(*fib)->IsUserBit(referredBit) && (*fib != &*fi) )
-					if(Clean<MeshType>::TestFaceFaceIntersection(&*fi,*fib)){
-						ret.push_back(*fib);
-						if(!Intersected) {
-							ret.push_back(&*fi);
-							Intersected=true;
-						}
-					}
-			}
-			inBox.clear();
-		}
-
-		FaceType::DeleteBitFlag(referredBit);
+		BoxBVH<ScalarType> bvh;
+		bvh.Build(FaceBoxes(m));
+
+		std::vector<std::pair<int,int> > pairs;
+		BoxBVH<ScalarType>::OverlapPairs(bvh, bvh, [&](int i, int j) {
+			return TestFaceFaceIntersection(&m.face[i], &m.face[j]);
+		}, pairs);
+
+		std::vector<char> intersected(m.face.size(), 0);
+		for (const auto &p : pairs)
+			intersected[p.first] = intersected[p.second] = 1;
+		for (size_t i = 0; i < m.face.size(); ++i)
+			if (intersected[i]) ret.push_back(&m.face[i]);
 		return (ret.size()>0);
 	}
 
@@ -2063,37 +2052,53 @@ public:
 	}
 	/**
   Select the faces on the first mesh that intersect the second mesh.
-  It uses a grid for querying so a face::mark should be added.
+  The faces of the second mesh go in a bounding volume hierarchy, queried in parallel by the faces
+  of the first one. Returns the number of intersecting face pairs.
   */
 	static int SelectIntersectingFaces(MeshType &m1, MeshType &m2)
 	{
-		RequirePerFaceMark(m2);
 		RequireCompactness(m1);
 		RequireCompactness(m2);
 
 		tri::UpdateSelection<MeshType>::FaceClear(m1);
 
-		TriMeshGrid gM;
-		gM.Set(m2.face.begin(),m2.face.end());
+		BoxBVH<ScalarType> bvh;
+		bvh.Build(FaceBoxes(m2));
+
 		int selCnt=0;
-		for(auto fi=m1.face.begin();fi!=m1.face.end();++fi)
+		const int faceNum = int(m1.face.size());
+#pragma omp parallel reduction(+: selCnt)
 		{
-			Box3< ScalarType> bbox;
-			(*fi).GetBBox(bbox);
-			std::vector<FaceType*> inBox;
-			vcg::tri::GetInBoxFace(m2, gM, bbox,inBox);
-			for(auto fib=inBox.begin(); fib!=inBox.end(); ++fib)
+			std::vector<int> stack;
+#pragma omp for schedule(dynamic, 256)
+			for (int i = 0; i < faceNum; ++i)
 			{
-				if(Clean<MeshType>::TestFaceFaceIntersection(&*fi,*fib)){
-					fi->SetS();
-					++selCnt;
-				}
+				FaceType *f = &m1.face[i];
+				Box3<ScalarType> bbox;
+				f->GetBBox(bbox);
+				bvh.BoxQuery(bbox, [&](int j) {
+					if (TestFaceFaceIntersection(f, &m2.face[j])) {
+						f->SetS();
+						++selCnt;
+					}
+				}, stack);
 			}
-			inBox.clear();
 		}
 		return selCnt;
 	}
 
+private:
+	// Bounding boxes of the faces, null for the deleted ones.
+	static std::vector<Box3<ScalarType> > FaceBoxes(MeshType &m)
+	{
+		std::vector<Box3<ScalarType> > boxes(m.face.size());
+		const int faceNum = int(m.face.size());
+#pragma omp parallel for schedule(static)
+		for (int i = 0; i < faceNum; ++i)
+			if (!m.face[i].IsD()) m.face[i].GetBBox(boxes[i]);
+		return boxes;
+	}
+
 }; // end class
 /*@}*/
 
@@ -217,7 +217,7 @@ private:
 
     bool Exist(const vcg::Point3i &p0, const vcg::Point3i &p1, VertexPointer &v)
     {
-        int pos = p0.X()+p0.Z()*_bbox.DimX();
+        int pos = (p0.X()-_bbox.min.X())+(p0.Z()-_bbox.min.Z())*_bbox.DimX();
         int vidx;
 
         if (p0.X()!=p1.X()) // punti allineati lungo l'asse X
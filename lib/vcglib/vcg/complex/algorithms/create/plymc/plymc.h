@@ -52,6 +52,7 @@
 #include <vcg/complex/algorithms/local_optimization/tri_edge_collapse_quadric.h>
 
 #include <stdarg.h>
+#include <chrono>
 #include "volume.h"
 #include "tri_edge_collapse_mc.h"
 namespace vcg {
@@ -132,6 +133,9 @@ public:
       SimplificationFlag=false;
       VertSplatFlag=false;
       MergeColor=false;
+      ThreadNum=1;
+      MemoryBudgetMB=0;
+      WeldBlocksFlag=false;
       basename = "plymcout";
     }
 
@@ -164,20 +168,47 @@ public:
     bool SimplificationFlag;
     bool VertSplatFlag;
     bool MergeColor;
+    int ThreadNum;       // number of subvolumes processed concurrently (1: the classical serial loop)
+    int MemoryBudgetMB;  // if >0 it caps the number of concurrent subvolumes (see WorkerNum())
+    bool WeldBlocksFlag; // at the end merge all the subvolume meshes into basename.ply
     std::string basename;
     std::vector<std::string> OutNameVec;
     std::vector<std::string> OutNameSimpVec;
+    std::string OutWeldedName;
   }; //end Parameter class
 
+  /// Per subvolume report, filled by Process() in lexicographic block order
+  class BlockStat
+  {
+  public:
+    BlockStat() : AllocatedBlocks(0),VolumeBytes(0),MeshNum(0),vn(0),fn(0),AddSec(0),MCSec(0),SaveSec(0) {}
+    Point3i IPos;
+    std::string OutName;      // empty if the subvolume did not contain any surface
+    std::string OutNameSimp;
+    int AllocatedBlocks;      // number of BLOCKSIDE^3 voxel blocks allocated in the subvolume
+    size_t VolumeBytes;       // memory used by those blocks
+    int MeshNum;              // meshes rasterized into the subvolume
+    int vn,fn;
+    float AddSec,MCSec,SaveSec;  // wall clock time of the three phases
+  };
+
   /// PLYMC Data
   MeshProvider MP;
   Parameter p;
   Volume<Voxelf> VV;
   std::string errorMessage;
+  std::vector<BlockStat> BlockStatVec;
 
 /// PLYMC Methods
 
   bool InitMesh(SMesh &m, const char *filename, Matrix44f Tr)
+  {
+    return InitMesh(m,filename,Tr,VV);
+  }
+
+  // The mesh is brought in the integer space of the grid. All the subvolumes of a partition share the
+  // same grid, so a loaded mesh can be reused by any of them.
+  bool InitMesh(SMesh &m, const char *filename, Matrix44f Tr, const Volume<Voxelf> &grid)
   {
     int loadmask;
     int ret = tri::io::Importer<SMesh>::Open(m,filename,loadmask);
@@ -245,21 +276,32 @@ public:
       printf("Init Mesh %s (%ivn,%ifn)\n",filename,m.vn,m.fn);
     }
     for(SVertexIterator vi=m.vert.begin(); vi!=m.vert.end();++vi)
-      VV.Interize((*vi).P());
+      grid.Interize((*vi).P());
     return true;
   }
 
   // This function add a mesh (or a point cloud to the volume)
 // the point cloud MUST have normalized vertex normals.
     bool AddMeshToVolumeM(SMesh &m, std::string meshname, const double w )
+    {
+      return AddMeshToVolumeM(m,meshname,w,VV);
+    }
+
+    static float FaceQuality(const typename SMesh::FaceType &f)
+    {
+      return (f.cV(0)->cQ()+f.cV(1)->cQ()+f.cV(2)->cQ())/3.0f;
+    }
+
+    // The mesh is only read, so that the same cached mesh can be rasterized by concurrent subvolumes.
+    bool AddMeshToVolumeM(const SMesh &m, std::string meshname, const double w, Volume<Voxelf> &V )
     {
       tri::RequireCompactness(m);
-      if(!m.bbox.Collide(VV.SubBoxSafe)) return false;
+      if(!m.bbox.Collide(V.SubBoxSafe)) return false;
       size_t found =meshname.find_last_of("/\\");
       std::string shortname = meshname.substr(found+1);
 
       Volume <Voxelf> B;
-      B.Init(VV);
+      B.Init(V);
 
       bool res=false;
       double quality=0;
@@ -269,10 +311,10 @@ public:
       {
         float minq=std::numeric_limits<float>::max(), maxq=-std::numeric_limits<float>::max();
             // Calcolo range qualita geodesica PER FACCIA come media di quelle per vertice
-            for(SFaceIterator fi=m.face.begin(); fi!=m.face.end();++fi){
-                (*fi).Q()=((*fi).V(0)->Q()+(*fi).V(1)->Q()+(*fi).V(2)->Q())/3.0f;
-                minq=std::min((*fi).Q(),minq);
-                maxq=std::max((*fi).Q(),maxq);
+            for(auto fi=m.face.begin(); fi!=m.face.end();++fi){
+                float fq=FaceQuality(*fi);
+                minq=std::min(fq,minq);
+                maxq=std::max(fq,maxq);
             }
 
             // La qualita' e' inizialmente espressa come distanza assoluta dal bordo della mesh
@@ -282,24 +324,24 @@ public:
             // Classical approach: scan each face
             int tt0=clock();
             printf("---- Face Rasterization");
-            for(SFaceIterator fi=m.face.begin(); fi!=m.face.end();++fi)
+            for(auto fi=m.face.begin(); fi!=m.face.end();++fi)
                 {
                     if(closed || (p.PLYFileQualityFlag==false && p.GeodesicQualityFlag==false)) quality=1.0;
-                    else quality=w*(*fi).Q();
+                    else quality=w*FaceQuality(*fi);
                     if(quality)
-                            res |= B.ScanFace((*fi).V(0)->P(),(*fi).V(1)->P(),(*fi).V(2)->P(),quality,(*fi).N());
+                            res |= B.ScanFace((*fi).cV(0)->cP(),(*fi).cV(1)->cP(),(*fi).cV(2)->cP(),quality,(*fi).cN());
                 }
             printf(" : %li\n",clock()-tt0);
 
     } else
     {	// Splat approach add only the vertices to the volume
         printf("Vertex Splatting\n");
-        for(SVertexIterator vi=m.vert.begin();vi!=m.vert.end();++vi)
+        for(auto vi=m.vert.begin();vi!=m.vert.end();++vi)
                 {
                     if(p.PLYFileQualityFlag==false) quality=1.0;
-                    else quality=w*(*vi).Q();
+                    else quality=w*(*vi).cQ();
                     if(quality)
-                        res |= B.SplatVert((*vi).P(),quality,(*vi).N(),(*vi).C());
+                        res |= B.SplatVert((*vi).cP(),quality,(*vi).cN(),(*vi).cC());
                 }
     }
     if(!res) return false;
@@ -318,7 +360,7 @@ public:
         if(p.IntraSmoothFlag)
         {
             Volume <Voxelf> SM;
-            SM.Init(VV);
+            SM.Init(V);
             SM.CopySmooth(B,1,p.QualitySmoothAbs);
             B=SM;
             if(p.VerboseLevel>1) B.SlicedPPM(shortname.c_str(),SFormat("%02is",vstp++),p.SliceNum	);
@@ -328,16 +370,246 @@ public:
     if(p.SmoothNum>0)
         {
             Volume <Voxelf> SM;
-            SM.Init(VV);
+            SM.Init(V);
             SM.CopySmooth(B,1,p.QualitySmoothAbs);
             B=SM;
             if(p.VerboseLevel>1) B.SlicedPPM(shortname.c_str(),SFormat("%02isf",vstp++),p.SliceNum	);
         }
-    VV.Merge(B);
-    if(p.VerboseLevel>0) VV.SlicedPPMQ(std::string("merge_").c_str(),shortname.c_str(),p.SliceNum	);
+    V.Merge(B);
+    if(p.VerboseLevel>0) V.SlicedPPMQ(std::string("merge_").c_str(),shortname.c_str(),p.SliceNum	);
     return true;
 }
 
+  // Number of subvolumes processed at the same time. Each worker holds up to three subvolume sized
+  // volumes (the accumulated one, the one of the mesh being rasterized and a smoothing copy), so
+  // MemoryBudgetMB is divided by three times the dense size of a safe subvolume.
+  int WorkerNum(const Volume<Voxelf> &B, int blockNum) const
+  {
+    int workerNum=std::max(1,p.ThreadNum);
+    if(p.VerboseLevel>0) workerNum=1; // debug slices of different subvolumes would share the file names
+    if(p.MemoryBudgetMB>0)
+    {
+      double voxelNum = double(B.SubPartSafe.DimX())*double(B.SubPartSafe.DimY())*double(B.SubPartSafe.DimZ());
+      double workerMB = 3.0*voxelNum*sizeof(Voxelf)/(1024.0*1024.0);
+      workerNum=std::min(workerNum,std::max(1,int(p.MemoryBudgetMB/workerMB)));
+      printf("Memory budget %i MB, ~%.1f MB per subvolume: %i concurrent subvolumes\n",p.MemoryBudgetMB,workerMB,workerNum);
+    }
+    return std::max(1,std::min(workerNum,blockNum));
+  }
+
+  // Build and save the surface of a single subvolume. V is a scratch volume that is (re)initialized here.
+  // When concurrent is true the meshes are taken pinned from the cache and every access to it is serialized.
+  bool ProcessSubBlock(Volume<Voxelf> &V, Point3i ipos, __int64 cells, const Box3f &fullbf, int saveMask,
+                       bool concurrent, BlockStat &st, vcg::CallBackPos *cb)
+  {
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point t0=Clock::now();
+    st.IPos=ipos;
+
+    V.Init(cells,fullbf,p.IDiv,ipos);
+    printf("\n\n --------------- Allocated subcells. %i\n",V.Allocated());
+
+    std::string filename=p.basename;
+    if(p.IDiv!=Point3i(1,1,1))
+    {
+      std::string subvoltag;
+      V.GetSubVolumeTag(subvoltag);
+      filename+=subvoltag;
+    }
+    /********** Grande loop di scansione di tutte le mesh *********/
+    bool res=false;
+    if(!cb) printf("Step 1: Converting meshes into volume\n");
+    for(int i=0;i<MP.size();++i)
+    {
+      Box3f bbb= MP.bb(i);
+      /**********************/
+      if(cb) cb((i+1)/MP.size(),"Step 1: Converting meshes into volume");
+      /**********************/
+      // if bbox of mesh #i is part of the subblock, then process it
+      if(bbb.Collide(V.SubBoxSafe))
+      {
+        SMesh *sm;
+        bool initOk=true;
+        if(!concurrent)
+        {
+          if(!MP.Find(i,sm)) initOk = InitMesh(*sm,MP.MeshName(i).c_str(),MP.Tr(i),V);
+        }
+        else
+        {
+#pragma omp critical (plymc_cache)
+          {
+            if(!MP.Acquire(i,sm)) initOk = InitMesh(*sm,MP.MeshName(i).c_str(),MP.Tr(i),V);
+            if(!initOk) MP.Release(i);
+          }
+        }
+        if(!initOk)
+        {
+#pragma omp critical (plymc_error)
+          errorMessage = "Failed Init of mesh " +MP.MeshName(i);
+          return false ;
+        }
+        res |= AddMeshToVolumeM(*sm, MP.MeshName(i),MP.W(i),V);
+        st.MeshNum++;
+        if(concurrent)
+        {
+#pragma omp critical (plymc_cache)
+          MP.Release(i);
+        }
+      }
+    }
+
+    //B.Normalize(1);
+    printf("End Scanning\n");
+    if(p.OffsetFlag)
+    {
+      V.Offset(p.OffsetThr);
+      if (p.VerboseLevel>0)
+      {
+        V.SlicedPPM("finaloff","__",p.SliceNum);
+        V.SlicedPPMQ("finaloff","__",p.SliceNum);
+      }
+    }
+    //if(p.VerboseLevel>1) V.SlicedPPM(filename.c_str(),SFormat("_%02im",i),p.SliceNum	);
+
+    for(int i=0;i<p.RefillNum;++i)
+    {
+      V.Refill(3,6);
+      if(p.VerboseLevel>1) V.SlicedPPM(filename.c_str(),SFormat("_%02imsr",i),p.SliceNum	);
+      //if(VerboseLevel>1) V.SlicedPPMQ(filename,SFormat("_%02ips",i++),SliceNum	);
+    }
+
+    for(int i=0;i<p.SmoothNum;++i)
+    {
+      Volume <Voxelf> SM;
+      SM.Init(V);
+      printf("%2i/%2i: ",i,p.SmoothNum);
+      SM.CopySmooth(V,1,p.QualitySmoothAbs);
+      V=SM;
+      V.Refill(3,6);
+      if(p.VerboseLevel>1) V.SlicedPPM(filename.c_str(),SFormat("_%02ims",i),p.SliceNum	);
+    }
+    st.AllocatedBlocks=V.Allocated();
+    st.VolumeBytes=size_t(st.AllocatedBlocks)*Volume<Voxelf>::BLOCKSIDE()*Volume<Voxelf>::BLOCKSIDE()*Volume<Voxelf>::BLOCKSIDE()*sizeof(Voxelf);
+
+    Clock::time_point t1=Clock::now();  //--------
+    st.AddSec=std::chrono::duration<float>(t1-t0).count();
+    printf("Extracting surface...\r");
+    if (p.VerboseLevel>0)
+    {
+      V.SlicedPPM("final","__",p.SliceNum);
+      V.SlicedPPMQ("final","__",p.SliceNum);
+    }
+    MCMesh me;
+    if(res)
+    {
+      typedef vcg::tri::TrivialWalker<MCMesh, Volume <Voxelf> >	  Walker;
+      typedef vcg::tri::MarchingCubes<MCMesh, Walker>             MarchingCubes;
+
+      Walker walker;
+      MarchingCubes	mc(me, walker);
+      /**********************/
+      if(cb) cb(50,"Step 2: Marching Cube...");
+      else printf("Step 2: Marching Cube...\n");
+      /**********************/
+      walker.SetExtractionBox(V.SubPartSafe);
+      walker.BuildMesh(me,V,mc,0);
+
+      // Vertices lying on the border of the subpart are kept by both the adjacent subvolumes,
+      // they have exactly the same coords so that WeldBlocks() can merge them.
+      typename MCMesh::VertexIterator vi;
+      Box3f bbb; bbb.Import(V.SubPart);
+      for(vi=me.vert.begin();vi!=me.vert.end();++vi)
+      {
+        if(!bbb.IsIn((*vi).P()))
+          vcg::tri::Allocator< MCMesh >::DeleteVertex(me,*vi);
+        V.DeInterize((*vi).P());
+      }
+      for (typename MCMesh::FaceIterator fi = me.face.begin(); fi != me.face.end(); ++fi)
+      {
+        if((*fi).V(0)->IsD() || (*fi).V(1)->IsD() || (*fi).V(2)->IsD() )
+          vcg::tri::Allocator< MCMesh >::DeleteFace(me,*fi);
+        else std::swap((*fi).V1(0), (*fi).V2(0));
+      }
+
+      Clock::time_point t2=Clock::now();  //--------
+      st.MCSec=std::chrono::duration<float>(t2-t1).count();
+      if(me.vn >0 || me.fn >0)
+      {
+        st.OutName=filename+std::string(".ply");
+        tri::io::ExporterPLY<MCMesh>::Save(me,st.OutName.c_str(),saveMask);
+        if(p.SimplificationFlag)
+        {
+          /**********************/
+          if(cb) cb(50,"Step 3: Simplify mesh...");
+          else printf("Step 3: Simplify mesh...\n");
+          /**********************/
+          st.OutNameSimp=filename+std::string(".d.ply");
+          me.face.EnableVFAdjacency();
+          // the collapse operator keeps its marks in static members
+#pragma omp critical (plymc_simplify)
+          MCSimplify<MCMesh>(me, V.voxel[0]/4.0);
+          tri::Allocator<MCMesh>::CompactFaceVector(me);
+          me.face.EnableFFAdjacency();
+          tri::Clean<MCMesh>::RemoveTVertexByFlip(me,20,true);
+          tri::Clean<MCMesh>::RemoveFaceFoldByFlip(me);
+          tri::io::ExporterPLY<MCMesh>::Save(me,st.OutNameSimp.c_str(),saveMask);
+        }
+      }
+      st.SaveSec=std::chrono::duration<float>(Clock::now()-t2).count();
+    }
+    st.vn=me.vn;
+    st.fn=me.fn;
+
+    printf("Mesh Saved '%s':  %8d vertices, %8d faces                   \n",(filename+std::string(".ply")).c_str(),me.vn,me.fn);
+    return true;
+  }
+
+  void PrintBlockStats() const
+  {
+    float TotAdd=0,TotMC=0,TotSav=0;
+    size_t maxBytes=0;
+    printf("SubBlock  meshes  vol blocks   vol MB    add s     mc s   save s        vn        fn\n");
+    for(size_t i=0;i<BlockStatVec.size();++i)
+    {
+      const BlockStat &st=BlockStatVec[i];
+      printf("%2i %2i %2i  %6i  %10i %8.1f %8.2f %8.2f %8.2f %9i %9i\n",st.IPos[0],st.IPos[1],st.IPos[2],
+             st.MeshNum,st.AllocatedBlocks,st.VolumeBytes/(1024.0*1024.0),st.AddSec,st.MCSec,st.SaveSec,st.vn,st.fn);
+      TotAdd+=st.AddSec; TotMC+=st.MCSec; TotSav+=st.SaveSec;
+      maxBytes=std::max(maxBytes,st.VolumeBytes);
+    }
+    printf("Adding Meshes %8.2f s\n",TotAdd);
+    printf("MC            %8.2f s\n",TotMC);
+    printf("Saving        %8.2f s\n",TotSav);
+    printf("Total         %8.2f s (summed over the subvolumes)\n",TotAdd+TotMC+TotSav);
+    printf("Largest subvolume %.1f MB\n",maxBytes/(1024.0*1024.0));
+  }
+
+  // Merge the subvolume meshes, in lexicographic block order, into a single mesh. The vertices on the
+  // shared faces of adjacent subvolumes are coincident, so the result does not depend on the order
+  // in which the subvolumes have been computed.
+  bool WeldBlocks(int saveMask)
+  {
+    MCMesh full;
+    for(size_t i=0;i<p.OutNameVec.size();++i)
+    {
+      MCMesh part;
+      int loadMask;
+      if(tri::io::ImporterPLY<MCMesh>::Open(part,p.OutNameVec[i].c_str(),loadMask))
+      {
+        errorMessage = "Unable to reload " + p.OutNameVec[i];
+        return false;
+      }
+      tri::Append<MCMesh,MCMesh>::Mesh(full,part);
+    }
+    int dupVert = tri::Clean<MCMesh>::RemoveDuplicateVertex(full);
+    int dupFace = tri::Clean<MCMesh>::RemoveDuplicateFace(full);
+    tri::Allocator<MCMesh>::CompactEveryVector(full);
+    p.OutWeldedName=p.basename+std::string(".ply");
+    printf("Welded %i subvolumes into '%s' (%i border vertices, %i border faces merged)\n",
+           int(p.OutNameVec.size()),p.OutWeldedName.c_str(),dupVert,dupFace);
+    return tri::io::ExporterPLY<MCMesh>::Save(full,p.OutWeldedName.c_str(),saveMask)==0;
+  }
+
 bool Process(vcg::CallBackPos *cb=0)
 {
   errorMessage = "";
@@ -363,10 +635,23 @@ bool Process(vcg::CallBackPos *cb=0)
   if(p.NCell>0) cells = (__int64)(p.NCell)*(__int64)(1000);
   else cells = (__int64)(voxdim[0]/p.VoxSize) * (__int64)(voxdim[1]/p.VoxSize) *(__int64)(voxdim[2]/p.VoxSize) ;
 
+  Box3f fullbf; fullbf.Import(fullb);
+
+  // The subvolumes to be computed, in lexicographic order
+  std::vector<Point3i> blockVec;
+  for(p.IPos[0]=p.IPosS[0];p.IPos[0]<=p.IPosE[0];++p.IPos[0])
+    for(p.IPos[1]=p.IPosS[1];p.IPos[1]<=p.IPosE[1];++p.IPos[1])
+      for(p.IPos[2]=p.IPosS[2];p.IPos[2]<=p.IPosE[2];++p.IPos[2])
+        if((p.IPos[2]+(p.IPos[1]*p.IDiv[2])+(p.IPos[0]*p.IDiv[2]*p.IDiv[1])) >=
+           (p.IPosB[2]+(p.IPosB[1]*p.IDiv[2])+(p.IPosB[0]*p.IDiv[2]*p.IDiv[1]))) // skip until IPos >= IPosB
+          blockVec.push_back(p.IPos);
+        else
+          printf("----------- skipping SubBlock %2i %2i %2i ----------\n",p.IPos[0],p.IPos[1],p.IPos[2]);
+
+  int workerNum;
   {
     Volume<Voxelf> B; // local to this small block
 
-    Box3f fullbf; fullbf.Import(fullb);
     B.Init(cells,fullbf,p.IDiv,p.IPosS);
     B.Dump(stdout);
     if(p.WideSize>0) p.WideNum=p.WideSize/B.voxel.Norm();
@@ -374,165 +659,60 @@ bool Process(vcg::CallBackPos *cb=0)
     // Now the volume has been determined; the quality threshold in absolute units can be computed
     if(p.QualitySmoothAbs==0)
       p.QualitySmoothAbs= p.QualitySmoothVox * B.voxel.Norm();
-  }
-
-
-  int TotAdd=0,TotMC=0,TotSav=0; // partial timings counter
-
-  for(p.IPos[0]=p.IPosS[0];p.IPos[0]<=p.IPosE[0];++p.IPos[0])
-    for(p.IPos[1]=p.IPosS[1];p.IPos[1]<=p.IPosE[1];++p.IPos[1])
-      for(p.IPos[2]=p.IPosS[2];p.IPos[2]<=p.IPosE[2];++p.IPos[2])
-        if((p.IPos[2]+(p.IPos[1]*p.IDiv[2])+(p.IPos[0]*p.IDiv[2]*p.IDiv[1])) >=
-           (p.IPosB[2]+(p.IPosB[1]*p.IDiv[2])+(p.IPosB[0]*p.IDiv[2]*p.IDiv[1]))) // skip until IPos >= IPosB
-        {
-          printf("----------- SubBlock %2i %2i %2i ----------\n",p.IPos[0],p.IPos[1],p.IPos[2]);
-          //Volume<Voxelf> B;
-          int t0=clock();
-
-          Box3f fullbf; fullbf.Import(fullb);
-
-          VV.Init(cells,fullbf,p.IDiv,p.IPos);
-          printf("\n\n --------------- Allocated subcells. %i\n",VV.Allocated());
-
-          std::string filename=p.basename;
-          if(p.IDiv!=Point3i(1,1,1))
-          {
-            std::string subvoltag;
-            VV.GetSubVolumeTag(subvoltag);
-            filename+=subvoltag;
-          }
-          /********** Grande loop di scansione di tutte le mesh *********/
-          bool res=false;
-          if(!cb) printf("Step 1: Converting meshes into volume\n");
-          for(int i=0;i<MP.size();++i)
-          {
-            Box3f bbb= MP.bb(i);
-            /**********************/
-            if(cb) cb((i+1)/MP.size(),"Step 1: Converting meshes into volume");
-            /**********************/
-            // if bbox of mesh #i is part of the subblock, then process it
-            if(bbb.Collide(VV.SubBoxSafe))
-            {
-              SMesh *sm;
-              if(!MP.Find(i,sm) )
-              {
-                res = InitMesh(*sm,MP.MeshName(i).c_str(),MP.Tr(i));
-                if(!res)
-                {
-                  errorMessage = "Failed Init of mesh " +MP.MeshName(i);
-                  return false ;
-                }
-              }
-              res |= AddMeshToVolumeM(*sm, MP.MeshName(i),MP.W(i));
-            }
-          }
 
-          //B.Normalize(1);
-          printf("End Scanning\n");
-          if(p.OffsetFlag)
-          {
-            VV.Offset(p.OffsetThr);
-            if (p.VerboseLevel>0)
-            {
-              VV.SlicedPPM("finaloff","__",p.SliceNum);
-              VV.SlicedPPMQ("finaloff","__",p.SliceNum);
-            }
-          }
-          //if(p.VerboseLevel>1) VV.SlicedPPM(filename.c_str(),SFormat("_%02im",i),p.SliceNum	);
-
-          for(int i=0;i<p.RefillNum;++i)
-          {
-            VV.Refill(3,6);
-            if(p.VerboseLevel>1) VV.SlicedPPM(filename.c_str(),SFormat("_%02imsr",i),p.SliceNum	);
-            //if(VerboseLevel>1) VV.SlicedPPMQ(filename,SFormat("_%02ips",i++),SliceNum	);
-          }
-
-          for(int i=0;i<p.SmoothNum;++i)
-          {
-            Volume <Voxelf> SM;
-            SM.Init(VV);
-            printf("%2i/%2i: ",i,p.SmoothNum);
-            SM.CopySmooth(VV,1,p.QualitySmoothAbs);
-            VV=SM;
-            VV.Refill(3,6);
-            if(p.VerboseLevel>1) VV.SlicedPPM(filename.c_str(),SFormat("_%02ims",i),p.SliceNum	);
-          }
-
-          int t1=clock();  //--------
-          TotAdd+=t1-t0;
-          printf("Extracting surface...\r");
-          if (p.VerboseLevel>0)
-          {
-            VV.SlicedPPM("final","__",p.SliceNum);
-            VV.SlicedPPMQ("final","__",p.SliceNum);
-          }
-          MCMesh me;
-          if(res)
-          {
-            typedef vcg::tri::TrivialWalker<MCMesh, Volume <Voxelf> >	  Walker;
-            typedef vcg::tri::MarchingCubes<MCMesh, Walker>             MarchingCubes;
-
-            Walker walker;
-            MarchingCubes	mc(me, walker);
-            /**********************/
-            if(cb) cb(50,"Step 2: Marching Cube...");
-            else printf("Step 2: Marching Cube...\n");
-            /**********************/
-            walker.SetExtractionBox(VV.SubPartSafe);
-            walker.BuildMesh(me,VV,mc,0);
-
-            typename MCMesh::VertexIterator vi;
-            Box3f bbb; bbb.Import(VV.SubPart);
-            for(vi=me.vert.begin();vi!=me.vert.end();++vi)
-            {
-              if(!bbb.IsIn((*vi).P()))
-                vcg::tri::Allocator< MCMesh >::DeleteVertex(me,*vi);
-              VV.DeInterize((*vi).P());
-            }
-            for (typename MCMesh::FaceIterator fi = me.face.begin(); fi != me.face.end(); ++fi)
-            {
-              if((*fi).V(0)->IsD() || (*fi).V(1)->IsD() || (*fi).V(2)->IsD() )
-                vcg::tri::Allocator< MCMesh >::DeleteFace(me,*fi);
-              else std::swap((*fi).V1(0), (*fi).V2(0));
-            }
+    workerNum=WorkerNum(B,int(blockVec.size()));
+  }
 
-            int t2=clock();  //--------
-            TotMC+=t2-t1;
-            if(me.vn >0 || me.fn >0)
-            {
-              p.OutNameVec.push_back(filename+std::string(".ply"));
-              tri::io::ExporterPLY<MCMesh>::Save(me,p.OutNameVec.back().c_str(),saveMask);
-              if(p.SimplificationFlag)
-              {
-                /**********************/
-                if(cb) cb(50,"Step 3: Simplify mesh...");
-                else printf("Step 3: Simplify mesh...\n");
-                /**********************/
-                p.OutNameSimpVec.push_back(filename+std::string(".d.ply"));
-                me.face.EnableVFAdjacency();
-                MCSimplify<MCMesh>(me, VV.voxel[0]/4.0);
-                tri::Allocator<MCMesh>::CompactFaceVector(me);
-                me.face.EnableFFAdjacency();
-                tri::Clean<MCMesh>::RemoveTVertexByFlip(me,20,true);
-                tri::Clean<MCMesh>::RemoveFaceFoldByFlip(me);
-                tri::io::ExporterPLY<MCMesh>::Save(me,p.OutNameSimpVec.back().c_str(),saveMask);
-              }
-            }
-            int t3=clock();  //--------
-            TotSav+=t3-t2;
+  BlockStatVec.clear();
+  BlockStatVec.resize(blockVec.size());
+  bool ok=true;
+  if(workerNum==1)
+  {
+    for(size_t k=0;k<blockVec.size() && ok;++k)
+    {
+      p.IPos=blockVec[k];
+      printf("----------- SubBlock %2i %2i %2i ----------\n",p.IPos[0],p.IPos[1],p.IPos[2]);
+      ok=ProcessSubBlock(VV,p.IPos,cells,fullbf,saveMask,false,BlockStatVec[k],cb);
+    }
+  }
+  else
+  {
+    // Each worker owns its volume; the meshes are shared through the provider cache, where they are
+    // pinned while in use, so the cache must be large enough to hold one mesh per worker.
+    printf("Processing %i subvolumes on %i workers\n",int(blockVec.size()),workerNum);
+    if(MP.getCacheSize()<workerNum) MP.setCacheSize(workerNum);
+    int blockNum=int(blockVec.size());
+    int doneNum=0;
+#pragma omp parallel for schedule(dynamic,1) num_threads(workerNum)
+    for(int k=0;k<blockNum;++k)
+    {
+      bool cont;
+#pragma omp critical (plymc_progress)
+      cont=ok;
+      if(!cont) continue; // a previous subvolume failed
+      Volume<Voxelf> V;
+      bool blockOk=ProcessSubBlock(V,blockVec[k],cells,fullbf,saveMask,true,BlockStatVec[k],0);
+#pragma omp critical (plymc_progress)
+      {
+        if(!blockOk) ok=false;
+        ++doneNum;
+        printf("----------- SubBlock %2i %2i %2i done (%i/%i) ----------\n",blockVec[k][0],blockVec[k][1],blockVec[k][2],doneNum,blockNum);
+        if(cb) cb((100*doneNum)/blockNum,"Processing subvolumes");
+      }
+    }
+  }
 
-          }
+  // Output names are always collected in lexicographic order, whatever the completion order was.
+  for(size_t k=0;k<BlockStatVec.size();++k)
+  {
+    if(!BlockStatVec[k].OutName.empty()) p.OutNameVec.push_back(BlockStatVec[k].OutName);
+    if(!BlockStatVec[k].OutNameSimp.empty()) p.OutNameSimpVec.push_back(BlockStatVec[k].OutNameSimp);
+  }
+  PrintBlockStats();
+  if(!ok) return false;
 
-          printf("Mesh Saved '%s':  %8d vertices, %8d faces                   \n",(filename+std::string(".ply")).c_str(),me.vn,me.fn);
-          printf("Adding Meshes %8i\n",TotAdd);
-          printf("MC            %8i\n",TotMC);
-          printf("Saving        %8i\n",TotSav);
-          printf("Total         %8i\n",TotAdd+TotMC+TotSav);
-        }
-        else
-        {
-          printf("----------- skipping SubBlock %2i %2i %2i ----------\n",p.IPos[0],p.IPos[1],p.IPos[2]);
-        }
+  if(p.WeldBlocksFlag && p.IDiv!=Point3i(1,1,1) && !p.OutNameVec.empty())
+    return WeldBlocks(saveMask);
   return true;
 }
 
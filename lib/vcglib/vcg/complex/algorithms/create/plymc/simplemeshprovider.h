@@ -48,10 +48,11 @@ class MeshCache
   class Pair
   {
   public:
-    Pair(){used=0;}
+    Pair(){used=0;pinned=0;}
     TriMeshType *M;
     std::string Name;
     int used; // 'data' dell'ultimo accesso. si butta fuori quello lru
+    int pinned; // number of Acquire() not yet released; a pinned mesh is never recycled
   };
   
   std::list<Pair> MV;
@@ -81,11 +82,11 @@ public:
     int last;
     
     last = std::numeric_limits<int>::max();
-    oldest = MV.begin();
+    oldest = MV.end();
     
     for(mi=MV.begin();mi!=MV.end();++mi)
     {
-      if((*mi).used<last)
+      if((*mi).pinned==0 && (*mi).used<last)
       {
         last=(*mi).used;
         oldest=mi;
@@ -100,7 +101,7 @@ public:
     // we have not found the requested mesh
     // either allocate a new mesh or give back a previous mesh.
     
-    if(MV.size()>MeshCacheSize)	{
+    if(MV.size()>MeshCacheSize && oldest!=MV.end())	{
       sm=(*oldest).M;
       (*oldest).used=0;
       (*oldest).Name=name;
@@ -112,7 +113,28 @@ public:
     }
     return false;
   }
-  
+
+  /**
+   * @brief Acquire same as Find, but the mesh stays pinned in the cache until the matching Release().
+   * It allows different threads to use cached meshes while another one loads a new mesh
+   * (the calls must be serialized by the caller).
+   */
+  bool Acquire(const std::string &name,  TriMeshType * &sm)
+  {
+    bool found = Find(name,sm);
+    for(typename std::list<Pair>::iterator mi=MV.begin();mi!=MV.end();++mi)
+      if((*mi).M==sm) (*mi).pinned++;
+    return found;
+  }
+
+  void Release(const std::string &name)
+  {
+    for(typename std::list<Pair>::iterator mi=MV.begin();mi!=MV.end();++mi)
+      if((*mi).Name==name && (*mi).pinned>0) {
+        (*mi).pinned--;
+        return;
+      }
+  }
   
   size_t MeshCacheSize;
   size_t size() const {return MV.size();}
@@ -186,6 +208,16 @@ public:
   {
     return MC.Find(meshnames[i],sm);
   }
+
+  bool Acquire(int i, TriMeshType * &sm)
+  {
+    return MC.Acquire(meshnames[i],sm);
+  }
+
+  void Release(int i)
+  {
+    MC.Release(meshnames[i]);
+  }
   
   bool InitBBox()
   {
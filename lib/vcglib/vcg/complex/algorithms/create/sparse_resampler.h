@@ -0,0 +1,448 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+#ifndef __VCG_MESH_SPARSE_RESAMPLER
+#define __VCG_MESH_SPARSE_RESAMPLER
+
+#include <algorithm>
+#include <unordered_map>
+#include <vcg/complex/algorithms/update/normal.h>
+#include <vcg/complex/algorithms/update/bounding.h>
+#include <vcg/complex/algorithms/create/marching_cubes.h>
+#include <vcg/space/index/kdtree/kdtree_face.h>
+
+namespace vcg {
+namespace tri {
+
+/** \addtogroup trimesh */
+/*@{*/
+/** Class SparseResampler.
+    Narrow band version of Resampler: same distance field, same extracted surface, but the volume
+    is never allocated densely.
+    The grid is split in bricks of BlockSize^3 cells. Only the bricks that can contain a sample
+    closer than max_dist to the old mesh are activated; every active brick evaluates its own
+    (BlockSize+1)^3 samples and runs marching cubes on them independently, in parallel.
+    The brick meshes are then merged and the vertices lying on the brick faces are welded through
+    the id of the grid edge they were generated on. Since a sample shared by two bricks is computed
+    in the same way by both, the welded vertices coincide exactly and the merge is deterministic.
+    Memory is proportional to the number of active bricks, i.e. to the surface area.
+        @param OldMeshType (Template Parameter) Specifies the type of mesh to be resampled
+        @param NewMeshType (Template Parameter) Specifies the type of output mesh.
+ */
+template <class OldMeshType,
+          class NewMeshType,
+          class DISTFUNCTOR = vcg::face::PointDistanceBaseFunctor<typename OldMeshType::ScalarType > >
+class SparseResampler : public BasicGrid<typename NewMeshType::ScalarType>
+{
+  typedef typename NewMeshType::ScalarType NewScalarType;
+  typedef typename NewMeshType::BoxType NewBoxType;
+  typedef typename NewMeshType::CoordType NewCoordType;
+  typedef typename NewMeshType::VertexType* NewVertexPointer;
+  typedef typename OldMeshType::CoordType OldCoordType;
+  typedef typename OldMeshType::FaceType OldFaceType;
+  typedef typename OldMeshType::ScalarType OldScalarType;
+  typedef vcg::KdTreeFace<OldMeshType> GridType;
+  typedef vcg::tri::EmptyTMark<OldMeshType> MarkerFace;
+  typedef std::pair<bool,NewScalarType> field_value;
+
+  // Output of a single brick; positions are in global grid coordinates.
+  struct BrickMesh
+  {
+    std::vector<NewCoordType> vert;
+    std::vector<long long> key;   // grid edge id of the vertices lying on the brick faces, -1 otherwise
+    std::vector<int> face;
+  };
+
+  /// Walker over one brick: samples and intercepts are addressed in brick local coordinates.
+  class BrickWalker
+  {
+  public:
+    BrickWalker(SparseResampler &res, int blockSize) : _r(res), _sz(blockSize+1)
+    {
+      _values.resize(_sz*_sz*_sz);
+      for (int a = 0; a < 3; ++a)
+        _edges[a].resize(_sz*_sz*_sz);
+    }
+
+    void Begin(const Point3i &origin, const Point3i &cells, NewMeshType &m)
+    {
+      _origin = origin;
+      _cells = cells;
+      _m = &m;
+      _key.clear();
+      for (int a = 0; a < 3; ++a)
+        std::fill(_edges[a].begin(), _edges[a].end(), -1);
+
+      for (int k = 0; k <= _cells[2]; ++k)
+        for (int j = 0; j <= _cells[1]; ++j)
+          for (int i = 0; i <= _cells[0]; ++i)
+          {
+            OldCoordType pp(_origin[0]+i, _origin[1]+j, _origin[2]+k);
+            _values[Idx(i,j,k)] = _r.MultiSampleFlag ? _r.MultiDistanceFromMesh(pp) : _r.DistanceFromMesh(pp);
+          }
+    }
+
+    template<class EXTRACTOR_TYPE>
+    void ProcessCells(EXTRACTOR_TYPE &extractor)
+    {
+      for (int k = 0; k < _cells[2]; ++k)
+        for (int j = 0; j < _cells[1]; ++j)
+          for (int i = 0; i < _cells[0]; ++i)
+          {
+            bool goodCell=true;
+            for(int ii=0;ii<2;++ii)
+              for(int jj=0;jj<2;++jj)
+                for(int kk=0;kk<2;++kk)
+                  goodCell &= _values[Idx(i+ii,j+jj,k+kk)].first;
+
+            if(goodCell) extractor.ProcessCell(Point3i(i,j,k), Point3i(i+1,j+1,k+1));
+          }
+    }
+
+    const std::vector<long long> &Keys() const { return _key; }
+
+    NewScalarType V(int x,int y,int z)
+    {
+      const field_value &f = _values[Idx(x,y,z)];
+      if(_r.DiscretizeFlag) return f.second+_r.offset<0?-1:1;
+      return f.second+_r.offset;
+    }
+
+    bool Exist(const vcg::Point3i &p1, const vcg::Point3i &p2, NewVertexPointer &v)
+    {
+      const int pos = _edges[Axis(p1,p2)][Idx(p1[0],p1[1],p1[2])];
+      v = (pos == -1) ? NULL : &_m->vert[pos];
+      return pos != -1;
+    }
+
+    void GetXIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, NewVertexPointer &v) { GetIntercept(p1, p2, 0, v); }
+    void GetYIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, NewVertexPointer &v) { GetIntercept(p1, p2, 1, v); }
+    void GetZIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, NewVertexPointer &v) { GetIntercept(p1, p2, 2, v); }
+
+  private:
+    int Idx(int x, int y, int z) const { return x + _sz*(y + _sz*z); }
+
+    static int Axis(const vcg::Point3i &p1, const vcg::Point3i &p2)
+    {
+      if (p1[0] != p2[0]) return 0;
+      if (p1[1] != p2[1]) return 1;
+      return 2;
+    }
+
+    void GetIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, int dir, NewVertexPointer &v)
+    {
+      int &pos = _edges[dir][Idx(p1[0],p1[1],p1[2])];
+      if (pos == -1)
+      {
+        pos = int(_m->vert.size());
+        Allocator<NewMeshType>::AddVertices(*_m, 1);
+
+        NewScalarType f1 = V(p1[0],p1[1],p1[2]);
+        NewScalarType f2 = V(p2[0],p2[1],p2[2]);
+        NewScalarType u =  f1/(f1-f2);
+        const Point3i g1 = _origin + p1, g2 = _origin + p2;
+        NewCoordType ret(g1[0], g1[1], g1[2]);
+        ret[dir] = g1[dir]*(1.f-u) + u*g2[dir];
+        _m->vert[pos].P() = ret;
+
+        // only the edges lying on a face of the brick can be shared with a neighbour brick
+        bool onFace = false;
+        for (int b = 0; b < 3; ++b)
+          if (b != dir && (p1[b] == 0 || p1[b] == _cells[b])) onFace = true;
+        _key.resize(_m->vert.size(), -1);
+        if (onFace)
+          _key[pos] = _r.EdgeKey(_origin + p1, dir);
+      }
+      v = &_m->vert[pos];
+    }
+
+    SparseResampler &_r;
+    int _sz;
+    Point3i _origin, _cells;
+    NewMeshType *_m;
+    std::vector<field_value> _values;
+    std::vector<int> _edges[3];
+    std::vector<long long> _key;
+  };
+
+public:
+  NewScalarType max_dim; // the limit value of the search (that takes into account of the offset)
+  NewScalarType offset;    // an offset value that is always added to the returned value. Useful for extrarting isosurface  at a different threshold
+  bool DiscretizeFlag; // if the extracted surface should be discretized or not.
+  bool MultiSampleFlag;
+  bool AbsDistFlag; // if true the Distance Field computed is no more a signed one.
+  int BlockSize;   // cells per brick side
+
+  SparseResampler(const Box3<NewScalarType> &_bbox, Point3i _siz, int blockSize = 8)
+  {
+    this->bbox= _bbox;
+    this->siz=_siz;
+    this->ComputeDimAndVoxel();
+    offset=0;
+    DiscretizeFlag=false;
+    MultiSampleFlag=false;
+    AbsDistFlag=false;
+    BlockSize=blockSize;
+  }
+
+  long long EdgeKey(const Point3i &p, int dir) const
+  {
+    return ((((long long)p[0]*(this->siz[1]+1)) + p[1])*(this->siz[2]+1) + p[2])*3 + dir;
+  }
+
+  /// signed distance of a point given in grid coordinates, the same field used by Resampler
+  field_value DistanceFromMesh(OldCoordType &pp)
+  {
+    OldScalarType dist;
+    const NewScalarType max_dist = max_dim;
+    OldCoordType testPt;
+    this->IPfToPf(pp,testPt);
+
+    OldCoordType closestPt;
+    DISTFUNCTOR PDistFunct;
+    MarkerFace markerFunctor;
+    OldFaceType *f = _g.GetClosest(PDistFunct,markerFunctor,testPt,max_dist,dist,closestPt);
+
+    if (f==NULL) return field_value(false,0);
+    if(AbsDistFlag) return field_value(true,dist);
+    assert(!f->IsD());
+
+    OldCoordType pip(-1,-1,-1);
+    bool retIP=InterpolationParameters(*f,(*f).cN(),closestPt, pip);
+    assert(retIP); (void)retIP;
+
+    const NewScalarType InterpolationEpsilon = 0.00001f;
+    int zeroCnt=0;
+    if(pip[0]<InterpolationEpsilon) ++zeroCnt;
+    if(pip[1]<InterpolationEpsilon) ++zeroCnt;
+    if(pip[2]<InterpolationEpsilon) ++zeroCnt;
+    assert(zeroCnt<3);
+
+    OldCoordType dir=(testPt-closestPt).Normalize();
+
+    // On edges and vertices the face normal is not reliable, use the interpolated one
+    NewScalarType signBest;
+    if(zeroCnt>0)
+    {
+      OldCoordType closestNormV = (f->V(0)->cN())*pip[0] + (f->V(1)->cN())*pip[1] + (f->V(2)->cN())*pip[2] ;
+      signBest = dir.dot(closestNormV) ;
+    }
+    else
+    {
+      signBest = dir.dot(f->cN()) ;
+    }
+
+    if(signBest<0) dist=-dist;
+
+    return field_value(true,dist);
+  }
+
+  field_value MultiDistanceFromMesh(OldCoordType &pp)
+  {
+    float distSum=0;
+    int positiveCnt=0; // positive results counter
+    const int MultiSample=7;
+    const OldCoordType   delta[7]={OldCoordType(0,0,0),
+                              OldCoordType( 0.2,  -0.01, -0.02),
+                              OldCoordType(-0.2,   0.01,  0.02),
+                              OldCoordType( 0.01,  0.2,   0.01),
+                              OldCoordType( 0.03, -0.2,  -0.03),
+                              OldCoordType(-0.02, -0.03,  0.2 ),
+                              OldCoordType(-0.01,  0.01, -0.2 )};
+
+    for(int qq=0;qq<MultiSample;++qq)
+    {
+      OldCoordType pp2=pp+delta[qq];
+      field_value ff= DistanceFromMesh(pp2);
+      if(ff.first==false) return field_value(false,0);
+      distSum += fabs(ff.second);
+      if(ff.second>0) positiveCnt ++;
+    }
+    if(positiveCnt<=MultiSample/2) distSum = -distSum;
+    return field_value(true, distSum/MultiSample);
+  }
+
+  /// Collects the bricks that can hold a cell with all the corners closer than max_dim to some face.
+  void ComputeActiveBricks(OldMeshType &old_mesh, std::vector<long long> &active)
+  {
+    const Point3i nb = BrickNum();
+    active.clear();
+#pragma omp parallel
+    {
+      std::vector<long long> local;
+#pragma omp for schedule(dynamic, 1000)
+      for (int fi = 0; fi < int(old_mesh.face.size()); ++fi)
+      {
+        const OldFaceType &f = old_mesh.face[fi];
+        if (f.IsD()) continue;
+        Box3<NewScalarType> fb;
+        for (int j = 0; j < 3; ++j)
+          fb.Add(NewCoordType::Construct(f.cP(j)));
+        fb.Offset(max_dim);
+
+        // cells touching a sample of the inflated box, clamped to the grid
+        Point3i lo, hi;
+        for (int a = 0; a < 3; ++a)
+        {
+          lo[a] = std::max(0,               int(std::floor((fb.min[a]-this->bbox.min[a])/this->voxel[a])) - 1);
+          hi[a] = std::min(this->siz[a] - 1, int(std::ceil ((fb.max[a]-this->bbox.min[a])/this->voxel[a])));
+        }
+        if (lo[0] > hi[0] || lo[1] > hi[1] || lo[2] > hi[2]) continue;
+
+        for (int bz = lo[2]/BlockSize; bz <= hi[2]/BlockSize; ++bz)
+          for (int by = lo[1]/BlockSize; by <= hi[1]/BlockSize; ++by)
+            for (int bx = lo[0]/BlockSize; bx <= hi[0]/BlockSize; ++bx)
+              local.push_back(bx + (long long)nb[0]*(by + (long long)nb[1]*bz));
+      }
+      std::sort(local.begin(), local.end());
+      local.erase(std::unique(local.begin(), local.end()), local.end());
+#pragma omp critical
+      active.insert(active.end(), local.begin(), local.end());
+    }
+
+    // sorting makes the brick order, hence the output, independent of the thread scheduling
+    std::sort(active.begin(), active.end());
+    active.erase(std::unique(active.begin(), active.end()), active.end());
+  }
+
+  /// Returns the number of active bricks.
+  int BuildMesh(OldMeshType &old_mesh, NewMeshType &new_mesh, vcg::CallBackPos *cb)
+  {
+    // the following two steps are required to be sure that the point-face distance without precomputed data works well.
+    tri::UpdateNormal<OldMeshType>::PerFaceNormalized(old_mesh);
+    tri::UpdateNormal<OldMeshType>::PerVertexAngleWeighted(old_mesh);
+    _g.Set(old_mesh.face.begin(),old_mesh.face.end(),(int)old_mesh.fn*100);
+
+    new_mesh.Clear();
+
+    std::vector<long long> active;
+    ComputeActiveBricks(old_mesh, active);
+    if (cb) cb(10, "Marching active bricks");
+
+    const Point3i nb = BrickNum();
+    std::vector<BrickMesh> bricks(active.size());
+#pragma omp parallel
+    {
+      NewMeshType scratch;
+      BrickWalker walker(*this, BlockSize);
+#pragma omp for schedule(dynamic, 1)
+      for (int bi = 0; bi < int(active.size()); ++bi)
+      {
+        const long long id = active[bi];
+        const Point3i b(int(id % nb[0]), int((id / nb[0]) % nb[1]), int(id / ((long long)nb[0]*nb[1])));
+        const Point3i origin = b * BlockSize;
+        Point3i cells;
+        for (int a = 0; a < 3; ++a)
+          cells[a] = std::min(BlockSize, this->siz[a] - origin[a]);
+
+        vcg::tri::MarchingCubes<NewMeshType, BrickWalker> mc(scratch, walker);
+        mc.Initialize();
+        walker.Begin(origin, cells, scratch);
+        walker.ProcessCells(mc);
+        mc.Finalize();
+
+        BrickMesh &out = bricks[bi];
+        out.vert.resize(scratch.vert.size());
+        out.key.assign(scratch.vert.size(), -1);
+        for (size_t i = 0; i < scratch.vert.size(); ++i)
+        {
+          out.vert[i] = scratch.vert[i].cP();
+          if (i < walker.Keys().size()) out.key[i] = walker.Keys()[i];
+        }
+        out.face.reserve(scratch.face.size()*3);
+        for (size_t i = 0; i < scratch.face.size(); ++i)
+          for (int j = 0; j < 3; ++j)
+            out.face.push_back(int(tri::Index(scratch, scratch.face[i].cV(j))));
+      }
+    }
+    if (cb) cb(80, "Welding bricks");
+
+    // Welding: the first brick (in id order) generating a seam vertex owns it.
+    // Non owned vertices are encoded as -(index+1).
+    std::unordered_map<long long, int> seam;
+    std::vector<std::vector<int> > remap(bricks.size());
+    std::vector<int> faceOffset(bricks.size()+1, 0);
+    int vn = 0;
+    for (size_t bi = 0; bi < bricks.size(); ++bi)
+    {
+      const BrickMesh &bm = bricks[bi];
+      remap[bi].resize(bm.vert.size());
+      for (size_t i = 0; i < bm.vert.size(); ++i)
+      {
+        if (bm.key[i] < 0) { remap[bi][i] = vn++; continue; }
+        auto ins = seam.insert(std::make_pair(bm.key[i], vn));
+        remap[bi][i] = ins.second ? vn++ : -(ins.first->second + 1);
+      }
+      faceOffset[bi+1] = faceOffset[bi] + int(bm.face.size()/3);
+    }
+
+    Allocator<NewMeshType>::AddVertices(new_mesh, vn);
+    Allocator<NewMeshType>::AddFaces(new_mesh, faceOffset.back());
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int bi = 0; bi < int(bricks.size()); ++bi)
+    {
+      const BrickMesh &bm = bricks[bi];
+      const std::vector<int> &rm = remap[bi];
+      for (size_t i = 0; i < bm.vert.size(); ++i)
+        if (rm[i] >= 0)
+          this->IPfToPf(bm.vert[i], new_mesh.vert[rm[i]].P());
+
+      for (size_t i = 0; i < bm.face.size()/3; ++i)
+        for (int j = 0; j < 3; ++j)
+        {
+          const int v = rm[bm.face[i*3+j]];
+          new_mesh.face[faceOffset[bi]+i].V(j) = &new_mesh.vert[v >= 0 ? v : -v-1];
+        }
+    }
+    return int(active.size());
+  }
+
+  ///resample the mesh using marching cube algorithm evaluating the distance field only in a narrow band around the surface.
+  ///Same parameters as Resampler::Resample, plus the brick size. Returns the number of active bricks.
+  static int Resample(OldMeshType &old_mesh, NewMeshType &new_mesh,  NewBoxType volumeBox, vcg::Point3<int> accuracy,float max_dist, float thr=0, bool DiscretizeFlag=false, bool MultiSampleFlag=false, bool AbsDistFlag=false, vcg::CallBackPos *cb=0, int blockSize=8)
+  {
+    ///be sure that the bounding box is updated
+    vcg::tri::UpdateBounding<OldMeshType>::Box(old_mesh);
+
+    SparseResampler res(volumeBox, accuracy, blockSize);
+    res.max_dim=max_dist+fabs(thr);
+    res.offset = - thr;
+    res.DiscretizeFlag = DiscretizeFlag;
+    res.MultiSampleFlag = MultiSampleFlag;
+    res.AbsDistFlag = AbsDistFlag;
+    return res.BuildMesh(old_mesh, new_mesh, cb);
+  }
+
+private:
+  Point3i BrickNum() const
+  {
+    return Point3i((this->siz[0]+BlockSize-1)/BlockSize,
+                   (this->siz[1]+BlockSize-1)/BlockSize,
+                   (this->siz[2]+BlockSize-1)/BlockSize);
+  }
+
+  GridType _g;
+};
+
+}//end namespace tri
+}//end namespace vcg
+#endif
@@ -30,6 +30,7 @@
 
 #include <vector>
 #include <memory>
+#include <limits>
 
 namespace vcg{
 namespace tri{
@@ -431,6 +432,340 @@ public:
     }
 };
 
+/**
+ * @brief Geodesic distance service for many queries on the same mesh.
+ *
+ * Update() factorizes the two heat method operators once, together with the per face gradient and
+ * per corner divergence coefficients, and keeps them until it is called with a different revision
+ * of the mesh. Every query then costs two back-substitutions plus two flat parallel loops, and
+ * ComputeBatch() answers independent queries in parallel. The operators are the same of
+ * GeodesicHeat::Compute(), so are the distances, and no adjacency is required.
+ *
+ * Meshes with more than Param::maxHeatVertexNum vertices are not factorized: the queries are then
+ * answered by ComputeFastMarching(), a fast marching over the faces driven by a bucket queue,
+ * that needs only linear memory. It can also be called directly as a fast approximation.
+ *
+ * The engine keeps a pointer to the mesh: the mesh must outlive it. The mesh must have no deleted
+ * vertices or faces (compact it with Allocator::CompactEveryVector() before Update()), so that the
+ * seeds and the distances are indices of its vertex vector. The engine never modifies the mesh.
+ */
+template <class MeshType>
+class GeodesicHeatEngine{
+    typedef typename MeshType::VertexType VertexType;
+    typedef typename MeshType::FaceType FaceType;
+    typedef typename MeshType::CoordType CoordType;
+    typedef Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> Solver;
+
+public:
+    class Param
+    {
+    public:
+        double m = 1;                        // time step of the backward Euler heat step, in squared average edge lengths
+        int maxHeatVertexNum = 2000000;      // larger meshes are not factorized and use fast marching only
+        double bucketWidthPerc = 0.25;       // fast marching bucket width, as a fraction of the average edge length
+    };
+
+    GeodesicHeatEngine() {}
+    GeodesicHeatEngine(const Param &p) : par(p) {}
+
+    /**
+     * @brief Prepares the engine for the given revision of the mesh.
+     *
+     * @param mesh the mesh
+     * @param revision a number that the caller changes every time the mesh geometry or connectivity changes
+     * @return false if the factorization failed (queries then fall back to fast marching)
+     *
+     * Nothing is recomputed when mesh and revision are the ones of the previous call.
+     * Throws MissingCompactnessException if the mesh has deleted vertices or faces; the engine is
+     * then left without a mesh.
+     */
+    bool Update(MeshType &mesh, unsigned long long revision){
+        if(m == &mesh && cachedRevision == revision && valid &&
+           vertNum == int(mesh.vert.size()) && faceNum == int(mesh.face.size()))
+            return factorized || !heatRequested;
+
+        valid = false;
+        vcg::tri::RequireVertexCompactness(mesh);
+        vcg::tri::RequireFaceCompactness(mesh);
+        m = &mesh;
+        cachedRevision = revision;
+        vertNum = int(mesh.vert.size());
+        faceNum = int(mesh.face.size());
+        factorized = false;
+        heatRequested = vertNum <= par.maxHeatVertexNum;
+
+        buildCorners();
+        averageEdgeLength = vcg::tri::Stat<MeshType>::ComputeFaceEdgeLengthAverage(mesh);
+        valid = true;
+        if(!heatRequested) return true;
+
+        Eigen::SparseMatrix<double> massMatrix;
+        Eigen::SparseMatrix<double> cotanMatrix;
+        buildOperators(massMatrix);
+        GeodesicHeat<MeshType>::buildCotanLowerTriMatrix(mesh, cotanMatrix);
+
+        double timestep = par.m * averageEdgeLength * averageEdgeLength;
+        heatSolver.compute(massMatrix - timestep * cotanMatrix);
+        if (heatSolver.info() != Eigen::Success) return false;
+        poissonSolver.compute(cotanMatrix);
+        if (poissonSolver.info() != Eigen::Success) return false;
+        factorized = true;
+        return true;
+    }
+
+    bool IsFactorized() const { return factorized; }
+    unsigned long long Revision() const { return cachedRevision; }
+
+    /**
+     * @brief Distance from the nearest of the given sources (vertex indices).
+     *
+     * Heat method when the mesh is factorized, otherwise fast marching.
+     * @return false if there are no sources, a source is not a vertex index or a solve failed
+     */
+    bool Compute(const std::vector<int> &sources, Eigen::VectorXd &distance) const {
+        assert(valid);
+        if(!ValidSources(sources)) return false;
+        if(!factorized)
+            return ComputeFastMarching(sources, distance);
+
+        Eigen::VectorXd sourcePoints(vertNum);
+        sourcePoints.setZero();
+        for(int s : sources)
+            sourcePoints(s) = 1;
+
+        Eigen::VectorXd heatflow = heatSolver.solve(sourcePoints); // (VN)
+
+        // normalized opposite of the heat gradient on each face
+        std::vector<Eigen::Vector3d> unitField(faceNum);
+#pragma omp parallel for schedule(static)
+        for (int f = 0; f < faceNum; ++f){
+            Eigen::Vector3d g = faceGrad[3*f]   * heatflow(faceVerts[3*f]) +
+                                faceGrad[3*f+1] * heatflow(faceVerts[3*f+1]) +
+                                faceGrad[3*f+2] * heatflow(faceVerts[3*f+2]);
+            unitField[f] = -g / g.norm();
+        }
+
+        // its divergence, every vertex gathering its own corners
+        Eigen::VectorXd divergence(vertNum);
+#pragma omp parallel for schedule(static)
+        for (int v = 0; v < vertNum; ++v){
+            double d = 0;
+            for (int i = cornerOffsets[v]; i < cornerOffsets[v+1]; ++i){
+                const int c = corners[i];
+                d += cornerDiv[c].dot(unitField[c/3]);
+            }
+            divergence(v) = d;
+        }
+
+        distance = poissonSolver.solve(divergence); // (VN)
+        if (!distance.allFinite()) return false;
+
+        // shift to impose dist(source) = 0
+        distance.array() -= distance.minCoeff();
+        return true;
+    }
+
+    /**
+     * @brief Runs independent queries in parallel, one per source set.
+     * @return false if any of the queries failed
+     */
+    bool ComputeBatch(const std::vector<std::vector<int>> &sourceSets, std::vector<Eigen::VectorXd> &distances) const {
+        const int queryNum = int(sourceSets.size());
+        distances.resize(queryNum);
+        int failed = 0;
+#pragma omp parallel for schedule(dynamic, 1) reduction(+: failed)
+        for (int q = 0; q < queryNum; ++q){
+            if (!Compute(sourceSets[q], distances[q]))
+                ++failed;
+        }
+        return failed == 0;
+    }
+
+    /**
+     * @brief Approximated distance by fast marching.
+     *
+     * The front is advanced with an untidy priority queue (Yatziv et al. 2006): a circular array of
+     * buckets of width Param::bucketWidthPerc * average edge length, so that every vertex is extracted
+     * in constant time at the price of an error bounded by the bucket width. Each accepted vertex updates
+     * its neighbors with the planar unfolding of the faces they share with an accepted vertex, or along
+     * the edge otherwise.
+     * Vertices not reachable from the sources get an infinite distance.
+     * @return false if there are no sources or a source is not a vertex index
+     */
+    bool ComputeFastMarching(const std::vector<int> &sources, Eigen::VectorXd &distance) const {
+        assert(valid);
+        if(!ValidSources(sources)) return false;
+        const double inf = std::numeric_limits<double>::infinity();
+        distance.setConstant(vertNum, inf);
+        std::vector<char> accepted(vertNum, 0);
+
+        const double h = std::max(par.bucketWidthPerc * averageEdgeLength, std::numeric_limits<double>::min());
+        // no update moves the front more than the longest edge from the vertex just accepted
+        const size_t bucketNum = size_t(maxEdgeLength / h) + 2;
+        std::vector<std::vector<int>> buckets(bucketNum);
+        size_t pending = 0;
+
+        for (int s : sources){
+            distance(s) = 0;
+            buckets[0].push_back(s);
+            ++pending;
+        }
+
+        std::vector<int> current;
+        for (size_t k = 0; pending > 0; ++k){
+            std::vector<int> &bucket = buckets[k % bucketNum];
+            while (!bucket.empty()){
+                current.swap(bucket);
+                pending -= current.size();
+                for (int v : current){
+                    // stale entries: already accepted, or moved to a later bucket after an improvement
+                    if (accepted[v] || size_t(distance(v) / h) > k) continue;
+                    accepted[v] = 1;
+                    const CoordType &pv = m->vert[v].cP();
+                    for (int i = cornerOffsets[v]; i < cornerOffsets[v+1]; ++i){
+                        const int c = corners[i];
+                        const int f = c/3;
+                        const int a = faceVerts[3*f + (c+1)%3];
+                        const int b = faceVerts[3*f + (c+2)%3];
+                        for (int j = 0; j < 2; ++j){
+                            const int u = j == 0 ? a : b;   // vertex to update
+                            const int w = j == 0 ? b : a;   // third vertex of the face
+                            if (accepted[u]) continue;
+                            const CoordType &pu = m->vert[u].cP();
+                            double d = accepted[w] ? triangleUpdate(pu, pv, distance(v), m->vert[w].cP(), distance(w))
+                                                   : distance(v) + double(Distance(pu, pv));
+                            if (d < distance(u)){
+                                distance(u) = d;
+                                buckets[std::max(size_t(d / h), k) % bucketNum].push_back(u);
+                                ++pending;
+                            }
+                        }
+                    }
+                }
+                current.clear();
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief True if there is at least one source and every source is a vertex index of the mesh.
+     */
+    bool ValidSources(const std::vector<int> &sources) const {
+        if(!valid || sources.empty()) return false;
+        for (int s : sources)
+            if (s < 0 || s >= vertNum) return false;
+        return true;
+    }
+
+private:
+    // Vertex -> corners CSR, longest edge, mass matrix and the per face / per corner coefficients of the
+    // gradient and divergence operators. Corner c is vertex c%3 of face c/3.
+    void buildCorners(){
+        faceVerts.resize(3*faceNum);
+        cornerOffsets.assign(vertNum+1, 0);
+        maxEdgeLength = 0;
+        for (int f = 0; f < faceNum; ++f){
+            for (int k = 0; k < 3; ++k){
+                faceVerts[3*f+k] = int(vcg::tri::Index(*m, m->face[f].cV(k)));
+                ++cornerOffsets[faceVerts[3*f+k]+1];
+                maxEdgeLength = std::max(maxEdgeLength, double(Distance(m->face[f].cP(k), m->face[f].cP((k+1)%3))));
+            }
+        }
+        for (int v = 0; v < vertNum; ++v)
+            cornerOffsets[v+1] += cornerOffsets[v];
+        corners.resize(3*faceNum);
+        std::vector<int> cursor(cornerOffsets.begin(), cornerOffsets.end()-1);
+        for (int c = 0; c < 3*faceNum; ++c)
+            corners[cursor[faceVerts[c]]++] = c;
+    }
+
+    void buildOperators(Eigen::SparseMatrix<double> &massMatrix){
+        faceGrad.resize(3*faceNum);
+        cornerDiv.resize(3*faceNum);
+        std::vector<double> faceArea(faceNum);
+#pragma omp parallel for schedule(static)
+        for (int f = 0; f < faceNum; ++f){
+            const FaceType &fp = m->face[f];
+            Eigen::Vector3d p[3];
+            for (int k = 0; k < 3; ++k)
+                p[k] = Eigen::Vector3d(fp.cP(k)[0], fp.cP(k)[1], fp.cP(k)[2]);
+            // edge k is the one opposite to vertex k (counter-clockwise)
+            Eigen::Vector3d e[3] = { p[2] - p[1], p[0] - p[2], p[1] - p[0] };
+            Eigen::Vector3d n = e[2].cross(-e[1]);
+            faceArea[f] = n.norm() / 2;
+            n /= n.norm();
+            for (int k = 0; k < 3; ++k){
+                faceGrad[3*f+k] = n.cross(e[k]) / (2 * faceArea[f]);
+                // left and right edges leaving vertex k, and their opposite cotangents
+                Eigen::Vector3d el = -e[(k+1)%3];
+                Eigen::Vector3d er =  e[(k+2)%3];
+                double cotl = cotan(-el, -e[k]);
+                double cotr = cotan(-er,  e[k]);
+                cornerDiv[3*f+k] = (cotl * er + cotr * el) / 2;
+            }
+        }
+
+        // dual cell area: a third of the incident faces
+        massMatrix.resize(vertNum, vertNum);
+        massMatrix.reserve(Eigen::VectorXi::Constant(vertNum, 1));
+        for (int v = 0; v < vertNum; ++v){
+            double area = 0;
+            for (int i = cornerOffsets[v]; i < cornerOffsets[v+1]; ++i)
+                area += faceArea[corners[i]/3];
+            massMatrix.insert(v, v) = area / 3;
+        }
+        massMatrix.makeCompressed();
+    }
+
+    // Distance at C from the accepted vertices A and B of a face, unfolding the face on the plane:
+    // the virtual source S is at distance dA from A and dB from B, on the other side of AB, and
+    // is used only if the segment SC crosses AB.
+    static double triangleUpdate(const CoordType &pc, const CoordType &pa, double dA, const CoordType &pb, double dB){
+        double best = std::min(dA + double(Distance(pa, pc)), dB + double(Distance(pb, pc)));
+        Eigen::Vector3d A(pa[0], pa[1], pa[2]), B(pb[0], pb[1], pb[2]), C(pc[0], pc[1], pc[2]);
+        Eigen::Vector3d ab = B - A;
+        double c = ab.norm();
+        if (c <= 0) return best;
+        ab /= c;
+        Eigen::Vector3d ac = C - A;
+        double cx = ac.dot(ab);
+        double cy = (ac - ab * cx).norm();
+        double sx = (dA*dA - dB*dB + c*c) / (2*c);
+        double sy2 = dA*dA - sx*sx;
+        if (sy2 < 0) return best;
+        double sy = -std::sqrt(sy2);
+        double t = -sy / (cy - sy);
+        double x = sx + t * (cx - sx);
+        if (x < 0 || x > c) return best;
+        return std::min(best, std::sqrt((cx-sx)*(cx-sx) + (cy-sy)*(cy-sy)));
+    }
+
+    static inline double cotan(const Eigen::Vector3d& v0, const Eigen::Vector3d& v1){
+        return v0.dot(v1) / v0.cross(v1).norm();
+    }
+
+    Param par;
+
+    MeshType *m = nullptr;
+    unsigned long long cachedRevision = 0;
+    int vertNum = 0;
+    int faceNum = 0;
+    bool valid = false;
+    bool heatRequested = false;
+    bool factorized = false;
+    double averageEdgeLength = 0;
+    double maxEdgeLength = 0;
+
+    std::vector<int> faceVerts;             // 3 per face
+    std::vector<int> cornerOffsets;         // vertex -> corners CSR
+    std::vector<int> corners;
+    std::vector<Eigen::Vector3d> faceGrad;  // per corner: gradient of the hat function of the vertex on the face
+    std::vector<Eigen::Vector3d> cornerDiv; // per corner: divergence weights of the face field
+    Solver heatSolver;
+    Solver poissonSolver;
+};
+
 }
 }
 
@@ -23,6 +23,7 @@
 #ifndef __VCG_TRI_UPDATE_HOLE
 #define __VCG_TRI_UPDATE_HOLE
 
+#include <chrono>
 #include <vcg/complex/algorithms/clean.h>
 
 // This file contains three Ear Classes
@@ -342,9 +343,10 @@ public:
   typedef typename MESH::ScalarType ScalarType;
   typedef typename MESH::CoordType CoordType;
 
+  // The faces the new ones are tested against, one ring per thread so that holes can be filled concurrently.
   static std::vector<FacePointer> &AdjacencyRing()
   {
-    static std::vector<FacePointer> ar;
+    static thread_local std::vector<FacePointer> ar;
     return ar;
   }
 
@@ -460,6 +462,23 @@ public:
       }
       return true;
     }
+
+    // True when the loop passes twice through the same vertex: the minimum weight triangulation
+    // would make degenerate faces there.
+    bool IsPinched() const
+    {
+      std::vector<VertexPointer> loopV;
+      loopV.reserve(size);
+      PosType ip=p;
+      do
+      {
+        loopV.push_back(ip.v);
+        ip.NextB();
+      }
+      while (ip != p);
+      std::sort(loopV.begin(),loopV.end());
+      return std::adjacent_find(loopV.begin(),loopV.end()) != loopV.end();
+    }
   };
 
                
@@ -477,9 +496,30 @@ template<class EAR>
     {
       
       assert(tri::IsValidPointer(m,p.f));
+      assert(p.IsBorder());
+      std::vector<PosType> loop;
+      getBoundHole(p,loop);
+      FaceIterator f = tri::Allocator<MESH>::AddFaces(m, loop.size()-2, facePointersToBeUpdated);
+      f = EarCut<EAR>(p,f);
+      
+      // If the hole had k non manifold vertexes it requires less than n-2 face ( it should be n - 2*(k+1) ), 
+      // so we delete the remaining ones. 
+      while(f!=m.face.end()){
+        tri::Allocator<MESH>::DeleteFace(m,*f);
+        f++;
+      }
+    }
+
+/** EarCut
+ * Closes the hole of p using the already allocated faces starting from f
+ * (at least the hole size minus two of them) and returns the end of the used ones.
+ * It only touches the hole boundary, so holes that do not share vertices can be cut concurrently.
+ */
+template<class EAR>
+    static FaceIterator EarCut(const PosType &p, FaceIterator f)
+    {
       assert(p.IsBorder());
       int holeSize = EAR::InitNonManifoldBitOnHoleBoundary(p);
-      FaceIterator f = tri::Allocator<MESH>::AddFaces(m, holeSize-2, facePointersToBeUpdated);
 
       std::priority_queue< EAR > EarHeap;
       PosType fp = p;
@@ -517,13 +557,7 @@ template<class EAR>
           }
         }//is update()
       } 
-      
-      // If the hole had k non manifold vertexes it requires less than n-2 face ( it should be n - 2*(k+1) ), 
-      // so we delete the remaining ones. 
-      while(f!=m.face.end()){
-        tri::Allocator<MESH>::DeleteFace(m,*f);
-        f++;
-      }
+      return f;
     }
 
     template<class EAR>
@@ -532,23 +566,12 @@ template<class EAR>
       std::vector< Info > vinfo;
       GetInfo(m, Selected,vinfo);
 
-      typename std::vector<Info >::iterator ith;
-      int indCb=0;
-      int holeCnt=0;
-      std::vector<FacePointer *> facePtrToBeUpdated;
-      for(ith = vinfo.begin(); ith!= vinfo.end(); ++ith)
-        facePtrToBeUpdated.push_back( &(*ith).p.f );
-
-      for(ith = vinfo.begin(); ith!= vinfo.end(); ++ith)
-      {
-        indCb++;
-        if(cb) (*cb)(indCb*10/vinfo.size(),"Closing Holes");
-        if((*ith).size < sizeHole){
-          holeCnt++;
-          FillHoleEar< EAR >(m, (*ith).p,facePtrToBeUpdated);
-        }
-      }
-      return holeCnt;
+      std::vector<HoleTask> tasks;
+      for(size_t i=0; i<vinfo.size(); ++i)
+        if(vinfo[i].size < sizeHole)
+          tasks.push_back(HoleTask(i,HoleTask::EarCutting));
+      FillHoles<EAR>(m,vinfo,tasks,std::false_type(),false,cb);
+      return int(tasks.size());
     }
 
 /// Main Hole Filling function.
@@ -560,47 +583,76 @@ template<class EAR>
     {
       std::vector<Info > vinfo;
       GetInfo(m, Selected,vinfo);
-      typename std::vector<Info>::iterator ith;
 
-      // collect the face pointer that has to be updated by the various addfaces
-      std::vector<FacePointer *> vfpOrig;
-      for(ith = vinfo.begin(); ith!= vinfo.end(); ++ith)
-        vfpOrig.push_back( &(*ith).p.f );
+      std::vector<HoleTask> tasks;
+      for(size_t i=0; i<vinfo.size(); ++i)
+        if(vinfo[i].size < maxSizeHole)
+          tasks.push_back(HoleTask(i,HoleTask::EarCutting));
+      FillHoles<EAR>(m,vinfo,tasks,std::true_type(),false,cb);
+      return int(tasks.size());
+    }
 
-      int indCb=0;
-      int holeCnt=0;
-      for(ith = vinfo.begin(); ith!= vinfo.end(); ++ith)
+  /// Parameters of Fill(): which holes are filled and how.
+  struct FillParam
+  {
+    int maxHoleSize = 30;          // holes with this number of border edges or more are left open
+    int minimumWeightMaxSize = 0;  // holes up to this size get the minimum weight triangulation, the larger ones are ear cut
+    bool selected = false;         // only the holes on the border of the selected faces
+  };
+
+  /// What Fill() did and how fast.
+  struct FillStats
+  {
+    int holeNum = 0;          // holes found in the mesh
+    int filledNum = 0;
+    int earCuttingNum = 0;
+    int minimumWeightNum = 0;
+    int serialNum = 0;        // holes sharing a vertex with another one, filled one after the other
+    int faceNum = 0;          // faces added
+    float sec = 0;
+
+    float HolesPerSec() const { return sec>0 ? filledNum/sec : 0; }
+  };
+
+/// Fills all the holes smaller than FillParam::maxHoleSize, choosing the strategy by the hole size:
+/// the minimum weight triangulation (O(n^3)) for the smallest ones, ear cutting with EAR for the others
+/// and for the holes whose loop passes twice through a vertex.
+/// Holes that do not share vertices are filled in parallel. Unlike MinimumWeightFill, the FF adjacency
+/// of the minimum weight triangulations is kept consistent. Returns the number of filled holes.
+template<class EAR>
+    static int Fill(MESH &m, const FillParam &pp, FillStats *stats=0, CallBackPos *cb=0)
+    {
+      typedef std::chrono::steady_clock Clock;
+      Clock::time_point t0=Clock::now();
+
+      std::vector<Info > vinfo;
+      GetInfo(m, pp.selected,vinfo);
+
+      std::vector<HoleTask> tasks;
+      for(size_t i=0; i<vinfo.size(); ++i)
+        if(vinfo[i].size < pp.maxHoleSize)
+        {
+          // a pinched loop is ear cut, the ears handle its non manifold vertex
+          bool minimumWeight = vinfo[i].size <= pp.minimumWeightMaxSize && !vinfo[i].IsPinched();
+          tasks.push_back(HoleTask(i, minimumWeight ? HoleTask::MinimumWeight : HoleTask::EarCutting));
+        }
+      int faceNum = FillHoles<EAR>(m,vinfo,tasks,std::false_type(),true,cb);
+
+      if(stats)
       {
-        indCb++;
-        if(cb) (*cb)(indCb*10/vinfo.size(),"Closing Holes");
-        if((*ith).size < maxSizeHole){
-          std::vector<FacePointer *> facePtrToBeUpdated;
-          holeCnt++;
-          facePtrToBeUpdated=vfpOrig;
-          EAR::AdjacencyRing().clear();
-          //Loops around the hole to collect the faces that have to be tested for intersection.
-          PosType ip = (*ith).p;
-          do
-          {
-            PosType inp = ip;
-            do
-            {
-              inp.FlipE();
-              inp.FlipF();
-              EAR::AdjacencyRing().push_back(inp.f);
-            } while(!inp.IsBorder());
-            ip.NextB();
-          }while(ip != (*ith).p);
-
-          typename std::vector<FacePointer>::iterator fpi;
-          for(fpi=EAR::AdjacencyRing().begin();fpi!=EAR::AdjacencyRing().end();++fpi)
-            facePtrToBeUpdated.push_back( &*fpi );
-
-          FillHoleEar<EAR >(m, ith->p,facePtrToBeUpdated);
-          EAR::AdjacencyRing().clear();
+        *stats = FillStats();
+        stats->holeNum = int(vinfo.size());
+        stats->filledNum = int(tasks.size());
+        for(size_t t=0; t<tasks.size(); ++t)
+        {
+          if(tasks[t].mode==HoleTask::MinimumWeight) ++stats->minimumWeightNum;
+          else ++stats->earCuttingNum;
+          if(tasks[t].serial) ++stats->serialNum;
         }
+        stats->faceNum = faceNum;
+        stats->sec = std::chrono::duration<float>(Clock::now()-t0).count();
       }
-      return holeCnt;
+      return int(tasks.size());
     }
 
 
@@ -712,10 +764,19 @@ template<class EAR>
             return false;
         }
 
+  // Scratch buffers of the minimum weight triangulation dynamic programming, reused across holes.
+  // The (i,j) entries are at i*nv+j.
+  struct MinimumWeightScratch
+  {
+    std::vector< Weight > w; // minimal weight of the triangulation of the (i,j) sub polygon
+    std::vector< int    > vi;// index of the third vertex of the triangle on the (i,j) edge
+  };
+
   static Weight computeWeight( int i, int j, int k,
-                               std::vector<PosType > pv,
-                               std::vector< std::vector< int > >  v)
+                               const std::vector<PosType > &pv,
+                               const std::vector< int > &v)
   {
+    const int nv = int(pv.size());
     PosType pi = pv[i];
     PosType pj = pv[j];
     PosType pk = pv[k];
@@ -727,8 +788,8 @@ template<class EAR>
     }
     // Return an infinite weight, if one of the neighboring patches
     // could not be created.
-    if(v[i][j] == -1){return Weight();}
-    if(v[j][k] == -1){return Weight();}
+    if(v[i*nv+j] == -1){return Weight();}
+    if(v[j*nv+k] == -1){return Weight();}
     
     //calcolo il massimo angolo diedrale, se esiste.
     ScalarType angleRad = 0;
@@ -741,7 +802,7 @@ template<class EAR>
     }
     else
     {
-      angleRad = std::max(angleRad, ComputeDihedralAngleRad(pi.v->P(),pj.v->P(), pk.v->P(), pv[ v[i][j] ].v->P()));
+      angleRad = std::max(angleRad, ComputeDihedralAngleRad(pi.v->P(),pj.v->P(), pk.v->P(), pv[ v[i*nv+j] ].v->P()));
     }
     
     if(j + 1 == k)
@@ -752,10 +813,10 @@ template<class EAR>
     }
     else
     {
-      angleRad = std::max(angleRad, ComputeDihedralAngleRad(pj.v->P(),pk.v->P(), pi.v->P(), pv[ v[j][k] ].v->P()));
+      angleRad = std::max(angleRad, ComputeDihedralAngleRad(pj.v->P(),pk.v->P(), pi.v->P(), pv[ v[j*nv+k] ].v->P()));
     }
     
-    if( i == 0 && k == (int)v.size() - 1)
+    if( i == 0 && k == nv - 1)
     {
       px = pi;
       px.FlipE(); px.FlipV();
@@ -767,22 +828,34 @@ template<class EAR>
     return Weight(angleRad, area);
   }
   
-  static void calculateMinimumWeightTriangulation(MESH &m, FaceIterator f,std::vector<PosType > vv )
+  static void calculateMinimumWeightTriangulation(MESH &m, FaceIterator f,const std::vector<PosType > &vv )
   {
-    std::vector< std::vector< Weight > > w; //matrice dei pesi minimali di ogni orecchio preso in consideraione
-    std::vector< std::vector< int    > > vi;//memorizza l'indice del terzo vertice del triangolo
+    MinimumWeightScratch s;
+    f = MinimumWeightTriangulation(f,vv,s,false);
     
+    while(f!=m.face.end())
+    {
+      (*f).SetD();
+      ++f;
+      m.fn--;
+    }
+  }
+
+  /// Triangulates the boundary loop vv with the already allocated faces starting from f
+  /// (at least vv.size()-2 of them) and returns the end of the used ones.
+  /// With attach the new faces get FF adjacency among themselves and with the loop faces.
+  static FaceIterator MinimumWeightTriangulation(FaceIterator f, const std::vector<PosType > &vv,
+                                                 MinimumWeightScratch &s, bool attach)
+  {
     //hole size
-    int nv = vv.size();
+    const int nv = vv.size();
     
-    w.clear();
-    w.resize( nv, std::vector<Weight>( nv, Weight() ) );
-    
-    vi.resize( nv, std::vector<int>( nv, 0 ) );
+    s.w.assign( nv*nv, Weight() );
+    s.vi.assign( nv*nv, 0 );
     
     //inizializzo tutti i pesi possibili del buco
     for ( int i = 0; i < nv-1; ++i )
-      w[i][i+1] = Weight( 0, 0 );
+      s.w[i*nv+i+1] = Weight( 0, 0 );
     
     //doppio ciclo for per calcolare di tutti i possibili triangoli i loro pesi.
     for ( int j = 2; j < nv; ++j )
@@ -798,106 +871,74 @@ template<class EAR>
         //ciclo tra i vertici in mezzo a i due prefissati
         for ( int m = i + 1; m < i + j; ++m )
         {
-          Weight a = w[i][m];
-          Weight b = w[m][i+j];
-          Weight newval =  a + b + computeWeight( i, m, i+j, vv, vi);
+          Weight a = s.w[i*nv+m];
+          Weight b = s.w[m*nv+i+j];
+          Weight newval =  a + b + computeWeight( i, m, i+j, vv, s.vi);
           if ( newval < minval )
           {
             minval = newval;
             minIndex = m;
           }
         }
-        w[i][i+j] = minval;
-        vi[i][i+j] = minIndex;
+        s.w[i*nv+i+j] = minval;
+        s.vi[i*nv+i+j] = minIndex;
       }
     }
     
     //Triangulate
-    int i, j;
-    i=0; j=nv-1;
-    
-    triangulate(m,f, i, j, vi, vv);
-    
-    while(f!=m.face.end())
-    {
-      (*f).SetD();
-      ++f;
-      m.fn--;
-    }
+    if(nv > 2)
+      triangulate(f, 0, nv-1, s.vi, vv, attach ? vv[0].f : 0, vv[0].z);
+    return f;
   }
   
-  
-  static void triangulate(MESH &m, FaceIterator &f,int i, int j,
-                          std::vector< std::vector<int> > vi, std::vector<PosType > vv)
+  // Adds the triangle of the (i,j) sub polygon and recurses on the two sides.
+  // Its (j,i) edge, the second one, is adjacent to the edge e of the face adj
+  // (the parent triangle or the loop face); a null adj means no FF update.
+  static void triangulate(FaceIterator &f,int i, int j,
+                          const std::vector<int> &vi, const std::vector<PosType > &vv,
+                          FacePointer adj, int e)
   {
     if(i + 1 == j){return;}
     if(i==j)return;
     
-    int k = vi[i][j];
+    const int nv = vv.size();
+    int k = vi[i*nv+j];
     
     if(k == -1)	return;
+    // a loop through the same vertex twice: no degenerate face, the sub polygon stays open
+    if(vv[i].v == vv[k].v || vv[k].v == vv[j].v || vv[j].v == vv[i].v) return;
     
     //Setto i vertici
-    f->V(0) = vv[i].v;
-    f->V(1) = vv[k].v;
-    f->V(2) = vv[j].v;
+    FacePointer fp = &*f;
+    if(fp->HasPolyInfo()) fp->Alloc(3);
+    fp->V(0) = vv[i].v;
+    fp->V(1) = vv[k].v;
+    fp->V(2) = vv[j].v;
     
     f++;
-    triangulate(m,f,i,k,vi,vv);
-    triangulate(m,f,k,j,vi,vv);
+    if(adj)
+    {
+      if(FaceType::HasNormal()) fp->N() = TriangleNormal(*fp).Normalize();
+      for(int z=0;z<3;++z) face::FFSetBorder(fp,z);
+      face::FFAttachManifold(fp,2,adj,e);
+      // the sides that are loop edges: the pos i+1 is the edge from vertex i to vertex i+1
+      if(i + 1 == k) face::FFAttachManifold(fp,0,vv[k].f,vv[k].z);
+      if(k + 1 == j) face::FFAttachManifold(fp,1,vv[j].f,vv[j].z);
+    }
+    triangulate(f,i,k,vi,vv,adj?fp:0,0);
+    triangulate(f,k,j,vi,vv,adj?fp:0,1);
   }
   
   static void MinimumWeightFill(MESH &m, int holeSize, bool Selected)
   {
-    std::vector<PosType > vvi;
-    std::vector<FacePointer * > vfp;
-    
     std::vector<Info > vinfo;
-    typename std::vector<Info >::iterator VIT;
     GetInfo(m, Selected,vinfo);
     
-    for(VIT = vinfo.begin(); VIT != vinfo.end();++VIT)
-    {
-      vvi.push_back(VIT->p);
-    }
-    
-    typename std::vector<PosType >::iterator ith;
-    typename std::vector<PosType >::iterator ithn;
-    typename std::vector<VertexPointer >::iterator itf;
-    
-    std::vector<PosType > app;
-    PosType ps;
-    std::vector<FaceType > tr;
-    std::vector<VertexPointer > vf;
-    
-    for(ith = vvi.begin(); ith!= vvi.end(); ++ith)
-    {
-      tr.clear();
-      vf.clear();
-      app.clear();
-      vfp.clear();
-      
-      ps = *ith;
-      getBoundHole(ps,app);
-      
-      if(app.size() <= size_t(holeSize) )
-      {
-        typename std::vector<PosType >::iterator itP;
-        std::vector<FacePointer *> vfp;
-        
-        for(ithn = vvi.begin(); ithn!= vvi.end(); ++ithn)
-          vfp.push_back(&(ithn->f));
-        
-        for(itP = app.begin (); itP != app.end ();++itP)
-          vfp.push_back( &(*itP).f );
-        
-        //aggiungo le facce
-        FaceIterator f = tri::Allocator<MESH>::AddFaces(m, (app.size()-2) , vfp);
-        
-        calculateMinimumWeightTriangulation(m,f, app);
-      }
-    }
-    
+    std::vector<HoleTask> tasks;
+    for(size_t i=0; i<vinfo.size(); ++i)
+      if(vinfo[i].size <= holeSize)
+        tasks.push_back(HoleTask(i,HoleTask::MinimumWeight));
+    FillHoles<TrivialEar<MESH> >(m,vinfo,tasks,std::false_type(),false,0);
   }
   
   static void getBoundHole (PosType sp,std::vector<PosType >&ret)
@@ -912,6 +953,138 @@ template<class EAR>
     }while(sp != fp);
   }
   
+  
+private:
+  // A hole to be filled by FillHoles, with its strategy and its slice of the preallocated faces.
+  struct HoleTask
+  {
+    enum Mode { EarCutting, MinimumWeight };
+
+    HoleTask(size_t _hole, Mode _mode) : hole(int(_hole)), mode(_mode), faceBegin(0), faceEnd(0), serial(false) {}
+
+    int hole;            // index in the Info vector
+    Mode mode;
+    int faceBegin;       // first face of the slice, from the first added face
+    int faceEnd;         // end of the faces actually used
+    bool serial;         // shares a vertex with another hole
+  };
+
+  template<class EAR> static void CollectAdjacencyRing(const PosType &, std::false_type) {}
+  template<class EAR> static void ClearAdjacencyRing(std::false_type) {}
+  template<class EAR> static void ClearAdjacencyRing(std::true_type) { EAR::AdjacencyRing().clear(); }
+
+  // Collects the faces around the hole that the SelfIntersectionEar have to be tested against.
+  template<class EAR>
+  static void CollectAdjacencyRing(const PosType &p, std::true_type)
+  {
+    EAR::AdjacencyRing().clear();
+    PosType ip = p;
+    do
+    {
+      PosType inp = ip;
+      do
+      {
+        inp.FlipE();
+        inp.FlipF();
+        EAR::AdjacencyRing().push_back(inp.f);
+      } while(!inp.IsBorder());
+      ip.NextB();
+    }while(ip != p);
+  }
+
+  /* Fills the given holes. All the faces are added at once, and each hole closes its own slice of them
+   * touching nothing but its boundary faces: the holes that do not share a vertex with other holes
+   * (they never share edges) are filled in parallel, the others one after the other, so the result does
+   * not depend on the number of threads. Returns the number of added faces.
+   */
+  template<class EAR, class RING>
+  static int FillHoles(MESH &m, std::vector<Info> &vinfo, std::vector<HoleTask> &tasks, RING ring,
+                       bool attachMinimumWeight, CallBackPos *cb)
+  {
+    const int taskNum = int(tasks.size());
+    std::vector< std::vector<PosType> > loops(taskNum);
+    int faceNum=0;
+    for(int t=0; t<taskNum; ++t)
+    {
+      getBoundHole(vinfo[tasks[t].hole].p,loops[t]);
+      tasks[t].faceBegin = faceNum;
+      faceNum += std::max(int(loops[t].size())-2, 0);
+    }
+    if(faceNum==0) return 0;
+
+    // the holes sharing a vertex with another one
+    std::vector<int> owner(m.vert.size(),-1);
+    for(int t=0; t<taskNum; ++t)
+      for(size_t i=0; i<loops[t].size(); ++i)
+      {
+        int &o = owner[tri::Index(m,loops[t][i].v)];
+        if(o==-1) o=t;
+        else if(o!=t) tasks[o].serial = tasks[t].serial = true;
+      }
+
+    std::vector<FacePointer *> facePtrToBeUpdated;
+    for(size_t i=0; i<vinfo.size(); ++i)
+      facePtrToBeUpdated.push_back( &vinfo[i].p.f );
+    for(int t=0; t<taskNum; ++t)
+      for(size_t i=0; i<loops[t].size(); ++i)
+        facePtrToBeUpdated.push_back( &loops[t][i].f );
+    const int firstFace = int(m.face.size());
+    tri::Allocator<MESH>::AddFaces(m, faceNum, facePtrToBeUpdated);
+
+    // lazily allocated by the ears, it must happen before any concurrent access
+    bool earCutting=false;
+    for(int t=0; t<taskNum; ++t)
+      earCutting |= (tasks[t].mode==HoleTask::EarCutting);
+    if(earCutting && EAR::NonManifoldBit()==0)
+      EAR::NonManifoldBit() = VertexType::NewBitFlag();
+
+    int doneNum=0;
+    for(int serialPass=0; serialPass<2; ++serialPass)
+    {
+#pragma omp parallel if(serialPass==0)
+      {
+        MinimumWeightScratch scratch;
+#pragma omp for schedule(dynamic,1)
+        for(int t=0; t<taskNum; ++t)
+        {
+          HoleTask &ht = tasks[t];
+          if(ht.serial != (serialPass==1)) continue;
+          FaceIterator f = m.face.begin()+firstFace+ht.faceBegin;
+          if(ht.mode==HoleTask::EarCutting)
+          {
+            CollectAdjacencyRing<EAR>(vinfo[ht.hole].p,ring);
+            f = EarCut<EAR>(vinfo[ht.hole].p,f);
+            ClearAdjacencyRing<EAR>(ring);
+          }
+          else
+            f = MinimumWeightTriangulation(f,loops[t],scratch,attachMinimumWeight);
+          ht.faceEnd = int(f-m.face.begin())-firstFace;
+          if(cb)
+          {
+#pragma omp critical (hole_fill_cb)
+            {
+              ++doneNum;
+              (*cb)(doneNum*100/taskNum,"Closing Holes");
+            }
+          }
+        }
+      }
+    }
+
+    // the holes with non manifold vertices or failed triangulations use less faces
+    int addedNum=faceNum;
+    for(int t=0; t<taskNum; ++t)
+    {
+      const int sliceEnd = (t+1<taskNum) ? tasks[t+1].faceBegin : faceNum;
+      for(int i=tasks[t].faceEnd; i<sliceEnd; ++i)
+      {
+        tri::Allocator<MESH>::DeleteFace(m,m.face[firstFace+i]);
+        --addedNum;
+      }
+    }
+    return addedNum;
+  }
+  
 };// class Hole
 
 } // end namespace tri
@@ -92,6 +92,11 @@ public:
         bool projectFlag=true;
         bool selectedOnly = false;
         bool cleanFlag = true;
+        // Runs the valence improvement (swaps), the smoothing and the projection with OpenMP. Split and
+        // collapse stay serial and bound the speedup: every split or collapse changes the topology that
+        // the tests of the next edges read. The result is not the same mesh of the serial mode;
+        // apps/sample/trimesh_remeshing_parallel compares their quality.
+        bool parallelFlag = false;
 
         bool userSelectedCreases = false;
         bool surfDistCheck = true;
@@ -320,7 +325,12 @@ public:
             }
 
             if(params.swapFlag)
-                ImproveValence(toRemesh, params);
+            {
+                if (params.parallelFlag)
+                    ImproveValenceParallel(toRemesh, params);
+                else
+                    ImproveValence(toRemesh, params);
+            }
 
             if(params.smoothFlag)
                 ImproveByLaplacian(toRemesh, params);
@@ -573,13 +583,19 @@ private:
         return (int)(std::ceil(angleSumRad / (M_PI/3.0f)));
     }
 
+    // The default marker stamps the faces of m and is not thread safe; concurrent callers use EmptyTMark,
+    // that gives the same answer at the cost of testing faces spanning several cells more than once.
+    template <class MarkerType = FaceTmark<MeshType> >
     static bool testHausdorff (MeshType & m, StaticGrid & grid, const std::vector<CoordType> & verts, const ScalarType maxD, const CoordType & checkOrientation = CoordType(0,0,0))
     {
+        MarkerType mf;
+        mf.SetMesh(&m);
+        vcg::face::PointDistanceBaseFunctor<ScalarType> PDistFunct;
         for (CoordType v : verts)
         {
             CoordType closest, normal, ip;
-            ScalarType dist = 0;
-            const FaceType* fp = GetClosestFaceBase(m, grid, v, maxD, dist, closest);
+            ScalarType dist = maxD;
+            const FaceType* fp = grid.GetClosest(PDistFunct, mf, v, maxD, dist, closest);
 
             //you can't use this kind of orientation check, since when you stand on edges it fails
             if (fp == NULL || (checkOrientation != CoordType(0,0,0) && checkOrientation * fp->N() < 0.7))
@@ -679,50 +695,130 @@ private:
     // Edge swap step: edges are flipped in order to optimize valence and triangle quality across the mesh
     static void ImproveValence(MeshType &m, Params &params)
     {
-        const static ScalarType foldCheckRad = math::ToRad(5.);
         tri::UpdateTopology<MeshType>::FaceFace(m);
         tri::UpdateTopology<MeshType>::VertexFace(m);
         ForEachFace(m, [&] (FaceType & f) {
             //			if (face::IsManifold(f, 0) && face::IsManifold(f, 1) && face::IsManifold(f, 2))
             for (int i = 0; i < 3; ++i)
             {
-                if (&f > f.cFFp(i))
+                if (&f > f.cFFp(i) && testSwapCandidate<FaceTmark<MeshType> >(f, i, params))
                 {
-                    const PosType pi(&f, i);
-                    const CoordType swapEdgeMidPoint = (f.cP2(i) + f.cFFp(i)->cP2(f.cFFi(i))) / 2.;
-
-                    if(((!params.selectedOnly) || (f.IsS() && f.cFFp(i)->IsS())) &&
-                            !face::IsBorder(f, i) &&
-                            face::IsManifold(f, i) && /*checkManifoldness(f, i) &&*/
-                            face::checkFlipEdgeNotManifold(f, i) &&
-                            testSwap(pi, params.creaseAngleCosThr) &&
-//                            face::CheckFlipEdge(f, i) &&
-                            face::CheckFlipEdgeNormal(f, i, float(vcg::math::ToRad(5.))) && 
-                            (!params.surfDistCheck || testHausdorff(*params.mProject, params.grid, {{ swapEdgeMidPoint }}, params.maxSurfDist)))
-                    {
-                        //When doing the swap we need to preserve and update the crease info accordingly
-                        FaceType* g = f.cFFp(i);
-                        const int w = f.FFi(i);
+                    applySwap(f, i, params);
+                    break;
+                }
+            }
+        });
+    }
+
+    // Tests if edge i of f can be swapped; shared by the serial and the parallel valence improvement.
+    template <class MarkerType>
+    static bool testSwapCandidate(FaceType & f, const int i, Params &params)
+    {
+        const PosType pi(&f, i);
+        const CoordType swapEdgeMidPoint = (f.cP2(i) + f.cFFp(i)->cP2(f.cFFi(i))) / 2.;
+
+        return ((!params.selectedOnly) || (f.IsS() && f.cFFp(i)->IsS())) &&
+                !face::IsBorder(f, i) &&
+                face::IsManifold(f, i) &&
+                face::checkFlipEdgeNotManifold(f, i) &&
+                testSwap(pi, params.creaseAngleCosThr) &&
+                face::CheckFlipEdgeNormal(f, i, float(vcg::math::ToRad(5.))) &&
+                (!params.surfDistCheck || testHausdorff<MarkerType>(*params.mProject, params.grid, {{ swapEdgeMidPoint }}, params.maxSurfDist));
+    }
+
+    static void applySwap(FaceType & f, const int i, Params &params)
+    {
+        //When doing the swap we need to preserve and update the crease info accordingly
+        FaceType* g = f.cFFp(i);
+        const int w = f.FFi(i);
 
-                        const bool creaseF = g->IsFaceEdgeS((w + 1) % 3);
-                        const bool creaseG = f.IsFaceEdgeS((i + 1) % 3);
+        const bool creaseF = g->IsFaceEdgeS((w + 1) % 3);
+        const bool creaseG = f.IsFaceEdgeS((i + 1) % 3);
 
-                        face::FlipEdgeNotManifold(f, i);
+        face::FlipEdgeNotManifold(f, i);
 
-                        f.ClearFaceEdgeS((i + 1) % 3);
-                        g->ClearFaceEdgeS((w + 1) % 3);
+        f.ClearFaceEdgeS((i + 1) % 3);
+        g->ClearFaceEdgeS((w + 1) % 3);
 
-                        if (creaseF)
-                            f.SetFaceEdgeS(i);
-                        if (creaseG)
-                            g->SetFaceEdgeS(w);
+        if (creaseF)
+            f.SetFaceEdgeS(i);
+        if (creaseG)
+            g->SetFaceEdgeS(w);
 
-                        ++params.stat.flipNum;
+        ++params.stat.flipNum;
+    }
+
+    /*
+        Parallel version of ImproveValence.
+        The swap tests only read the mesh, so they are evaluated concurrently for every face. A swap
+        changes the valence of the 4 vertices of its two faces, and the tests of another edge only
+        depend on the valence, the positions and the adjacency around its own 4 vertices: swaps with
+        disjoint vertex quads are independent. Each round greedily extracts such an independent set
+        (a color class of the conflict graph) in face order and applies it; the candidates that
+        conflicted are tested again in the next round on the updated mesh.
+        The result is deterministic but it is not the same as the serial sweep, since every swap
+        of a round is decided on the mesh as it was at the beginning of the round.
+    */
+    static void ImproveValenceParallel(MeshType &m, Params &params)
+    {
+        tri::UpdateTopology<MeshType>::FaceFace(m);
+        tri::UpdateTopology<MeshType>::VertexFace(m);
+
+        std::vector<int> toTest;
+        for (int fi = 0; fi < int(m.face.size()); ++fi)
+            if (!m.face[fi].IsD())
+                toTest.push_back(fi);
+
+        std::vector<char> vertBusy(m.vert.size(), 0);
+        while (!toTest.empty())
+        {
+            // edge index of the candidate swap of each face to test, -1 if none
+            std::vector<int> candidate(toTest.size(), -1);
+#pragma omp parallel for schedule(dynamic, 64)
+            for (int k = 0; k < int(toTest.size()); ++k)
+            {
+                FaceType & f = m.face[toTest[k]];
+                for (int i = 0; i < 3; ++i)
+                {
+                    if (&f > f.cFFp(i) && testSwapCandidate<EmptyTMark<MeshType> >(f, i, params))
+                    {
+                        candidate[k] = i;
                         break;
                     }
                 }
             }
-        });
+
+            std::vector<int> conflicting;
+            std::vector<VertexType*> touched;
+            for (size_t k = 0; k < toTest.size(); ++k)
+            {
+                const int i = candidate[k];
+                if (i < 0)
+                    continue;
+
+                FaceType & f = m.face[toTest[k]];
+                VertexType * quad[4] = { f.V0(i), f.V1(i), f.V2(i), f.cFFp(i)->V2(f.cFFi(i)) };
+                bool free = true;
+                for (int j = 0; j < 4; ++j)
+                    free = free && !vertBusy[tri::Index(m, quad[j])];
+
+                if (!free)
+                {
+                    conflicting.push_back(toTest[k]);
+                    continue;
+                }
+                for (int j = 0; j < 4; ++j)
+                {
+                    vertBusy[tri::Index(m, quad[j])] = 1;
+                    touched.push_back(quad[j]);
+                }
+                applySwap(f, i, params);
+            }
+
+            for (VertexType * vp : touched)
+                vertBusy[tri::Index(m, vp)] = 0;
+            toTest.swap(conflicting);
+        }
     }
 
     // The predicate that defines which edges should be split
@@ -1306,13 +1402,18 @@ private:
 //                }
 //            }
 
-            for (auto vi = m.vert.begin(); vi != m.vert.end(); ++vi)
-                if (!(*vi).IsD() && TD[*vi].cnt > 0)
+            // every vertex only reads its own accumulated sum: the update is order independent
+#pragma omp parallel for schedule(dynamic, 256) if(params.parallelFlag)
+            for (int i = 0; i < int(m.vert.size()); ++i)
+            {
+                VertexType & v = m.vert[i];
+                if (!v.IsD() && TD[v].cnt > 0)
                 {
-                    std::vector<CoordType> newPos(1, TD[*vi].sum);
-					if ((*vi).IsS() && (!params.surfDistCheck || testHausdorff(*params.mProject, params.grid, newPos, params.maxSurfDist)))
-                        (*vi).P() = (*vi).P() * (1-delta) + TD[*vi].sum * (delta);
+                    std::vector<CoordType> newPos(1, TD[v].sum);
+                    if (v.IsS() && (!params.surfDistCheck || testHausdorff<EmptyTMark<MeshType> >(*params.mProject, params.grid, newPos, params.maxSurfDist)))
+                        v.P() = v.P() * (1-delta) + TD[v].sum * (delta);
                 }
+            }
         } // end step
     }
 
@@ -1363,18 +1464,26 @@ private:
     //		crease verts should reproject only on creases.
     static void ProjectToSurface(MeshType &m, Params & params)
     {
-        for(auto vi=m.vert.begin();vi!=m.vert.end();++vi)
-            if(!(*vi).IsD())
+        // closest point queries on the read-only grid of mProject, with a per query marker
+#pragma omp parallel for schedule(dynamic, 256) if(params.parallelFlag)
+        for (int i = 0; i < int(m.vert.size()); ++i)
+        {
+            VertexType & v = m.vert[i];
+            if(!v.IsD())
             {
-                Point3<ScalarType> newP, normP, barP;
-                ScalarType maxDist = params.maxSurfDist * 2.5f, minDist = 0.f;
-                FaceType* fp = GetClosestFaceBase(*params.mProject, params.grid, vi->cP(), maxDist, minDist, newP/*, normP, barP*/);
+                vcg::face::PointDistanceBaseFunctor<ScalarType> PDistFunct;
+                EmptyTMark<MeshType> mf;
+                Point3<ScalarType> newP;
+                const ScalarType maxDist = params.maxSurfDist * 2.5f;
+                ScalarType minDist = maxDist;
+                FaceType* fp = params.grid.GetClosest(PDistFunct, mf, v.cP(), maxDist, minDist, newP);
 
                 if (fp != NULL)
                 {
-                    vi->P() = newP;
+                    v.P() = newP;
                 }
             }
+        }
     }
 };
 } // end namespace tri
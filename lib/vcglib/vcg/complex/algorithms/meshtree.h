@@ -393,7 +393,7 @@ namespace vcg {
             MM(movId)->updateDataMask(MeshType::MeshModel::MM_FACEMARK);
             std::vector<vcg::AlignPair::A2Vertex> tmpmv;
             aa.convertVertex(MM(movId)->cm.vert,tmpmv);
-            aa.sampleMovVert(tmpmv, ap.SampleNum, ap.SampleMode);
+            aa.sampleMovVert(tmpmv, ap.SampleNum, ap.SampleMode, ap.StratifiedGridSize);
 
             aa.mov=&tmpmv;
             aa.fix=&Fix;
@@ -0,0 +1,283 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *   
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+#ifndef VCG_ONE_RING_H
+#define VCG_ONE_RING_H
+
+#include <algorithm>
+#include <vector>
+#include <vcg/complex/complex.h>
+
+namespace vcg {
+namespace tri {
+
+/** \addtogroup trimesh */
+/*@{*/
+/**
+Flat (CSR) one-ring of every vertex of a triangle mesh, with the per edge and per vertex
+geometric quantities that the discrete differential operators need.
+
+The ring of vertex i (i is the index in m.vert) is the range [offsets[i], offsets[i+1])
+of the per edge vectors, with the neighbors sorted by index. The rings are built from the
+faces only, no adjacency is required, and every vertex only gathers its own corners, so the
+build runs in parallel and does not depend on the number of threads.
+Deleted vertices and unreferenced vertices have an empty ring.
+
+Every edge also keeps the vertices opposite to it in its faces, and how many of these faces flag it
+as border (the face border flags at build time, e.g. from UpdateFlags::FaceBorderFromFF): the
+connectivity the ring based smoothing of Smooth needs.
+
+The geometric part (weights, areas, angles) refers to the positions at build time: call
+Build() again after the mesh has been moved.
+*/
+template <class MeshType>
+class OneRing
+{
+public:
+    typedef typename MeshType::ScalarType   ScalarType;
+    typedef typename MeshType::CoordType    CoordType;
+    typedef typename MeshType::FaceType     FaceType;
+
+    std::vector<int>           offsets;      // vn+1 entries
+    std::vector<int>           neighbors;    // per edge: index of the other vertex
+    std::vector<ScalarType>    cotWeights;   // per edge: (cot(a)+cot(b))/2 of the two opposite angles, a single term on the border
+    std::vector<ScalarType>    edgeAreas;    // per edge: sum of the double areas of the faces sharing the edge
+    std::vector<unsigned char> edgeFaceNum;  // per edge: number of faces sharing the edge, 1 on the border
+    std::vector<unsigned char> edgeBorderNum; // per edge: number of faces in which the edge is flagged border
+    std::vector<int>           oppositeOffsets; // en+1 entries
+    std::vector<int>           opposites;    // per edge: the vertex opposite to the edge in each of its faces
+
+    std::vector<ScalarType>    mixedAreas;   // per vertex: mixed voronoi area (Meyer et al. 2002)
+    std::vector<ScalarType>    angleSums;    // per vertex: sum of the face angles incident in the vertex
+
+    OneRing() {}
+    OneRing(MeshType &m) { Build(m); }
+
+    int VN() const { return int(offsets.size()) - 1; }
+    int Begin(int v) const { return offsets[v]; }
+    int End(int v) const { return offsets[v+1]; }
+    int Valence(int v) const { return offsets[v+1] - offsets[v]; }
+
+    bool IsBorder(int v) const
+    {
+        for (int e = offsets[v]; e < offsets[v+1]; ++e)
+            if (edgeFaceNum[e] == 1) return true;
+        return false;
+    }
+
+    // True if an edge of v is flagged border in one of its faces.
+    bool IsBorderFlagged(int v) const
+    {
+        for (int e = offsets[v]; e < offsets[v+1]; ++e)
+            if (edgeBorderNum[e] > 0) return true;
+        return false;
+    }
+
+    void Clear()
+    {
+        offsets.clear(); neighbors.clear(); cotWeights.clear(); edgeAreas.clear(); edgeFaceNum.clear();
+        edgeBorderNum.clear(); oppositeOffsets.clear(); opposites.clear();
+        mixedAreas.clear(); angleSums.clear();
+    }
+
+    void Build(MeshType &m)
+    {
+        const int vn = int(m.vert.size());
+        const int fn = int(m.face.size());
+
+        // 1) per corner quantities, face by face
+        std::vector<int>        cornerVert(fn*3, -1);
+        std::vector<ScalarType> cornerAngle(fn*3, 0);
+        std::vector<ScalarType> cornerCot(fn*3, 0);
+        std::vector<ScalarType> cornerArea(fn*3, 0);
+        std::vector<ScalarType> faceDoubleArea(fn, 0);
+#pragma omp parallel for schedule(static)
+        for (int f = 0; f < fn; ++f)
+        {
+            const FaceType &face = m.face[f];
+            if (face.IsD()) continue;
+            for (int k = 0; k < 3; ++k)
+                cornerVert[f*3+k] = int(tri::Index(m, face.cV(k)));
+            CornerQuantities(face, &cornerAngle[f*3], &cornerCot[f*3], &cornerArea[f*3], faceDoubleArea[f]);
+        }
+
+        // 2) vertex -> corners (counting sort, corners stay in face order)
+        std::vector<int> cornerOffsets(vn+1, 0);
+        for (int c = 0; c < fn*3; ++c)
+            if (cornerVert[c] >= 0) ++cornerOffsets[cornerVert[c]+1];
+        for (int v = 0; v < vn; ++v)
+            cornerOffsets[v+1] += cornerOffsets[v];
+        std::vector<int> corners(cornerOffsets[vn]);
+        {
+            std::vector<int> cursor(cornerOffsets.begin(), cornerOffsets.end()-1);
+            for (int c = 0; c < fn*3; ++c)
+                if (cornerVert[c] >= 0) corners[cursor[cornerVert[c]]++] = c;
+        }
+
+        // 3) every vertex merges the two edges of each of its corners into its ring. A ring has at most
+        // two edges per corner, so the rings are first written in slots of that size and compacted after.
+        std::vector<int>           slotNeighbors(cornerOffsets[vn]*2);
+        std::vector<ScalarType>    slotCot(cornerOffsets[vn]*2);
+        std::vector<ScalarType>    slotArea(cornerOffsets[vn]*2);
+        std::vector<unsigned char> slotFaceNum(cornerOffsets[vn]*2);
+        std::vector<unsigned char> slotBorderNum(cornerOffsets[vn]*2);
+        std::vector<int>           slotOpposites(cornerOffsets[vn]*2);
+        std::vector<int>           slotOppositeNum(cornerOffsets[vn]*2);
+        std::vector<int>           ringSize(vn, 0);
+        mixedAreas.assign(vn, 0);
+        angleSums.assign(vn, 0);
+#pragma omp parallel
+        {
+            std::vector<RingEdge> ring;
+#pragma omp for schedule(dynamic, 1024)
+            for (int v = 0; v < vn; ++v)
+            {
+                ring.clear();
+                ScalarType area = 0, angle = 0;
+                for (int i = cornerOffsets[v]; i < cornerOffsets[v+1]; ++i)
+                {
+                    const int c = corners[i];
+                    const int f = c / 3, k = c % 3;
+                    const int c1 = f*3 + (k+1)%3, c2 = f*3 + (k+2)%3;
+                    // the edge towards the next vertex (edge k) is opposite to the corner after it, and the
+                    // edge towards the previous one (edge k+2) to the corner before it
+                    const FaceType &face = m.face[f];
+                    ring.push_back(RingEdge(cornerVert[c1], cornerCot[c2], faceDoubleArea[f], cornerVert[c2], face.IsB(k)));
+                    ring.push_back(RingEdge(cornerVert[c2], cornerCot[c1], faceDoubleArea[f], cornerVert[c1], face.IsB((k+2)%3)));
+                    area  += cornerArea[c];
+                    angle += cornerAngle[c];
+                }
+                mixedAreas[v] = area;
+                angleSums[v]  = angle;
+
+                std::sort(ring.begin(), ring.end());
+                const int base = cornerOffsets[v]*2;
+                int cnt = 0;
+                for (size_t i = 0; i < ring.size(); ++cnt)
+                {
+                    ScalarType cot = 0, edgeArea = 0;
+                    int faceNum = 0, borderNum = 0;
+                    size_t j = i;
+                    for (; j < ring.size() && ring[j].v == ring[i].v; ++j)
+                    {
+                        cot += ring[j].cot;
+                        edgeArea += ring[j].doubleArea;
+                        if (ring[j].border) ++borderNum;
+                        slotOpposites[base+j] = ring[j].opposite;
+                        ++faceNum;
+                    }
+                    slotNeighbors[base+cnt]   = ring[i].v;
+                    slotCot[base+cnt]         = cot / 2;
+                    slotArea[base+cnt]        = edgeArea;
+                    slotFaceNum[base+cnt]     = (unsigned char)(std::min(faceNum, 255));
+                    slotBorderNum[base+cnt]   = (unsigned char)(std::min(borderNum, 255));
+                    slotOppositeNum[base+cnt] = faceNum;
+                    i = j;
+                }
+                ringSize[v] = cnt;
+            }
+        }
+
+        offsets.assign(vn+1, 0);
+        for (int v = 0; v < vn; ++v)
+            offsets[v+1] = offsets[v] + ringSize[v];
+        const int en = offsets[vn];
+        neighbors.resize(en);
+        cotWeights.resize(en);
+        edgeAreas.resize(en);
+        edgeFaceNum.resize(en);
+        edgeBorderNum.resize(en);
+        oppositeOffsets.resize(en+1);
+        oppositeOffsets[en] = cornerOffsets[vn]*2;
+#pragma omp parallel for schedule(static)
+        for (int v = 0; v < vn; ++v)
+        {
+            const int src = cornerOffsets[v]*2, dst = offsets[v];
+            int opp = src;
+            for (int i = 0; i < ringSize[v]; ++i)
+            {
+                neighbors[dst+i]       = slotNeighbors[src+i];
+                cotWeights[dst+i]      = slotCot[src+i];
+                edgeAreas[dst+i]       = slotArea[src+i];
+                edgeFaceNum[dst+i]     = slotFaceNum[src+i];
+                edgeBorderNum[dst+i]   = slotBorderNum[src+i];
+                oppositeOffsets[dst+i] = opp;
+                opp += slotOppositeNum[src+i];
+            }
+        }
+        // there is one opposite per corner edge: they fill the slots, already in place
+        opposites.swap(slotOpposites);
+    }
+
+private:
+    struct RingEdge
+    {
+        int v;
+        ScalarType cot;
+        ScalarType doubleArea;
+        int opposite;
+        bool border;
+        RingEdge(int _v, ScalarType _cot, ScalarType _doubleArea, int _opposite, bool _border)
+            : v(_v), cot(_cot), doubleArea(_doubleArea), opposite(_opposite), border(_border) {}
+        bool operator < (const RingEdge &o) const { return v < o.v || (v == o.v && opposite < o.opposite); }
+    };
+
+    // Angles, cotangents and mixed voronoi areas of the three corners of a face, following
+    // Meyer et al.: the voronoi area on non obtuse faces, otherwise half the face area for the obtuse
+    // corner and a quarter for the other two. Degenerate faces get zero cotangents and angles.
+    static void CornerQuantities(const FaceType &f, ScalarType *angle, ScalarType *cot, ScalarType *area, ScalarType &doubleArea)
+    {
+        doubleArea = DoubleArea(f);
+        angle[0] = math::Abs(Angle(f.cP(1)-f.cP(0), f.cP(2)-f.cP(0)));
+        angle[1] = math::Abs(Angle(f.cP(0)-f.cP(1), f.cP(2)-f.cP(1)));
+        angle[2] = ScalarType(M_PI) - (angle[0]+angle[1]);
+        if (angle[0] == 0 || angle[1] == 0 || angle[2] == 0)
+        {
+            for (int k = 0; k < 3; ++k) { angle[k] = 0; cot[k] = 0; area[k] = doubleArea/6; }
+            return;
+        }
+        for (int k = 0; k < 3; ++k)
+            cot[k] = ScalarType(1.0/tan(angle[k]));
+
+        const ScalarType halfPi = ScalarType(M_PI/2);
+        if (angle[0] < halfPi && angle[1] < halfPi && angle[2] < halfPi)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                const int k1 = (k+1)%3, k2 = (k+2)%3;
+                // the two edges incident in corner k, each weighted by the cotangent of its opposite angle
+                area[k] = (SquaredDistance(f.cP(k), f.cP(k2)) * cot[k1] + SquaredDistance(f.cP(k), f.cP(k1)) * cot[k2]) / 8;
+            }
+        }
+        else
+        {
+            for (int k = 0; k < 3; ++k)
+                area[k] = (angle[k] >= halfPi) ? doubleArea/4 : doubleArea/8;
+        }
+    }
+};
+
+/*@}*/
+} // end namespace tri
+} // end namespace vcg
+
+#endif // VCG_ONE_RING_H
@@ -56,15 +56,19 @@ class OutlierRemoval
       typename MeshType::template PerVertexAttributeHandle<ScalarType> sigma =        tri::Allocator<MeshType>:: template GetPerVertexAttribute<ScalarType>(mesh, std::string("sigma"));
       typename MeshType::template PerVertexAttributeHandle<ScalarType> plof =         tri::Allocator<MeshType>:: template GetPerVertexAttribute<ScalarType>(mesh, std::string("plof"));
 
+      // the neighborhoods are used twice, so they are computed once in a batch
+      std::vector<unsigned int> offsets, neighbors;
+      std::vector<ScalarType> sqDists;
+      VertexConstDataWrapper<MeshType> ww(mesh);
+      kdTree.doQueryKBatch(ww, kNearest, offsets, neighbors, sqDists);
+
 #pragma omp parallel for schedule(dynamic, 10) //MSVC supports only OMP 2 -> no unsigned int allowed in parallel for...
       for (int i = 0; i < (int)mesh.vert.size(); i++)
       {
-        PriorityQueue queue;
-        kdTree.doQueryK(mesh.vert[i].cP(), kNearest, queue);
         ScalarType sum = 0;
-        for (int j = 0; j < queue.getNofElements(); j++)
-          sum += queue.getWeight(j);
-        sum /= (queue.getNofElements());
+        for (unsigned int j = offsets[i]; j < offsets[i+1]; j++)
+          sum += sqDists[j];
+        sum /= (offsets[i+1] - offsets[i]);
         sigma[i] = sqrt(sum);
       }
 
@@ -72,12 +76,10 @@ class OutlierRemoval
 #pragma omp parallel for reduction(+: mean) schedule(dynamic, 10)
       for (int i = 0; i < (int)mesh.vert.size(); i++)
       {
-        PriorityQueue queue;
-        kdTree.doQueryK(mesh.vert[i].cP(), kNearest, queue);
         ScalarType sum = 0;
-        for (int j = 0; j < queue.getNofElements(); j++)
-          sum += sigma[queue.getIndex(j)];
-        sum /= (queue.getNofElements());
+        for (unsigned int j = offsets[i]; j < offsets[i+1]; j++)
+          sum += sigma[neighbors[j]];
+        sum /= (offsets[i+1] - offsets[i]);
         plof[i] = sigma[i] / sum  - 1.0f;
         mean += plof[i] * plof[i];
       }
@@ -35,6 +35,7 @@ sampling strategies (montecarlo, stratified etc).
 #ifndef __VCGLIB_POINT_SAMPLING
 #define __VCGLIB_POINT_SAMPLING
 
+#include <chrono>
 #include <random>
 
 #include <vcg/math/random_generator.h>
@@ -1198,6 +1199,53 @@ static void Montecarlo(MeshType & m, VertexSampler &ps,int sampleNum)
         }
 }
 
+/**
+  Parallel version of Montecarlo(), with the same EXACT number of samples and distribution.
+  The samples are generated in fixed size chunks, each one with its own random stream
+  seeded from the given seed and the chunk index, so the result only depends on the seed
+  (not on the number of threads). The samples are passed to the sampler in order, by a single thread.
+  */
+static void MontecarloParallel(MeshType & m, VertexSampler &ps, int sampleNum, unsigned int seed)
+{
+    typedef  std::pair<ScalarType, FacePointer> IntervalType;
+    std::vector< IntervalType > intervals (m.fn+1);
+    int i=0;
+    intervals[i]=std::make_pair(0,FacePointer(0));
+    for(FaceIterator fi=m.face.begin(); fi != m.face.end(); fi++)
+        if(!(*fi).IsD())
+        {
+            intervals[i+1]=std::make_pair(intervals[i].first+0.5*DoubleArea(*fi), &*fi);
+            ++i;
+        }
+    const ScalarType meshArea = intervals.back().first;
+
+    const int chunkSize = 1<<16;
+    const int batchChunkNum = 64;   // chunks generated in parallel before being handed to the sampler
+    const int chunkNum = (sampleNum+chunkSize-1)/chunkSize;
+    std::vector< std::pair<FacePointer, CoordType> > batch;
+    for(int batchBegin=0; batchBegin<chunkNum; batchBegin+=batchChunkNum)
+    {
+        const int batchEnd = std::min(batchBegin+batchChunkNum, chunkNum);
+        const int firstSample = batchBegin*chunkSize;
+        batch.resize(std::min(batchEnd*chunkSize, sampleNum) - firstSample);
+#pragma omp parallel for schedule(dynamic,1)
+        for(int c=batchBegin; c<batchEnd; ++c)
+        {
+            math::MarsenneTwisterRNG rnd(seed + 0x9e3779b9u*(unsigned int)c);
+            const int end = std::min((c+1)*chunkSize, sampleNum);
+            for(int s=c*chunkSize; s<end; ++s)
+            {
+                ScalarType val = meshArea * rnd.generate01();
+                typename std::vector<IntervalType>::iterator it = lower_bound(intervals.begin(),intervals.end(),std::make_pair(val,FacePointer(0)) );
+                assert(it != intervals.end() && it != intervals.begin());
+                batch[s-firstSample] = std::make_pair((*it).second, math::GenerateBarycentricUniform<ScalarType>(rnd));
+            }
+        }
+        for(size_t s=0; s<batch.size(); ++s)
+            ps.AddFace(*batch[s].first, batch[s].second);
+    }
+}
+
 static ScalarType WeightedArea(FaceType &f, PerVertexFloatAttribute &wH)
 {
     ScalarType averageQ = ( wH[f.V(0)] + wH[f.V(1)] + wH[f.V(2)] )/3.0;
@@ -1716,6 +1764,7 @@ struct PoissonDiskParam
     preGenMesh = NULL;
     geodesicDistanceFlag = false;
     randomSeed = 0;
+    parallelFlag = false;
   }
 
   struct Stat
@@ -1742,6 +1791,7 @@ struct PoissonDiskParam
                               // 2) with a per vertex attribute.
   int MAXLEVELS;
   int randomSeed;
+  bool parallelFlag;          // PoissonDiskPruning runs PoissonDiskPruningParallel
 
   Stat pds;
 };
@@ -1932,6 +1982,11 @@ static void PoissonDiskPruningByNumber(VertexSampler &ps, MeshType &m,
 static void PoissonDiskPruning(VertexSampler &ps, MeshType &montecarloMesh,
                                ScalarType diskRadius, PoissonDiskParam &pp)
 {
+  if(pp.parallelFlag)
+  {
+    PoissonDiskPruningParallel(ps,montecarloMesh,diskRadius,pp);
+    return;
+  }
   tri::RequireCompactness(montecarloMesh);
   if(pp.randomSeed) SamplingRandomGenerator().initialize(pp.randomSeed);
   if(pp.adaptiveRadiusFlag)
@@ -2011,6 +2066,254 @@ static void PoissonDiskPruning(VertexSampler &ps, MeshType &montecarloMesh,
     pp.pds.pruneTime = t2-t1;
 }
 
+// Sorts v, in parallel for large vectors: blocks sorted concurrently then merged pairwise.
+template <class T>
+static void ParallelSort(std::vector<T> &v)
+{
+  const int blockNum = 64;
+  const int n = int(v.size());
+  if(n < (1<<16)) { std::sort(v.begin(),v.end()); return; }
+  std::vector<int> bound(blockNum+1);
+  for(int b=0; b<=blockNum; ++b) bound[b] = int((long long)n*b/blockNum);
+#pragma omp parallel for schedule(dynamic,1)
+  for(int b=0; b<blockNum; ++b)
+    std::sort(v.begin()+bound[b], v.begin()+bound[b+1]);
+  std::vector<T> tmp(n);
+  for(int width=1; width<blockNum; width*=2)
+  {
+#pragma omp parallel for schedule(dynamic,1)
+    for(int b=0; b<blockNum; b+=2*width)
+    {
+      const int mid = bound[std::min(b+width,blockNum)], end = bound[std::min(b+2*width,blockNum)];
+      std::merge(v.begin()+bound[b], v.begin()+mid, v.begin()+mid, v.begin()+end, tmp.begin()+bound[b]);
+    }
+    v.swap(tmp);
+  }
+}
+
+/// Flat, read only table of the montecarlo samples bucketed in a uniform grid,
+/// used by PoissonDiskPruningParallel. Only the non empty cells are stored, sorted by key.
+struct PoissonCellTable
+{
+  BoxType bb;
+  ScalarType cellSize;
+  Point3i size;
+  std::vector<long long> keys;  // keys of the non empty cells, sorted
+  std::vector<int> offsets;     // the samples of the i-th cell are samples[offsets[i]..offsets[i+1]-1]
+  std::vector<int> samples;     // vertex indices, grouped by cell, in mesh order within a cell
+
+  Point3i CellOf(const CoordType &p) const
+  {
+    Point3i c;
+    for(int k=0; k<3; ++k)
+      c[k] = std::min(std::max(int(floor((p[k]-bb.min[k])/cellSize)),0),size[k]-1);
+    return c;
+  }
+  long long Key(const Point3i &c) const { return ((long long)c[0]*size[1]+c[1])*size[2]+c[2]; }
+  int Find(long long key) const
+  {
+    typename std::vector<long long>::const_iterator it = std::lower_bound(keys.begin(),keys.end(),key);
+    return (it!=keys.end() && *it==key) ? int(it-keys.begin()) : -1;
+  }
+
+  void Init(MeshType &m, ScalarType _cellSize)
+  {
+    bb = m.bbox;
+    cellSize = _cellSize;
+    for(int k=0; k<3; ++k) size[k] = std::max(1,int(ceil(bb.Dim()[k]/cellSize)));
+
+    const int vn = int(m.vert.size());
+    std::vector< std::pair<long long,int> > sampleKeys(vn);
+#pragma omp parallel for schedule(static)
+    for(int i=0; i<vn; ++i)
+      sampleKeys[i] = std::make_pair(Key(CellOf(m.vert[i].cP())), i);
+    ParallelSort(sampleKeys);
+
+    keys.clear(); offsets.clear();
+    samples.resize(vn);
+    for(int i=0; i<vn; ++i)
+    {
+      if(i==0 || sampleKeys[i].first!=sampleKeys[i-1].first)
+      {
+        keys.push_back(sampleKeys[i].first);
+        offsets.push_back(i);
+      }
+      samples[i] = sampleKeys[i].second;
+    }
+    offsets.push_back(vn);
+  }
+
+  /// Calls f(sampleIndex) for the samples of the cells touched by the box of center p and half side r.
+  template <class Visitor>
+  void ForEachInBox(const CoordType &p, ScalarType r, Visitor &f) const
+  {
+    Point3i c0 = CellOf(p-CoordType(r,r,r)), c1 = CellOf(p+CoordType(r,r,r));
+    for(int x=c0[0]; x<=c1[0]; ++x)
+      for(int y=c0[1]; y<=c1[1]; ++y)
+        for(int z=c0[2]; z<=c1[2]; ++z)
+        {
+          const int c = Find(Key(Point3i(x,y,z)));
+          if(c<0) continue;
+          for(int i=offsets[c]; i<offsets[c+1]; ++i) f(samples[i]);
+        }
+  }
+};
+
+// Counts, or removes, the alive samples within radius from p; the removal can use the approximate geodesic distance.
+static int PoissonProcessInSphere(const PoissonCellTable &table, MeshType &m, std::vector<char> &alive,
+                                  const CoordType &p, const CoordType &n, ScalarType radius, bool remove, bool geodesic)
+{
+  int cnt=0;
+  const ScalarType r2 = radius*radius;
+  vertex::ApproximateGeodesicDistanceFunctor<VertexType> GDF;
+  auto visit = [&](int s) {
+    if(!alive[s]) return;
+    const VertexType &v = m.vert[s];
+    bool inside = (remove && geodesic) ? GDF(p,n,v.cP(),v.cN()) <= radius : SquaredDistance(p,v.cP()) <= r2;
+    if(!inside) return;
+    ++cnt;
+    if(remove) alive[s]=0;
+  };
+  table.ForEachInBox(p,radius,visit);
+  return cnt;
+}
+
+/// Parallel version of PoissonDiskPruning.
+/// The montecarlo samples are bucketed in a flat table of grid cells as large as the largest disk radius,
+/// so that a chosen sample only removes samples of its own cell and of the adjacent ones.
+/// The cells are split in 27 groups by their coordinates modulo 3 (grid coloring): two cells of a group
+/// are at least two cells apart, so a whole group is processed in parallel without locks, and the groups
+/// one after the other, in rounds, until no montecarlo sample is left. The visiting order of the cells is
+/// shuffled with pp.randomSeed (or with a seed drawn from SamplingRandomGenerator() if it is zero),
+/// so the result is reproducible for a given seed, whatever the number of threads.
+/// Unlike the serial version, the best sample choice counts the samples in the radius of the candidate
+/// (not in its quality) when the radius is adaptive.
+static void PoissonDiskPruningParallel(VertexSampler &ps, MeshType &montecarloMesh,
+                                       ScalarType diskRadius, PoissonDiskParam &pp)
+{
+  tri::RequireCompactness(montecarloMesh);
+  if(pp.adaptiveRadiusFlag)
+    tri::RequirePerVertexQuality(montecarloMesh);
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point t0=Clock::now();
+
+  PerVertexFloatAttribute rH = tri::Allocator<MeshType>:: template GetPerVertexAttribute<float> (montecarloMesh,"radius");
+  if(pp.adaptiveRadiusFlag)
+    InitRadiusHandleFromQuality(montecarloMesh, rH, diskRadius, pp.radiusVariance, pp.invertQuality);
+  const ScalarType cellSize = pp.adaptiveRadiusFlag ? std::max(diskRadius, diskRadius*pp.radiusVariance) : diskRadius;
+
+  PoissonCellTable table;
+  table.Init(montecarloMesh,cellSize);
+  const int cellNum = int(table.keys.size());
+  pp.pds.gridSize = table.size;
+  pp.pds.gridCellNum = cellNum;
+  pp.pds.montecarloSampleNum = montecarloMesh.vn;
+  pp.pds.sampleNum = 0;
+
+  std::vector<char> alive(montecarloMesh.vert.size(),1);
+  if(pp.preGenFlag)
+  {
+    if(pp.preGenMesh==0)
+    {
+      typename MeshType::template PerVertexAttributeHandle<bool> fixed;
+      fixed = tri::Allocator<MeshType>:: template GetPerVertexAttribute<bool> (montecarloMesh,"fixed");
+      for(VertexIterator vi=montecarloMesh.vert.begin();vi!=montecarloMesh.vert.end();++vi)
+        if(fixed[*vi]) {
+          pp.pds.sampleNum++;
+          ps.AddVert(*vi);
+          PoissonProcessInSphere(table,montecarloMesh,alive,vi->cP(),vi->cN(),diskRadius,true,false);
+        }
+    }
+    else
+    {
+      for(VertexIterator vi =pp.preGenMesh->vert.begin(); vi!=pp.preGenMesh->vert.end();++vi)
+      {
+        ps.AddVert(*vi);
+        pp.pds.sampleNum++;
+        PoissonProcessInSphere(table,montecarloMesh,alive,vi->cP(),vi->cN(),diskRadius,true,false);
+      }
+    }
+  }
+
+  // the cells of each color, in shuffled order
+  math::MarsenneTwisterRNG rnd(pp.randomSeed ? (unsigned int)pp.randomSeed : SamplingRandomGenerator().generate());
+  std::vector<int> colorCells[27];
+  for(int c=0; c<cellNum; ++c)
+  {
+    const long long key = table.keys[c];
+    const int z = int(key % table.size[2]), y = int((key / table.size[2]) % table.size[1]), x = int(key / table.size[2] / table.size[1]);
+    colorCells[(x%3)*9 + (y%3)*3 + z%3].push_back(c);
+  }
+  for(int col=0; col<27; ++col)
+    for(int i=int(colorCells[col].size())-1; i>0; --i)
+      std::swap(colorCells[col][i], colorCells[col][rnd.generate(i+1)]);
+  Clock::time_point t1=Clock::now();
+
+  // first sample of each cell that may still be alive
+  std::vector<int> cursor(table.offsets.begin(), table.offsets.end()-1);
+  std::vector<int> chosen;
+  bool picked=true;
+  while(picked)
+  {
+    picked=false;
+    for(int col=0; col<27; ++col)
+    {
+      std::vector<int> &cells = colorCells[col];
+      std::vector<int> cellSample(cells.size(),-1);
+#pragma omp parallel for schedule(dynamic,64)
+      for(int i=0; i<int(cells.size()); ++i)
+      {
+        const int c = cells[i];
+        const int end = table.offsets[c+1];
+        int &cur = cursor[c];
+        while(cur<end && !alive[table.samples[cur]]) ++cur;
+        if(cur==end) continue;
+
+        int sp = table.samples[cur];
+        if(pp.bestSampleChoiceFlag)
+        {
+          int minRemoveCnt = std::numeric_limits<int>::max();
+          for(int j=cur, poolCnt=0; j<end && poolCnt<pp.bestSamplePoolSize; ++j)
+          {
+            const int s = table.samples[j];
+            if(!alive[s]) continue;
+            ++poolCnt;
+            const ScalarType r = pp.adaptiveRadiusFlag ? ScalarType(rH[s]) : diskRadius;
+            const int curRemoveCnt = PoissonProcessInSphere(table,montecarloMesh,alive,montecarloMesh.vert[s].cP(),montecarloMesh.vert[s].cN(),r,false,false);
+            if(curRemoveCnt < minRemoveCnt)
+            {
+              sp = s;
+              minRemoveCnt = curRemoveCnt;
+            }
+          }
+        }
+        cellSample[i] = sp;
+        const ScalarType currentRadius = pp.adaptiveRadiusFlag ? ScalarType(rH[sp]) : diskRadius;
+        PoissonProcessInSphere(table,montecarloMesh,alive,montecarloMesh.vert[sp].cP(),montecarloMesh.vert[sp].cN(),currentRadius,true,pp.geodesicDistanceFlag);
+        alive[sp]=0;
+      }
+
+      // the cells found empty are dropped for good
+      size_t keptNum=0;
+      for(size_t i=0; i<cells.size(); ++i)
+        if(cellSample[i]>=0)
+        {
+          chosen.push_back(cellSample[i]);
+          cells[keptNum++] = cells[i];
+        }
+      cells.resize(keptNum);
+      picked |= (keptNum>0);
+    }
+  }
+
+  for(size_t i=0; i<chosen.size(); ++i)
+    ps.AddVert(montecarloMesh.vert[chosen[i]]);
+  pp.pds.sampleNum += chosen.size();
+  Clock::time_point t2=Clock::now();
+  pp.pds.gridTime = int(std::chrono::duration<double>(t1-t0).count()*CLOCKS_PER_SEC);
+  pp.pds.pruneTime = int(std::chrono::duration<double>(t2-t1).count()*CLOCKS_PER_SEC);
+}
+
 /** Compute a Poisson-disk sampling of the surface.
  *  The radius of the disk is computed according to the estimated sampling density.
  *
@@ -2282,7 +2585,8 @@ void PoissonSampling(MeshType &m, // the mesh that has to be sampled
                      typename MeshType::ScalarType &radius,  // the Poisson Disk Radius (used if sampleNum==0, setted if sampleNum!=0)
                      typename MeshType::ScalarType radiusVariance=1,
                      typename MeshType::ScalarType PruningByNumberTolerance=0.04f,
-                     unsigned int randSeed=0)
+                     unsigned int randSeed=0,
+                     bool parallelFlag=false) // parallel montecarlo and pruning, reproducible for a given seed
 
 {
   typedef tri::TrivialSampler<MeshType> BaseSampler;
@@ -2305,7 +2609,14 @@ void PoissonSampling(MeshType &m, // the mesh that has to be sampled
   BaseSampler pdSampler(poissonSamples);
 
   if(randSeed) tri::SurfaceSampling<MeshType,MontecarloSampler>::SamplingRandomGenerator().initialize(randSeed);
-  tri::SurfaceSampling<MeshType,MontecarloSampler>::Montecarlo(m, mcSampler, std::max(10000,sampleNum*40));
+  if(parallelFlag)
+  {
+    pp.parallelFlag = true;
+    if(!randSeed) pp.randomSeed = tri::SurfaceSampling<MeshType,MontecarloSampler>::SamplingRandomGenerator().generate();
+    tri::SurfaceSampling<MeshType,MontecarloSampler>::MontecarloParallel(m, mcSampler, std::max(10000,sampleNum*40), pp.randomSeed);
+  }
+  else
+    tri::SurfaceSampling<MeshType,MontecarloSampler>::Montecarlo(m, mcSampler, std::max(10000,sampleNum*40));
   tri::UpdateBounding<MeshType>::Box(MontecarloMesh);
 //  tri::Build(MontecarloMesh, MontecarloSamples);
   int t1=clock();
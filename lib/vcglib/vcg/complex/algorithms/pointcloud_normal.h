@@ -59,29 +59,52 @@ public:
 
   static void ComputeUndirectedNormal(MeshType &m, int nn, ScalarType maxDist, KdTree<ScalarType> &tree,vcg::CallBackPos * cb=0)
   {
-//    tree.setMaxNofNeighbors(nn);
+    std::vector<unsigned int> offsets, neighbors;
+    std::vector<ScalarType> sqDists;
+    if(cb) cb(1,"Searching neighbors");
+    VertexConstDataWrapper<MeshType> DW(m);
+    tree.doQueryKBatch(DW,nn,offsets,neighbors,sqDists);
+    if(cb) cb(50,"Fitting planes");
+    ComputeUndirectedNormal(m,maxDist,offsets,neighbors,sqDists);
+  }
+
+  /// Plane fitting over precomputed neighborhoods (in the CSR form given by KdTree::doQueryKBatch).
+  /// The 3x3 covariance is accumulated in two passes, the centroid first, so that it keeps its precision
+  /// far from the origin, and solved in closed form, one vertex per iteration in parallel.
+  static void ComputeUndirectedNormal(MeshType &m, ScalarType maxDist, const std::vector<unsigned int> &offsets,
+                                      const std::vector<unsigned int> &neighbors, const std::vector<ScalarType> &sqDists)
+  {
     const ScalarType maxDistSquared = maxDist*maxDist;
-    int cnt=0;
-	int step = std::max(m.vn, int(m.vn / 100));
-    typename KdTree<ScalarType>::PriorityQueue nq;
-    for (VertexIterator vi=m.vert.begin();vi!=m.vert.end();++vi)
+#pragma omp parallel for schedule(dynamic, 256)
+    for (int vi = 0; vi < (int)m.vert.size(); ++vi)
     {
-        tree.doQueryK(vi->cP(),nn,nq);
-        if(cb && (++cnt%step)==0) cb(cnt/step,"Fitting planes");
+      Eigen::Vector3d bar = Eigen::Vector3d::Zero();
+      int cnt = 0;
+      for (unsigned int i = offsets[vi]; i < offsets[vi+1]; ++i)
+        if (sqDists[i] < maxDistSquared)
+        {
+          const CoordType &p = m.vert[neighbors[i]].cP();
+          bar += Eigen::Vector3d(p[0], p[1], p[2]);
+          ++cnt;
+        }
+      if (cnt == 0) continue;
+      bar /= cnt;
 
-//        int neighbours = tree.getNofFoundNeighbors();
-        int neighbours = nq.getNofElements();
-        std::vector<CoordType> ptVec;
-        for (int i = 0; i < neighbours; i++)
+      Eigen::Matrix3d cov = Eigen::Matrix3d::Zero();
+      for (unsigned int i = offsets[vi]; i < offsets[vi+1]; ++i)
+        if (sqDists[i] < maxDistSquared)
         {
-//            int neightId = tree.getNeighborId(i);
-            int neightId = nq.getIndex(i);
-            if(nq.getWeight(i) <maxDistSquared)
-              ptVec.push_back(m.vert[neightId].cP());
+          const CoordType &p = m.vert[neighbors[i]].cP();
+          Eigen::Vector3d e = Eigen::Vector3d(p[0], p[1], p[2]) - bar;
+          cov.noalias() += e * e.transpose();
         }
-        Plane3<ScalarType> plane;
-        FitPlaneToPointSet(ptVec,plane);
-        vi->N()=plane.Direction();
+      cov /= cnt;
+
+      Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> eig;
+      eig.computeDirect(cov);
+      Eigen::Vector3d d = eig.eigenvectors().col(0); // eigenvalues are sorted, cov is positive semi-definite
+      CoordType n(d[0], d[1], d[2]);
+      m.vert[vi].N() = n.Normalize();
     }
   }
 
@@ -110,6 +133,176 @@ public:
     }
     //std::push_heap(heap.begin(),heap.end());
   }
+
+  /// Same as above, with the neighbors taken from precomputed neighborhoods.
+  static void AddNeighboursToHeap( MeshType &m, VertexPointer vp, const std::vector<unsigned int> &offsets,
+                                   const std::vector<unsigned int> &neighbors, std::vector<WArc> &heap)
+  {
+    size_t vi = tri::Index(m,vp);
+    for (unsigned int i = offsets[vi]; i < offsets[vi+1]; i++)
+    {
+      int neightId = neighbors[i];
+      if (neightId < m.vn && (&m.vert[neightId] != vp) && !m.vert[neightId].IsV())
+      {
+        heap.push_back(WArc(vp,&(m.vert[neightId])));
+        if(heap.back().w < 0.3)
+          heap.pop_back();
+        else
+          std::push_heap(heap.begin(),heap.end());
+      }
+    }
+  }
+
+  /// Orientation by blocks. The points are bucketed in a grid (about blockPointNum points per cell) and the usual
+  /// greedy propagation is run independently, and in parallel, inside each cell: every connected piece gets a
+  /// consistent orientation of its own. Then the pieces vote, across the arcs that link them, whether they agree
+  /// or not, and a maximum spanning forest over the votes decides which pieces have to be flipped.
+  static void OrientByBlocks(MeshType &m, const std::vector<unsigned int> &offsets, const std::vector<unsigned int> &neighbors, int blockPointNum)
+  {
+    int vn = int(m.vert.size());
+    tri::UpdateBounding<MeshType>::Box(m);
+    int cellPerSide = std::max(1, int(std::ceil(std::pow(double(vn) / std::max(1, blockPointNum), 1.0 / 3.0))));
+    Point3i siz;
+    for (int k = 0; k < 3; ++k)
+      siz[k] = m.bbox.Dim()[k] > 0 ? cellPerSide : 1;
+    int cellNum = siz[0] * siz[1] * siz[2];
+
+    std::vector<int> cell(vn);
+    std::vector<int> cellStart(cellNum + 1, 0);
+    for (int i = 0; i < vn; ++i)
+    {
+      Point3i c;
+      for (int k = 0; k < 3; ++k)
+      {
+        ScalarType t = m.bbox.Dim()[k] > 0 ? (m.vert[i].cP()[k] - m.bbox.min[k]) / m.bbox.Dim()[k] : 0;
+        c[k] = std::max(0, std::min(siz[k] - 1, int(t * siz[k])));
+      }
+      cell[i] = c[0] + siz[0] * (c[1] + siz[1] * c[2]);
+      ++cellStart[cell[i] + 1];
+    }
+    for (int c = 0; c < cellNum; ++c)
+      cellStart[c + 1] += cellStart[c];
+    std::vector<int> cellVert(vn);
+    {
+      std::vector<int> cursor(cellStart.begin(), cellStart.end() - 1);
+      for (int i = 0; i < vn; ++i)
+        cellVert[cursor[cell[i]]++] = i;
+    }
+
+    // propagation inside each cell; piece[i] is first numbered inside its cell
+    std::vector<int> piece(vn, -1);
+    std::vector<int> cellPieceNum(cellNum + 1, 0);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < cellNum; ++c)
+    {
+      typedef std::pair<ScalarType, std::pair<int,int> > LocalArc; // weight, (src, trg)
+      std::vector<LocalArc> heap;
+      int pieceNum = 0;
+      for (int j = cellStart[c]; j < cellStart[c + 1]; ++j)
+      {
+        int seed = cellVert[j];
+        if (piece[seed] != -1) continue;
+        piece[seed] = pieceNum;
+        heap.clear();
+        int cur = seed;
+        while (true)
+        {
+          for (unsigned int k = offsets[cur]; k < offsets[cur + 1]; ++k)
+          {
+            int nb = neighbors[k];
+            if (nb == cur || cell[nb] != c || piece[nb] != -1) continue;
+            ScalarType w = std::abs(m.vert[cur].cN() * m.vert[nb].cN());
+            if (w < 0.3) continue;
+            heap.push_back(LocalArc(w, std::make_pair(cur, nb)));
+            std::push_heap(heap.begin(), heap.end());
+          }
+          cur = -1;
+          while (!heap.empty() && cur == -1)
+          {
+            std::pop_heap(heap.begin(), heap.end());
+            LocalArc a = heap.back();
+            heap.pop_back();
+            int trg = a.second.second;
+            if (piece[trg] != -1) continue;
+            piece[trg] = pieceNum;
+            if (m.vert[a.second.first].cN() * m.vert[trg].cN() < 0)
+              m.vert[trg].N() = -m.vert[trg].N();
+            cur = trg;
+          }
+          if (cur == -1) break;
+        }
+        ++pieceNum;
+      }
+      cellPieceNum[c + 1] = pieceNum;
+    }
+    for (int c = 0; c < cellNum; ++c)
+      cellPieceNum[c + 1] += cellPieceNum[c];
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < vn; ++i)
+      piece[i] += cellPieceNum[cell[i]];
+    int pieceNum = cellPieceNum[cellNum];
+
+    // votes between pieces: positive if they agree
+    typedef std::pair<std::pair<int,int>, ScalarType> Vote;
+    std::vector<Vote> votes;
+#pragma omp parallel
+    {
+      std::vector<Vote> localVotes;
+#pragma omp for schedule(static)
+      for (int i = 0; i < vn; ++i)
+        for (unsigned int k = offsets[i]; k < offsets[i + 1]; ++k)
+        {
+          int nb = neighbors[k];
+          if (piece[nb] == piece[i]) continue;
+          localVotes.push_back(Vote(std::make_pair(std::min(piece[i], piece[nb]), std::max(piece[i], piece[nb])),
+                                    m.vert[i].cN() * m.vert[nb].cN()));
+        }
+#pragma omp critical
+      votes.insert(votes.end(), localVotes.begin(), localVotes.end());
+    }
+    std::sort(votes.begin(), votes.end());
+    std::vector<Vote> links;
+    for (size_t i = 0; i < votes.size(); ++i)
+    {
+      if (links.empty() || links.back().first != votes[i].first)
+        links.push_back(Vote(votes[i].first, 0));
+      links.back().second += votes[i].second;
+    }
+    std::stable_sort(links.begin(), links.end(), [](const Vote &a, const Vote &b) {
+      return std::abs(a.second) > std::abs(b.second);
+    });
+
+    // maximum spanning forest with a union find that tracks the flip parity of each piece w.r.t. its parent
+    std::vector<int> parent(pieceNum), parity(pieceNum, 0);
+    for (int i = 0; i < pieceNum; ++i)
+      parent[i] = i;
+    auto find = [&](int x, int &par) {
+      par = 0;
+      while (parent[x] != x) { par ^= parity[x]; x = parent[x]; }
+      return x;
+    };
+    for (size_t i = 0; i < links.size(); ++i)
+    {
+      int pa, pb;
+      int ra = find(links[i].first.first, pa);
+      int rb = find(links[i].first.second, pb);
+      if (ra == rb || links[i].second == 0) continue;
+      parent[rb] = ra;
+      parity[rb] = pa ^ pb ^ (links[i].second < 0 ? 1 : 0);
+    }
+    std::vector<char> flip(pieceNum);
+    for (int i = 0; i < pieceNum; ++i)
+    {
+      int par;
+      find(i, par);
+      flip[i] = char(par);
+    }
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < vn; ++i)
+      if (flip[piece[i]])
+        m.vert[i].N() = -m.vert[i].N();
+  }
+
   /*! \brief parameters for the normal generation
    */
   struct Param
@@ -119,7 +312,9 @@ public:
       smoothingIterNum(0),
       coherentAdjNum(8),
       viewPoint(0,0,0),
-      useViewPoint(false)
+      useViewPoint(false),
+      blockOrientation(false),
+      blockPointNum(4096)
     {}
 
     int fittingAdjNum; /// number of adjacent nodes used for computing the fitting plane
@@ -127,6 +322,8 @@ public:
     int coherentAdjNum; /// number of nodes used in the coherency pass
     CoordType viewPoint;  /// position of a viewpoint used to disambiguate direction
     bool useViewPoint;  /// if the position of the viewpoint has to be used.
+    bool blockOrientation; /// orient the normals by blocks in parallel (see OrientByBlocks), faster but only approximates the global propagation
+    int blockPointNum;  /// average number of points of a block when blockOrientation is set
   };
 
   static void Compute(MeshType &m, Param p, vcg::CallBackPos * cb=0)
@@ -145,14 +342,27 @@ public:
 
     if(p.useViewPoint) // Simple case use the viewpoint position to determine the right orientation of each point
     {
-      for(VertexIterator vi=m.vert.begin();vi!=m.vert.end();++vi)
+#pragma omp parallel for schedule(static)
+      for(int i=0;i<(int)m.vert.size();++i)
       {
-        if ( vi->N().dot(p.viewPoint- vi->P())<0.0)
-            vi->N()=-(*vi).N();
+        if ( m.vert[i].N().dot(p.viewPoint- m.vert[i].P())<0.0)
+            m.vert[i].N()=-m.vert[i].N();
       }
       return;
     }
 
+    // the neighborhoods used for the propagation are computed once for all
+    if(cb) cb(75,"Orienting normals");
+    std::vector<unsigned int> offsets, neighbors;
+    std::vector<ScalarType> sqDists;
+    tree.doQueryKBatch(DW,p.coherentAdjNum,offsets,neighbors,sqDists);
+
+    if(p.blockOrientation)
+    {
+      OrientByBlocks(m,offsets,neighbors,p.blockPointNum);
+      return;
+    }
+
     tri::UpdateFlags<MeshType>::VertexClearV(m);
     std::vector<WArc> heap;
     VertexIterator vi=m.vert.begin();
@@ -165,7 +375,7 @@ public:
       if(vi==m.vert.end()) return;
 
       vi->SetV();
-      AddNeighboursToHeap(m,&*vi,p.coherentAdjNum,tree,heap);
+      AddNeighboursToHeap(m,&*vi,offsets,neighbors,heap);
 
       while(!heap.empty())
       {
@@ -177,7 +387,7 @@ public:
           a.trg->SetV();
           if(a.src->cN()*a.trg->cN()<0.0)
               a.trg->N()=-a.trg->N();
-          AddNeighboursToHeap(m,a.trg,p.coherentAdjNum,tree,heap);
+          AddNeighboursToHeap(m,a.trg,offsets,neighbors,heap);
         }
       }
     }
@@ -24,10 +24,14 @@
 #ifndef __VCGLIB__SMOOTH
 #define __VCGLIB__SMOOTH
 
+#include <algorithm>
+#include <vector>
+
 #include <vcg/space/ray3.h>
 #include <vcg/complex/algorithms/update/normal.h>
 #include <vcg/complex/algorithms/update/halfedge_topology.h>
 #include <vcg/complex/algorithms/closest.h>
+#include <vcg/complex/algorithms/one_ring.h>
 #include <vcg/space/index/kdtree/kdtree.h>
 
 namespace vcg
@@ -613,6 +617,165 @@ So if
         } // end for step
     };
 
+    /*
+      Flat one-ring versions of the Laplacian, Taubin and HC smoothing above, for long smoothing passes.
+
+      They walk the edges of a OneRing, with its per edge border counts (the face border flags at build
+      time) and opposite vertices (for the cotangent weights). Only its connectivity is used, so it is
+      built once and reused across steps and calls while the vertices move. Every step is then a gather
+      over the rings from one position buffer to the other: each vertex only writes itself, so the steps
+      run in parallel and the result does not depend on the number of threads.
+
+      The weights are the same of AccumulateLaplacianInfo (border vertices are averaged only with their
+      border neighbors), tetrahedral meshes are not supported.
+    */
+    // Weighted sum of the neighbors of v in pos and sum of the weights, as AccumulateLaplacianInfo does.
+    static void RingLaplacianSum(const OneRing<MeshType> &ring, const std::vector<CoordType> &pos, int v, bool cotangentFlag,
+                                 CoordType &sum, ScalarType &cnt)
+    {
+        if (ring.IsBorderFlagged(v))
+        {
+            sum = pos[v];
+            cnt = 1;
+            for (int e = ring.offsets[v]; e < ring.offsets[v + 1]; ++e)
+                if (ring.edgeBorderNum[e] > 0)
+                {
+                    sum += pos[ring.neighbors[e]] * ScalarType(ring.edgeBorderNum[e]);
+                    cnt += ScalarType(ring.edgeBorderNum[e]);
+                }
+            return;
+        }
+        sum = CoordType(0, 0, 0);
+        cnt = 0;
+        for (int e = ring.offsets[v]; e < ring.offsets[v + 1]; ++e)
+        {
+            const CoordType &pn = pos[ring.neighbors[e]];
+            ScalarType weight = ScalarType(ring.edgeFaceNum[e]);
+            if (cotangentFlag)
+            {
+                // cotangents of the angles opposite to the edge, degenerate corners weigh zero. No edge of v
+                // is flagged border here, so all the faces of the edge count.
+                weight = 0;
+                for (int o = ring.oppositeOffsets[e]; o < ring.oppositeOffsets[e + 1]; ++o)
+                {
+                    const CoordType a = pos[v] - pos[ring.opposites[o]];
+                    const CoordType b = pn - pos[ring.opposites[o]];
+                    const ScalarType crossNorm = (a ^ b).Norm();
+                    if (crossNorm > 0) weight += (a * b) / crossNorm;
+                }
+            }
+            sum += pn * weight;
+            cnt += weight;
+        }
+    }
+
+    static void VertexCoordLaplacian(MeshType &m, const OneRing<MeshType> &ring, int step, bool SmoothSelected = false, bool cotangentWeight = false, vcg::CallBackPos *cb = 0)
+    {
+        assert(ring.VN() == int(m.vert.size()));
+        const int vn = int(m.vert.size());
+        std::vector<CoordType> pos(vn), next(vn);
+        for (int v = 0; v < vn; ++v)
+            pos[v] = m.vert[v].cP();
+        for (int i = 0; i < step; ++i)
+        {
+            if (cb)
+                cb(100 * i / step, "Classic Laplacian Smoothing");
+#pragma omp parallel for schedule(static)
+            for (int v = 0; v < vn; ++v)
+            {
+                next[v] = pos[v];
+                if (m.vert[v].IsD() || (SmoothSelected && !m.vert[v].IsS()))
+                    continue;
+                CoordType sum;
+                ScalarType cnt;
+                RingLaplacianSum(ring, pos, v, cotangentWeight, sum, cnt);
+                if (cnt > 0)
+                    next[v] = (pos[v] + sum) / (cnt + 1);
+            }
+            pos.swap(next);
+        }
+        for (int v = 0; v < vn; ++v)
+            if (!m.vert[v].IsD())
+                m.vert[v].P() = pos[v];
+    }
+
+    static void VertexCoordTaubin(MeshType &m, const OneRing<MeshType> &ring, int step, float lambda, float mu, bool SmoothSelected = false, vcg::CallBackPos *cb = 0)
+    {
+        assert(ring.VN() == int(m.vert.size()));
+        const int vn = int(m.vert.size());
+        std::vector<CoordType> pos(vn), next(vn);
+        for (int v = 0; v < vn; ++v)
+            pos[v] = m.vert[v].cP();
+        for (int i = 0; i < step; ++i)
+        {
+            if (cb)
+                cb(100 * i / step, "Taubin Smoothing");
+            for (int pass = 0; pass < 2; ++pass)
+            {
+                const ScalarType factor = (pass == 0) ? lambda : mu;
+#pragma omp parallel for schedule(static)
+                for (int v = 0; v < vn; ++v)
+                {
+                    next[v] = pos[v];
+                    if (m.vert[v].IsD() || (SmoothSelected && !m.vert[v].IsS()))
+                        continue;
+                    CoordType sum;
+                    ScalarType cnt;
+                    RingLaplacianSum(ring, pos, v, false, sum, cnt);
+                    if (cnt > 0)
+                        next[v] = pos[v] + (sum / cnt - pos[v]) * factor;
+                }
+                pos.swap(next);
+            }
+        }
+        for (int v = 0; v < vn; ++v)
+            if (!m.vert[v].IsD())
+                m.vert[v].P() = pos[v];
+    }
+
+    static void VertexCoordLaplacianHC(MeshType &m, const OneRing<MeshType> &ring, int step, bool SmoothSelected = false)
+    {
+        assert(ring.VN() == int(m.vert.size()));
+        const ScalarType beta = 0.5;
+        const int vn = int(m.vert.size());
+        // HC counts every face edge once and the border ones twice
+        std::vector<ScalarType> cnt(vn, 0);
+        for (int v = 0; v < vn; ++v)
+            for (int e = ring.offsets[v]; e < ring.offsets[v + 1]; ++e)
+                cnt[v] += ScalarType(ring.edgeFaceNum[e] + ring.edgeBorderNum[e]);
+
+        std::vector<CoordType> pos(vn), avg(vn), dif(vn);
+        for (int v = 0; v < vn; ++v)
+            pos[v] = m.vert[v].cP();
+        for (int i = 0; i < step; ++i)
+        {
+            // First pass: the average of the neighbors and its difference from the current position
+#pragma omp parallel for schedule(static)
+            for (int v = 0; v < vn; ++v)
+            {
+                CoordType sum(0, 0, 0);
+                for (int e = ring.offsets[v]; e < ring.offsets[v + 1]; ++e)
+                    sum += pos[ring.neighbors[e]] * ScalarType(ring.edgeFaceNum[e] + ring.edgeBorderNum[e]);
+                avg[v] = (cnt[v] > 0) ? sum / cnt[v] : pos[v];
+                dif[v] = avg[v] - pos[v];
+            }
+            // Second pass: pull back each vertex by the average difference of its neighbors
+#pragma omp parallel for schedule(static)
+            for (int v = 0; v < vn; ++v)
+            {
+                if (cnt[v] <= 0 || (SmoothSelected && !m.vert[v].IsS()))
+                    continue;
+                CoordType sum(0, 0, 0);
+                for (int e = ring.offsets[v]; e < ring.offsets[v + 1]; ++e)
+                    sum += dif[ring.neighbors[e]] * ScalarType(ring.edgeFaceNum[e] + ring.edgeBorderNum[e]);
+                pos[v] = avg[v] - (avg[v] - pos[v]) * beta + (sum / cnt[v]) * (1 - beta);
+            }
+        }
+        for (int v = 0; v < vn; ++v)
+            if (!m.vert[v].IsD())
+                m.vert[v].P() = pos[v];
+    }
+
     // Laplacian smooth of the quality.
 
     class ColorSmoothInfo
@@ -1355,19 +1518,20 @@ A(...) (2-2nm)   =
             tree = new KdTree<ScalarType>(ww);
         else
             tree = tp;
-        typename KdTree<ScalarType>::PriorityQueue nq;
+        // the points do not move, so the neighborhoods are computed once for all the iterations
+        std::vector<unsigned int> offsets, neighbors;
+        std::vector<ScalarType> sqDists;
+        tree->doQueryKBatch(ww, neighborNum, offsets, neighbors, sqDists);
 
-        //  tree->setMaxNofNeighbors(neighborNum);
         for (int ii = 0; ii < iterNum; ++ii)
         {
-            for (VertexIterator vi = m.vert.begin(); vi != m.vert.end(); ++vi)
+#pragma omp parallel for schedule(static)
+            for (int vi = 0; vi < (int)m.vert.size(); ++vi)
             {
-                tree->doQueryK(vi->cP(), neighborNum, nq);
-                int neighbours = nq.getNofElements();
-                for (int i = 0; i < neighbours; i++)
+                for (unsigned int i = offsets[vi]; i < offsets[vi+1]; i++)
                 {
-                    int neightId = nq.getIndex(i);
-                    if (m.vert[neightId].cN() * vi->cN() > 0)
+                    int neightId = neighbors[i];
+                    if (m.vert[neightId].cN() * m.vert[vi].cN() > 0)
                         TD[vi] += m.vert[neightId].cN();
                     else
                         TD[vi] -= m.vert[neightId].cN();
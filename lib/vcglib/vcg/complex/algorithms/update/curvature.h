@@ -30,6 +30,7 @@
 #include <vcg/complex/algorithms/point_sampling.h>
 #include <vcg/complex/algorithms/intersection.h>
 #include <vcg/complex/algorithms/inertia.h>
+#include <vcg/complex/algorithms/one_ring.h>
 #include <Eigen/Core>
 
 namespace vcg {
@@ -72,6 +73,102 @@ private:
   };
 
 
+  // Eigen analysis of the Taubin tensor M of a vertex: sets its principal directions and curvatures.
+  static void TaubinPrincipalDirections(VertexType &v, const Matrix33<ScalarType> &M)
+  {
+    Matrix33<ScalarType> tempMatrix;
+    // compute vector W for the Householder matrix
+    CoordType W;
+    CoordType e1(1.0f,0.0f,0.0f);
+    if ((e1 - v.cN()).SquaredNorm() > (e1 + v.cN()).SquaredNorm())
+      W = e1 - v.cN();
+    else
+      W = e1 + v.cN();
+    W.Normalize();
+
+    // compute the Householder matrix I - 2WW^t
+    Matrix33<ScalarType> Q;
+    Q.SetIdentity();
+    tempMatrix.ExternalProduct(W,W);
+    Q -= tempMatrix * 2.0f;
+
+    // compute matrix Q^t M Q
+    Matrix33<ScalarType> QtMQ = (Q.transpose() * M * Q);
+
+//    CoordType bl = Q.GetColumn(0);
+    CoordType T1 = Q.GetColumn(1);
+    CoordType T2 = Q.GetColumn(2);
+
+    // find sin and cos for the Givens rotation
+    float s,c;
+    // Gabriel Taubin hint and Valentino Fiorin impementation
+    float alpha = QtMQ[1][1]-QtMQ[2][2];
+    float beta  = QtMQ[2][1];
+
+    float h[2];
+    float delta = sqrtf(4.0f*powf(alpha, 2) +16.0f*powf(beta, 2));
+    h[0] = (2.0f*alpha + delta) / (2.0f*beta);
+    h[1] = (2.0f*alpha - delta) / (2.0f*beta);
+
+    float t[2];
+    float best_c, best_s;
+    float min_error = std::numeric_limits<ScalarType>::infinity();
+    for (int i=0; i<2; i++)
+    {
+      delta = sqrtf(powf(h[i], 2) + 4.0f);
+      t[0] = (h[i]+delta) / 2.0f;
+      t[1] = (h[i]-delta) / 2.0f;
+
+      for (int j=0; j<2; j++)
+      {
+        float squared_t = powf(t[j], 2);
+        float denominator = 1.0f + squared_t;
+        s = (2.0f*t[j])		/ denominator;
+        c = (1-squared_t) / denominator;
+
+        float approximation = c*s*alpha + (powf(c, 2) - powf(s, 2))*beta;
+        float angle_similarity = fabs(acosf(c)/asinf(s));
+        float error = fabs(1.0f-angle_similarity)+fabs(approximation);
+        if (error<min_error)
+        {
+          min_error = error;
+          best_c = c;
+          best_s = s;
+        }
+      }
+    }
+    c = best_c;
+    s = best_s;
+
+    Eigen::Matrix2f minor2x2;
+    Eigen::Matrix2f S;
+
+
+    // diagonalize M
+    minor2x2(0,0) = QtMQ[1][1];
+    minor2x2(0,1) = QtMQ[1][2];
+    minor2x2(1,0) = QtMQ[2][1];
+    minor2x2(1,1) = QtMQ[2][2];
+
+    S(0,0) = S(1,1) = c;
+    S(0,1) = s;
+    S(1,0) = -1.0f * s;
+
+    Eigen::Matrix2f StMS = S.transpose() * minor2x2 * S;
+
+    // compute curvatures and curvature directions
+    float Principal_Curvature1 = (3.0f * StMS(0,0)) - StMS(1,1);
+    float Principal_Curvature2 = (3.0f * StMS(1,1)) - StMS(0,0);
+
+    CoordType Principal_Direction1 = T1 * c - T2 * s;
+    CoordType Principal_Direction2 = T1 * s + T2 * c;
+
+    v.PD1().Import(Principal_Direction1);
+    v.PD2().Import(Principal_Direction2);
+    v.K1() =  Principal_Curvature1;
+    v.K2() =  Principal_Curvature2;
+  }
+
 public:
     /// \brief Compute principal direction and magnitudo of curvature.
 
@@ -160,97 +257,66 @@ public:
           M += tempMatrix * weights[i] * curvature ;
         }
 
-        // compute vector W for the Householder matrix
-        CoordType W;
-        CoordType e1(1.0f,0.0f,0.0f);
-        if ((e1 - central_vertex->cN()).SquaredNorm() > (e1 + central_vertex->cN()).SquaredNorm())
-          W = e1 - central_vertex->cN();
-        else
-          W = e1 + central_vertex->cN();
-        W.Normalize();
-
-        // compute the Householder matrix I - 2WW^t
-        Matrix33<ScalarType> Q;
-        Q.SetIdentity();
-        tempMatrix.ExternalProduct(W,W);
-        Q -= tempMatrix * 2.0f;
-
-        // compute matrix Q^t M Q
-        Matrix33<ScalarType> QtMQ = (Q.transpose() * M * Q);
-
-//        CoordType bl = Q.GetColumn(0);
-        CoordType T1 = Q.GetColumn(1);
-        CoordType T2 = Q.GetColumn(2);
-
-        // find sin and cos for the Givens rotation
-        float s,c;
-        // Gabriel Taubin hint and Valentino Fiorin impementation
-        float alpha = QtMQ[1][1]-QtMQ[2][2];
-        float beta  = QtMQ[2][1];
-
-        float h[2];
-        float delta = sqrtf(4.0f*powf(alpha, 2) +16.0f*powf(beta, 2));
-        h[0] = (2.0f*alpha + delta) / (2.0f*beta);
-        h[1] = (2.0f*alpha - delta) / (2.0f*beta);
-
-        float t[2];
-        float best_c, best_s;
-        float min_error = std::numeric_limits<ScalarType>::infinity();
-        for (int i=0; i<2; i++)
-        {
-          delta = sqrtf(powf(h[i], 2) + 4.0f);
-          t[0] = (h[i]+delta) / 2.0f;
-          t[1] = (h[i]-delta) / 2.0f;
-
-          for (int j=0; j<2; j++)
-          {
-            float squared_t = powf(t[j], 2);
-            float denominator = 1.0f + squared_t;
-            s = (2.0f*t[j])		/ denominator;
-            c = (1-squared_t) / denominator;
-
-            float approximation = c*s*alpha + (powf(c, 2) - powf(s, 2))*beta;
-            float angle_similarity = fabs(acosf(c)/asinf(s));
-            float error = fabs(1.0f-angle_similarity)+fabs(approximation);
-            if (error<min_error)
-            {
-              min_error = error;
-              best_c = c;
-              best_s = s;
-            }
-          }
-        }
-        c = best_c;
-        s = best_s;
-
-        Eigen::Matrix2f minor2x2;
-        Eigen::Matrix2f S;
-
-
-        // diagonalize M
-        minor2x2(0,0) = QtMQ[1][1];
-        minor2x2(0,1) = QtMQ[1][2];
-        minor2x2(1,0) = QtMQ[2][1];
-        minor2x2(1,1) = QtMQ[2][2];
-
-        S(0,0) = S(1,1) = c;
-        S(0,1) = s;
-        S(1,0) = -1.0f * s;
-
-        Eigen::Matrix2f StMS = S.transpose() * minor2x2 * S;
-
-        // compute curvatures and curvature directions
-        float Principal_Curvature1 = (3.0f * StMS(0,0)) - StMS(1,1);
-        float Principal_Curvature2 = (3.0f * StMS(1,1)) - StMS(0,0);
+        TaubinPrincipalDirections(*vi, M);
+      }
+    }
+  }
 
-        CoordType Principal_Direction1 = T1 * c - T2 * s;
-        CoordType Principal_Direction2 = T1 * s + T2 * c;
+  /// \brief Compute principal direction and magnitudo of curvature over a precomputed OneRing.
+  /**
+  The Taubin tensor of PrincipalDirections(m), with the one-ring of each vertex read from the flat ring
+  instead of walking the VF adjacency, so no adjacency is required and the vertices are processed in
+  parallel. The ring must have been built on the current positions of the mesh.
+
+  The results are not the same as PrincipalDirections(m): here the weight of an edge is half the area of
+  the two faces that share it (the whole face on the border). PrincipalDirections(m) averages the face
+  after the edge in the walk with the face of the previous edge, so its weights are shifted by one face
+  around the vertex, and wrap wrongly on the first edge.
+  */
+  static void PrincipalDirectionsOneRing(MeshType &m, const OneRing<MeshType> &ring)
+  {
+    tri::RequirePerVertexCurvatureDir(m);
+    vcg::tri::UpdateNormal<MeshType>::PerVertexAngleWeighted(m);
+    vcg::tri::UpdateNormal<MeshType>::NormalizePerVertex(m);
+    assert(ring.VN() == int(m.vert.size()));
 
-        (*vi).PD1().Import(Principal_Direction1);
-        (*vi).PD2().Import(Principal_Direction2);
-        (*vi).K1() =  Principal_Curvature1;
-        (*vi).K2() =  Principal_Curvature2;
+    const int vn = int(m.vert.size());
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (int i = 0; i < vn; ++i)
+    {
+      VertexType &v = m.vert[i];
+      if (v.IsD() || ring.Valence(i) == 0) continue;
+
+      // each face is shared by two edges of the ring
+      ScalarType totalDoubleArea = 0;
+      for (int e = ring.Begin(i); e < ring.End(i); ++e)
+        totalDoubleArea += ring.edgeAreas[e];
+      totalDoubleArea /= 2;
+
+      // I-NN^t, projection on the tangent plane
+      Matrix33<ScalarType> Tp;
+      for (int k = 0; k < 3; ++k)
+        Tp[k][k] = 1 - v.cN()[k]*v.cN()[k];
+      Tp[0][1] = Tp[1][0] = -(v.cN()[0] * v.cN()[1]);
+      Tp[1][2] = Tp[2][1] = -(v.cN()[1] * v.cN()[2]);
+      Tp[0][2] = Tp[2][0] = -(v.cN()[0] * v.cN()[2]);
+
+      Matrix33<ScalarType> tempMatrix;
+      Matrix33<ScalarType> M;
+      M.SetZero();
+      for (int e = ring.Begin(i); e < ring.End(i); ++e)
+      {
+        // weight: half the area of the faces sharing the edge, the whole face on the border
+        ScalarType w = ring.edgeAreas[e] / totalDoubleArea;
+        if (ring.edgeFaceNum[e] != 1) w /= 2;
+
+        CoordType edge = v.cP() - m.vert[ring.neighbors[e]].cP();
+        ScalarType curvature = (2 * v.cN().dot(edge)) / edge.SquaredNorm();
+        CoordType T = (Tp*edge).normalized();
+        tempMatrix.ExternalProduct(T,T);
+        M += tempMatrix * w * curvature;
       }
+      TaubinPrincipalDirections(v, M);
     }
   }
 
@@ -303,9 +369,14 @@ If pointVSfaceInt==false the covariance is computed by (analytic)integration ove
       mGrid.Set(m.face.begin(),m.face.end());
     }
 
+    // The point sampled neighborhoods are read-only grid queries and every vertex writes only its own
+    // curvature, so that case runs in parallel; the face one clips a shared temporary mesh and stays serial.
     int jj = 0;
-    for(vi  = m.vert.begin(); vi != m.vert.end(); ++vi)
+    const int vn = int(m.vert.size());
+#pragma omp parallel for schedule(dynamic, 256) firstprivate(closests, distances, points) if(pointVSfaceInt)
+    for(int vIdx = 0; vIdx < vn; ++vIdx)
     {
+      VertexIterator vi = m.vert.begin() + vIdx;
       vcg::Matrix33<ScalarType> A, eigenvectors;
       vcg::Point3<ScalarType> bp, eigenvalues;
 //      int nrot;
@@ -377,8 +448,11 @@ If pointVSfaceInt==false the covariance is computed by (analytic)integration ove
         std::swap((*vi).PD1(),(*vi).PD2());
         if (cb)
         {
-          (*cb)(int(100.0f * (float)jj / (float)m.vn),"Vertices Analysis");
-          ++jj;
+#pragma omp critical (curvature_pca_cb)
+          {
+            (*cb)(int(100.0f * (float)jj / (float)m.vn),"Vertices Analysis");
+            ++jj;
+          }
         }													}
     }
 
@@ -523,6 +597,55 @@ static void MeanAndGaussian(MeshType & m)
   }
 }
 
+/// \brief Computes the discrete mean gaussian curvature over a precomputed OneRing.
+/**
+Same operators as MeanAndGaussian(m) (Meyer et al. 2002): the cotangent weights, the mixed areas and
+the angle sums come from the ring, and each vertex is computed independently, in parallel.
+No adjacency is required. The ring must have been built on the current positions of the mesh.
+*/
+static void MeanAndGaussian(MeshType & m, const OneRing<MeshType> &ring)
+{
+  vcg::tri::UpdateNormal<MeshType>::PerVertexNormalized(m);
+  auto KH = vcg::tri::Allocator<MeshType>:: template GetPerVertexAttribute<ScalarType> (m, std::string("KH"));
+  auto KG = vcg::tri::Allocator<MeshType>:: template GetPerVertexAttribute<ScalarType> (m, std::string("KG"));
+  assert(ring.VN() == int(m.vert.size()));
+
+  const int vn = int(m.vert.size());
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (int i = 0; i < vn; ++i)
+  {
+    const VertexType &v = m.vert[i];
+    if (v.IsD()) continue;
+
+    CoordType contr(0,0,0);
+    int border[2];
+    int borderNum = 0;
+    for (int e = ring.Begin(i); e < ring.End(i); ++e)
+    {
+      contr += (v.cP() - m.vert[ring.neighbors[e]].cP()) * ring.cotWeights[e];
+      if (ring.edgeFaceNum[e] == 1 && borderNum < 2)
+        border[borderNum++] = ring.neighbors[e];
+    }
+    contr /= 2;
+
+    ScalarType kg = ScalarType(2.0 * M_PI) - ring.angleSums[i];
+    if (borderNum == 2)
+      kg -= math::Abs(Angle(m.vert[border[0]].cP() - v.cP(), m.vert[border[1]].cP() - v.cP()));
+
+    const ScalarType area = ring.mixedAreas[i];
+    if (area <= std::numeric_limits<ScalarType>::epsilon())
+    {
+      KH[v] = 0;
+      KG[v] = 0;
+    }
+    else
+    {
+      KH[v] = ((contr.dot(v.cN()) > 0) ? 1 : -1) * (contr / area).Norm();
+      KG[v] = kg / area;
+    }
+  }
+}
+
 
     /// \brief Update the mean and the gaussian curvature of a vertex.
 
@@ -50,6 +50,9 @@ class vector_ocf: public std::vector<VALUE_TYPE> {
 public:
   vector_ocf():std::vector<VALUE_TYPE>()
   {
+    // the ocf coord and flags are not optional, they are just kept in side vectors
+    CoordEnabled = VALUE_TYPE::HasCoordOcf();
+    FlagsEnabled = VALUE_TYPE::HasFlagsOcf();
     ColorEnabled = false;
     CurvatureEnabled = false;
     CurvatureDirEnabled = false;
@@ -68,6 +71,8 @@ public:
     {
         BaseType::push_back(v);
         BaseType::back()._ovp = this;
+        if (CoordEnabled)         PV.push_back(typename VALUE_TYPE::CoordType());
+        if (FlagsEnabled)         FlV.push_back(0);
         if (ColorEnabled)         CV.push_back(vcg::Color4b(vcg::Color4b::White));
         if (QualityEnabled)       QV.push_back(0);
         if (MarkEnabled)          MV.push_back(0);
@@ -81,6 +86,22 @@ public:
 
     void pop_back();
 
+    void clear()
+    {
+        BaseType::clear();
+        PV.clear();
+        FlV.clear();
+        CV.clear();
+        QV.clear();
+        MV.clear();
+        NV.clear();
+        TV.clear();
+        AV.clear();
+        CuV.clear();
+        CuDV.clear();
+        RadiusV.clear();
+    }
+
     void resize(size_t _size)
     {
         const size_t oldsize = BaseType::size();
@@ -90,6 +111,8 @@ public:
             advance(firstnew,oldsize);
             _updateOVP(firstnew,(*this).end());
         }
+        if (CoordEnabled)         PV.resize(_size);
+        if (FlagsEnabled)         FlV.resize(_size,0);
         if (ColorEnabled)         CV.resize(_size);
         if (QualityEnabled)       QV.resize(_size,0);
         if (MarkEnabled)          MV.resize(_size);
@@ -104,6 +127,8 @@ public:
     void reserve(size_t _size)
     {
         BaseType::reserve(_size);
+        if (CoordEnabled)        PV.reserve(_size);
+        if (FlagsEnabled)        FlV.reserve(_size);
         if (ColorEnabled)        CV.reserve(_size);
         if (QualityEnabled)      QV.reserve(_size);
         if (MarkEnabled)         MV.reserve(_size);
@@ -125,6 +150,9 @@ public:
 ////////////////////////////////////////
 // Enabling Eunctions
 
+bool IsCoordEnabled() const {return CoordEnabled;}
+bool IsFlagsEnabled() const {return FlagsEnabled;}
+
 bool IsQualityEnabled() const {return QualityEnabled;}
 void EnableQuality() {
     assert(VALUE_TYPE::HasQualityOcf());
@@ -244,6 +272,8 @@ struct VFAdjType {
     };
 
 public:
+  std::vector<typename VALUE_TYPE::CoordType> PV;
+  std::vector<int> FlV;
   std::vector<typename VALUE_TYPE::ColorType> CV;
   std::vector<typename VALUE_TYPE::CurvatureType> CuV;
   std::vector<typename VALUE_TYPE::CurvatureDirType> CuDV;
@@ -254,6 +284,8 @@ public:
   std::vector<typename VALUE_TYPE::TexCoordType> TV;
   std::vector<struct VFAdjType> AV;
 
+  bool CoordEnabled;
+  bool FlagsEnabled;
   bool ColorEnabled;
   bool CurvatureEnabled;
   bool CurvatureDirEnabled;
@@ -269,6 +301,54 @@ public:
 //template<>	void EnableAttribute<typename VALUE_TYPE::NormalType>(){	NormalEnabled=true;}
 
 /*------------------------- COORD -----------------------------------------*/
+// Coord and flags stored in the contiguous side vectors PV and FlV of the vector_ocf, so that the
+// passes that touch only the positions (or only the flags) can stream them. Unlike the other ocf
+// components they are always enabled.
+
+template <class A, class T> class CoordOcf: public T {
+public:
+  typedef A CoordType;
+  typedef typename A::ScalarType ScalarType;
+  const CoordType &P() const { assert((*this).Base().CoordEnabled); return (*this).Base().PV[(*this).Index()]; }
+        CoordType &P()       { assert((*this).Base().CoordEnabled); return (*this).Base().PV[(*this).Index()]; }
+  const CoordType &cP() const { assert((*this).Base().CoordEnabled); return (*this).Base().PV[(*this).Index()]; }
+
+  template <class RightVertexType>
+  void ImportData(const RightVertexType & rightV)
+  {
+    if(rightV.IsCoordEnabled())
+      P().Import(rightV.cP());
+    T::ImportData(rightV);
+  }
+  static bool HasCoord()   { return true; }
+  static bool HasCoordOcf()   { return true; }
+  static void Name(std::vector<std::string> & name){name.push_back(std::string("CoordOcf"));T::Name(name);}
+};
+
+template <class T> class Coord3fOcf: public CoordOcf<vcg::Point3f, T> {public: static void Name(std::vector<std::string> & name){name.push_back(std::string("Coord3fOcf"));T::Name(name);}};
+template <class T> class Coord3dOcf: public CoordOcf<vcg::Point3d, T> {public: static void Name(std::vector<std::string> & name){name.push_back(std::string("Coord3dOcf"));T::Name(name);}};
+
+/*------------------------- FLAGS -----------------------------------------*/
+
+template <class T> class BitFlagsOcf: public T {
+public:
+  typedef int FlagType;
+  inline const int &Flags() const { assert((*this).Base().FlagsEnabled); return (*this).Base().FlV[(*this).Index()]; }
+  inline       int &Flags()       { assert((*this).Base().FlagsEnabled); return (*this).Base().FlV[(*this).Index()]; }
+  inline       int cFlags() const { assert((*this).Base().FlagsEnabled); return (*this).Base().FlV[(*this).Index()]; }
+
+  template <class RightVertexType>
+  void ImportData(const RightVertexType & rightV)
+  {
+    if(RightVertexType::HasFlags())
+      Flags() = rightV.cFlags();
+    T::ImportData(rightV);
+  }
+  static bool HasFlags()   { return true; }
+  static bool HasFlagsOcf()   { return true; }
+  static void Name(std::vector<std::string> & name){name.push_back(std::string("BitFlagsOcf"));T::Name(name);}
+};
+
 /*----------------------------- VFADJ ------------------------------*/
 
 
@@ -538,6 +618,8 @@ public:
 public:
     vector_ocf<typename T::VertexType> *_ovp;
 
+    static bool HasCoordOcf()   { return false; }
+    static bool HasFlagsOcf()   { return false; }
     static bool HasColorOcf()   { return false; }
     static bool HasCurvatureOcf()   { return false; }
     static bool HasCurvatureDirOcf()   { return false; }
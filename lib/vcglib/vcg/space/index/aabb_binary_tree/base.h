@@ -41,6 +41,7 @@ First Commit.
 #include <assert.h>
 
 // stl headers
+#include <algorithm>
 #include <vector>
 
 // vcg headers
@@ -273,53 +274,16 @@ template <class OBJTYPE, class SCALARTYPE, class NODEAUXDATATYPE>
 template <class OBJBARYCENTERFUNCT>
 int AABBBinaryTree<OBJTYPE, SCALARTYPE, NODEAUXDATATYPE>::BalanceMedian(const ObjPtrVectorIterator & oBegin, const ObjPtrVectorIterator & oEnd, const int size, const int splitAxis, OBJBARYCENTERFUNCT & getBarycenter, ObjPtrVectorIterator & medianIter) {
 	const int iMedian = (size + 1) / 2;
-
-	ObjPtrVectorIterator l, r, i, j;
-	ObjPtr iTmp;
-	ScalarType pos;
 	ObjPtrVectorIterator median = oBegin + iMedian;
-	CoordType bc;
-
-	l = oBegin;
-	r = oEnd - 1;
-
-	while (l < r) {
-		getBarycenter(*(*r), bc);
-		pos = bc[splitAxis];
-
-		i = l;
-		j = r - 1;
-
-		while (true) {
-			getBarycenter(*(*i), bc);
-			while ((bc[splitAxis] <= pos) && (i < r)) {
-				i++;
-				getBarycenter(*(*i), bc);
-			}
-			getBarycenter(*(*j), bc);
-			while ((bc[splitAxis] > pos) && (j > l)) {
-				j--;
-				getBarycenter(*(*j), bc);
-			}
-			if (i >= j) {
-				break;
-			}
-			iTmp = (*i);
-			(*i) = (*j);
-			(*j) = iTmp;
-		}
-
-		iTmp = (*i);
-		(*i) = (*r);
-		(*r) = iTmp;
 
-		if (i >= (median)) {
-			r = i - 1;
-		}
-		if (i <= (median)) {
-			l = i + 1;
-		}
-	}
+	// Introselect: the former last-element pivot quickselect was quadratic on objects already sorted
+	// along the split axis, which is the common case for faces of scanned or gridded meshes.
+	std::nth_element(oBegin, median, oEnd, [&](const ObjPtr a, const ObjPtr b) {
+		CoordType ca, cb;
+		getBarycenter(*a, ca);
+		getBarycenter(*b, cb);
+		return (ca[splitAxis] < cb[splitAxis]);
+	});
 
 	medianIter = median;
 
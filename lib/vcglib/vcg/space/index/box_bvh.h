@@ -0,0 +1,415 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+#ifndef VCG_SPACE_INDEX_BOX_BVH_H
+#define VCG_SPACE_INDEX_BOX_BVH_H
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <vcg/space/box3.h>
+#include <vcg/space/ray3.h>
+
+namespace vcg {
+
+/**
+Bounding volume hierarchy over a set of boxes, one per primitive, stored in a flat node array.
+
+Nodes are split at the median of the longest axis of the box centers. The layout of the tree only
+depends on the number of primitives (the left child of a node follows it, the right one follows the
+whole left subtree), so the subtrees are built in parallel straight into their final place.
+
+OverlapPairs() finds all the pairs of primitives whose boxes collide, within one tree or between two
+trees, with a dual-tree traversal that runs in parallel over a frontier of node pairs; BoxQuery() is
+the single box query, to run one per thread when only one side is worth a tree. Collisions use
+Box3::Collide(), so boxes that only touch do not collide, exactly as in the grid box queries.
+RayQuery() is the nearest hit ray query and RegionQuery() visits the primitives of any region that can
+classify a box, e.g. a sub frustum for rectangle or lasso selections.
+*/
+template <class SCALARTYPE>
+class BoxBVH
+{
+public:
+    typedef SCALARTYPE ScalarType;
+    typedef Box3<ScalarType> BoxType;
+
+    struct Node
+    {
+        BoxType box;
+        int begin, end;   // range in items
+        int right;        // right child, -1 for leaves (the left child is the next node)
+        bool IsLeaf() const { return right < 0; }
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int> items;         // primitive indices, grouped by leaf
+    std::vector<BoxType> itemBoxes; // their boxes, in the same order
+
+    BoxBVH() {}
+
+    void Clear() { nodes.clear(); items.clear(); itemBoxes.clear(); }
+    bool Empty() const { return nodes.empty(); }
+
+    /** Builds the hierarchy. Null boxes (e.g. of deleted primitives) are left out. */
+    void Build(const std::vector<BoxType> &boxes, int leafSize = 4)
+    {
+        Clear();
+        mLeafSize = std::max(leafSize, 1);
+        std::vector<BuildItem> buildItems;
+        for (int i = 0; i < int(boxes.size()); ++i)
+            if (!boxes[i].IsNull()) buildItems.push_back(BuildItem(boxes[i].Center(), i));
+        const int n = int(buildItems.size());
+        if (n == 0) return;
+
+        nodes.resize(NodeCount(n));
+        std::vector<BuildTask> tasks;
+        const int taskSize = std::max(n / 256, 4096);
+        BuildRange(buildItems, 0, 0, n, taskSize, &tasks);
+#pragma omp parallel for schedule(dynamic, 1)
+        for (int t = 0; t < int(tasks.size()); ++t)
+            BuildRange(buildItems, tasks[t].node, tasks[t].begin, tasks[t].end, taskSize, 0);
+
+        items.resize(n);
+        itemBoxes.resize(n);
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < n; ++i)
+        {
+            items[i] = buildItems[i].index;
+            itemBoxes[i] = boxes[items[i]];
+        }
+
+        // node boxes bottom-up: children always follow their parent
+        for (int i = int(nodes.size()) - 1; i >= 0; --i)
+        {
+            Node &nd = nodes[i];
+            nd.box.SetNull();
+            if (nd.IsLeaf())
+                for (int j = nd.begin; j < nd.end; ++j) nd.box.Add(itemBoxes[j]);
+            else
+            {
+                nd.box.Add(nodes[i + 1].box);
+                nd.box.Add(nodes[nd.right].box);
+            }
+        }
+    }
+
+    /**
+    Calls test(i, j) for every pair of primitives, i of a and j of b, whose boxes collide and keeps the
+    pairs for which it returns true. The test is called concurrently, so it must be thread safe.
+    When a and b are the same tree each unordered pair is tested once, with i < j.
+    The kept pairs are returned sorted.
+    */
+    template <class PairTest>
+    static void OverlapPairs(const BoxBVH &a, const BoxBVH &b, PairTest test, std::vector<std::pair<int, int> > &result)
+    {
+        result.clear();
+        if (a.Empty() || b.Empty()) return;
+        const bool self = (&a == &b);
+
+        // breadth first expansion of the root pair, to get enough independent pairs for the threads
+        std::vector<NodePair> frontier(1, NodePair(0, 0));
+        for (size_t minFrontier = 256; frontier.size() < minFrontier; )
+        {
+            std::vector<NodePair> next;
+            bool split = false;
+            for (size_t i = 0; i < frontier.size(); ++i)
+                split |= Expand(a, b, self, frontier[i], next);
+            frontier.swap(next);
+            if (!split) break;
+        }
+
+        std::vector<std::pair<int, int> > found;
+#pragma omp parallel
+        {
+            std::vector<std::pair<int, int> > local;
+            std::vector<NodePair> stack;
+#pragma omp for schedule(dynamic, 1) nowait
+            for (int p = 0; p < int(frontier.size()); ++p)
+            {
+                stack.assign(1, frontier[p]);
+                while (!stack.empty())
+                {
+                    NodePair np = stack.back();
+                    stack.pop_back();
+                    const Node &na = a.nodes[np.first];
+                    const Node &nb = b.nodes[np.second];
+                    if (na.IsLeaf() && nb.IsLeaf())
+                        LeafPairs(a, b, self, np, test, local);
+                    else
+                        Expand(a, b, self, np, stack);
+                }
+            }
+#pragma omp critical (box_bvh_merge)
+            found.insert(found.end(), local.begin(), local.end());
+        }
+        std::sort(found.begin(), found.end());
+        result.swap(found);
+    }
+
+    /**
+    Calls visit(i) for every primitive whose box collides with the given one. The stack is only
+    scratch memory, passing one per thread avoids an allocation per query.
+    */
+    template <class Visitor>
+    void BoxQuery(const BoxType &box, Visitor visit, std::vector<int> &stack) const
+    {
+        if (Empty()) return;
+        stack.assign(1, 0);
+        while (!stack.empty())
+        {
+            const int ni = stack.back();
+            stack.pop_back();
+            const Node &nd = nodes[ni];
+            if (!nd.box.Collide(box)) continue;
+            if (nd.IsLeaf())
+            {
+                for (int i = nd.begin; i < nd.end; ++i)
+                    if (itemBoxes[i].Collide(box)) visit(items[i]);
+            }
+            else
+            {
+                stack.push_back(nd.right);
+                stack.push_back(ni + 1);
+            }
+        }
+    }
+
+    /**
+    Finds the primitive first hit by the ray within distance dist (in units of the ray direction).
+    hit(i, t) returns true with the distance t when primitive i is hit; the nodes are visited near to
+    far and skipped once they start beyond the closest hit so far. Returns the primitive, or -1 when
+    nothing is hit, and its distance in dist.
+    */
+    template <class HitTest>
+    int RayQuery(const Ray3<ScalarType> &ray, ScalarType &dist, HitTest hit, std::vector<int> &stack) const
+    {
+        int best = -1;
+        if (Empty()) return best;
+        const CoordType &o = ray.Origin();
+        const CoordType &d = ray.Direction();
+        const CoordType inv(ScalarType(1) / d[0], ScalarType(1) / d[1], ScalarType(1) / d[2]);
+        ScalarType enter;
+        stack.clear();
+        if (SlabTest(nodes[0].box, o, inv, dist, enter)) stack.push_back(0);
+        while (!stack.empty())
+        {
+            const int ni = stack.back();
+            stack.pop_back();
+            const Node &nd = nodes[ni];
+            if (!SlabTest(nd.box, o, inv, dist, enter)) continue;
+            if (nd.IsLeaf())
+            {
+                for (int i = nd.begin; i < nd.end; ++i)
+                {
+                    ScalarType t;
+                    if (!SlabTest(itemBoxes[i], o, inv, dist, enter) || !hit(items[i], t) || t >= dist) continue;
+                    dist = t;
+                    best = items[i];
+                }
+            }
+            else
+            {
+                ScalarType enterL, enterR;
+                const bool l = SlabTest(nodes[ni + 1].box, o, inv, dist, enterL);
+                const bool r = SlabTest(nodes[nd.right].box, o, inv, dist, enterR);
+                // the nearer child goes on top
+                if (l && r && enterL > enterR)
+                {
+                    stack.push_back(ni + 1);
+                    stack.push_back(nd.right);
+                }
+                else
+                {
+                    if (r) stack.push_back(nd.right);
+                    if (l) stack.push_back(ni + 1);
+                }
+            }
+        }
+        return best;
+    }
+
+    /**
+    Visits the primitives of a region given by classify(box), that returns -1 when the box is out of
+    the region, 1 when it is all inside and 0 otherwise. visit(i, inside) is called for each primitive
+    whose box is not out, with inside true when its box is all inside; the primitives of a node all
+    inside are visited without classifying their boxes.
+    */
+    template <class BoxClassifier, class Visitor>
+    void RegionQuery(BoxClassifier classify, Visitor visit, std::vector<int> &stack) const
+    {
+        if (Empty()) return;
+        stack.assign(1, 0);
+        while (!stack.empty())
+        {
+            const int ni = stack.back();
+            stack.pop_back();
+            const Node &nd = nodes[ni];
+            const int c = classify(nd.box);
+            if (c < 0) continue;
+            if (c > 0)
+            {
+                for (int i = nd.begin; i < nd.end; ++i) visit(items[i], true);
+            }
+            else if (nd.IsLeaf())
+            {
+                for (int i = nd.begin; i < nd.end; ++i)
+                {
+                    const int ci = classify(itemBoxes[i]);
+                    if (ci >= 0) visit(items[i], ci > 0);
+                }
+            }
+            else
+            {
+                stack.push_back(nd.right);
+                stack.push_back(ni + 1);
+            }
+        }
+    }
+
+private:
+    typedef Point3<ScalarType> CoordType;
+    typedef std::pair<int, int> NodePair;
+
+    // Ray (origin o, inverse direction inv) against a box, for distances in [0, maxDist).
+    static bool SlabTest(const BoxType &box, const CoordType &o, const CoordType &inv, ScalarType maxDist, ScalarType &enter)
+    {
+        ScalarType t0 = 0, t1 = maxDist;
+        for (int k = 0; k < 3; ++k)
+        {
+            ScalarType tn = (box.min[k] - o[k]) * inv[k];
+            ScalarType tf = (box.max[k] - o[k]) * inv[k];
+            if (tn > tf) std::swap(tn, tf);
+            // NaN (origin on a slab of a null direction) must not reject the box
+            if (tn > t0) t0 = tn;
+            if (tf < t1) t1 = tf;
+            if (t0 > t1) return false;
+        }
+        enter = t0;
+        return true;
+    }
+
+    struct BuildItem
+    {
+        CoordType center;
+        int index;
+        BuildItem(const CoordType &_center, int _index) : center(_center), index(_index) {}
+    };
+
+    struct BuildTask
+    {
+        int node, begin, end;
+        BuildTask(int _node, int _begin, int _end) : node(_node), begin(_begin), end(_end) {}
+    };
+
+    int mLeafSize = 4;
+
+    int NodeCount(int n) const
+    {
+        return n <= mLeafSize ? 1 : 1 + NodeCount(n / 2) + NodeCount(n - n / 2);
+    }
+
+    // Splits [begin, end) under node, node boxes excluded. With a task list, the subtrees not larger
+    // than taskSize are queued instead of being built.
+    void BuildRange(std::vector<BuildItem> &buildItems, int node, int begin, int end, int taskSize,
+                    std::vector<BuildTask> *tasks)
+    {
+        if (tasks && end - begin <= taskSize)
+        {
+            tasks->push_back(BuildTask(node, begin, end));
+            return;
+        }
+        Node &nd = nodes[node];
+        nd.begin = begin;
+        nd.end = end;
+        const int n = end - begin;
+        if (n <= mLeafSize)
+        {
+            nd.right = -1;
+            return;
+        }
+        BoxType centerBox;
+        for (int i = begin; i < end; ++i)
+            centerBox.Add(buildItems[i].center);
+        const int axis = centerBox.MaxDim();
+        const int mid = begin + n / 2;
+        std::nth_element(buildItems.begin() + begin, buildItems.begin() + mid, buildItems.begin() + end,
+                         [axis](const BuildItem &i0, const BuildItem &i1) { return i0.center[axis] < i1.center[axis]; });
+        nd.right = node + 1 + NodeCount(n / 2);
+        BuildRange(buildItems, node + 1, begin, mid, taskSize, tasks);
+        BuildRange(buildItems, nd.right, mid, end, taskSize, tasks);
+    }
+
+    // Pushes the children pairs of a colliding node pair; returns false if there is nothing to split.
+    static bool Expand(const BoxBVH &a, const BoxBVH &b, bool self, const NodePair &np, std::vector<NodePair> &out)
+    {
+        const Node &na = a.nodes[np.first];
+        const Node &nb = b.nodes[np.second];
+        if (self && np.first == np.second)
+        {
+            if (na.IsLeaf()) { out.push_back(np); return false; }
+            const int l = np.first + 1, r = na.right;
+            out.push_back(NodePair(l, l));
+            out.push_back(NodePair(r, r));
+            if (a.nodes[l].box.Collide(a.nodes[r].box)) out.push_back(NodePair(l, r));
+            return true;
+        }
+        if (!na.box.Collide(nb.box)) return true;
+        if (na.IsLeaf() && nb.IsLeaf()) { out.push_back(np); return false; }
+        // descend the larger one
+        if (nb.IsLeaf() || (!na.IsLeaf() && na.box.Volume() >= nb.box.Volume()))
+        {
+            const int l = np.first + 1, r = na.right;
+            if (a.nodes[l].box.Collide(nb.box)) out.push_back(NodePair(l, np.second));
+            if (a.nodes[r].box.Collide(nb.box)) out.push_back(NodePair(r, np.second));
+        }
+        else
+        {
+            const int l = np.second + 1, r = nb.right;
+            if (na.box.Collide(b.nodes[l].box)) out.push_back(NodePair(np.first, l));
+            if (na.box.Collide(b.nodes[r].box)) out.push_back(NodePair(np.first, r));
+        }
+        return true;
+    }
+
+    template <class PairTest>
+    static void LeafPairs(const BoxBVH &a, const BoxBVH &b, bool self, const NodePair &np, PairTest &test,
+                          std::vector<std::pair<int, int> > &out)
+    {
+        const Node &na = a.nodes[np.first];
+        const Node &nb = b.nodes[np.second];
+        const bool sameLeaf = self && np.first == np.second;
+        for (int i = na.begin; i < na.end; ++i)
+        {
+            for (int j = sameLeaf ? i + 1 : nb.begin; j < nb.end; ++j)
+            {
+                if (!a.itemBoxes[i].Collide(b.itemBoxes[j])) continue;
+                int ia = a.items[i], ib = b.items[j];
+                if (self && ia > ib) std::swap(ia, ib);
+                if (test(ia, ib)) out.push_back(std::make_pair(ia, ib));
+            }
+        }
+    }
+};
+
+} // end namespace vcg
+
+#endif // VCG_SPACE_INDEX_BOX_BVH_H
@@ -32,6 +32,7 @@
 #include <limits>
 #include <iostream>
 #include <cstdint>
+#include <algorithm>
 
 namespace vcg {
 
@@ -117,25 +118,46 @@ namespace vcg {
 
   public:
 
+    // element of the stack
+    struct QueryNode
+    {
+      QueryNode() {}
+      QueryNode(unsigned int id) : nodeId(id) {}
+      unsigned int nodeId;  // id of the next node
+      Scalar sq;            // squared distance to the next node
+    };
+
+    // Traversal stack of a query. Passing the same one to many queries (one per thread) avoids
+    // allocating it at each call.
+    typedef std::vector<QueryNode> QueryStack;
+
     KdTree(const ConstDataWrapper<VectorType>& points, unsigned int nofPointsPerCell = 16, unsigned int maxDepth = 64, bool balanced = false);
 
     ~KdTree();
 
     void doQueryK(const VectorType& queryPoint, int k, PriorityQueue& mNeighborQueue);
+    void doQueryK(const VectorType& queryPoint, int k, PriorityQueue& mNeighborQueue, QueryStack& stack);
 
     void doQueryDist(const VectorType& queryPoint, Scalar dist, std::vector<unsigned int>& points, std::vector<Scalar>& sqrareDists);
+    void doQueryDist(const VectorType& queryPoint, Scalar dist, std::vector<unsigned int>& points, std::vector<Scalar>& sqrareDists, QueryStack& stack);
 
     void doQueryClosest(const VectorType& queryPoint, unsigned int& index, Scalar& dist);
+    void doQueryClosest(const VectorType& queryPoint, unsigned int& index, Scalar& dist, QueryStack& stack);
+
+    void doQueryKBatch(const ConstDataWrapper<VectorType>& queryPoints, int k,
+                       std::vector<unsigned int>& offsets, std::vector<unsigned int>& points, std::vector<Scalar>& sqrareDists,
+                       bool sortQueries = true);
+
+    void doQueryDistBatch(const ConstDataWrapper<VectorType>& queryPoints, Scalar dist,
+                          std::vector<unsigned int>& offsets, std::vector<unsigned int>& points, std::vector<Scalar>& sqrareDists,
+                          bool sortQueries = true);
 
   protected:
 
-    // element of the stack
-    struct QueryNode
+    // a subtree whose construction has been deferred to be done in parallel
+    struct BuildTask
     {
-      QueryNode() {}
-      QueryNode(unsigned int id) : nodeId(id) {}
-      unsigned int nodeId;  // id of the next node
-      Scalar sq;            // squared distance to the next node
+      unsigned int nodeId, start, end, level;
     };
 
     // used to build the tree: split the subset [start..end[ according to dim and splitValue,
@@ -143,6 +165,11 @@ namespace vcg {
     unsigned int split(int start, int end, unsigned int dim, Scalar splitValue);
 
     int createTree(unsigned int nodeId, unsigned int start, unsigned int end, unsigned int level);
+    int createTree(NodeList& nodes, unsigned int nodeId, unsigned int start, unsigned int end, unsigned int level,
+                   std::vector<BuildTask>* tasks, unsigned int taskSize);
+    void buildParallel();
+
+    void queryOrder(const ConstDataWrapper<VectorType>& queryPoints, bool sortQueries, std::vector<unsigned int>& order) const;
 
   protected:
 
@@ -178,7 +205,7 @@ namespace vcg {
     //first node inserted (no leaf). The others are made by the createTree function (recursively)
     mNodes.resize(1);
     mNodes.back().leaf = 0;
-    numLevel = createTree(0, 0, mPoints.size(), 1);
+    buildParallel();
   }
 
   template<typename Scalar>
@@ -205,11 +232,19 @@ namespace vcg {
   */
   template<typename Scalar>
   void KdTree<Scalar>::doQueryK(const VectorType& queryPoint, int k, PriorityQueue& mNeighborQueue)
+  {
+    QueryStack mNodeStack;
+    doQueryK(queryPoint, k, mNeighborQueue, mNodeStack);
+  }
+
+  template<typename Scalar>
+  void KdTree<Scalar>::doQueryK(const VectorType& queryPoint, int k, PriorityQueue& mNeighborQueue, QueryStack& mNodeStack)
   {
     mNeighborQueue.setMaxSize(k);
     mNeighborQueue.init();
 
-    std::vector<QueryNode> mNodeStack(numLevel + 1);
+    if (mNodeStack.size() < numLevel + 1)
+      mNodeStack.resize(numLevel + 1);
     mNodeStack[0].nodeId = 0;
     mNodeStack[0].sq = 0.;
     unsigned int count = 1;
@@ -281,7 +316,15 @@ namespace vcg {
   template<typename Scalar>
   void KdTree<Scalar>::doQueryDist(const VectorType& queryPoint, Scalar dist, std::vector<unsigned int>& points, std::vector<Scalar>& sqrareDists)
   {
-    std::vector<QueryNode> mNodeStack(numLevel + 1);
+    QueryStack mNodeStack;
+    doQueryDist(queryPoint, dist, points, sqrareDists, mNodeStack);
+  }
+
+  template<typename Scalar>
+  void KdTree<Scalar>::doQueryDist(const VectorType& queryPoint, Scalar dist, std::vector<unsigned int>& points, std::vector<Scalar>& sqrareDists, QueryStack& mNodeStack)
+  {
+    if (mNodeStack.size() < numLevel + 1)
+      mNodeStack.resize(numLevel + 1);
     mNodeStack[0].nodeId = 0;
     mNodeStack[0].sq = 0.;
     unsigned int count = 1;
@@ -344,7 +387,15 @@ namespace vcg {
   template<typename Scalar>
   void KdTree<Scalar>::doQueryClosest(const VectorType& queryPoint, unsigned int& index, Scalar& dist)
   {
-    std::vector<QueryNode> mNodeStack(numLevel + 1);
+    QueryStack mNodeStack;
+    doQueryClosest(queryPoint, index, dist, mNodeStack);
+  }
+
+  template<typename Scalar>
+  void KdTree<Scalar>::doQueryClosest(const VectorType& queryPoint, unsigned int& index, Scalar& dist, QueryStack& mNodeStack)
+  {
+    if (mNodeStack.size() < numLevel + 1)
+      mNodeStack.resize(numLevel + 1);
     mNodeStack[0].nodeId = 0;
     mNodeStack[0].sq = 0.;
     unsigned int count = 1;
@@ -405,6 +456,159 @@ namespace vcg {
 
 
 
+  /** Performs a kNN query for each point of queryPoints.
+  *
+  * The result is stored in CSR form: the neighbors of the i-th query are points[offsets[i]..offsets[i+1]),
+  * sorted by increasing distance, and their squared distances are in sqrareDists.
+  * The queries are distributed among threads, each one with its own stack and queue. If sortQueries is true
+  * they are visited in Morton order, so that consecutive queries walk down the same branches of the tree.
+  */
+  template<typename Scalar>
+  void KdTree<Scalar>::doQueryKBatch(const ConstDataWrapper<VectorType>& queryPoints, int k,
+                                     std::vector<unsigned int>& offsets, std::vector<unsigned int>& points, std::vector<Scalar>& sqrareDists,
+                                     bool sortQueries)
+  {
+    int n = int(queryPoints.size());
+    int kk = std::min(k, int(mPoints.size()));
+    offsets.resize(n + 1);
+    for (int i = 0; i <= n; ++i)
+      offsets[i] = i * kk;
+    points.resize(size_t(n) * kk);
+    sqrareDists.resize(size_t(n) * kk);
+
+    std::vector<unsigned int> order;
+    queryOrder(queryPoints, sortQueries, order);
+
+#pragma omp parallel
+    {
+      PriorityQueue queue;
+      QueryStack stack;
+#pragma omp for schedule(dynamic, 256)
+      for (int j = 0; j < n; ++j)
+      {
+        unsigned int q = order[j];
+        doQueryK(queryPoints[q], kk, queue, stack);
+        queue.sort(true);
+        unsigned int base = offsets[q];
+        for (int i = 0; i < queue.getNofElements(); ++i)
+        {
+          points[base + i] = queue.getIndex(i);
+          sqrareDists[base + i] = queue.getWeight(i);
+        }
+      }
+    }
+  }
+
+  /** Performs a distance query for each point of queryPoints.
+  *
+  * The result is stored in CSR form as in doQueryKBatch(), but the points within each range are in
+  * the order they have been found (as in doQueryDist()).
+  * Each thread collects the results of a chunk of consecutive queries, the chunks are then copied to their final place.
+  */
+  template<typename Scalar>
+  void KdTree<Scalar>::doQueryDistBatch(const ConstDataWrapper<VectorType>& queryPoints, Scalar dist,
+                                        std::vector<unsigned int>& offsets, std::vector<unsigned int>& points, std::vector<Scalar>& sqrareDists,
+                                        bool sortQueries)
+  {
+    int n = int(queryPoints.size());
+    std::vector<unsigned int> order;
+    queryOrder(queryPoints, sortQueries, order);
+
+    const int chunkSize = 1024;
+    int chunkNum = (n + chunkSize - 1) / chunkSize;
+    std::vector< std::vector<unsigned int> > chunkPoints(chunkNum);
+    std::vector< std::vector<Scalar> > chunkDists(chunkNum);
+    offsets.assign(n + 1, 0);
+
+#pragma omp parallel
+    {
+      QueryStack stack;
+#pragma omp for schedule(dynamic, 1)
+      for (int c = 0; c < chunkNum; ++c)
+      {
+        int jEnd = std::min(n, (c + 1) * chunkSize);
+        for (int j = c * chunkSize; j < jEnd; ++j)
+        {
+          size_t before = chunkPoints[c].size();
+          doQueryDist(queryPoints[order[j]], dist, chunkPoints[c], chunkDists[c], stack);
+          offsets[order[j] + 1] = (unsigned int)(chunkPoints[c].size() - before);
+        }
+      }
+    }
+
+    for (int i = 0; i < n; ++i)
+      offsets[i + 1] += offsets[i];
+    points.resize(offsets[n]);
+    sqrareDists.resize(offsets[n]);
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < chunkNum; ++c)
+    {
+      size_t pos = 0;
+      int jEnd = std::min(n, (c + 1) * chunkSize);
+      for (int j = c * chunkSize; j < jEnd; ++j)
+      {
+        unsigned int q = order[j];
+        for (unsigned int i = offsets[q]; i < offsets[q + 1]; ++i, ++pos)
+        {
+          points[i] = chunkPoints[c][pos];
+          sqrareDists[i] = chunkDists[c][pos];
+        }
+      }
+      std::vector<unsigned int>().swap(chunkPoints[c]);
+      std::vector<Scalar>().swap(chunkDists[c]);
+    }
+  }
+
+  /**
+  * Visiting order of a batch of queries. When sorted, the queries are bucketed by the Morton code of a grid
+  * laid over the tree bounding box (about 32 queries per cell), with a counting sort that keeps the input order
+  * inside each cell.
+  */
+  template<typename Scalar>
+  void KdTree<Scalar>::queryOrder(const ConstDataWrapper<VectorType>& queryPoints, bool sortQueries, std::vector<unsigned int>& order) const
+  {
+    int n = int(queryPoints.size());
+    order.resize(n);
+    if (!sortQueries || n < 64)
+    {
+      for (int i = 0; i < n; ++i)
+        order[i] = i;
+      return;
+    }
+
+    int bits = 1;
+    while (bits < 7 && (size_t(1) << (3 * (bits + 1))) * 32 <= size_t(n))
+      ++bits;
+    int cellNum = 1 << (3 * bits);
+    int side = 1 << bits;
+
+    VectorType dim = mAABB.max - mAABB.min;
+    std::vector<unsigned int> codes(n);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i)
+    {
+      unsigned int code = 0;
+      for (int a = 0; a < 3; ++a)
+      {
+        Scalar t = dim[a] > 0 ? (queryPoints[i][a] - mAABB.min[a]) / dim[a] : Scalar(0);
+        int c = std::max(0, std::min(side - 1, int(t * side)));
+        for (int b = 0; b < bits; ++b)
+          code |= ((c >> b) & 1u) << (3 * b + a);
+      }
+      codes[i] = code;
+    }
+
+    std::vector<unsigned int> start(cellNum + 1, 0);
+    for (int i = 0; i < n; ++i)
+      ++start[codes[i] + 1];
+    for (int c = 0; c < cellNum; ++c)
+      start[c + 1] += start[c];
+    for (int i = 0; i < n; ++i)
+      order[start[codes[i]]++] = i;
+  }
+
+
   /**
   * Split the subarray between start and end in two part, one with the elements less than splitValue,
   * the other with the elements greater or equal than splitValue. The elements are compared
@@ -448,9 +652,19 @@ namespace vcg {
   */
   template<typename Scalar>
   int KdTree<Scalar>::createTree(unsigned int nodeId, unsigned int start, unsigned int end, unsigned int level)
+  {
+    return createTree(mNodes, nodeId, start, end, level, 0, 0);
+  }
+
+  /** Same as above, building the nodes into the given list. If tasks is not null, the non leaf children with at most
+  *  taskSize points are not built: they are appended to tasks, to be completed later by buildParallel().
+  */
+  template<typename Scalar>
+  int KdTree<Scalar>::createTree(NodeList& nodes, unsigned int nodeId, unsigned int start, unsigned int end, unsigned int level,
+                                 std::vector<BuildTask>* tasks, unsigned int taskSize)
   {
     //select the first node
-    Node& node = mNodes[nodeId];
+    Node& node = nodes[nodeId];
     AxisAlignedBoxType aabb;
 
     //putting all the points in the bounding box
@@ -483,14 +697,14 @@ namespace vcg {
     //midId is the index of the first element in the second partition
     unsigned int midId = split(start, end, dim, node.splitValue);
 
-    node.firstChildId = mNodes.size();
-    mNodes.resize(mNodes.size() + 2);
+    node.firstChildId = nodes.size();
+    nodes.resize(nodes.size() + 2);
     bool flag = (midId == start) || (midId == end);
     int leftLevel, rightLevel;
     {
       // left child
-      unsigned int childId = mNodes[nodeId].firstChildId;
-      Node& child = mNodes[childId];
+      unsigned int childId = nodes[nodeId].firstChildId;
+      Node& child = nodes[childId];
       if (flag || (midId - start) <= targetCellSize || level >= targetMaxDepth)
       {
         child.leaf = 1;
@@ -501,14 +715,21 @@ namespace vcg {
       else
       {
         child.leaf = 0;
-        leftLevel = createTree(childId, start, midId, level + 1);
+        if (tasks && (midId - start) <= taskSize)
+        {
+          BuildTask task = { childId, start, midId, level + 1 };
+          tasks->push_back(task);
+          leftLevel = level + 1;
+        }
+        else
+          leftLevel = createTree(nodes, childId, start, midId, level + 1, tasks, taskSize);
       }
     }
 
     {
       // right child
-      unsigned int childId = mNodes[nodeId].firstChildId + 1;
-      Node& child = mNodes[childId];
+      unsigned int childId = nodes[nodeId].firstChildId + 1;
+      Node& child = nodes[childId];
       if (flag || (end - midId) <= targetCellSize || level >= targetMaxDepth)
       {
         child.leaf = 1;
@@ -519,7 +740,14 @@ namespace vcg {
       else
       {
         child.leaf = 0;
-        rightLevel = createTree(childId, midId, end, level + 1);
+        if (tasks && (end - midId) <= taskSize)
+        {
+          BuildTask task = { childId, midId, end, level + 1 };
+          tasks->push_back(task);
+          rightLevel = level + 1;
+        }
+        else
+          rightLevel = createTree(nodes, childId, midId, end, level + 1, tasks, taskSize);
       }
     }
     if (leftLevel > rightLevel)
@@ -527,6 +755,53 @@ namespace vcg {
     return rightLevel;
   }
 
+
+  /** Builds the tree from the root node.
+  *
+  *  The top of the tree is built serially until the subsets are small enough, then the remaining subtrees,
+  *  that work on disjoint ranges of mPoints, are built in parallel into their own node lists. These are finally
+  *  appended to mNodes in a fixed order, so the resulting tree does not depend on the number of threads.
+  */
+  template<typename Scalar>
+  void KdTree<Scalar>::buildParallel()
+  {
+    unsigned int size = mPoints.size();
+    // below this size the task setup costs more than it saves
+    const unsigned int minParallelSize = 1 << 15;
+    if (size < minParallelSize)
+    {
+      numLevel = createTree(0, 0, size, 1);
+      return;
+    }
+
+    std::vector<BuildTask> tasks;
+    unsigned int taskSize = std::max(size / 256, targetCellSize * 64);
+    numLevel = createTree(mNodes, 0, 0, size, 1, &tasks, taskSize);
+
+    std::vector<NodeList> subtrees(tasks.size());
+    std::vector<int> levels(tasks.size());
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < (int)tasks.size(); ++i)
+    {
+      subtrees[i].resize(1);
+      subtrees[i][0].leaf = 0;
+      levels[i] = createTree(subtrees[i], 0, tasks[i].start, tasks[i].end, tasks[i].level, 0, 0);
+    }
+
+    // the root of a subtree replaces its placeholder, its node j>0 goes to base+j
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+      NodeList& nodes = subtrees[i];
+      unsigned int base = mNodes.size() - 1;
+      for (size_t j = 0; j < nodes.size(); ++j)
+        if (!nodes[j].leaf)
+          nodes[j].firstChildId += base;
+      mNodes[tasks[i].nodeId] = nodes[0];
+      mNodes.insert(mNodes.end(), nodes.begin() + 1, nodes.end());
+      numLevel = std::max(numLevel, (unsigned int)levels[i]);
+      NodeList().swap(nodes);
+    }
+  }
 }
 
 #endif
@@ -17,11 +17,12 @@
 #include <vector>
 #include <GL/freeglut.h>
 #include <cstdint>
-#include "Point3D.h"
-#include "Point3D.inl.h"
-#include "VCGLib_Helper/LODMaker.h"
-#include "ObjIO.h"
+#include "ViewerScene.h"
+#include "GpuTimer.h"
 #include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <string>
 
 #ifndef M_PI
 #define M_PI	3.14159265358979323846
@@ -31,213 +32,115 @@
 #pragma warning (disable: 4305 4244)
 #endif
 
-std::vector<uint32_t> _indices;
-std::vector<Point3D> _vertices;
-std::vector<Point3D> _normals;
-
-std::vector<uint32_t> _indices2;
-std::vector<Point3D> _vertices2;
-std::vector<Point3D> _normals2;
-
-bool displayNormals_ = false;
-int displayMode = 0;
-
-float lpos[] = {10, 10, 10, 0};
-float lAmbient[] = {0.2, 0.2, 0.2, 0};
-float lDiffuse[] = {1, 1, 1, 0};
-
-static const char *helpprompt[] = {"Press F1 for help", 0};
-static const char *helptext[] = {
-	"Rotate: left mouse drag",
-	" Scale: right mouse drag up/down",
-	"   Pan: middle mouse drag",
-	"",
-	"Toggle fullscreen: f",
-	"Toggle animation: space",
-	"Quit: escape",
-	0
-};
+std::chrono::high_resolution_clock::time_point _startTime;
+
+GpuTimer _gpuTimer;
+bool showProfile_ = false;                   // frame time graph in place of the help text
+std::string profilePath_;                    // percentiles written there on exit, when set
+
+int pick_mode;                               // 0: none, 1: click or rectangle, 2: lasso
+int pick_x0, pick_y0, pick_x1, pick_y1;      // GLUT window coordinates (y down)
+bool pick_dragged;
+std::vector<vcg::Point2f> pick_lasso;        // GL window coordinates (y up)
+
+int sceneInstances_;                         // -scene: instances of the two meshes drawn in their place
+bool pointBudgetFixed_;                      // -points: no adaptation to the frame time
+
+FILE *recordFile_;                           // -record: the camera of every frame is appended there
 
 void idle(void);
 void display(void);
-void print_help(void);
+void drawProfile(void);
+void dumpProfile(void);
+void closeWindow(void);
+void drawPickOverlay(void);
 void reshape(int x, int y);
 void keypress(unsigned char key, int x, int y);
 void skeypress(int key, int x, int y);
 void mouse(int bn, int st, int x, int y);
 void motion(int x, int y);
+void pickIdle(void);
 
-int win_width, win_height;
-float cam_theta, cam_phi = 25, cam_dist = 8;
-float cam_pan[3];
 int mouse_x, mouse_y;
 int bnstate[8];
-int anim, help;
+int anim;
 long anim_start;
 long nframes;
 
-#ifndef GL_FRAMEBUFFER_SRGB
-#define GL_FRAMEBUFFER_SRGB	0x8db9
-#endif
-
-#ifndef GL_MULTISAMPLE
-#define GL_MULTISAMPLE 0x809d
-#endif
-
-using v3f = Point3D;
-
-void setMatColor(float r,float g,float b,float a){
-    GLfloat m[] = {r,g,b,a};
-    glMaterialfv(GL_FRONT, GL_DIFFUSE, m);
-    glColor3f(r,g,b);
+// Polls the caches of the multiresolution mesh: a redraw may refine the cut once patches arrived.
+void multiResTimer(int)
+{
+	if(_multiRes.newData()) glutPostRedisplay();
+	glutTimerFunc(50, multiResTimer, 0);
 }
 
-void computeNormals(std::vector<uint32_t> &indices, std::vector<v3f> &vertices, std::vector<v3f> &normals)
+// Polls the loader until both meshes are final.
+void loadTimer(int)
 {
-    normals.clear();
-    for(int i = 0; i < indices.size()/3; ++i){
-
-        v3f v1 = vertices[indices[i*3]];
-        v3f v2 = vertices[indices[i*3+1]];
-        v3f v3 = vertices[indices[i*3+2]];
-        v3f n = (v2-v1)^(v3-v1);
-        n.Normalize();
-        normals.push_back(n);
+    // busy() first: once it is false, every snapshot is published and adopted below
+    bool loading = _loader.busy();
+    if(adoptMeshes()) glutPostRedisplay();
+    if(!loading && sceneInstances_ > 0 && _scene.empty()) {
+        buildScene(sceneInstances_);
+        vcg::Box3f box = sceneBox();
+        for(int k = 0; k < 3; ++k) cam_pan[k] = -box.Center()[k];
+        cam_dist = 0.6f * box.Diag();
+        glutPostRedisplay();
     }
+    if(loading || pickerStale_) glutTimerFunc(20, loadTimer, 0);
 }
 
-void translateVertices(std::vector<Point3D> & vertices, Point3D vec)
+// Time to the first frame, to the first frame showing a mesh and to the first one with both meshes final.
+void reportFrameTimes(void)
 {
-    for (auto &v : vertices){
-        v += vec;
+    static int reported = 0;
+    bool hasMesh = !_mesh.vertices.empty() || !_mesh2.vertices.empty() || _multiRes.isOpen();
+    bool isFinal = !_loader.busy() && !pickerStale_;
+    const char *names[3] = {"first frame", "first mesh frame", "final frame"};
+    int level = isFinal ? 3 : hasMesh ? 2 : 1;
+    for(; reported < level; ++reported) {
+        auto now = std::chrono::high_resolution_clock::now();
+        printf("%s: %.0f ms\n", names[reported], std::chrono::duration<double, std::milli>(now - _startTime).count());
     }
 }
 
-void fillTabs(){
-    ObjIO::readObj("../../objTUY/TUY_1071.obj",_indices,_vertices);
-}
-
-void displayNormal(Point3D & pos, Point3D &normal, float scale)
+int main(int argc, char **argv)
 {
-    glLineWidth(1.0f);  // Set the line width for clarity
-    glDisable(GL_LIGHTING);
-
-    glColor3f(1,1,0);
-    glBegin(GL_LINES);
-    glVertex3f(pos[0], pos[1], pos[2]);
-    glVertex3f(pos[0]+ normal[0]*scale, pos[1]+normal[1]*scale, pos[2]+normal[2]*scale);
-    glEnd();
+    _startTime = std::chrono::high_resolution_clock::now();
 
-    glEnable(GL_LIGHTING);
-    glLineWidth(1.0f);  // Reset the line width
-}
+    // an .obj given on the command line replaces the default model; one without faces is shown as a point cloud,
+    // an .mrm is drawn view dependently. The headless reports and benchmarks are the tools of tools/.
+    if(!openModel(argc > 1 && argv[1][0] != '-' ? argv[1] : defaultModel)) return 1;
 
-void displayMesh(std::vector<uint32_t> &indices, std::vector<v3f> &vertices, std::vector<v3f> &normals)
-{
-    if(normals.size() == 0)
-    {
-        for(int i = 0; i < indices.size()/3; ++i) {
-            //v3f n = normals[indices[i*3]];
-            v3f v1 = vertices[indices[i*3]];
-            v3f v2 = vertices[indices[i*3+1]];
-            v3f v3 = vertices[indices[i*3+2]];
-
-            glBegin(GL_TRIANGLES);
-            //glNormal3f(n[0], n[1], n[2]);
-            glVertex3f(v1[0], v1[1], v1[2]);
-            glVertex3f(v2[0], v2[1], v2[2]);
-            glVertex3f(v3[0], v3[1], v3[2]);
-            glEnd();
+    for(int i = 1; i < argc; ++i) {
+        // -profile [file] : shows the frame profile, its percentiles go to file (frameprofile.txt) on exit
+        if(strcmp(argv[i], "-profile") == 0) {
+            showProfile_ = true;
+            profilePath_ = i + 1 < argc && argv[i+1][0] != '-' ? argv[i+1] : "frameprofile.txt";
         }
-    } else
-    {
-        for(int i = 0; i < indices.size()/3; ++i) {
-            v3f n = normals[i];
-            v3f v1 = vertices[indices[i*3]];
-            v3f v2 = vertices[indices[i*3+1]];
-            v3f v3 = vertices[indices[i*3+2]];
-
-            glBegin(GL_TRIANGLES);
-            glNormal3f(n[0], n[1], n[2]);
-            glVertex3f(v1[0], v1[1], v1[2]);
-            glVertex3f(v2[0], v2[1], v2[2]);
-            glVertex3f(v3[0], v3[1], v3[2]);
-            glEnd();
-
-            if(displayNormals_){
-                v3f pos = (v1+v2+v3)/3;
-                displayNormal(pos,n, 0.05);
-            }
+        // -points budget : draws the first budget points of a point cloud, instead of as many as 33 ms allow
+        if(strcmp(argv[i], "-points") == 0 && i + 1 < argc) {
+            _points.budget = std::max(PointRenderer::minBudget, (size_t)atoll(argv[i+1]));
+            pointBudgetFixed_ = true;
+        }
+        // -scene instances : a grid of instances of the two meshes with their LOD levels, batched in one draw call
+        if(strcmp(argv[i], "-scene") == 0 && i + 1 < argc) sceneInstances_ = atoi(argv[i+1]);
+        // -record file : appends the camera of every frame drawn to file, a camera path for RenderBench -path
+        if(strcmp(argv[i], "-record") == 0 && i + 1 < argc) {
+            recordFile_ = fopen(argv[i+1], "a");
+            if(!recordFile_) printf("can not write %s\n", argv[i+1]);
         }
     }
-}
-
-void drawCoordinateAxis() {
-    glLineWidth(2.0f);  // Set the line width for clarity
-
-    if(displayMode == 0){
-        glDisable(GL_LIGHTING);
-    }
-
-    // X-axis (red)
-    //setMatColor(1,0,0,0);
-    glColor3f(1,0,0);
-    glBegin(GL_LINES);
-    glVertex3f(-cam_pan[0], -cam_pan[1], -cam_pan[2]);
-    glVertex3f(-cam_pan[0]+1, -cam_pan[1], -cam_pan[2]);
-    glEnd();
-
-    // Y-axis (green)
-    glColor3f(0,1,0);
-    glBegin(GL_LINES);
-    glVertex3f(-cam_pan[0], -cam_pan[1], -cam_pan[2]);
-    glVertex3f(-cam_pan[0], -cam_pan[1]+1, -cam_pan[2]);
-    glEnd();
-
-    // Z-axis (blue)
-    glColor3f(0,0,1);
-    glBegin(GL_LINES);
-    glVertex3f(-cam_pan[0], -cam_pan[1], -cam_pan[2]);
-    glVertex3f(-cam_pan[0], -cam_pan[1], -cam_pan[2]+1);
-    glEnd();
-
-    if(displayMode == 0){
-        glEnable(GL_LIGHTING);
-    }
-    glLineWidth(1.0f);  // Reset the line width
-}
-
-int main(int argc, char **argv)
-{
-    fillTabs();
-
-    computeNormals(_indices, _vertices, _normals);
-
-    auto start = std::chrono::high_resolution_clock::now();
-
-    CMeshO m1 = VCG_CMesh0_Helper::constructCMesh(_indices, _vertices, _normals);
-
-    LODMaker::repairAndPrepareForDecimation(m1);
-
-    //LODMaker::decimateMesh(100, m1);
-
-    VCG_CMesh0_Helper::retrieveCMeshData(m1, _indices2, _vertices2, _normals2);
-
-    auto end = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-
-    std::cout << "init vertices : " << _indices.size() << "\n";
-    std::cout << "decimate mesh vertices : " << _indices2.size() << "\n";
-    std::cout << "elapsed time : " << duration.count() << "\n";
-
-    translateVertices(_vertices, Point3D(-0.15,0,0));
-    translateVertices(_vertices2, Point3D(0.15,0,0));
 
 	glutInit(&argc, argv);
 	glutInitWindowSize(1600, 900);
 	glutInitDisplayMode(GLUT_RGB | GLUT_DEPTH | GLUT_DOUBLE);
 	glutCreateWindow("freeglut 3D view demo");
 
+	if(_gpuTimer.init()) printf("gpu frame timing: on\n");
+	atexit(dumpProfile);
+
+	glutCloseFunc(closeWindow);
 	glutDisplayFunc(display);
 	glutReshapeFunc(reshape);
 	glutKeyboardFunc(keypress);
@@ -245,16 +148,10 @@ int main(int argc, char **argv)
 	glutMouseFunc(mouse);
 	glutMotionFunc(motion);
 
-	glEnable(GL_DEPTH_TEST);
-	//glEnable(GL_CULL_FACE);
-	glEnable(GL_LIGHTING);
-	glEnable(GL_LIGHT0);
+	initGLState();
 
-    glLightfv(GL_LIGHT0, GL_POSITION, lpos);
-    glLightfv(GL_LIGHT0, GL_AMBIENT, lAmbient);
-    glLightfv(GL_LIGHT0, GL_DIFFUSE, lDiffuse);
-    //glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
-    //glCullFace(GL_BACK);
+	if(_multiRes.isOpen()) glutTimerFunc(50, multiResTimer, 0);
+	else glutTimerFunc(20, loadTimer, 0);
 
 	glutMainLoop();
 	return 0;
@@ -269,43 +166,89 @@ void display(void)
 {
 	long tm;
 
+	uint64_t frameId = _profiler.beginFrame();
+	_gpuTimer.collect(_profiler);
+	_gpuTimer.begin(frameId);
+
+	if(recordFile_) fprintf(recordFile_, "%g %g %g %g %g %g\n", cam_theta, cam_phi, cam_dist, cam_pan[0], cam_pan[1], cam_pan[2]);
+	renderScene(modelviewMatrix(cam_theta, cam_phi, cam_dist, cam_pan));
+	if(_multiRes.isOpen()) {
+		char title[128];
+		snprintf(title, sizeof title, "%zu patches, %zu faces, %zu missing, %.1f px", _multiResStats.cutNodes,
+		         _multiResStats.drawnFaces, _multiResStats.missing, _multiResStats.maxError);
+		glutSetWindowTitle(title);
+	} else if(!_scene.empty()) {
+		char title[160];
+		snprintf(title, sizeof title, "%zu/%zu instances, %zu commands, %zu draw calls, %zu state changes, %zu faces",
+		         _sceneStats.visible, _sceneStats.instances, _sceneStats.commands, _sceneStats.drawCalls,
+		         _sceneStats.stateChanges, _sceneStats.faces);
+		glutSetWindowTitle(title);
+	} else if(_pointLOD && !_pointLOD->empty()) {
+		char title[128];
+		snprintf(title, sizeof title, "%zu/%zu points, %.3g spacing%s", _pointStats.drawn, _pointStats.points,
+		         _pointStats.spacing, _pointStats.splats ? ", splats" : "");
+		glutSetWindowTitle(title);
+	}
 
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
-	glTranslatef(0, 0, -cam_dist);
-	glRotatef(cam_phi, 1, 0, 0);
-	glRotatef(cam_theta, 0, 1, 0);
-	glTranslatef(cam_pan[0], cam_pan[1], cam_pan[2]);
-
-
-    setMatColor(1,1,1,0);
-	glBegin(GL_QUADS);
-	glNormal3f(0, 1, 0);
-	glVertex3f(-5, -1.3, 5);
-	glVertex3f(5, -1.3, 5);
-	glVertex3f(5, -1.3, -5);
-	glVertex3f(-5, -1.3, -5);
-	glEnd();
+    _profiler.enter(FrameProfiler::Overlay);
+    drawPickOverlay();
+	if(showProfile_) drawProfile();
+	else print_help();
+	_gpuTimer.end();
 
-    setMatColor(1,1,1,0);
-    displayMesh(_indices, _vertices, _normals);
-    setMatColor(1,0.8,0.2,0);
-    displayMesh(_indices2, _vertices2, _normals2);
+	_profiler.enter(FrameProfiler::Swap);
+	glutSwapBuffers();
+	_profiler.endFrame();
+	if(_pointLOD && !pointBudgetFixed_) {
+		const FrameProfiler::Frame &f = _profiler.frame(0);
+		_points.adapt(std::max(f.cpu, f.gpu), _mesh.vertices.size());
+	}
+	nframes++;
+	reportFrameTimes();
+}
 
-    drawCoordinateAxis();
+// rubber band of the rectangle or lasso being dragged
+void drawPickOverlay(void)
+{
+    if(!pick_mode || !pick_dragged) return;
 
-	print_help();
+    glPushAttrib(GL_ENABLE_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
+
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, win_width, 0, win_height, -1, 1);
+
+    glColor3f(1, 0.1, 0.1);
+    glBegin(GL_LINE_LOOP);
+    if(pick_mode == 1) {
+        glVertex2f(pick_x0, win_height - pick_y0);
+        glVertex2f(pick_x1, win_height - pick_y0);
+        glVertex2f(pick_x1, win_height - pick_y1);
+        glVertex2f(pick_x0, win_height - pick_y1);
+    } else {
+        for(const vcg::Point2f &p : pick_lasso) {
+            glVertex2f(p[0], p[1]);
+        }
+    }
+    glEnd();
 
-	glutSwapBuffers();
-	nframes++;
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    glPopAttrib();
 }
 
-void print_help(void)
+// Last frames as stacked bars of the CPU phases, the GPU time as a line, and their percentiles.
+void drawProfile(void)
 {
-	int i;
-	const char *s, **text;
+	static const float colors[FrameProfiler::PhaseNb][3] = {{0.3, 0.5, 1}, {0.2, 0.9, 0.3}, {1, 0.9, 0.2}, {0.6, 0.6, 0.6}};
+	const float x0 = 10, y0 = win_height - 190, height = 150, msHeight = height / 50;   // 50 ms full scale
 
 	glPushAttrib(GL_ENABLE_BIT);
 	glDisable(GL_LIGHTING);
@@ -318,22 +261,49 @@ void print_help(void)
 	glLoadIdentity();
 	glOrtho(0, win_width, 0, win_height, -1, 1);
 
-	text = help ? helptext : helpprompt;
-
-	for(i=0; text[i]; i++) {
-		glColor3f(0, 0.1, 0);
-		glRasterPos2f(7, win_height - (i + 1) * 20 - 2);
-		s = text[i];
-		while(*s) {
-			glutBitmapCharacter(GLUT_BITMAP_9_BY_15, *s++);
-		}
-		glColor3f(0, 0.9, 0);
-		glRasterPos2f(5, win_height - (i + 1) * 20);
-		s = text[i];
-		while(*s) {
-			glutBitmapCharacter(GLUT_BITMAP_9_BY_15, *s++);
+	size_t frameNb = std::min(_profiler.size(), (size_t)std::max(win_width - 20, 0));
+	glBegin(GL_LINES);
+	for(size_t age = 0; age < frameNb; ++age) {
+		const FrameProfiler::Frame &f = _profiler.frame(age);
+		float x = x0 + frameNb - 1 - age, y = y0;
+		for(int p = 0; p < FrameProfiler::PhaseNb; ++p) {
+			float h = std::min((float)f.phases[p] * msHeight, y0 + height - y);
+			glColor3fv(colors[p]);
+			glVertex2f(x, y);
+			glVertex2f(x, y + h);
+			y += h;
 		}
 	}
+	// 60 and 30 fps
+	glColor3f(1, 1, 1);
+	for(float ms : {1000.0f / 60, 1000.0f / 30}) {
+		glVertex2f(x0, y0 + ms * msHeight);
+		glVertex2f(x0 + frameNb, y0 + ms * msHeight);
+	}
+	glEnd();
+
+	glColor3f(1, 0.2, 0.2);
+	glBegin(GL_LINE_STRIP);
+	for(size_t age = 0; age < frameNb; ++age) {
+		const FrameProfiler::Frame &f = _profiler.frame(age);
+		if(f.gpu >= 0) glVertex2f(x0 + frameNb - 1 - age, y0 + std::min((float)f.gpu * msHeight, height));
+	}
+	glEnd();
+
+	char line[160];
+	int n = snprintf(line, sizeof line, "ms p50/p95/p99  cpu %.1f/%.1f/%.1f", _profiler.percentile(FrameProfiler::CpuTotal, 50),
+	                 _profiler.percentile(FrameProfiler::CpuTotal, 95), _profiler.percentile(FrameProfiler::CpuTotal, 99));
+	if(_profiler.percentile(FrameProfiler::Gpu, 50) >= 0) {
+		snprintf(line + n, sizeof line - n, "  gpu %.1f/%.1f/%.1f", _profiler.percentile(FrameProfiler::Gpu, 50),
+		         _profiler.percentile(FrameProfiler::Gpu, 95), _profiler.percentile(FrameProfiler::Gpu, 99));
+	}
+	_text.add(x0, y0 + height + 10, line, 0, 0.9, 0);
+	float x = x0;
+	for(int p = 0; p < FrameProfiler::PhaseNb; ++p) {
+		_text.add(x, y0 - 20, FrameProfiler::name(p), colors[p][0], colors[p][1], colors[p][2]);
+		x += 80;
+	}
+	_text.draw();
 
 	glPopMatrix();
 	glMatrixMode(GL_MODELVIEW);
@@ -341,19 +311,28 @@ void print_help(void)
 	glPopAttrib();
 }
 
-#define ZNEAR	0.05f
+void dumpProfile(void)
+{
+	if(profilePath_.empty()) return;
+	if(_profiler.dump(profilePath_)) printf("frame profile written to %s\n", profilePath_.c_str());
+	else printf("can not write %s\n", profilePath_.c_str());
+}
+
+// while the context is still current: on quit, and when the window is closed
+void closeWindow(void)
+{
+	_gpuTimer.release();
+}
+
 void reshape(int x, int y)
 {
-	float vsz, aspect = (float)x / (float)y;
 	win_width = x;
 	win_height = y;
 
 	glViewport(0, 0, x, y);
 
 	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	vsz = 0.4663f * ZNEAR;
-	glFrustum(-aspect * vsz, aspect * vsz, -vsz, vsz, 0.05, 5000.0);
+	loadMatrix(projectionMatrix((float)x / (float)y));
 }
 
 void keypress(unsigned char key, int x, int y)
@@ -364,6 +343,7 @@ void keypress(unsigned char key, int x, int y)
 	switch(key) {
 	case 27:
 	case 'q':
+		closeWindow();
 		exit(0);
 		break;
     case 'm':
@@ -386,6 +366,40 @@ void keypress(unsigned char key, int x, int y)
         }
         display();
         break;
+    case 'c':
+        clusterCulling_ = !clusterCulling_;
+        printf("cluster culling: %s\n", clusterCulling_ ? "on" : "off");
+        glutPostRedisplay();
+        break;
+    case 'p':
+        showProfile_ = !showProfile_;
+        if(profilePath_.empty()) profilePath_ = "frameprofile.txt";
+        glutPostRedisplay();
+        break;
+    case 'b':
+        _scene.indirect = !_scene.indirect;
+        printf("scene multi-draw indirect: %s\n", _scene.indirect ? "on" : "off");
+        glutPostRedisplay();
+        break;
+    case 's':
+        _points.splats = !_points.splats;
+        printf("point splats: %s\n", _points.splats ? "on" : "off");
+        glutPostRedisplay();
+        break;
+    case 'e':
+    case 'E':
+        if(pushSelection((key == 'e' ? 0.01f : -0.01f) * sceneBox().Diag())) {
+            // the picker still has the old positions
+            glutTimerFunc(20, loadTimer, 0);
+            glutPostRedisplay();
+        }
+        break;
+    case '+':
+    case '-':
+        _multiRes.targetError = std::max(0.25f, _multiRes.targetError * (key == '+' ? 2.0f : 0.5f));
+        printf("multiresolution error: %g px\n", _multiRes.targetError);
+        glutPostRedisplay();
+        break;
 	case ' ':
 		anim ^= 1;
 		glutIdleFunc(anim ? idle : 0);
@@ -431,12 +445,70 @@ void skeypress(int key, int x, int y)
 	}
 }
 
+// Polls the picking service until the submitted query is answered, the GUI never waits on it.
+void pickIdle(void)
+{
+	PickingService::Result result;
+	if(_picker.poll(result)) {
+		_selection = result.hits;
+		if(result.kind == PickingService::Ray) {
+			if(_selection.empty()) printf("pick: nothing\n");
+			else printf("pick: face %u of mesh %u (%.1f us)\n", _selection[0].face, _selection[0].mesh, result.micros);
+		} else {
+			printf("selection: %zu faces (%.1f us)\n", _selection.size(), result.micros);
+		}
+		glutPostRedisplay();
+	}
+	if(!_picker.busy()) {
+		glutIdleFunc(anim ? idle : 0);
+	}
+	if(anim) glutPostRedisplay();
+}
+
+void submitPick(void)
+{
+	if(!_scene.empty()) return;   // the picker only knows the two meshes
+	PickingService::Request request;
+	request.camera = pickCamera(modelviewMatrix(cam_theta, cam_phi, cam_dist, cam_pan), win_width, win_height);
+	if(pick_mode == 2 && pick_lasso.size() >= 3) {
+		request.kind = PickingService::Lasso;
+		request.lasso = pick_lasso;
+	} else if(pick_dragged) {
+		request.kind = PickingService::Rect;
+		request.x0 = pick_x0;
+		request.y0 = win_height - pick_y0;
+		request.x1 = pick_x1;
+		request.y1 = win_height - pick_y1;
+	} else {
+		request.kind = PickingService::Ray;
+		request.x0 = pick_x0 + 0.5f;
+		request.y0 = win_height - pick_y0 - 0.5f;
+	}
+	_picker.submit(request);
+	glutIdleFunc(pickIdle);
+}
+
 void mouse(int bn, int st, int x, int y)
 {
 	int bidx = bn - GLUT_LEFT_BUTTON;
 	bnstate[bidx] = st == GLUT_DOWN;
 	mouse_x = x;
 	mouse_y = y;
+
+	if(bn == GLUT_LEFT_BUTTON) {
+		if(st == GLUT_DOWN) {
+			int mod = glutGetModifiers();
+			pick_mode = (mod & GLUT_ACTIVE_CTRL) ? 2 : (mod & GLUT_ACTIVE_SHIFT) ? 1 : 0;
+			pick_x0 = pick_x1 = x;
+			pick_y0 = pick_y1 = y;
+			pick_dragged = false;
+			pick_lasso.assign(1, vcg::Point2f(x, win_height - y));
+		} else if(pick_mode) {
+			submitPick();
+			pick_mode = 0;
+			glutPostRedisplay();
+		}
+	}
 }
 
 void motion(int x, int y)
@@ -448,6 +520,15 @@ void motion(int x, int y)
 
 	if(!(dx | dy)) return;
 
+	if(pick_mode) {
+		pick_dragged = true;
+		pick_x1 = x;
+		pick_y1 = y;
+		pick_lasso.push_back(vcg::Point2f(x, win_height - y));
+		glutPostRedisplay();
+		return;
+	}
+
 	if(bnstate[0]) {
 		cam_theta += dx * 0.5;
 		cam_phi += dy * 0.5;
@@ -0,0 +1,114 @@
+#include "FrameProfiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+FrameProfiler::FrameProfiler(size_t frameNb) : ring_(std::max<size_t>(1, frameNb))
+{
+}
+
+double FrameProfiler::millis(Clock::time_point a, Clock::time_point b)
+{
+    return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+uint64_t FrameProfiler::beginFrame()
+{
+    Clock::time_point now = Clock::now();
+    current_ = Frame();
+    current_.id = nextId_++;
+    current_.interval = started_ ? millis(frameStart_, now) : 0;
+    frameStart_ = phaseStart_ = now;
+    phase_ = Submit;
+    inFrame_ = started_ = true;
+    return current_.id;
+}
+
+FrameProfiler::Phase FrameProfiler::enter(Phase phase)
+{
+    Phase previous = phase_;
+    if (!inFrame_) return previous;
+    Clock::time_point now = Clock::now();
+    current_.phases[phase_] += millis(phaseStart_, now);
+    phaseStart_ = now;
+    phase_ = phase;
+    return previous;
+}
+
+void FrameProfiler::endFrame()
+{
+    if (!inFrame_) return;
+    Clock::time_point now = Clock::now();
+    current_.phases[phase_] += millis(phaseStart_, now);
+    current_.cpu = millis(frameStart_, now);
+    inFrame_ = false;
+
+    ring_[head_] = current_;
+    head_ = (head_ + 1) % ring_.size();
+    count_ = std::min(count_ + 1, ring_.size());
+}
+
+void FrameProfiler::setGpuTime(uint64_t frameId, double ms)
+{
+    for (size_t age = 0; age < count_; ++age) {
+        Frame &f = ring_[(head_ + ring_.size() - 1 - age) % ring_.size()];
+        if (f.id == frameId) {
+            f.gpu = ms;
+            return;
+        }
+        if (f.id < frameId) return;
+    }
+}
+
+const char *FrameProfiler::name(int measure)
+{
+    static const char *names[] = {"cull", "submit", "overlay", "swap", "cpu", "interval", "gpu"};
+    return names[measure];
+}
+
+const FrameProfiler::Frame &FrameProfiler::frame(size_t age) const
+{
+    return ring_[(head_ + ring_.size() - 1 - age) % ring_.size()];
+}
+
+double FrameProfiler::value(const Frame &f, int measure) const
+{
+    if (measure < PhaseNb) return f.phases[measure];
+    if (measure == CpuTotal) return f.cpu;
+    if (measure == Interval) return f.id > 0 ? f.interval : -1;
+    return f.gpu;
+}
+
+double FrameProfiler::percentile(int measure, double p) const
+{
+    std::vector<double> values;
+    values.reserve(count_);
+    for (size_t age = 0; age < count_; ++age) {
+        double v = value(frame(age), measure);
+        if (v >= 0) values.push_back(v);
+    }
+    if (values.empty()) return -1;
+    size_t rank = (size_t) std::ceil(std::min(std::max(p, 0.0), 100.0) / 100 * values.size());
+    rank = std::min(std::max<size_t>(rank, 1), values.size()) - 1;
+    std::nth_element(values.begin(), values.begin() + rank, values.end());
+    return values[rank];
+}
+
+void FrameProfiler::print(FILE *file) const
+{
+    fprintf(file, "# last %zu frames, ms\n", count_);
+    fprintf(file, "%-9s %9s %9s %9s %9s\n", "measure", "p50", "p95", "p99", "max");
+    for (int m = 0; m <= Gpu; ++m) {
+        if (percentile(m, 50) < 0) continue;
+        fprintf(file, "%-9s %9.3f %9.3f %9.3f %9.3f\n", name(m), percentile(m, 50), percentile(m, 95),
+                percentile(m, 99), percentile(m, 100));
+    }
+}
+
+bool FrameProfiler::dump(const std::string &path) const
+{
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) return false;
+    print(file);
+    return fclose(file) == 0;
+}
@@ -0,0 +1,72 @@
+#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <cstdio>
+
+// Per frame CPU time of the phases of the render loop, plus the GPU time of the frame when the
+// caller measures it (see GpuTimer), over a ring of the last frameNb frames.
+// The phases are exclusive: enter() closes the phase being timed and opens another one, so a phase
+// nested in another (the cluster culling inside the mesh submission) is not counted twice.
+// No GL here: the headless modes use it as is.
+class FrameProfiler
+{
+public:
+    enum Phase { Cull, Submit, Overlay, Swap, PhaseNb };
+
+    struct Frame
+    {
+        uint64_t id = 0;
+        double phases[PhaseNb] = {0, 0, 0, 0};   // ms
+        double cpu = 0;                          // beginFrame() to endFrame(), ms
+        double interval = 0;                     // since the previous beginFrame(), ms
+        double gpu = -1;                         // ms, < 0 until known
+    };
+
+    // What percentile() and the dump summarize: a phase, or one of these.
+    enum Measure { CpuTotal = PhaseNb, Interval, Gpu };
+
+    explicit FrameProfiler(size_t frameNb = 600);
+
+    // Opens the Submit phase. Returns the id of the frame.
+    uint64_t beginFrame();
+    // Returns the phase that was open.
+    Phase enter(Phase phase);
+    void endFrame();
+    // GPU times arrive a few frames late; ignored once the frame left the ring.
+    void setGpuTime(uint64_t frameId, double ms);
+
+    static const char *name(int measure);
+
+    // Frames in the ring, age 0 being the last ended one.
+    size_t size() const { return count_; }
+    size_t capacity() const { return ring_.size(); }
+    const Frame &frame(size_t age) const;
+
+    // Nearest rank percentile (p in [0, 100]) of the frames in the ring, -1 without samples.
+    double percentile(int measure, double p) const;
+
+    // Prints p50/p95/p99/max of every measure.
+    void print(FILE *file) const;
+    // print() to a file. Returns false when the file can not be written.
+    bool dump(const std::string &path) const;
+
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    double value(const Frame &f, int measure) const;
+    static double millis(Clock::time_point a, Clock::time_point b);
+
+    std::vector<Frame> ring_;
+    size_t head_ = 0, count_ = 0;    // head_: slot of the next frame
+    uint64_t nextId_ = 0;
+    Frame current_;
+    Phase phase_ = Submit;
+    Clock::time_point frameStart_, phaseStart_;
+    bool inFrame_ = false, started_ = false;
+};
+
+#endif //FRAMEPROFILER_H
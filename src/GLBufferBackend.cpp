@@ -0,0 +1,126 @@
+#include "GLBufferBackend.h"
+#include <cstdio>
+#include <GL/freeglut.h>
+#include "OffscreenContext.h"
+
+#ifndef GL_COPY_READ_BUFFER
+#define GL_COPY_READ_BUFFER 0x8f36
+#define GL_COPY_WRITE_BUFFER 0x8f37
+#endif
+#ifndef GL_MAP_READ_BIT
+#define GL_MAP_READ_BIT 0x0001
+#define GL_MAP_WRITE_BIT 0x0002
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#define GL_ALREADY_SIGNALED 0x911a
+#define GL_CONDITION_SATISFIED 0x911c
+#define GL_TIMEOUT_EXPIRED 0x911b
+#endif
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+namespace
+{
+    typedef void (APIENTRY *GenBuffersProc)(GLsizei n, GLuint *buffers);
+    typedef void (APIENTRY *DeleteBuffersProc)(GLsizei n, const GLuint *buffers);
+    typedef void (APIENTRY *BindBufferProc)(GLenum target, GLuint buffer);
+    typedef void (APIENTRY *BufferStorageProc)(GLenum target, ptrdiff_t size, const void *data, GLbitfield flags);
+    typedef void *(APIENTRY *MapBufferRangeProc)(GLenum target, ptrdiff_t offset, ptrdiff_t length, GLbitfield access);
+    typedef void (APIENTRY *CopyBufferSubDataProc)(GLenum readTarget, GLenum writeTarget, ptrdiff_t readOffset,
+                                                   ptrdiff_t writeOffset, ptrdiff_t size);
+    typedef void *(APIENTRY *FenceSyncProc)(GLenum condition, GLbitfield flags);
+    typedef GLenum (APIENTRY *ClientWaitSyncProc)(void *sync, GLbitfield flags, uint64_t timeout);
+    typedef void (APIENTRY *DeleteSyncProc)(void *sync);
+
+    GenBuffersProc genBuffers;
+    DeleteBuffersProc deleteBuffers;
+    BindBufferProc bindBuffer;
+    BufferStorageProc bufferStorage;
+    MapBufferRangeProc mapBufferRange;
+    CopyBufferSubDataProc copyBufferSubData;
+    FenceSyncProc fenceSync;
+    ClientWaitSyncProc clientWaitSync;
+    DeleteSyncProc deleteSync;
+
+    template <class PROC>
+    bool load(PROC &proc, const char *name)
+    {
+        proc = (PROC) OffscreenContext::procAddress(name);
+        return proc != nullptr;
+    }
+
+    const GLbitfield mapFlags = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+}
+
+bool GLBufferBackend::init()
+{
+    const char *version = (const char *) glGetString(GL_VERSION);
+    int major = 0, minor = 0;
+    if (version) sscanf(version, "%d.%d", &major, &minor);
+    if (major * 10 + minor < 44) return false;
+    return load(genBuffers, "glGenBuffers") && load(deleteBuffers, "glDeleteBuffers") &&
+           load(bindBuffer, "glBindBuffer") && load(bufferStorage, "glBufferStorage") &&
+           load(mapBufferRange, "glMapBufferRange") && load(copyBufferSubData, "glCopyBufferSubData") &&
+           load(fenceSync, "glFenceSync") && load(clientWaitSync, "glClientWaitSync") && load(deleteSync, "glDeleteSync");
+}
+
+unsigned int GLBufferBackend::create(size_t size, void **mapped)
+{
+    GLuint buffer = 0;
+    genBuffers(1, &buffer);
+    // the copy targets: creating a buffer does not disturb the bindings of the draws
+    bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    while (glGetError() != GL_NO_ERROR) {}
+    bufferStorage(GL_COPY_WRITE_BUFFER, (ptrdiff_t) size, nullptr, mapFlags);
+    *mapped = glGetError() == GL_NO_ERROR ? mapBufferRange(GL_COPY_WRITE_BUFFER, 0, (ptrdiff_t) size, mapFlags) : nullptr;
+    bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    if (!*mapped) {
+        deleteBuffers(1, &buffer);
+        return 0;
+    }
+    return buffer;
+}
+
+void GLBufferBackend::destroy(unsigned int buffer)
+{
+    // deleting unmaps it; GL keeps the storage until the commands reading it are done
+    deleteBuffers(1, &buffer);
+}
+
+void GLBufferBackend::copy(unsigned int src, size_t srcOffset, unsigned int dst, size_t dstOffset, size_t size)
+{
+    bindBuffer(GL_COPY_READ_BUFFER, src);
+    bindBuffer(GL_COPY_WRITE_BUFFER, dst);
+    copyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (ptrdiff_t) srcOffset, (ptrdiff_t) dstOffset, (ptrdiff_t) size);
+    bindBuffer(GL_COPY_READ_BUFFER, 0);
+    bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+uint64_t GLBufferBackend::fence()
+{
+    return (uint64_t) (uintptr_t) fenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool GLBufferBackend::signaled(uint64_t fence)
+{
+    GLenum status = clientWaitSync((void *) (uintptr_t) fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+}
+
+void GLBufferBackend::wait(uint64_t fence)
+{
+    // anything but a timeout ends the wait: GL_WAIT_FAILED, or 0 without a current context
+    while (clientWaitSync((void *) (uintptr_t) fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+}
+
+void GLBufferBackend::release(uint64_t fence)
+{
+    deleteSync((void *) (uintptr_t) fence);
+}
@@ -0,0 +1,23 @@
+#ifndef GLBUFFERBACKEND_H
+#define GLBUFFERBACKEND_H
+
+#include "GpuBufferAllocator.h"
+
+// The suballocators on GL 4.4: immutable buffers (glBufferStorage) mapped persistent and coherent,
+// glCopyBufferSubData, and sync objects polled with a zero timeout. init() needs a current context
+// and fails below GL 4.4.
+class GLBufferBackend : public GpuBufferBackend
+{
+public:
+    bool init();
+
+    unsigned int create(size_t size, void **mapped) override;
+    void destroy(unsigned int buffer) override;
+    void copy(unsigned int src, size_t srcOffset, unsigned int dst, size_t dstOffset, size_t size) override;
+    uint64_t fence() override;
+    bool signaled(uint64_t fence) override;
+    void wait(uint64_t fence) override;
+    void release(uint64_t fence) override;
+};
+
+#endif //GLBUFFERBACKEND_H
@@ -0,0 +1,423 @@
+#include "GpuBufferAllocator.h"
+#include <algorithm>
+
+namespace
+{
+    size_t alignUp(size_t offset, size_t alignment)
+    {
+        return alignment > 1 ? (offset + alignment - 1) / alignment * alignment : offset;
+    }
+}
+
+StreamRing::~StreamRing()
+{
+    release();
+}
+
+bool StreamRing::init(GpuBufferBackend *backend, size_t capacity)
+{
+    release();
+    void *mapped = nullptr;
+    buffer_ = backend->create(capacity, &mapped);
+    if (!buffer_) return false;
+    backend_ = backend;
+    data_ = (uint8_t *) mapped;
+    capacity_ = capacity;
+    head_ = used_ = frameBytes_ = 0;
+    return true;
+}
+
+void StreamRing::release()
+{
+    if (!buffer_) return;
+    while (!inFlight_.empty()) retire(true);
+    backend_->destroy(buffer_);
+    buffer_ = 0;
+    data_ = nullptr;
+    capacity_ = 0;
+}
+
+void StreamRing::retire(bool wait)
+{
+    while (!inFlight_.empty()) {
+        Frame &f = inFlight_.front();
+        if (wait) {
+            backend_->wait(f.fence);
+        } else if (!backend_->signaled(f.fence)) {
+            return;
+        }
+        backend_->release(f.fence);
+        used_ -= f.bytes;
+        inFlight_.pop_front();
+        if (wait) return;
+    }
+}
+
+StreamRing::Span StreamRing::allocate(size_t size, size_t alignment)
+{
+    Span span;
+    if (!buffer_ || size > capacity_) return span;
+    retire(false);
+    for (;;) {
+        size_t start = alignUp(head_, alignment);
+        // does not fit before the end: the rest of the buffer is padding of this frame
+        if (start + size > capacity_) start = 0;
+        size_t need = (start >= head_ ? start - head_ : capacity_ - head_) + size;
+        if (used_ + need <= capacity_) {
+            used_ += need;
+            frameBytes_ += need;
+            stats_.bytes += need;
+            head_ = start + size;
+            span.buffer = buffer_;
+            span.offset = start;
+            span.data = data_ + start;
+            return span;
+        }
+        if (inFlight_.empty()) return span;    // the current frame alone fills the ring
+        ++stats_.stalls;
+        retire(true);
+    }
+}
+
+void StreamRing::endFrame()
+{
+    if (!buffer_) return;
+    ++stats_.frames;
+    if (frameBytes_ == 0) return;
+    inFlight_.push_back(Frame{frameBytes_, backend_->fence()});
+    frameBytes_ = 0;
+    retire(false);
+}
+
+BufferArena::~BufferArena()
+{
+    release();
+}
+
+bool BufferArena::init(GpuBufferBackend *backend, size_t capacity)
+{
+    release();
+    void *mapped = nullptr;
+    buffer_ = backend->create(capacity, &mapped);
+    if (!buffer_) return false;
+    backend_ = backend;
+    data_ = (uint8_t *) mapped;
+    capacity_ = capacity;
+    blocks_.assign(1, Block{0, capacity, 0, 0, 0, false, false});
+    records_.assign(1, Record());   // handle 0
+    return true;
+}
+
+void BufferArena::release()
+{
+    if (!buffer_) return;
+    for (const std::pair<uint64_t, uint64_t> &f : frameFences_) {
+        backend_->wait(f.second);
+        backend_->release(f.second);
+    }
+    frameFences_.clear();
+    for (const std::pair<unsigned int, uint64_t> &r : retired_) backend_->destroy(r.first);
+    retired_.clear();
+    backend_->destroy(buffer_);
+    buffer_ = 0;
+    data_ = nullptr;
+    capacity_ = 0;
+    blocks_.clear();
+    records_.clear();
+}
+
+void BufferArena::reindex()
+{
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+        if (blocks_[i].handle) records_[blocks_[i].handle].block = (int) i;
+    }
+}
+
+int BufferArena::findFit(size_t size, size_t alignment) const
+{
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+        const Block &b = blocks_[i];
+        if (b.handle || b.pending) continue;
+        if (alignUp(b.offset, alignment) + size <= b.offset + b.size) return (int) i;
+    }
+    return -1;
+}
+
+BufferArena::Handle BufferArena::place(int block, size_t size, size_t alignment, bool evictable)
+{
+    Handle h = (Handle) records_.size();
+    Block &b = blocks_[block];
+    size_t start = alignUp(b.offset, alignment);
+    size_t end = start + size;
+    if (end < b.offset + b.size) {
+        Block rest{end, b.offset + b.size - end, end, 0, 0, false, false};
+        b.size = end - b.offset;
+        blocks_.insert(blocks_.begin() + block + 1, rest);
+    }
+    Block &placed = blocks_[block];
+    placed.start = start;
+    placed.handle = h;
+    placed.lastUse = frame_;
+    placed.evictable = evictable;
+    Record r;
+    r.size = size;
+    r.alignment = alignment;
+    records_.push_back(r);
+    reindex();
+    ++stats_.allocations;
+    return h;
+}
+
+void BufferArena::makeFree(int block)
+{
+    Block &b = blocks_[block];
+    b.handle = 0;
+    b.pending = false;
+    b.start = b.offset;
+    auto isFree = [this](size_t i) { return !blocks_[i].handle && !blocks_[i].pending; };
+    if (block + 1 < (int) blocks_.size() && isFree(block + 1)) {
+        b.size += blocks_[block + 1].size;
+        blocks_.erase(blocks_.begin() + block + 1);
+    }
+    if (block > 0 && isFree(block - 1)) {
+        blocks_[block - 1].size += blocks_[block].size;
+        blocks_.erase(blocks_.begin() + block);
+    }
+    reindex();
+}
+
+void BufferArena::poll()
+{
+    while (!frameFences_.empty() && backend_->signaled(frameFences_.front().second)) {
+        completed_ = frameFences_.front().first;
+        backend_->release(frameFences_.front().second);
+        frameFences_.pop_front();
+    }
+    for (size_t i = 0; i < blocks_.size();) {
+        // merging may remove the block before i: start over from the merged one
+        if (blocks_[i].pending && blocks_[i].lastUse <= completed_) {
+            makeFree((int) i);
+            i = i > 0 ? i - 1 : 0;
+        } else {
+            ++i;
+        }
+    }
+    for (size_t i = 0; i < retired_.size();) {
+        if (retired_[i].second <= completed_) {
+            backend_->destroy(retired_[i].first);
+            retired_.erase(retired_.begin() + i);
+        } else {
+            ++i;
+        }
+    }
+}
+
+BufferArena::Handle BufferArena::allocate(size_t size, size_t alignment, bool evictable)
+{
+    if (!buffer_ || size == 0 || size > capacity_) return 0;
+    alignment = std::max<size_t>(alignment, 1);
+    poll();
+    int block = findFit(size, alignment);
+    // free bytes scattered in holes too small: packing them keeps what the eviction would throw away,
+    // but copies the whole arena, so at most every defragmentInterval frames
+    if (block < 0 && capacity_ - stats().used >= size + alignment && fragmentation() > 0.5f &&
+        (defragmented_ == 0 || frame_ >= defragmented_ + defragmentInterval)) {
+        defragmented_ = frame_;
+        if (defragment()) block = findFit(size, alignment);
+    }
+    // the bytes packed in place come back when the frame of the copies is done: wait for them
+    if (block < 0 && compacted_ > completed_) {
+        ++stats_.failures;
+        return 0;
+    }
+    // then the least recently used blocks
+    while (block < 0 && evictOne()) block = findFit(size, alignment);
+    if (block < 0) {
+        ++stats_.failures;
+        return 0;
+    }
+    return place(block, size, alignment, evictable);
+}
+
+bool BufferArena::evictOne()
+{
+    // least recently touched, by a frame the GPU finished: evicting a block still in flight would only
+    // make it pending, and the next candidates too
+    int victim = -1;
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+        const Block &b = blocks_[i];
+        if (!b.handle || !b.evictable || b.lastUse > completed_) continue;
+        if (victim < 0 || b.lastUse < blocks_[victim].lastUse) victim = (int) i;
+    }
+    if (victim < 0) return false;
+    Handle h = blocks_[victim].handle;
+    ++stats_.evictions;
+    free(h);
+    if (onEvict) onEvict(h);
+    return true;
+}
+
+void BufferArena::free(Handle h)
+{
+    if (!isLive(h)) return;
+    int block = records_[h].block;
+    records_[h].block = -1;
+    if (blocks_[block].lastUse <= completed_) {
+        makeFree(block);
+    } else {
+        blocks_[block].handle = 0;
+        blocks_[block].pending = true;
+    }
+}
+
+void BufferArena::touch(Handle h)
+{
+    if (isLive(h)) blocks_[records_[h].block].lastUse = frame_;
+}
+
+void BufferArena::endFrame()
+{
+    if (!buffer_) return;
+    frameFences_.push_back(std::make_pair(frame_, backend_->fence()));
+    ++frame_;
+    poll();
+}
+
+size_t BufferArena::offset(Handle h) const
+{
+    return isLive(h) ? blocks_[records_[h].block].start : 0;
+}
+
+size_t BufferArena::size(Handle h) const
+{
+    return isLive(h) ? records_[h].size : 0;
+}
+
+void *BufferArena::data(Handle h)
+{
+    return isLive(h) ? data_ + blocks_[records_[h].block].start : nullptr;
+}
+
+bool BufferArena::defragment()
+{
+    poll();
+    if (!buffer_) return false;
+    if (defragmentHeadroom < capacity_ * (retired_.size() + 1)) return compact();
+    void *mapped = nullptr;
+    unsigned int buffer = backend_->create(capacity_, &mapped);
+    if (!buffer) return false;
+
+    std::vector<Block> packed;
+    size_t at = 0;
+    for (const Block &b : blocks_) {
+        if (!b.handle) continue;    // the pending blocks stay in the old buffer, the GPU still reads them there
+        const Record &r = records_[b.handle];
+        size_t start = alignUp(at, r.alignment);
+        backend_->copy(buffer_, b.start, buffer, start, r.size);
+        stats_.movedBytes += r.size;
+        Block moved = b;
+        moved.offset = at;
+        moved.start = start;
+        moved.size = start + r.size - at;
+        packed.push_back(moved);
+        at = start + r.size;
+    }
+    if (at < capacity_) packed.push_back(Block{at, capacity_ - at, at, 0, 0, false, false});
+
+    // the frames in flight may read the old buffer: destroyed once the current one is done
+    retired_.push_back(std::make_pair(buffer_, frame_));
+    buffer_ = buffer;
+    data_ = (uint8_t *) mapped;
+    blocks_.swap(packed);
+    reindex();
+    ++stats_.defragmentations;
+    return true;
+}
+
+// The live blocks slide down in offset order, so that no copy overwrites the bytes a later one reads. A
+// copy may not overlap itself: a block moving by less than its size is copied in slices of the move, and
+// one that would move by less than a sixteenth of its size stays where it is. The bytes left behind are
+// read by the copies and by the frames in flight, so they are pending until the current frame is done;
+// the moved blocks count as used by it, they may not be evicted before their copies ran.
+bool BufferArena::compact()
+{
+    std::vector<Block> packed;
+    size_t at = 0;
+    bool moved = false;
+    for (const Block &b : blocks_) {
+        if (!b.handle) continue;
+        const Record &r = records_[b.handle];
+        size_t start = alignUp(at, r.alignment);
+        size_t shift = b.start - start;
+        Block placed = b;
+        if (shift > 0 && shift * 16 >= r.size) {
+            for (size_t done = 0; done < r.size; done += shift) {
+                backend_->copy(buffer_, b.start + done, buffer_, start + done, std::min(shift, r.size - done));
+            }
+            stats_.movedBytes += r.size;
+            placed.offset = at;
+            placed.start = start;
+            placed.size = start + r.size - at;
+            placed.lastUse = frame_;
+            moved = true;
+        } else if (b.offset > at) {
+            packed.push_back(Block{at, b.offset - at, at, 0, frame_, false, true});
+        }
+        packed.push_back(placed);
+        at = placed.offset + placed.size;
+    }
+    if (!moved) return false;
+    if (at < capacity_) packed.push_back(Block{at, capacity_ - at, at, 0, frame_, false, true});
+
+    blocks_.swap(packed);
+    reindex();
+    compacted_ = frame_;
+    ++stats_.defragmentations;
+    return true;
+}
+
+float BufferArena::fragmentation() const
+{
+    Stats st = stats();
+    size_t free = capacity_ - st.used - st.pending;
+    return free ? 1.0f - (float) st.largestFree / free : 0.0f;
+}
+
+BufferArena::Stats BufferArena::stats() const
+{
+    Stats st = stats_;
+    st.used = st.pending = st.largestFree = 0;
+    st.blocks = 0;
+    for (const Block &b : blocks_) {
+        if (b.handle) {
+            st.used += b.size;
+            ++st.blocks;
+        } else if (b.pending) {
+            st.pending += b.size;
+        } else {
+            st.largestFree = std::max(st.largestFree, b.size);
+        }
+    }
+    return st;
+}
+
+bool BufferArena::check() const
+{
+    size_t at = 0;
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+        const Block &b = blocks_[i];
+        if (b.offset != at || b.size == 0) return false;
+        at += b.size;
+        bool isFree = !b.handle && !b.pending;
+        if (isFree && i > 0 && !blocks_[i - 1].handle && !blocks_[i - 1].pending) return false;
+        if (b.handle) {
+            if (b.handle >= records_.size() || records_[b.handle].block != (int) i) return false;
+            const Record &r = records_[b.handle];
+            if (b.start < b.offset || b.start + r.size > b.offset + b.size || b.start % r.alignment) return false;
+        }
+    }
+    for (size_t h = 1; h < records_.size(); ++h) {
+        if (records_[h].block >= 0 && blocks_[records_[h].block].handle != h) return false;
+    }
+    return at == capacity_;
+}
@@ -0,0 +1,197 @@
+#ifndef GPUBUFFERALLOCATOR_H
+#define GPUBUFFERALLOCATOR_H
+
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+// What the suballocators need from GL: persistently mapped buffers, GPU side copies and fences.
+// GLBufferBackend is the real one, MockBufferBackend runs the allocators without a context.
+class GpuBufferBackend
+{
+public:
+    virtual ~GpuBufferBackend() = default;
+
+    // A buffer of size bytes, mapped for reading and writing for its whole life. Returns 0 on failure.
+    virtual unsigned int create(size_t size, void **mapped) = 0;
+    virtual void destroy(unsigned int buffer) = 0;
+    // Queued like a draw: the CPU does not wait for it. src may be dst, the ranges do not overlap.
+    virtual void copy(unsigned int src, size_t srcOffset, unsigned int dst, size_t dstOffset, size_t size) = 0;
+    // Fence after the commands issued so far, never 0.
+    virtual uint64_t fence() = 0;
+    // Does not wait.
+    virtual bool signaled(uint64_t fence) = 0;
+    virtual void wait(uint64_t fence) = 0;
+    // The allocators are done with the fence.
+    virtual void release(uint64_t fence) = 0;
+};
+
+// Per frame streaming data (instance attributes, indirect commands) written straight into a
+// persistently mapped ring. endFrame() fences the bytes of the frame; they are reused once the fence
+// signaled. allocate() only waits when the GPU is capacity bytes behind, which a ring of three
+// frames never is: such waits are counted as stalls.
+class StreamRing
+{
+public:
+    struct Span
+    {
+        unsigned int buffer = 0;
+        size_t offset = 0;
+        void *data = nullptr;   // null when size is larger than the ring
+    };
+
+    struct Stats
+    {
+        size_t frames = 0;
+        size_t bytes = 0;       // allocated, padding included
+        size_t stalls = 0;      // allocations that waited for a fence
+    };
+
+    StreamRing() = default;
+    ~StreamRing();
+    StreamRing(const StreamRing &) = delete;
+    StreamRing &operator=(const StreamRing &) = delete;
+
+    bool init(GpuBufferBackend *backend, size_t capacity);
+    // Waits for the frames in flight, then frees the buffer.
+    void release();
+    bool isInit() const { return buffer_ != 0; }
+    size_t capacity() const { return capacity_; }
+    unsigned int buffer() const { return buffer_; }
+
+    // offset is a multiple of alignment.
+    Span allocate(size_t size, size_t alignment = 16);
+    void endFrame();
+
+    const Stats &stats() const { return stats_; }
+
+private:
+    struct Frame
+    {
+        size_t bytes;
+        uint64_t fence;
+    };
+
+    void retire(bool wait);
+
+    GpuBufferBackend *backend_ = nullptr;
+    unsigned int buffer_ = 0;
+    uint8_t *data_ = nullptr;
+    size_t capacity_ = 0;
+    size_t head_ = 0;           // next byte written
+    size_t used_ = 0;           // bytes in flight and of the current frame, from head_ backwards
+    size_t frameBytes_ = 0;
+    std::deque<Frame> inFlight_;
+    Stats stats_;
+};
+
+// Offset and size suballocation of one persistently mapped buffer of a fixed capacity. The blocks are
+// first fit in an offset ordered list with neighbouring free blocks merged. A block freed while the GPU
+// may still read it (touched by a frame whose fence has not signaled) is only reused afterwards. When
+// nothing fits, the evictable blocks are evicted least recently touched first, onEvict telling their
+// owner; unless the free bytes would do but are scattered, then the arena is defragmented first (at
+// most every defragmentInterval frames). defragment() packs the live blocks with GPU copies, so it never
+// waits either; the offsets change, the handles stay. With a defragmentHeadroom of at least the
+// capacity it packs them into a new buffer, kept with the old one until the frames in flight are done
+// with it, and the freed bytes are reused at once. Otherwise, by default, it slides them down inside
+// the buffer: the memory stays the capacity, but the freed bytes are only reused once the current frame
+// is done, and the allocations that do not fit fail until then rather than evict. Blocks are written
+// right after allocate(), before any later defragmentation queues its copies.
+// Handles are never reused, 0 is none.
+class BufferArena
+{
+public:
+    typedef uint32_t Handle;
+
+    struct Stats
+    {
+        size_t used = 0;            // live blocks, alignment padding included
+        size_t pending = 0;         // freed, waiting for the GPU
+        size_t largestFree = 0;
+        size_t blocks = 0;
+        size_t allocations = 0, failures = 0, evictions = 0, defragmentations = 0;
+        size_t movedBytes = 0;      // copied by the defragmentations
+    };
+
+    std::function<void(Handle)> onEvict;
+    // Frames between two defragmentations started by allocate().
+    unsigned int defragmentInterval = 16;
+    // Bytes that may be used beyond capacity() by the buffers a defragmentation replaced: each one takes
+    // capacity() bytes until the frames in flight are done with it. Less than capacity(): in place.
+    size_t defragmentHeadroom = 0;
+
+    BufferArena() = default;
+    ~BufferArena();
+    BufferArena(const BufferArena &) = delete;
+    BufferArena &operator=(const BufferArena &) = delete;
+
+    bool init(GpuBufferBackend *backend, size_t capacity);
+    void release();
+    bool isInit() const { return buffer_ != 0; }
+    size_t capacity() const { return capacity_; }
+    unsigned int buffer() const { return buffer_; }
+
+    // Returns 0 when size bytes do not fit even after eviction and defragmentation.
+    // alignment needs not be a power of two.
+    Handle allocate(size_t size, size_t alignment = 16, bool evictable = true);
+    void free(Handle h);
+    // The block is drawn by the current frame.
+    void touch(Handle h);
+    // Fences the current frame and reuses the blocks the GPU is done with.
+    void endFrame();
+
+    bool isLive(Handle h) const { return h < records_.size() && records_[h].block >= 0; }
+    size_t offset(Handle h) const;
+    size_t size(Handle h) const;
+    void *data(Handle h);
+
+    // Returns false when no block moved, or there is no memory for the new buffer.
+    bool defragment();
+
+    // 1 - largest free block / free bytes.
+    float fragmentation() const;
+    Stats stats() const;
+    // Checks the block list: ordered, adjacent, no two free neighbours, records consistent.
+    bool check() const;
+
+private:
+    struct Block
+    {
+        size_t offset, size;        // size includes the padding before the aligned start
+        size_t start;               // aligned offset handed out
+        Handle handle;              // 0 when free
+        uint64_t lastUse;           // frame
+        bool evictable, pending;    // pending: freed, in use by a frame not finished yet
+    };
+
+    struct Record
+    {
+        int block = -1;             // in blocks_, -1 once freed
+        size_t size = 0, alignment = 1;
+    };
+
+    int findFit(size_t size, size_t alignment) const;
+    Handle place(int block, size_t size, size_t alignment, bool evictable);
+    void makeFree(int block);
+    void poll();
+    bool evictOne();
+    void reindex();
+    bool compact();
+
+    GpuBufferBackend *backend_ = nullptr;
+    unsigned int buffer_ = 0;
+    uint8_t *data_ = nullptr;
+    size_t capacity_ = 0;
+    std::vector<Block> blocks_;         // ordered by offset, covering the buffer
+    std::vector<Record> records_;       // by handle
+    uint64_t frame_ = 1, completed_ = 0; // current frame, last frame the GPU finished
+    uint64_t defragmented_ = 0;         // frame of the last defragment() from allocate()
+    uint64_t compacted_ = 0;            // frame of the last defragmentation in place
+    std::deque<std::pair<uint64_t, uint64_t> > frameFences_;   // frame, fence
+    std::vector<std::pair<unsigned int, uint64_t> > retired_;   // buffers replaced by defragment(), until frame
+    Stats stats_;
+};
+
+#endif //GPUBUFFERALLOCATOR_H
@@ -0,0 +1,100 @@
+#include "GpuTimer.h"
+#include <cstdio>
+#include <cstring>
+#include <GL/freeglut.h>
+#include "FrameProfiler.h"
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88bf
+#endif
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT 0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+namespace
+{
+    typedef void (APIENTRY *GenQueriesProc)(GLsizei n, GLuint *ids);
+    typedef void (APIENTRY *DeleteQueriesProc)(GLsizei n, const GLuint *ids);
+    typedef void (APIENTRY *BeginQueryProc)(GLenum target, GLuint id);
+    typedef void (APIENTRY *EndQueryProc)(GLenum target);
+    typedef void (APIENTRY *GetQueryObjectivProc)(GLuint id, GLenum pname, GLint *params);
+    typedef void (APIENTRY *GetQueryObjectui64vProc)(GLuint id, GLenum pname, uint64_t *params);
+
+    GenQueriesProc genQueries;
+    DeleteQueriesProc deleteQueries;
+    BeginQueryProc beginQuery;
+    EndQueryProc endQuery;
+    GetQueryObjectivProc getQueryObjectiv;
+    GetQueryObjectui64vProc getQueryObjectui64v;
+}
+
+bool GpuTimer::init()
+{
+    available_ = false;
+    const char *version = (const char *) glGetString(GL_VERSION);
+    int major = 0, minor = 0;
+    if (version) sscanf(version, "%d.%d", &major, &minor);
+    if (major * 10 + minor < 33 && !glutExtensionSupported("GL_ARB_timer_query")) return false;
+
+    genQueries = (GenQueriesProc) glutGetProcAddress("glGenQueries");
+    deleteQueries = (DeleteQueriesProc) glutGetProcAddress("glDeleteQueries");
+    beginQuery = (BeginQueryProc) glutGetProcAddress("glBeginQuery");
+    endQuery = (EndQueryProc) glutGetProcAddress("glEndQuery");
+    getQueryObjectiv = (GetQueryObjectivProc) glutGetProcAddress("glGetQueryObjectiv");
+    getQueryObjectui64v = (GetQueryObjectui64vProc) glutGetProcAddress("glGetQueryObjectui64v");
+    if (!genQueries || !deleteQueries || !beginQuery || !endQuery || !getQueryObjectiv || !getQueryObjectui64v) return false;
+
+    genQueries(QueryNb, queries_);
+    available_ = true;
+    return true;
+}
+
+void GpuTimer::release()
+{
+    if (!available_) return;
+    if (open_) end();
+    deleteQueries(QueryNb, queries_);
+    memset(queries_, 0, sizeof queries_);
+    memset(pending_, 0, sizeof pending_);
+    next_ = 0;
+    available_ = false;
+}
+
+void GpuTimer::begin(uint64_t frameId)
+{
+    // the slot is still waiting for its result: this frame goes untimed rather than stalling
+    if (!available_ || pending_[next_]) return;
+    frameIds_[next_] = frameId;
+    beginQuery(GL_TIME_ELAPSED, queries_[next_]);
+    open_ = true;
+}
+
+void GpuTimer::end()
+{
+    if (!open_) return;
+    endQuery(GL_TIME_ELAPSED);
+    pending_[next_] = true;
+    next_ = (next_ + 1) % QueryNb;
+    open_ = false;
+}
+
+void GpuTimer::collect(FrameProfiler &profiler)
+{
+    if (!available_) return;
+    for (int i = 0; i < QueryNb; ++i) {
+        if (!pending_[i]) continue;
+        GLint ready = 0;
+        getQueryObjectiv(queries_[i], GL_QUERY_RESULT_AVAILABLE, &ready);
+        if (!ready) continue;
+        uint64_t ns = 0;
+        getQueryObjectui64v(queries_[i], GL_QUERY_RESULT, &ns);
+        profiler.setGpuTime(frameIds_[i], ns * 1e-6);
+        pending_[i] = false;
+    }
+}
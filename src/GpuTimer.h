@@ -0,0 +1,35 @@
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <cstdint>
+
+class FrameProfiler;
+
+// GPU time of whole frames with GL_TIME_ELAPSED queries (GL 3.3 or GL_ARB_timer_query). The results
+// are read back without waiting, a few frames later, into the FrameProfiler frame that issued them.
+// Does nothing when the context has no timer queries. init() needs a current GL context, and release()
+// before it goes.
+class GpuTimer
+{
+public:
+    bool init();
+    void release();
+    bool available() const { return available_; }
+
+    void begin(uint64_t frameId);
+    void end();
+    // Collects the finished queries.
+    void collect(FrameProfiler &profiler);
+
+private:
+    static const int QueryNb = 4;
+
+    bool available_ = false;
+    unsigned int queries_[QueryNb] = {0, 0, 0, 0};
+    uint64_t frameIds_[QueryNb] = {0, 0, 0, 0};
+    bool pending_[QueryNb] = {false, false, false, false};
+    int next_ = 0;
+    bool open_ = false;
+};
+
+#endif //GPUTIMER_H
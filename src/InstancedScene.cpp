@@ -0,0 +1,484 @@
+#include "InstancedScene.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstddef>
+#include <cstring>
+#include <GL/freeglut.h>
+#include "OffscreenContext.h"
+
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#endif
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8f3f
+#endif
+#ifndef GL_VERTEX_SHADER
+#define GL_VERTEX_SHADER 0x8b31
+#define GL_FRAGMENT_SHADER 0x8b30
+#define GL_COMPILE_STATUS 0x8b81
+#define GL_LINK_STATUS 0x8b82
+#endif
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+namespace
+{
+    typedef void (APIENTRY *BindBufferProc)(GLenum target, GLuint buffer);
+    typedef GLuint (APIENTRY *CreateShaderProc)(GLenum type);
+    typedef void (APIENTRY *ShaderSourceProc)(GLuint shader, GLsizei count, const char *const *source, const GLint *length);
+    typedef void (APIENTRY *CompileShaderProc)(GLuint shader);
+    typedef void (APIENTRY *GetShaderivProc)(GLuint shader, GLenum pname, GLint *params);
+    typedef void (APIENTRY *GetInfoLogProc)(GLuint object, GLsizei size, GLsizei *length, char *log);
+    typedef GLuint (APIENTRY *CreateProgramProc)(void);
+    typedef void (APIENTRY *AttachShaderProc)(GLuint program, GLuint shader);
+    typedef void (APIENTRY *BindAttribLocationProc)(GLuint program, GLuint index, const char *name);
+    typedef void (APIENTRY *LinkProgramProc)(GLuint program);
+    typedef void (APIENTRY *UseProgramProc)(GLuint program);
+    typedef void (APIENTRY *DeleteProgramProc)(GLuint program);
+    typedef void (APIENTRY *VertexAttribPointerProc)(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer);
+    typedef void (APIENTRY *VertexAttribArrayProc)(GLuint index);
+    typedef void (APIENTRY *VertexAttribDivisorProc)(GLuint index, GLuint divisor);
+    typedef void (APIENTRY *MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+
+    BindBufferProc bindBuffer;
+    CreateShaderProc createShader;
+    ShaderSourceProc shaderSource;
+    CompileShaderProc compileShader;
+    GetShaderivProc getShaderiv, getProgramiv;
+    GetInfoLogProc getShaderInfoLog, getProgramInfoLog;
+    CreateProgramProc createProgram;
+    AttachShaderProc attachShader;
+    BindAttribLocationProc bindAttribLocation;
+    LinkProgramProc linkProgram;
+    UseProgramProc useProgram;
+    DeleteProgramProc deleteProgram;
+    VertexAttribPointerProc vertexAttribPointer;
+    VertexAttribArrayProc enableVertexAttribArray, disableVertexAttribArray;
+    VertexAttribDivisorProc vertexAttribDivisor;
+    MultiDrawElementsIndirectProc multiDrawElementsIndirect;
+
+    template <class PROC>
+    bool load(PROC &proc, const char *name)
+    {
+        proc = (PROC) OffscreenContext::procAddress(name);
+        return proc != nullptr;
+    }
+
+    // Lit as the fixed pipeline does the viewer's meshes: GL_LIGHT0 directional, the material color diffuse.
+    const char *vertexShader =
+            "#version 430 compatibility\n"
+            "in vec3 position;\n"
+            "in vec3 normal;\n"
+            "in mat4 transform;\n"
+            "in vec4 color;\n"
+            "out vec4 litColor;\n"
+            "void main()\n"
+            "{\n"
+            "    gl_Position = gl_ModelViewProjectionMatrix * (transform * vec4(position, 1.0));\n"
+            "    vec3 n = normalize(gl_NormalMatrix * (mat3(transform) * normal));\n"
+            "    float d = max(dot(n, normalize(gl_LightSource[0].position.xyz)), 0.0);\n"
+            "    litColor = vec4(color.rgb * (0.2 * gl_LightSource[0].ambient.rgb + d * gl_LightSource[0].diffuse.rgb), 1.0);\n"
+            "}\n";
+    const char *fragmentShader =
+            "#version 430 compatibility\n"
+            "in vec4 litColor;\n"
+            "out vec4 fragColor;\n"
+            "void main()\n"
+            "{\n"
+            "    fragColor = litColor;\n"
+            "}\n";
+
+    // attribute locations, the transform takes four
+    enum { PositionAttrib = 0, NormalAttrib = 1, TransformAttrib = 2, ColorAttrib = 6, AttribNb = 7 };
+
+    GLuint compile(GLenum type, const char *source)
+    {
+        GLuint shader = createShader(type);
+        shaderSource(shader, 1, &source, nullptr);
+        compileShader(shader);
+        GLint ok = 0;
+        getShaderiv(shader, GL_COMPILE_STATUS, &ok);
+        if (!ok) {
+            char log[1024];
+            getShaderInfoLog(shader, sizeof log, nullptr, log);
+            printf("instanced scene shader: %s\n", log);
+            return 0;
+        }
+        return shader;
+    }
+}
+
+uint32_t InstancedScene::addAsset()
+{
+    assets_.emplace_back();
+    return (uint32_t) assets_.size() - 1;
+}
+
+void InstancedScene::addLevel(uint32_t asset, const MeshBuffer &mesh)
+{
+    Asset &a = assets_[asset];
+    if (a.levelNb == MaxLevels || mesh.indices.empty()) return;
+
+    // smooth normals: the face normals around each vertex
+    std::vector<Point3D> normals(mesh.vertices.size(), Point3D(0, 0, 0));
+    for (size_t f = 0; f < mesh.indices.size() / 3 && f < mesh.normals.size(); ++f) {
+        for (int j = 0; j < 3; ++j) normals[mesh.indices[f * 3 + j]] += mesh.normals[f];
+    }
+    Level level;
+    level.firstIndex = (uint32_t) indices_.size();
+    level.indexCount = (uint32_t) mesh.indices.size();
+    level.baseVertex = (uint32_t) (vertices_.size() / 6);
+    level.vertexNb = (uint32_t) mesh.vertices.size();
+    level.asset = asset;
+    level.rank = a.levelNb;
+    level.block = 0;
+    for (size_t v = 0; v < mesh.vertices.size(); ++v) {
+        const Point3D &p = mesh.vertices[v];
+        Point3D n = normals[v];
+        float len = sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+        n = len > 0 ? n / len : Point3D(0, 1, 0);
+        vertices_.insert(vertices_.end(), {(float) p.x, (float) p.y, (float) p.z, (float) n.x, (float) n.y, (float) n.z});
+    }
+    indices_.insert(indices_.end(), mesh.indices.begin(), mesh.indices.end());
+
+    if (a.levelNb == 0) {
+        vcg::Box3f box(vcg::Point3f(mesh.bbMin.x, mesh.bbMin.y, mesh.bbMin.z), vcg::Point3f(mesh.bbMax.x, mesh.bbMax.y, mesh.bbMax.z));
+        a.center = box.Center();
+        a.radius = box.Diag() / 2;
+    }
+    a.levels[a.levelNb++] = (uint32_t) levels_.size();
+    levels_.push_back(level);
+}
+
+uint32_t InstancedScene::addMaterial(float r, float g, float b)
+{
+    materials_.push_back(vcg::Point3f(r, g, b));
+    return (uint32_t) materials_.size() - 1;
+}
+
+uint32_t InstancedScene::addInstance(uint32_t asset, const vcg::Matrix44f &transform, uint32_t material)
+{
+    const Asset &a = assets_[asset];
+    Instance instance;
+    instance.asset = asset;
+    instance.material = material;
+    instance.transform = transform;
+    instance.center = transform * a.center;
+    float scale = 0;
+    for (int c = 0; c < 3; ++c) {
+        scale = std::max(scale, vcg::Point3f(transform.ElementAt(0, c), transform.ElementAt(1, c), transform.ElementAt(2, c)).Norm());
+    }
+    instance.radius = a.radius * scale;
+    bounds_.Add(vcg::Box3f(instance.center - vcg::Point3f(instance.radius, instance.radius, instance.radius),
+                           instance.center + vcg::Point3f(instance.radius, instance.radius, instance.radius)));
+    instances_.push_back(instance);
+    return (uint32_t) instances_.size() - 1;
+}
+
+void InstancedScene::clear()
+{
+    for (const Level &l : levels_) arena_.free(l.block);
+    vertices_.clear();
+    indices_.clear();
+    levels_.clear();
+    assets_.clear();
+    materials_.clear();
+    instances_.clear();
+    commands_.clear();
+    instanceData_.clear();
+    bounds_.SetNull();
+}
+
+void InstancedScene::cull(const vcg::Matrix44f &projection, const vcg::Matrix44f &modelview, int viewportHeight, Stats *stats)
+{
+    ViewFrustum frustum;
+    frustum.set(projection, modelview);
+    // pixels per unit of radius at distance 1
+    float pixelScale = projection.ElementAt(1, 1) * viewportHeight / 2;
+
+    levelCounts_.assign(levels_.size(), 0);
+    instanceLevels_.resize(instances_.size());
+    Stats st;
+    st.instances = instances_.size();
+    for (size_t i = 0; i < instances_.size(); ++i) {
+        const Instance &inst = instances_[i];
+        int &level = instanceLevels_[i];
+        level = -1;
+        bool inside = true;
+        for (const vcg::Plane3f &p : frustum.planes) {
+            if (p.Direction() * inst.center - p.Offset() < -inst.radius) {
+                inside = false;
+                break;
+            }
+        }
+        const Asset &a = assets_[inst.asset];
+        if (!inside || a.levelNb == 0) continue;
+
+        float dist = std::max((inst.center - frustum.eye).Norm(), 1e-6f);
+        float pixels = inst.radius * pixelScale / dist;
+        uint32_t l = 0;
+        for (float limit = lodPixels; pixels < limit && l + 1 < a.levelNb; limit *= 0.5f) ++l;
+        level = (int) a.levels[l];
+        ++levelCounts_[level];
+        ++st.visible;
+        ++st.levelInstances[l];
+    }
+
+    // one command per level drawn, its instances from baseInstance on
+    commands_.clear();
+    commandLevels_.clear();
+    uint32_t baseInstance = 0;
+    for (size_t l = 0; l < levels_.size(); ++l) {
+        if (levelCounts_[l] == 0) continue;
+        Command c;
+        c.count = levels_[l].indexCount;
+        c.instanceCount = 0;
+        c.firstIndex = levels_[l].firstIndex;
+        c.baseVertex = (int32_t) levels_[l].baseVertex;
+        c.baseInstance = baseInstance;
+        baseInstance += levelCounts_[l];
+        levelCounts_[l] = (uint32_t) commands_.size();   // from now on the command of the level
+        commands_.push_back(c);
+        commandLevels_.push_back((uint32_t) l);
+    }
+
+    instanceData_.resize(st.visible);
+    for (size_t i = 0; i < instances_.size(); ++i) {
+        if (instanceLevels_[i] < 0) continue;
+        Command &c = commands_[levelCounts_[instanceLevels_[i]]];
+        InstanceData &d = instanceData_[c.baseInstance + c.instanceCount++];
+        const Instance &inst = instances_[i];
+        for (int row = 0; row < 4; ++row) {
+            for (int col = 0; col < 4; ++col) d.transform[col * 4 + row] = inst.transform.ElementAt(row, col);
+        }
+        const vcg::Point3f &m = materials_[inst.material];
+        d.color[0] = m[0];
+        d.color[1] = m[1];
+        d.color[2] = m[2];
+        d.color[3] = 1;
+    }
+    st.commands = commands_.size();
+    for (const Command &c : commands_) st.faces += size_t(c.count / 3) * c.instanceCount;
+    if (stats) *stats = st;
+}
+
+bool InstancedScene::initGL()
+{
+    glChecked_ = true;
+    const char *version = (const char *) glGetString(GL_VERSION);
+    int major = 0, minor = 0;
+    if (version) sscanf(version, "%d.%d", &major, &minor);
+    // 4.4 for the persistent mapped glBufferStorage of the arena and the ring, multi-draw indirect is 4.3
+    if (major * 10 + minor < 44 || !backend_.init()) return false;
+
+    if (!load(bindBuffer, "glBindBuffer") || !load(deleteProgram, "glDeleteProgram") ||
+        !load(createShader, "glCreateShader") || !load(shaderSource, "glShaderSource") ||
+        !load(compileShader, "glCompileShader") || !load(getShaderiv, "glGetShaderiv") ||
+        !load(getProgramiv, "glGetProgramiv") || !load(getShaderInfoLog, "glGetShaderInfoLog") ||
+        !load(getProgramInfoLog, "glGetProgramInfoLog") || !load(createProgram, "glCreateProgram") ||
+        !load(attachShader, "glAttachShader") || !load(bindAttribLocation, "glBindAttribLocation") ||
+        !load(linkProgram, "glLinkProgram") || !load(useProgram, "glUseProgram") ||
+        !load(vertexAttribPointer, "glVertexAttribPointer") || !load(enableVertexAttribArray, "glEnableVertexAttribArray") ||
+        !load(disableVertexAttribArray, "glDisableVertexAttribArray") || !load(vertexAttribDivisor, "glVertexAttribDivisor") ||
+        !load(multiDrawElementsIndirect, "glMultiDrawElementsIndirect")) return false;
+
+    GLuint vs = compile(GL_VERTEX_SHADER, vertexShader), fs = compile(GL_FRAGMENT_SHADER, fragmentShader);
+    if (!vs || !fs) return false;
+    program_ = createProgram();
+    attachShader(program_, vs);
+    attachShader(program_, fs);
+    bindAttribLocation(program_, PositionAttrib, "position");
+    bindAttribLocation(program_, NormalAttrib, "normal");
+    bindAttribLocation(program_, TransformAttrib, "transform");
+    bindAttribLocation(program_, ColorAttrib, "color");
+    linkProgram(program_);
+    GLint ok = 0;
+    getProgramiv(program_, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        getProgramInfoLog(program_, sizeof log, nullptr, log);
+        printf("instanced scene program: %s\n", log);
+        return false;
+    }
+    if (!arena_.init(&backend_, gpuBudget)) {
+        printf("instanced scene: no %zu MB buffer\n", gpuBudget >> 20);
+        return false;
+    }
+    arena_.onEvict = [this](BufferArena::Handle h) {
+        for (Level &l : levels_) {
+            if (l.block == h) l.block = 0;
+        }
+    };
+    return true;
+}
+
+void InstancedScene::releaseGL()
+{
+    ring_.release();
+    arena_.release();
+    for (Level &l : levels_) l.block = 0;
+    if (program_) deleteProgram(program_);
+    program_ = 0;
+    glChecked_ = hasIndirect_ = false;
+}
+
+bool InstancedScene::makeResident(uint32_t level, size_t &uploaded)
+{
+    Level &l = levels_[level];
+    if (l.block) {
+        arena_.touch(l.block);
+        return true;
+    }
+    size_t vertexBytes = size_t(l.vertexNb) * 6 * sizeof(float), bytes = vertexBytes + size_t(l.indexCount) * sizeof(uint32_t);
+    if (uploaded + bytes > uploadBudget && uploaded > 0) return false;
+    // 24 bytes aligned: the block starts on a vertex, its indices on a 4 bytes boundary
+    bool pinned = l.rank + 1 == assets_[l.asset].levelNb;
+    l.block = arena_.allocate(bytes, 6 * sizeof(float), !pinned);
+    if (!l.block) return false;
+    uint8_t *data = (uint8_t *) arena_.data(l.block);
+    memcpy(data, &vertices_[size_t(l.baseVertex) * 6], vertexBytes);
+    memcpy(data + vertexBytes, &indices_[l.firstIndex], size_t(l.indexCount) * sizeof(uint32_t));
+    uploaded += bytes;
+    return true;
+}
+
+void InstancedScene::draw(Stats *stats)
+{
+    if (!glChecked_) {
+        hasIndirect_ = initGL();
+        printf("instanced scene: %s\n", hasIndirect_ ? "multi-draw indirect available" : "no GL 4.4, one draw per instance");
+    }
+    Stats st;
+    if (!commands_.empty()) {
+        if (indirect && hasIndirect_) drawIndirect(&st);
+        else drawDirect(&st);
+    }
+    if (stats) {
+        stats->drawCalls = st.drawCalls;
+        stats->stateChanges = st.stateChanges;
+        stats->fallbacks = st.fallbacks;
+        stats->uploadedBytes = st.uploadedBytes;
+        stats->residentBytes = arena_.isInit() ? arena_.stats().used : 0;
+        stats->evictions = arena_.isInit() ? arena_.stats().evictions : 0;
+    }
+}
+
+void InstancedScene::drawIndirect(Stats *stats)
+{
+    // residency first: an upload may defragment the arena, moving the levels already resolved
+    std::vector<int> drawn(commands_.size(), -1);
+    for (size_t k = 0; k < commands_.size(); ++k) {
+        const Level &wanted = levels_[commandLevels_[k]];
+        const Asset &a = assets_[wanted.asset];
+        if (makeResident(commandLevels_[k], stats->uploadedBytes)) {
+            drawn[k] = (int) commandLevels_[k];
+            continue;
+        }
+        // the nearest resident level, coarser ones first
+        for (uint32_t d = 1; d < a.levelNb && drawn[k] < 0; ++d) {
+            for (int r : {(int) wanted.rank + (int) d, (int) wanted.rank - (int) d}) {
+                if (r >= 0 && r < (int) a.levelNb && levels_[a.levels[r]].block) {
+                    drawn[k] = (int) a.levels[r];
+                    arena_.touch(levels_[drawn[k]].block);
+                    break;
+                }
+            }
+        }
+        stats->fallbacks += commands_[k].instanceCount;
+    }
+    gpuCommands_.clear();
+    for (size_t k = 0; k < commands_.size(); ++k) {
+        if (drawn[k] < 0) continue;
+        const Level &l = levels_[drawn[k]];
+        size_t offset = arena_.offset(l.block);
+        Command c = commands_[k];
+        c.count = l.indexCount;
+        c.baseVertex = (int32_t) (offset / (6 * sizeof(float)));
+        c.firstIndex = (uint32_t) ((offset + size_t(l.vertexNb) * 6 * sizeof(float)) / sizeof(uint32_t));
+        gpuCommands_.push_back(c);
+    }
+
+    // three frames of per-instance data and commands in flight; grown (waiting once) when too small
+    size_t instanceBytes = instanceData_.size() * sizeof(InstanceData), commandBytes = gpuCommands_.size() * sizeof(Command);
+    size_t frameBytes = instanceBytes + commandBytes + 64;
+    if (ring_.capacity() < 3 * frameBytes) ring_.init(&backend_, std::max<size_t>(6 * frameBytes, 1 << 20));
+    StreamRing::Span instances = ring_.allocate(instanceBytes, 16), commands = ring_.allocate(commandBytes, 4);
+    if (gpuCommands_.empty() || !instances.data || !commands.data) {
+        ring_.endFrame();
+        arena_.endFrame();
+        return;
+    }
+    memcpy(instances.data, instanceData_.data(), instanceBytes);
+    memcpy(commands.data, gpuCommands_.data(), commandBytes);
+
+    useProgram(program_);
+    bindBuffer(GL_ARRAY_BUFFER, arena_.buffer());
+    bindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena_.buffer());
+    vertexAttribPointer(PositionAttrib, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (const void *) 0);
+    vertexAttribPointer(NormalAttrib, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (const void *) (3 * sizeof(float)));
+    bindBuffer(GL_ARRAY_BUFFER, ring_.buffer());
+    for (int c = 0; c < 4; ++c) {
+        vertexAttribPointer(TransformAttrib + c, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                            (const void *) (instances.offset + offsetof(InstanceData, transform) + c * 4 * sizeof(float)));
+    }
+    vertexAttribPointer(ColorAttrib, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                        (const void *) (instances.offset + offsetof(InstanceData, color)));
+    for (int a = 0; a < AttribNb; ++a) {
+        enableVertexAttribArray(a);
+        if (a >= TransformAttrib) vertexAttribDivisor(a, 1);
+    }
+    bindBuffer(GL_DRAW_INDIRECT_BUFFER, ring_.buffer());
+    stats->stateChanges += 5;
+
+    multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void *) commands.offset, (GLsizei) gpuCommands_.size(), 0);
+    stats->drawCalls = 1;
+
+    // back to the fixed pipeline state the rest of the frame expects
+    for (int a = 0; a < AttribNb; ++a) {
+        if (a >= TransformAttrib) vertexAttribDivisor(a, 0);
+        disableVertexAttribArray(a);
+    }
+    bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    bindBuffer(GL_ARRAY_BUFFER, 0);
+    useProgram(0);
+
+    ring_.endFrame();
+    arena_.endFrame();
+}
+
+void InstancedScene::drawDirect(Stats *stats)
+{
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_LIGHTING_BIT);
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnable(GL_NORMALIZE);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glMatrixMode(GL_MODELVIEW);
+    const float *color = nullptr;
+    for (const Command &c : commands_) {
+        glVertexPointer(3, GL_FLOAT, 6 * sizeof(float), &vertices_[size_t(c.baseVertex) * 6]);
+        glNormalPointer(GL_FLOAT, 6 * sizeof(float), &vertices_[size_t(c.baseVertex) * 6 + 3]);
+        stats->stateChanges += 2;
+        for (uint32_t k = c.baseInstance; k < c.baseInstance + c.instanceCount; ++k) {
+            const InstanceData &d = instanceData_[k];
+            if (!color || !std::equal(color, color + 4, d.color)) {
+                color = d.color;
+                glMaterialfv(GL_FRONT, GL_DIFFUSE, color);
+                glColor3fv(color);
+                ++stats->stateChanges;
+            }
+            glPushMatrix();
+            glMultMatrixf(d.transform);
+            glDrawElements(GL_TRIANGLES, c.count, GL_UNSIGNED_INT, &indices_[c.firstIndex]);
+            glPopMatrix();
+            ++stats->stateChanges;
+            ++stats->drawCalls;
+        }
+    }
+    glPopClientAttrib();
+    glPopAttrib();
+}
@@ -0,0 +1,146 @@
+#ifndef INSTANCEDSCENE_H
+#define INSTANCEDSCENE_H
+
+#include <vector>
+#include <cstdint>
+#include <vcg/math/matrix44.h>
+#include <vcg/space/box3.h>
+#include "MeshBuffer.h"
+#include "MeshClusters.h"
+#include "GpuBufferAllocator.h"
+#include "GLBufferBackend.h"
+
+// Many instances of a few assets, drawn in one call. The LOD levels of all the assets are kept in one
+// vertex array (position and smooth normal per vertex) and one index array; the instances are an
+// asset, a transform and a material. cull() keeps the instances whose bounding sphere is in the
+// frustum, picks a level by its projected size, and groups the survivors by level: one indirect
+// command per level, its instances consecutive in the per-instance data (transform and color,
+// fetched through divisor 1 attributes from the command's base instance).
+// On the GPU the levels live in a BufferArena of gpuBudget bytes, a block per level with its vertices
+// then its indices, uploaded on first use (at most uploadBudget bytes per frame) and evicted least
+// recently drawn first; the coarsest level of each asset is pinned. A level not resident yet is drawn
+// with the nearest resident one of its asset. The per-instance data and the commands of the frame go
+// through a StreamRing, then draw() issues a single glMultiDrawElementsIndirect: nothing waits for the
+// GPU. The indirect path needs GL 4.4, not the 4.3 of glMultiDrawElementsIndirect: the arena and the
+// ring are glBufferStorage buffers mapped persistent and coherent (GLBufferBackend), which came with 4.4.
+// Without it (or with indirect off) the same commands are drawn from client arrays, one
+// glDrawElements per instance with its matrix and material: the path the viewer had before, kept to
+// compare against. draw() needs a current context, and releaseGL() before it goes; the rest is plain CPU.
+class InstancedScene
+{
+public:
+    static const int MaxLevels = 8;
+
+    struct Stats
+    {
+        size_t instances = 0;
+        size_t visible = 0;
+        size_t levelInstances[MaxLevels] = {};  // visible instances per level, 0 the finest
+        size_t commands = 0;                    // indirect commands, one per level drawn
+        size_t drawCalls = 0;                   // GL draw calls issued by draw()
+        size_t stateChanges = 0;                // binds, uploads, matrix and material changes in draw()
+        size_t faces = 0;
+        size_t fallbacks = 0;                   // instances drawn with another level than the one picked
+        size_t uploadedBytes = 0;               // levels uploaded by draw()
+        size_t residentBytes = 0;               // in the arena
+        size_t evictions = 0;                   // since the start
+    };
+
+    // Levels drop when the projected radius of an instance halves below lodPixels.
+    float lodPixels = 150;
+    // Multi-draw indirect when the context has it.
+    bool indirect = true;
+    // Set before the first draw().
+    size_t gpuBudget = size_t(256) << 20;
+    size_t uploadBudget = size_t(8) << 20;
+
+    InstancedScene() = default;
+    InstancedScene(const InstancedScene &) = delete;
+    InstancedScene &operator=(const InstancedScene &) = delete;
+
+    // Returns the id of a new asset; its levels are added finest first, at most MaxLevels.
+    uint32_t addAsset();
+    void addLevel(uint32_t asset, const MeshBuffer &mesh);
+    uint32_t addMaterial(float r, float g, float b);
+    uint32_t addInstance(uint32_t asset, const vcg::Matrix44f &transform, uint32_t material);
+    void clear();
+
+    bool empty() const { return instances_.empty(); }
+    size_t assetNb() const { return assets_.size(); }
+    size_t levelNb(uint32_t asset) const { return assets_[asset].levelNb; }
+    vcg::Box3f bounds() const { return bounds_; }
+
+    // Builds the commands of the frame. viewportHeight in pixels.
+    void cull(const vcg::Matrix44f &projection, const vcg::Matrix44f &modelview, int viewportHeight, Stats *stats = nullptr);
+    // Draws the commands of the last cull() with the current modelview and projection.
+    void draw(Stats *stats = nullptr);
+    // Frees the GL objects: the next draw() starts over.
+    void releaseGL();
+
+private:
+    struct Level
+    {
+        uint32_t firstIndex, indexCount, baseVertex, vertexNb;   // in indices_ and vertices_
+        uint32_t asset, rank;                                    // rank 0 the finest
+        BufferArena::Handle block;                               // vertices then indices, 0 when not resident
+    };
+
+    struct Asset
+    {
+        uint32_t levels[MaxLevels];   // in levels_, finest first
+        uint32_t levelNb = 0;
+        vcg::Point3f center;
+        float radius = 0;
+    };
+
+    struct Instance
+    {
+        uint32_t asset, material;
+        vcg::Matrix44f transform;
+        vcg::Point3f center;   // of the bounding sphere, world space
+        float radius;
+    };
+
+    // The layout of GL's DrawElementsIndirectCommand.
+    struct Command
+    {
+        uint32_t count, instanceCount, firstIndex;
+        int32_t baseVertex;
+        uint32_t baseInstance;
+    };
+
+    // Per instance attributes: the transform column major, as GL takes matrices.
+    struct InstanceData
+    {
+        float transform[16];
+        float color[4];
+    };
+
+    bool initGL();
+    bool makeResident(uint32_t level, size_t &uploaded);
+    void drawIndirect(Stats *stats);
+    void drawDirect(Stats *stats);
+
+    std::vector<float> vertices_;        // x y z nx ny nz
+    std::vector<uint32_t> indices_;      // relative to the base vertex of their level
+    std::vector<Level> levels_;          // of all the assets
+    std::vector<Asset> assets_;
+    std::vector<vcg::Point3f> materials_;
+    std::vector<Instance> instances_;
+    vcg::Box3f bounds_;
+
+    std::vector<Command> commands_;
+    std::vector<uint32_t> commandLevels_;
+    std::vector<InstanceData> instanceData_;
+    std::vector<uint32_t> levelCounts_;      // cull() scratch
+    std::vector<int> instanceLevels_;        // cull() scratch, < 0 when culled
+
+    bool glChecked_ = false, hasIndirect_ = false;
+    unsigned int program_ = 0;
+    GLBufferBackend backend_;
+    BufferArena arena_;
+    StreamRing ring_;
+    std::vector<Command> gpuCommands_;      // commands_ on the arena
+};
+
+#endif //INSTANCEDSCENE_H
@@ -0,0 +1,72 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+JobSystem::JobSystem(unsigned workerNb) : workerNb_(std::max(1u, workerNb))
+{
+}
+
+JobSystem::~JobSystem()
+{
+    stop();
+}
+
+void JobSystem::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        jobs_.clear();
+    }
+    wake_.notify_all();
+    for (std::thread &t : workers_) {
+        t.join();
+    }
+    workers_.clear();
+}
+
+void JobSystem::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_) return;
+        if (workers_.empty()) {
+            for (unsigned i = 0; i < workerNb_; ++i) {
+                workers_.emplace_back(&JobSystem::workerLoop, this);
+            }
+        }
+        jobs_.push_back(std::move(job));
+    }
+    wake_.notify_one();
+}
+
+void JobSystem::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return jobs_.empty() && running_ == 0; });
+}
+
+bool JobSystem::busy()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !jobs_.empty() || running_ > 0;
+}
+
+void JobSystem::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+        if (stop_) return;
+
+        std::function<void()> job = std::move(jobs_.front());
+        jobs_.pop_front();
+        ++running_;
+        lock.unlock();
+
+        job();
+
+        lock.lock();
+        --running_;
+        if (jobs_.empty() && running_ == 0) idle_.notify_all();
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// A fixed pool of worker threads running jobs in submission order. Jobs may submit follow-up jobs,
+// wait() returns once the queue is empty and no job runs. The workers start with the first submit().
+// stop(), also run by the destructor, drops the jobs still queued and waits for the running ones; the
+// jobs submitted afterwards are ignored.
+class JobSystem
+{
+public:
+    explicit JobSystem(unsigned workerNb = std::thread::hardware_concurrency());
+    ~JobSystem();
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    void submit(std::function<void()> job);
+    void wait();
+    bool busy();
+    void stop();
+
+private:
+    void workerLoop();
+
+    unsigned workerNb_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_, idle_;
+    std::deque<std::function<void()>> jobs_;
+    unsigned running_ = 0;
+    bool stop_ = false;
+};
+
+#endif //JOBSYSTEM_H
@@ -0,0 +1,140 @@
+#include "MeshBuffer.h"
+#include <algorithm>
+
+void MeshBuffer::rebuild()
+{
+    if (isPointCloud()) {
+        NormalEngine::computePointCloudNormals(vertices, normals);
+    } else {
+        NormalEngine::computeFaceNormals(indices, vertices, normals);
+    }
+    corners_.build(indices, vertices.size());
+    recomputeBBox();
+
+    dirtyVertices_.clear();
+    isDirty_.assign(vertices.size(), 0);
+    isFaceDirty_.assign(indices.size() / 3, 0);
+
+    upload_ = DirtyRanges();
+    if (!vertices.empty()) upload_.vertices.push_back(Range{0, (uint32_t) vertices.size()});
+    if (!indices.empty()) upload_.faces.push_back(Range{0, (uint32_t) (indices.size() / 3)});
+}
+
+void MeshBuffer::setVertex(uint32_t v, const Point3D &p)
+{
+    const Point3D &old = vertices[v];
+    // A vertex leaving the bbox border may shrink it, that can only be found by a rescan.
+    for (int k = 0; k < 3; ++k) {
+        if (old[k] == bbMin[k] || old[k] == bbMax[k]) {
+            bboxStale_ = true;
+        }
+    }
+
+    vertices[v] = p;
+    if (!isDirty_[v]) {
+        isDirty_[v] = 1;
+        dirtyVertices_.push_back(v);
+    }
+}
+
+void MeshBuffer::translate(const Point3D &vec)
+{
+    for (auto &v : vertices) {
+        v += vec;
+    }
+    bbMin += vec;
+    bbMax += vec;
+
+    if (!vertices.empty()) upload_.vertices.assign(1, Range{0, (uint32_t) vertices.size()});
+}
+
+size_t MeshBuffer::update()
+{
+    if (dirtyVertices_.empty()) return 0;
+
+    std::vector<uint32_t> faces;
+    for (uint32_t v : dirtyVertices_) {
+        for (uint32_t c = corners_.offsets[v]; c < corners_.offsets[v+1]; ++c) {
+            uint32_t f = corners_.corners[c] / 3;
+            if (!isFaceDirty_[f]) {
+                isFaceDirty_[f] = 1;
+                faces.push_back(f);
+            }
+        }
+    }
+
+    int faceNb = (int) faces.size();
+#pragma omp parallel for schedule(static) if(faceNb > 4096)
+    for (int i = 0; i < faceNb; ++i) {
+        uint32_t f = faces[i];
+        const Point3D &v1 = vertices[indices[f*3]];
+        const Point3D &v2 = vertices[indices[f*3+1]];
+        const Point3D &v3 = vertices[indices[f*3+2]];
+        Point3D n = (v2-v1)^(v3-v1);
+        n.Normalize();
+        normals[f] = n;
+    }
+
+    for (uint32_t f : faces) {
+        isFaceDirty_[f] = 0;
+    }
+    std::sort(faces.begin(), faces.end());
+    markUpload(upload_.faces, faces);
+
+    if (bboxStale_) {
+        recomputeBBox();
+    } else {
+        for (uint32_t v : dirtyVertices_) {
+            for (int k = 0; k < 3; ++k) {
+                bbMin[k] = std::min(bbMin[k], vertices[v][k]);
+                bbMax[k] = std::max(bbMax[k], vertices[v][k]);
+            }
+        }
+    }
+
+    for (uint32_t v : dirtyVertices_) {
+        isDirty_[v] = 0;
+    }
+    std::sort(dirtyVertices_.begin(), dirtyVertices_.end());
+    markUpload(upload_.vertices, dirtyVertices_);
+    dirtyVertices_.clear();
+
+    return faces.size();
+}
+
+void MeshBuffer::recomputeBBox()
+{
+    bboxStale_ = false;
+    if (vertices.empty()) {
+        bbMin = bbMax = Point3D(0, 0, 0);
+        return;
+    }
+
+    bbMin = bbMax = vertices[0];
+    for (const auto &p : vertices) {
+        for (int k = 0; k < 3; ++k) {
+            bbMin[k] = std::min(bbMin[k], p[k]);
+            bbMax[k] = std::max(bbMax[k], p[k]);
+        }
+    }
+}
+
+void MeshBuffer::markUpload(std::vector<Range> &ranges, const std::vector<uint32_t> &items) const
+{
+    std::vector<Range> added;
+    for (uint32_t i : items) {
+        if (!added.empty() && i - added.back().end <= mergeGap) added.back().end = i + 1;
+        else added.push_back(Range{i, i + 1});
+    }
+
+    // merge with the ranges already pending, both sorted
+    std::vector<Range> merged;
+    merged.reserve(ranges.size() + added.size());
+    auto a = ranges.begin(), b = added.begin();
+    while (a != ranges.end() || b != added.end()) {
+        const Range &r = (b == added.end() || (a != ranges.end() && a->begin < b->begin)) ? *a++ : *b++;
+        if (!merged.empty() && r.begin <= merged.back().end + mergeGap) merged.back().end = std::max(merged.back().end, r.end);
+        else merged.push_back(r);
+    }
+    ranges.swap(merged);
+}
@@ -0,0 +1,77 @@
+#ifndef MESHBUFFER_H
+#define MESHBUFFER_H
+
+#include <vector>
+#include <cstdint>
+#include "Point3D.h"
+#include "Point3D.inl.h"
+#include "VCGLib_Helper/NormalEngine.h"
+
+// Flat triangle buffers drawn by the viewer (one normal per face), with dirty-region tracking.
+// Edits go through setVertex()/translate(); update() then refreshes only the face normals of the
+// 1-ring of the modified vertices and the bounding box, and accumulates the index ranges that a
+// GPU copy of the buffers would have to re-upload: sorted disjoint ranges, those at most mergeGap
+// elements apart merged into one. rebuild() is the full from-scratch path and must run once before
+// any edit.
+// A buffer without faces is a point cloud: normals then holds one estimated normal per vertex, computed
+// by rebuild() only (edits do not re-estimate them).
+class MeshBuffer
+{
+public:
+    // Half-open [begin, end).
+    struct Range
+    {
+        uint32_t begin, end;
+    };
+
+    // Sorted by begin, disjoint and not empty.
+    struct DirtyRanges
+    {
+        std::vector<Range> vertices;
+        std::vector<Range> faces;
+
+        bool empty() const { return vertices.empty() && faces.empty(); }
+    };
+
+    std::vector<uint32_t> indices;
+    std::vector<Point3D> vertices;
+    std::vector<Point3D> normals;
+
+    bool isPointCloud() const { return indices.empty() && !vertices.empty(); }
+
+    Point3D bbMin, bbMax;
+
+    // Dirty ranges at most this many vertices or faces apart are uploaded as one.
+    uint32_t mergeGap = 64;
+
+    // Recomputes normals, bbox and adjacency for the whole mesh. Call after replacing the buffers.
+    void rebuild();
+
+    void setVertex(uint32_t v, const Point3D &p);
+
+    // Moves the whole mesh. Face normals are translation invariant, only the bbox is shifted.
+    void translate(const Point3D &vec);
+
+    // Applies the pending edits. Returns the number of faces whose normal was recomputed.
+    size_t update();
+
+    // Ranges modified since the last clearUploadRanges(), to feed glBufferSubData.
+    const DirtyRanges &uploadRanges() const { return upload_; }
+    void clearUploadRanges() { upload_ = DirtyRanges(); }
+
+private:
+    void recomputeBBox();
+    // Adds the ranges of the sorted items to ranges.
+    void markUpload(std::vector<Range> &ranges, const std::vector<uint32_t> &items) const;
+
+    NormalEngine::VertexCorners corners_;
+
+    std::vector<uint32_t> dirtyVertices_;
+    std::vector<char> isDirty_;
+    std::vector<char> isFaceDirty_;
+    bool bboxStale_ = false;
+
+    DirtyRanges upload_;
+};
+
+#endif //MESHBUFFER_H
@@ -0,0 +1,159 @@
+#include "MeshClusters.h"
+#include <algorithm>
+#include <cmath>
+#include <vcg/space/index/aabb_binary_tree/frustum_cull.h>
+
+namespace
+{
+    inline vcg::Point3f toVcg(const Point3D &p)
+    {
+        return vcg::Point3f(p.x, p.y, p.z);
+    }
+}
+
+void ViewFrustum::set(const vcg::Matrix44f &projection, const vcg::Matrix44f &modelview)
+{
+    // Gribb-Hartmann: in clip space -w <= x,y,z <= w, i.e. row3 +- row0/1/2 >= 0.
+    vcg::Matrix44f m = projection * modelview;
+    for (int i = 0; i < 6; ++i) {
+        int row = i / 2;
+        float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+        vcg::Point3f n(m.ElementAt(3, 0) + sign * m.ElementAt(row, 0),
+                       m.ElementAt(3, 1) + sign * m.ElementAt(row, 1),
+                       m.ElementAt(3, 2) + sign * m.ElementAt(row, 2));
+        float d = m.ElementAt(3, 3) + sign * m.ElementAt(row, 3);
+        planes[i].Set(n, -d);
+    }
+
+    // The modelview is rigid: the eye is -R^T t.
+    for (int k = 0; k < 3; ++k) {
+        eye[k] = -(modelview.ElementAt(0, k) * modelview.ElementAt(0, 3) +
+                   modelview.ElementAt(1, k) * modelview.ElementAt(1, 3) +
+                   modelview.ElementAt(2, k) * modelview.ElementAt(2, 3));
+    }
+}
+
+void MeshClusters::build(const MeshBuffer &mesh, unsigned int targetFaceNb)
+{
+    faces.clear();
+    clusters.clear();
+    tree_.Clear();
+
+    uint32_t faceNb = (uint32_t) (mesh.indices.size() / 3);
+    faceIds_.resize(faceNb);
+    for (uint32_t f = 0; f < faceNb; ++f) {
+        faceIds_[f] = f;
+    }
+    if (faceNb == 0) return;
+
+    auto ptrFunctor = [](uint32_t &f) { return &f; };
+    auto boxFunctor = [&](const uint32_t &f, vcg::Box3f &box) {
+        box.Set(toVcg(mesh.vertices[mesh.indices[f*3]]));
+        box.Add(toVcg(mesh.vertices[mesh.indices[f*3+1]]));
+        box.Add(toVcg(mesh.vertices[mesh.indices[f*3+2]]));
+    };
+    auto baryFunctor = [&](const uint32_t &f, vcg::Point3f &bc) {
+        bc = (toVcg(mesh.vertices[mesh.indices[f*3]]) +
+              toVcg(mesh.vertices[mesh.indices[f*3+1]]) +
+              toVcg(mesh.vertices[mesh.indices[f*3+2]])) / 3.0f;
+    };
+    tree_.Set(faceIds_.begin(), faceIds_.end(), ptrFunctor, boxFunctor, baryFunctor, std::max(1u, targetFaceNb));
+
+    faces.resize(faceNb);
+    for (uint32_t k = 0; k < faceNb; ++k) {
+        faces[k] = *tree_.pObjects[k];
+    }
+
+    numberLeaves(tree_.pRoot, mesh);
+    vcg::AABBBinaryTreeFrustumCull<TreeType>::Initialize(tree_);
+}
+
+void MeshClusters::numberLeaves(TreeType::NodeType *node, const MeshBuffer &mesh)
+{
+    node->auxData.begin = (uint32_t) clusters.size();
+    if (!node->IsLeaf()) {
+        for (int c = 0; c < 2; ++c) {
+            if (node->children[c] != 0) numberLeaves(node->children[c], mesh);
+        }
+        node->auxData.end = (uint32_t) clusters.size();
+        return;
+    }
+
+    Cluster cl;
+    cl.faceBegin = (uint32_t) (node->oBegin - tree_.pObjects.begin());
+    cl.faceEnd = (uint32_t) (node->oEnd - tree_.pObjects.begin());
+
+    // Bounding sphere around the box center, tighter than the box half diagonal.
+    cl.center = node->boxCenter;
+    float radius2 = 0;
+    vcg::Point3f axis(0, 0, 0);
+    for (uint32_t k = cl.faceBegin; k < cl.faceEnd; ++k) {
+        uint32_t f = faces[k];
+        for (int j = 0; j < 3; ++j) {
+            radius2 = std::max(radius2, (toVcg(mesh.vertices[mesh.indices[f*3+j]]) - cl.center).SquaredNorm());
+        }
+        axis += toVcg(mesh.normals[f]);
+    }
+    cl.radius = std::sqrt(radius2);
+
+    // Normal cone around the mean normal. A degenerate face (null normal) or a half angle of 90
+    // degrees or more makes the cone useless.
+    cl.coneAxis = vcg::Point3f(0, 0, 0);
+    cl.coneSin = 1;
+    float axisNorm = axis.Norm();
+    if (axisNorm > 0) {
+        axis /= axisNorm;
+        float minCos = 1;
+        for (uint32_t k = cl.faceBegin; k < cl.faceEnd; ++k) {
+            vcg::Point3f n = toVcg(mesh.normals[faces[k]]);
+            float len = n.Norm();
+            minCos = (len > 0.5f) ? std::min(minCos, (n * axis) / len) : -1.0f;
+            if (minCos <= 0) break;
+        }
+        if (minCos > 0) {
+            cl.coneAxis = axis;
+            cl.coneSin = std::sqrt(std::max(0.0f, 1.0f - minCos * minCos));
+        }
+    }
+
+    clusters.push_back(cl);
+    node->auxData.end = (uint32_t) clusters.size();
+}
+
+void MeshClusters::cull(const ViewFrustum &frustum, bool backfaceCulling, std::vector<Range> &ranges, Stats *stats)
+{
+    ranges.clear();
+    Stats st;
+    st.clusterNb = clusters.size();
+
+    size_t inFrustum = 0;
+    auto apply = [&](TreeType::NodeType &node) {
+        for (uint32_t c = node.auxData.begin; c < node.auxData.end; ++c) {
+            const Cluster &cl = clusters[c];
+            ++inFrustum;
+
+            // Every face of the cluster faces away from every point of its bounding sphere when the
+            // view direction to the sphere stays inside the cone rotated by 90 degrees.
+            if (backfaceCulling && cl.coneSin < 1) {
+                vcg::Point3f d = cl.center - frustum.eye;
+                if (cl.coneAxis * d >= cl.coneSin * d.Norm() + cl.radius * (1 + cl.coneSin)) {
+                    ++st.backfaceCulled;
+                    continue;
+                }
+            }
+
+            ++st.drawnClusters;
+            st.drawnFaces += cl.faceEnd - cl.faceBegin;
+            // The traversal is front to back: merge only what already follows, keeping that order.
+            if (!ranges.empty() && ranges.back().faceEnd == cl.faceBegin) {
+                ranges.back().faceEnd = cl.faceEnd;
+            } else {
+                ranges.push_back(Range{cl.faceBegin, cl.faceEnd});
+            }
+        }
+    };
+    vcg::AABBBinaryTreeFrustumCull<TreeType>::FrustumCull(tree_, frustum.eye, frustum.planes, 0, apply);
+
+    st.frustumCulled = st.clusterNb - inFrustum;
+    if (stats) *stats = st;
+}
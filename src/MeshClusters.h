@@ -0,0 +1,79 @@
+#ifndef MESHCLUSTERS_H
+#define MESHCLUSTERS_H
+
+#include <vector>
+#include <cstdint>
+#include <vcg/math/matrix44.h>
+#include <vcg/space/plane3.h>
+#include <vcg/space/index/aabb_binary_tree/base.h>
+#include "MeshBuffer.h"
+
+// View frustum in world space, extracted from the GL projection and modelview matrices
+// (vcg row major layout, i.e. the transpose of what glGetFloatv returns).
+struct ViewFrustum
+{
+    vcg::Plane3f planes[6];  // inward normals: a point p is inside when Direction()*p >= Offset() for all of them
+    vcg::Point3f eye;
+
+    void set(const vcg::Matrix44f &projection, const vcg::Matrix44f &modelview);
+};
+
+// Meshlets of a MeshBuffer: its faces are split by an AABB tree into spatially coherent clusters of
+// about targetFaceNb triangles, each with a bounding sphere and a cone bounding its face normals.
+// cull() walks the tree with vcg::AABBBinaryTreeFrustumCull, drops the clusters whose faces are all
+// back facing, and returns the survivors as ranges of faces[] (consecutive clusters are merged).
+// The bounds refer to the positions at build() time: build again after moving the vertices.
+class MeshClusters
+{
+public:
+    struct Cluster
+    {
+        uint32_t faceBegin, faceEnd;   // range in faces
+        vcg::Point3f center;
+        float radius;
+        vcg::Point3f coneAxis;
+        float coneSin;                 // sine of the cone half angle, >= 1 when the cone can not cull
+    };
+
+    struct Range
+    {
+        uint32_t faceBegin, faceEnd;
+    };
+
+    struct Stats
+    {
+        size_t clusterNb = 0;
+        size_t frustumCulled = 0;
+        size_t backfaceCulled = 0;
+        size_t drawnClusters = 0;
+        size_t drawnFaces = 0;
+    };
+
+    std::vector<uint32_t> faces;      // face indices grouped by cluster
+    std::vector<Cluster> clusters;
+
+    MeshClusters() = default;
+    MeshClusters(const MeshClusters &) = delete;
+    MeshClusters &operator=(const MeshClusters &) = delete;
+
+    bool empty() const { return clusters.empty(); }
+
+    void build(const MeshBuffer &mesh, unsigned int targetFaceNb = 128);
+
+    void cull(const ViewFrustum &frustum, bool backfaceCulling, std::vector<Range> &ranges, Stats *stats = nullptr);
+
+private:
+    // Clusters below a tree node: they are contiguous because the leaves are numbered depth first.
+    struct NodeClusters
+    {
+        uint32_t begin, end;
+    };
+    typedef vcg::AABBBinaryTree<uint32_t, float, NodeClusters> TreeType;
+
+    void numberLeaves(TreeType::NodeType *node, const MeshBuffer &mesh);
+
+    std::vector<uint32_t> faceIds_;   // objects of the tree, which keeps pointers to them
+    TreeType tree_;
+};
+
+#endif //MESHCLUSTERS_H
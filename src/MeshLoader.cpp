@@ -0,0 +1,82 @@
+#include "MeshLoader.h"
+#include <sstream>
+#include "ObjIO.h"
+#include "VCGLib_Helper/LODMaker.h"
+
+MeshLoader::~MeshLoader()
+{
+    jobs_.stop();
+    for (std::atomic<Snapshot *> &slot : slots_) {
+        delete slot.exchange(nullptr);
+    }
+}
+
+double MeshLoader::elapsed() const
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_).count();
+}
+
+void MeshLoader::publish(int slot, Snapshot *snapshot)
+{
+    snapshot->millis = elapsed();
+    // the replaced snapshot was never seen by the render thread
+    delete slots_[slot].exchange(snapshot, std::memory_order_acq_rel);
+}
+
+std::unique_ptr<MeshLoader::Snapshot> MeshLoader::take(int slot)
+{
+    return std::unique_ptr<Snapshot>(slots_[slot].exchange(nullptr, std::memory_order_acq_rel));
+}
+
+void MeshLoader::start(const std::string &path, const Point3D offsets[2], int proxyCells)
+{
+    start_ = std::chrono::high_resolution_clock::now();
+    offsets_[0] = offsets[0];
+    offsets_[1] = offsets[1];
+
+    jobs_.submit([this, path, proxyCells] {
+        std::shared_ptr<MeshBuffer> mesh = std::make_shared<MeshBuffer>();
+        ObjIO::readObj(path.c_str(), mesh->indices, mesh->vertices);
+        if (mesh->vertices.empty()) return;
+        bool pointCloud = mesh->isPointCloud();
+
+        std::shared_ptr<CMeshO> cmesh = std::make_shared<CMeshO>(
+                VCG_CMesh0_Helper::constructCMesh(mesh->indices, mesh->vertices, std::vector<Point3D>()));
+        CMeshO proxy;
+        LODMaker::clusterMesh(*cmesh, proxyCells, proxy);
+        for (int slot = 0; slot < (pointCloud ? 1 : 2); ++slot) {
+            Snapshot *s = new Snapshot;
+            VCG_CMesh0_Helper::retrieveCMeshData(proxy, s->mesh.indices, s->mesh.vertices, s->mesh.normals);
+            s->mesh.rebuild();
+            s->mesh.translate(offsets_[slot]);
+            publish(slot, s);
+        }
+
+        jobs_.submit([this, mesh] {
+            Snapshot *s = new Snapshot;
+            s->level = Final;
+            s->mesh = std::move(*mesh);
+            s->mesh.rebuild();
+            s->mesh.translate(offsets_[0]);
+            if (s->mesh.isPointCloud()) {
+                s->points.reset(new PointLOD);
+                s->points->build(s->mesh);
+            }
+            s->clusters.reset(new MeshClusters);
+            s->clusters->build(s->mesh);
+            publish(0, s);
+        });
+        if (pointCloud) return;
+        jobs_.submit([this, cmesh] {
+            LODMaker::repairAndPrepareForDecimation(*cmesh);
+            Snapshot *s = new Snapshot;
+            s->level = Final;
+            VCG_CMesh0_Helper::retrieveCMeshData(*cmesh, s->mesh.indices, s->mesh.vertices, s->mesh.normals);
+            s->mesh.rebuild();
+            s->mesh.translate(offsets_[1]);
+            s->clusters.reset(new MeshClusters);
+            s->clusters->build(s->mesh);
+            publish(1, s);
+        });
+    });
+}
@@ -0,0 +1,60 @@
+#ifndef MESHLOADER_H
+#define MESHLOADER_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include "MeshBuffer.h"
+#include "MeshClusters.h"
+#include "PointLOD.h"
+#include "JobSystem.h"
+
+// Loads the viewer meshes on a JobSystem instead of the render thread. The scene has two slots:
+// slot 0 is the mesh of the file, slot 1 its repaired copy (LODMaker::repairAndPrepareForDecimation),
+// empty for a point cloud. Each slot first gets a Proxy snapshot, a vertex clustering of the file
+// shown as soon as it is parsed, then the Final one, with its normals and MeshClusters; the Final point
+// cloud comes reordered by its PointLOD.
+// The jobs: parse + proxy, then in parallel the full mesh of slot 0 and the repair of slot 1.
+// Snapshots are handed over through one atomic pointer per slot: publishing replaces a snapshot the
+// render thread did not take yet, take() never blocks, and a slot never goes back to the proxy.
+class MeshLoader
+{
+public:
+    enum Level { Proxy, Final };
+
+    // Immutable once published; the render thread owns it after take().
+    struct Snapshot
+    {
+        Level level = Proxy;
+        MeshBuffer mesh;
+        std::unique_ptr<MeshClusters> clusters;   // Final only
+        std::unique_ptr<PointLOD> points;         // Final point clouds only
+        double millis = 0;                        // since start()
+    };
+
+    MeshLoader() = default;
+    ~MeshLoader();
+    MeshLoader(const MeshLoader &) = delete;
+    MeshLoader &operator=(const MeshLoader &) = delete;
+
+    // offsets: translation of the mesh of each slot. proxyCells: size of the clustering grid.
+    void start(const std::string &path, const Point3D offsets[2], int proxyCells = 20000);
+
+    // The latest snapshot published for the slot since the last take(), if any.
+    std::unique_ptr<Snapshot> take(int slot);
+
+    bool busy() { return jobs_.busy(); }
+    void wait() { jobs_.wait(); }
+
+private:
+    void publish(int slot, Snapshot *snapshot);
+    double elapsed() const;
+
+    JobSystem jobs_{2};
+    std::atomic<Snapshot *> slots_[2] = {{nullptr}, {nullptr}};
+    std::chrono::high_resolution_clock::time_point start_;
+    Point3D offsets_[2];
+};
+
+#endif //MESHLOADER_H
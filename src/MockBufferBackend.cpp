@@ -0,0 +1,62 @@
+#include "MockBufferBackend.h"
+#include <algorithm>
+#include <cstring>
+
+unsigned int MockBufferBackend::create(size_t size, void **mapped)
+{
+    unsigned int buffer = nextBuffer_++;
+    std::vector<uint8_t> &memory = buffers_[buffer];
+    memory.assign(size, 0);
+    *mapped = memory.data();
+    bytes_ += size;
+    peakBytes_ = std::max(peakBytes_, bytes_);
+    return buffer;
+}
+
+void MockBufferBackend::destroy(unsigned int buffer)
+{
+    auto it = buffers_.find(buffer);
+    if (it == buffers_.end()) {
+        ++errors_;
+        return;
+    }
+    bytes_ -= it->second.size();
+    buffers_.erase(it);
+}
+
+void MockBufferBackend::copy(unsigned int src, size_t srcOffset, unsigned int dst, size_t dstOffset, size_t size)
+{
+    auto s = buffers_.find(src), d = buffers_.find(dst);
+    bool overlap = src == dst && srcOffset < dstOffset + size && dstOffset < srcOffset + size;
+    if (overlap || s == buffers_.end() || d == buffers_.end() || srcOffset + size > s->second.size() ||
+        dstOffset + size > d->second.size()) {
+        ++errors_;
+        return;
+    }
+    memcpy(d->second.data() + dstOffset, s->second.data() + srcOffset, size);
+    copiedBytes_ += size;
+}
+
+uint64_t MockBufferBackend::fence()
+{
+    fences_.insert(++issued_);
+    return issued_;
+}
+
+bool MockBufferBackend::signaled(uint64_t fence)
+{
+    if (!fences_.count(fence)) ++errors_;
+    return fence + lag_ <= issued_ || fence <= completed_;
+}
+
+void MockBufferBackend::wait(uint64_t fence)
+{
+    if (signaled(fence)) return;
+    ++waits_;
+    completed_ = fence;
+}
+
+void MockBufferBackend::release(uint64_t fence)
+{
+    if (!fences_.erase(fence)) ++errors_;
+}
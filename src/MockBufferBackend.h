@@ -0,0 +1,42 @@
+#ifndef MOCKBUFFERBACKEND_H
+#define MOCKBUFFERBACKEND_H
+
+#include <map>
+#include <set>
+#include "GpuBufferAllocator.h"
+
+// The suballocators without GL: buffers are plain memory, copies run at once, and a fence signals
+// once lag more fences were issued after it (the GPU lag frames behind), or when waited for. Counts
+// what the allocators asked for, and the misuses a driver would not report: out of range or
+// overlapping copies, unknown buffers and fences.
+class MockBufferBackend : public GpuBufferBackend
+{
+public:
+    explicit MockBufferBackend(int lag = 2) : lag_(lag) {}
+
+    unsigned int create(size_t size, void **mapped) override;
+    void destroy(unsigned int buffer) override;
+    void copy(unsigned int src, size_t srcOffset, unsigned int dst, size_t dstOffset, size_t size) override;
+    uint64_t fence() override;
+    bool signaled(uint64_t fence) override;
+    void wait(uint64_t fence) override;
+    void release(uint64_t fence) override;
+
+    size_t liveBuffers() const { return buffers_.size(); }
+    size_t liveFences() const { return fences_.size(); }
+    size_t bytes() const { return bytes_; }
+    size_t peakBytes() const { return peakBytes_; }
+    size_t copiedBytes() const { return copiedBytes_; }
+    size_t waits() const { return waits_; }
+    size_t errors() const { return errors_; }
+
+private:
+    int lag_;
+    std::map<unsigned int, std::vector<uint8_t> > buffers_;
+    unsigned int nextBuffer_ = 1;
+    std::set<uint64_t> fences_;
+    uint64_t issued_ = 0, completed_ = 0;
+    size_t bytes_ = 0, peakBytes_ = 0, copiedBytes_ = 0, waits_ = 0, errors_ = 0;
+};
+
+#endif //MOCKBUFFERBACKEND_H
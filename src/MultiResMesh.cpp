@@ -0,0 +1,278 @@
+#include "MultiResMesh.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <queue>
+#include "MeshClusters.h"
+
+int MultiResMesh::RamCache::get(PatchToken *token)
+{
+    if (!owner->read(token->node, token->bytes)) return -1;
+    return (int) token->bytes.size();
+}
+
+int MultiResMesh::RamCache::drop(PatchToken *token)
+{
+    int bytes = (int) token->bytes.size();
+    std::vector<char>().swap(token->bytes);
+    return bytes;
+}
+
+int MultiResMesh::RamCache::size(PatchToken *token)
+{
+    return (int) token->bytes.size();
+}
+
+int MultiResMesh::DrawCache::get(PatchToken *token)
+{
+    if (!decode(token->bytes, token->patch)) return -1;
+    return size(token);
+}
+
+int MultiResMesh::DrawCache::drop(PatchToken *token)
+{
+    int bytes = size(token);
+    token->patch = Patch();
+    return bytes;
+}
+
+int MultiResMesh::DrawCache::size(PatchToken *token)
+{
+    const Patch &p = token->patch;
+    return (int) ((p.vertices.size() + p.normals.size()) * sizeof(Point3D) + p.indices.size() * sizeof(uint32_t));
+}
+
+MultiResMesh::MultiResMesh()
+{
+    ramCache_.owner = this;
+    controller_.addCache(&ramCache_);
+    controller_.addCache(&drawCache_);
+}
+
+MultiResMesh::~MultiResMesh()
+{
+    close();
+}
+
+bool MultiResMesh::decode(const std::vector<char> &bytes, Patch &patch)
+{
+    uint32_t counts[2];
+    if (bytes.size() < sizeof(counts)) return false;
+    std::memcpy(counts, bytes.data(), sizeof(counts));
+    size_t floatNb = (size_t(counts[0]) + counts[1]) * 3;
+    if (bytes.size() != sizeof(counts) + floatNb * sizeof(float) + size_t(counts[1]) * 3 * sizeof(uint32_t)) return false;
+
+    const char *p = bytes.data() + sizeof(counts);
+    std::vector<float> floats(floatNb);
+    std::memcpy(floats.data(), p, floatNb * sizeof(float));
+    p += floatNb * sizeof(float);
+
+    patch.vertices.resize(counts[0]);
+    patch.normals.resize(counts[1]);
+    for (uint32_t v = 0; v < counts[0]; ++v) {
+        patch.vertices[v] = Point3D(floats[v*3], floats[v*3+1], floats[v*3+2]);
+    }
+    const float *n = floats.data() + size_t(counts[0]) * 3;
+    for (uint32_t f = 0; f < counts[1]; ++f) {
+        patch.normals[f] = Point3D(n[f*3], n[f*3+1], n[f*3+2]);
+    }
+    patch.indices.resize(size_t(counts[1]) * 3);
+    std::memcpy(patch.indices.data(), p, patch.indices.size() * sizeof(uint32_t));
+    for (uint32_t i : patch.indices) {
+        if (i >= counts[0]) return false;
+    }
+    return true;
+}
+
+// Only called by open() and then by the RAM cache thread.
+bool MultiResMesh::read(uint32_t node, std::vector<char> &bytes)
+{
+    const MultiResNode &n = nodes_[node];
+    bytes.resize(n.size);
+    return fseek(file_, (long) n.offset, SEEK_SET) == 0 && fread(bytes.data(), 1, n.size, file_) == n.size;
+}
+
+bool MultiResMesh::open(const std::string &path, uint64_t ramBytes, uint64_t drawBytes)
+{
+    close();
+    file_ = fopen(path.c_str(), "rb");
+    if (!file_) return false;
+
+    MultiResHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file_) == 1 && header.magic == MultiResBuilder::Magic && header.nodeNb > 0;
+    if (ok) {
+        nodes_.resize(header.nodeNb);
+        ok = fread(nodes_.data(), sizeof(MultiResNode), nodes_.size(), file_) == nodes_.size();
+    }
+    for (size_t i = 0; ok && i < nodes_.size(); ++i) {
+        for (int c : nodes_[i].children) {
+            ok = ok && c < (int) nodes_.size() && (c < 0) == (nodes_[i].children[0] < 0);
+        }
+    }
+    std::vector<char> bytes;
+    ok = ok && read(0, bytes) && decode(bytes, root_);
+    if (!ok) {
+        fclose(file_);
+        file_ = nullptr;
+        nodes_.clear();
+        return false;
+    }
+
+    tokens_.reset(new PatchToken[nodes_.size()]);
+    for (uint32_t i = 1; i < nodes_.size(); ++i) {
+        tokens_[i].node = i;
+        tokens_[i].setPriority(0);
+        controller_.addToken(&tokens_[i]);
+    }
+    ramCache_.setCapacity(ramBytes);
+    drawCache_.setCapacity(drawBytes);
+    controller_.updatePriorities();
+    controller_.start();
+    return true;
+}
+
+void MultiResMesh::close()
+{
+    if (!file_) return;
+    for (PatchToken *token : locked_) {
+        token->unlock();
+    }
+    locked_.clear();
+    cut_.clear();
+    controller_.finish();
+    tokens_.reset();
+    nodes_.clear();
+    root_ = Patch();
+    fclose(file_);
+    file_ = nullptr;
+}
+
+vcg::Point3f MultiResMesh::center() const
+{
+    return nodes_.empty() ? vcg::Point3f(0, 0, 0) : vcg::Point3f(nodes_[0].center[0], nodes_[0].center[1], nodes_[0].center[2]);
+}
+
+float MultiResMesh::radius() const
+{
+    return nodes_.empty() ? 0 : nodes_[0].radius;
+}
+
+bool MultiResMesh::newData()
+{
+    return isOpen() && controller_.newData();
+}
+
+void MultiResMesh::update(const vcg::Matrix44f &projection, const vcg::Matrix44f &modelview, int viewportHeight, Stats *stats)
+{
+    for (PatchToken *token : locked_) {
+        token->unlock();
+    }
+    locked_.clear();
+    cut_.clear();
+    if (!isOpen()) return;
+
+    Stats st;
+    ViewFrustum frustum;
+    frustum.set(projection, modelview);
+    // object space error at distance d -> pixels: error * pixelsPerUnit / d
+    float pixelsPerUnit = viewportHeight * projection.ElementAt(1, 1) / 2;
+
+    auto isCulled = [&](const MultiResNode &n) {
+        vcg::Point3f c(n.center[0], n.center[1], n.center[2]);
+        for (const vcg::Plane3f &p : frustum.planes) {
+            if (p.Direction() * c - p.Offset() < -n.radius) return true;
+        }
+        return false;
+    };
+    auto projectedError = [&](const MultiResNode &n) {
+        if (n.error == 0) return 0.0f;
+        vcg::Point3f c(n.center[0], n.center[1], n.center[2]);
+        float d = (c - frustum.eye).Norm() - n.radius;
+        return d > 0 ? n.error * pixelsPerUnit / d : std::numeric_limits<float>::infinity();
+    };
+
+    for (uint32_t i = 1; i < nodes_.size(); ++i) {
+        tokens_[i].setPriority(0);
+    }
+
+    // Greedy refinement, largest projected error first. The nodes left in the queue are the cut.
+    typedef std::pair<float, uint32_t> Entry;
+    std::priority_queue<Entry> queue;
+    std::vector<uint32_t> cutNodes;
+    // The cut holds at most half of the draw cache: the other half keeps the patches of the next
+    // refinements coming, otherwise a cache full of locked patches would stall the refinement.
+    uint64_t lockedBytes = 0, maxLockedBytes = drawCache_.capacity() / 2;
+    if (isCulled(nodes_[0])) {
+        ++st.culled;
+    } else {
+        queue.push(Entry(projectedError(nodes_[0]), 0));
+        st.drawnFaces = nodes_[0].faceNb;
+    }
+    while (!queue.empty()) {
+        Entry e = queue.top();
+        const MultiResNode &n = nodes_[e.second];
+        if (n.children[0] < 0) {
+            queue.pop();
+            cutNodes.push_back(e.second);
+            continue;
+        }
+        // Whatever happens, the children are wanted as much as their parent: prefetched when the cut
+        // is already fine enough, loaded first when it is not.
+        for (int c : n.children) {
+            if (!isCulled(nodes_[c])) tokens_[c].setPriority(e.first);
+        }
+        if (e.first <= targetError) break;
+        queue.pop();
+
+        size_t faceNb = st.drawnFaces - n.faceNb;
+        uint64_t bytes = lockedBytes;
+        PatchToken *children[2] = {nullptr, nullptr};
+        bool available = true;
+        for (int k = 0; k < 2; ++k) {
+            const MultiResNode &c = nodes_[n.children[k]];
+            if (isCulled(c)) continue;
+            faceNb += c.faceNb;
+            bytes += c.size;
+            if (available && tokens_[n.children[k]].lock()) {
+                children[k] = &tokens_[n.children[k]];
+            } else {
+                available = false;
+            }
+        }
+        if (!available || faceNb > faceBudget || bytes > maxLockedBytes) {
+            for (PatchToken *t : children) {
+                if (t) t->unlock();
+            }
+            if (!available) ++st.missing;
+            else ++st.limited;
+            cutNodes.push_back(e.second);
+            continue;
+        }
+        st.drawnFaces = faceNb;
+        lockedBytes = bytes;
+        for (int k = 0; k < 2; ++k) {
+            if (children[k]) {
+                locked_.push_back(children[k]);
+                queue.push(Entry(projectedError(nodes_[n.children[k]]), n.children[k]));
+            } else {
+                ++st.culled;
+            }
+        }
+    }
+    for (; !queue.empty(); queue.pop()) {
+        cutNodes.push_back(queue.top().second);
+    }
+    controller_.updatePriorities();
+
+    for (uint32_t i : cutNodes) {
+        cut_.push_back(i == 0 ? &root_ : &tokens_[i].patch);
+        st.maxError = std::max(st.maxError, projectedError(nodes_[i]));
+    }
+    if (stats) {
+        st.cutNodes = cut_.size();
+        st.ramBytes = ramCache_.size();
+        st.drawBytes = drawCache_.size();
+        *stats = st;
+    }
+}
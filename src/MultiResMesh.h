@@ -0,0 +1,116 @@
+#ifndef MULTIRESMESH_H
+#define MULTIRESMESH_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdio>
+#include <cstdint>
+#include <vcg/math/matrix44.h>
+#include <wrap/gcache/controller.h>
+#include "Point3D.h"
+#include "Point3D.inl.h"
+#include "VCGLib_Helper/MultiResBuilder.h"
+
+// View dependent rendering of a multiresolution file written by MultiResBuilder.
+// Each frame update() cuts the hierarchy where the projected error of the patches drops below
+// targetError pixels, within faceBudget faces. The patches are fetched from the file by a
+// vcg::Controller with two caches running in their own threads: one holds the raw bytes read from
+// the disk (ramBytes), the one above it the decoded patches ready to draw (drawBytes). A node is
+// refined only once both of its children are decoded, meanwhile the parent is drawn and the children
+// are queued with the error of the parent as priority; so a frame never waits for the disk and the
+// memory stays within the two capacities whatever the size of the file. The cut itself may use at most
+// half of drawBytes, the rest is for the patches being fetched.
+// The root patch is decoded at open() and always available.
+class MultiResMesh
+{
+public:
+    struct Patch
+    {
+        std::vector<Point3D> vertices;
+        std::vector<Point3D> normals;    // per face
+        std::vector<uint32_t> indices;
+    };
+
+    struct Stats
+    {
+        size_t cutNodes = 0;
+        size_t drawnFaces = 0;
+        size_t missing = 0;     // refinements waiting for their patches
+        size_t limited = 0;     // refinements refused by faceBudget or by the draw cache capacity
+        size_t culled = 0;      // nodes out of the frustum
+        uint64_t ramBytes = 0, drawBytes = 0;
+        float maxError = 0;     // largest projected error in the cut, in pixels (inf when the eye is inside)
+    };
+
+    float targetError = 2.0f;       // pixels
+    size_t faceBudget = 2000000;
+
+    MultiResMesh();
+    ~MultiResMesh();
+    MultiResMesh(const MultiResMesh &) = delete;
+    MultiResMesh &operator=(const MultiResMesh &) = delete;
+
+    // Returns false when the file can not be read.
+    bool open(const std::string &path, uint64_t ramBytes = 256u << 20, uint64_t drawBytes = 64u << 20);
+    void close();
+    bool isOpen() const { return file_ != nullptr; }
+
+    // Bounding sphere of the whole mesh.
+    vcg::Point3f center() const;
+    float radius() const;
+
+    // Chooses the cut for a camera and reprioritizes the fetching. The patches of the cut stay locked
+    // in the cache until the next update().
+    void update(const vcg::Matrix44f &projection, const vcg::Matrix44f &modelview, int viewportHeight, Stats *stats = nullptr);
+    const std::vector<const Patch *> &cut() const { return cut_; }
+
+    // True when patches were loaded or dropped since the last call: a new update() may refine further.
+    bool newData();
+
+private:
+    struct PatchToken : public vcg::Token<float>
+    {
+        uint32_t node = 0;
+        std::vector<char> bytes;    // in the RAM cache
+        Patch patch;                // in the draw cache
+    };
+
+    class RamCache : public vcg::Cache<PatchToken>
+    {
+    public:
+        using vcg::Cache<PatchToken>::size;
+        MultiResMesh *owner = nullptr;
+    protected:
+        int get(PatchToken *token);
+        int drop(PatchToken *token);
+        int size(PatchToken *token);
+    };
+
+    class DrawCache : public vcg::Cache<PatchToken>
+    {
+    public:
+        using vcg::Cache<PatchToken>::size;
+    protected:
+        int get(PatchToken *token);
+        int drop(PatchToken *token);
+        int size(PatchToken *token);
+    };
+
+    static bool decode(const std::vector<char> &bytes, Patch &patch);
+    bool read(uint32_t node, std::vector<char> &bytes);
+
+    FILE *file_ = nullptr;
+    std::vector<MultiResNode> nodes_;
+    std::unique_ptr<PatchToken[]> tokens_;    // one per node, their addresses are kept by the caches
+    Patch root_;
+
+    RamCache ramCache_;
+    DrawCache drawCache_;
+    vcg::Controller<PatchToken> controller_;
+
+    std::vector<PatchToken *> locked_;
+    std::vector<const Patch *> cut_;
+};
+
+#endif //MULTIRESMESH_H
@@ -0,0 +1,192 @@
+#include "OffscreenContext.h"
+#include <cstdio>
+#include <cstring>
+#include <GL/freeglut.h>
+
+#ifdef VIEWER_EGL
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#ifndef GL_FRAMEBUFFER
+#define GL_FRAMEBUFFER 0x8d40
+#define GL_RENDERBUFFER 0x8d41
+#define GL_COLOR_ATTACHMENT0 0x8ce0
+#define GL_DEPTH_ATTACHMENT 0x8d00
+#define GL_FRAMEBUFFER_COMPLETE 0x8cd5
+#endif
+#ifndef GL_DEPTH_COMPONENT24
+#define GL_DEPTH_COMPONENT24 0x81a6
+#endif
+
+namespace
+{
+    typedef void (*GenProc)(GLsizei n, GLuint *ids);
+    typedef void (*BindProc)(GLenum target, GLuint id);
+    typedef void (*RenderbufferStorageProc)(GLenum target, GLenum format, GLsizei width, GLsizei height);
+    typedef void (*FramebufferRenderbufferProc)(GLenum target, GLenum attachment, GLenum rbTarget, GLuint rb);
+    typedef GLenum (*CheckFramebufferStatusProc)(GLenum target);
+    typedef void (*DeleteProc)(GLsizei n, const GLuint *ids);
+
+    template <class PROC>
+    bool load(PROC &proc, const char *name)
+    {
+        proc = (PROC) eglGetProcAddress(name);
+        return proc != nullptr;
+    }
+}
+
+bool OffscreenContext::create(int width, int height)
+{
+    destroy();
+    width_ = width;
+    height_ = height;
+
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay) {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        error_ = "no EGL display";
+        return false;
+    }
+    display_ = display;
+
+    // no surface type asked (the default is a window): the framebuffer object is the only render target
+    const EGLint configAttribs[] = {EGL_SURFACE_TYPE, 0, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLConfig config;
+    EGLint configNb = 0;
+    if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(display, configAttribs, &config, 1, &configNb) || configNb == 0) {
+        error_ = "no desktop GL config";
+        destroy();
+        return false;
+    }
+    // no version asked: a compatibility context, the viewer draws in immediate mode
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, nullptr);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        error_ = "can not create a surfaceless GL context";
+        if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+        destroy();
+        return false;
+    }
+    context_ = context;
+
+    GenProc genFramebuffers, genRenderbuffers;
+    BindProc bindFramebuffer, bindRenderbuffer;
+    RenderbufferStorageProc renderbufferStorage;
+    FramebufferRenderbufferProc framebufferRenderbuffer;
+    CheckFramebufferStatusProc checkFramebufferStatus;
+    if (!load(genFramebuffers, "glGenFramebuffers") || !load(genRenderbuffers, "glGenRenderbuffers") ||
+        !load(bindFramebuffer, "glBindFramebuffer") || !load(bindRenderbuffer, "glBindRenderbuffer") ||
+        !load(renderbufferStorage, "glRenderbufferStorage") || !load(framebufferRenderbuffer, "glFramebufferRenderbuffer") ||
+        !load(checkFramebufferStatus, "glCheckFramebufferStatus")) {
+        error_ = "no framebuffer objects";
+        destroy();
+        return false;
+    }
+    genFramebuffers(1, &framebuffer_);
+    bindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    genRenderbuffers(2, renderbuffers_);
+    const GLenum formats[2] = {GL_RGBA8, GL_DEPTH_COMPONENT24};
+    const GLenum attachments[2] = {GL_COLOR_ATTACHMENT0, GL_DEPTH_ATTACHMENT};
+    for (int i = 0; i < 2; ++i) {
+        bindRenderbuffer(GL_RENDERBUFFER, renderbuffers_[i]);
+        renderbufferStorage(GL_RENDERBUFFER, formats[i], width, height);
+        framebufferRenderbuffer(GL_FRAMEBUFFER, attachments[i], GL_RENDERBUFFER, renderbuffers_[i]);
+    }
+    if (checkFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        error_ = "incomplete framebuffer";
+        destroy();
+        return false;
+    }
+    glViewport(0, 0, width, height);
+    return true;
+}
+
+void OffscreenContext::destroy()
+{
+    if (!display_) return;
+    if (context_) {
+        DeleteProc deleteFramebuffers, deleteRenderbuffers;
+        if (framebuffer_ && load(deleteFramebuffers, "glDeleteFramebuffers")) deleteFramebuffers(1, &framebuffer_);
+        if (renderbuffers_[0] && load(deleteRenderbuffers, "glDeleteRenderbuffers")) deleteRenderbuffers(2, renderbuffers_);
+        eglMakeCurrent((EGLDisplay) display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext((EGLDisplay) display_, (EGLContext) context_);
+    }
+    eglTerminate((EGLDisplay) display_);
+    display_ = context_ = nullptr;
+    framebuffer_ = renderbuffers_[0] = renderbuffers_[1] = 0;
+}
+
+std::string OffscreenContext::renderer() const
+{
+    const char *r = context_ ? (const char *) glGetString(GL_RENDERER) : nullptr;
+    return r ? r : "";
+}
+
+void OffscreenContext::readPixels(std::vector<uint8_t> &rgb) const
+{
+    rgb.resize(size_t(width_) * height_ * 3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width_, height_, GL_RGB, GL_UNSIGNED_BYTE, rgb.data());
+}
+
+void *OffscreenContext::procAddress(const char *name)
+{
+    if (eglGetCurrentContext() != EGL_NO_CONTEXT) return (void *) eglGetProcAddress(name);
+    return (void *) glutGetProcAddress(name);
+}
+
+#else
+
+bool OffscreenContext::create(int width, int height)
+{
+    width_ = width;
+    height_ = height;
+    error_ = "built without EGL";
+    return false;
+}
+
+void OffscreenContext::destroy()
+{
+}
+
+std::string OffscreenContext::renderer() const
+{
+    return "";
+}
+
+void OffscreenContext::readPixels(std::vector<uint8_t> &rgb) const
+{
+    rgb.assign(size_t(width_) * height_ * 3, 0);
+}
+
+void *OffscreenContext::procAddress(const char *name)
+{
+    return (void *) glutGetProcAddress(name);
+}
+
+#endif
+
+OffscreenContext::~OffscreenContext()
+{
+    destroy();
+}
+
+bool OffscreenContext::writePPM(const std::string &path) const
+{
+    std::vector<uint8_t> rgb;
+    readPixels(rgb);
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    fprintf(file, "P6\n%d %d\n255\n", width_, height_);
+    bool ok = true;
+    for (int y = height_ - 1; y >= 0 && ok; --y) {
+        ok = fwrite(rgb.data() + size_t(y) * width_ * 3, 1, size_t(width_) * 3, file) == size_t(width_) * 3;
+    }
+    return (fclose(file) == 0) && ok;
+}
@@ -0,0 +1,45 @@
+#ifndef OFFSCREENCONTEXT_H
+#define OFFSCREENCONTEXT_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// A GL compatibility context without window system: EGL on the Mesa surfaceless platform (llvmpipe
+// when there is no GPU), rendering into a framebuffer object of width x height with a depth buffer.
+// Built only where CMake finds EGL (VIEWER_EGL); create() fails otherwise.
+class OffscreenContext
+{
+public:
+    OffscreenContext() = default;
+    ~OffscreenContext();
+    OffscreenContext(const OffscreenContext &) = delete;
+    OffscreenContext &operator=(const OffscreenContext &) = delete;
+
+    // Makes the context current with the framebuffer bound. Returns false with error() set on failure.
+    bool create(int width, int height);
+    void destroy();
+    const std::string &error() const { return error_; }
+
+    // GL_RENDERER of the context.
+    std::string renderer() const;
+
+    // The framebuffer, rows bottom to top, 3 bytes per pixel.
+    void readPixels(std::vector<uint8_t> &rgb) const;
+    // Binary PPM, rows top to bottom.
+    bool writePPM(const std::string &path) const;
+
+    // A GL entry point of the current context, offscreen or GLUT's: glutGetProcAddress() needs glutInit().
+    static void *procAddress(const char *name);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+private:
+    int width_ = 0, height_ = 0;
+    std::string error_;
+    void *display_ = nullptr, *context_ = nullptr;
+    unsigned int framebuffer_ = 0, renderbuffers_[2] = {0, 0};
+};
+
+#endif //OFFSCREENCONTEXT_H
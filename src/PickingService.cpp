@@ -0,0 +1,277 @@
+#include "PickingService.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <vcg/space/intersection3.h>
+
+namespace
+{
+    // a*p + d >= 0 inside
+    struct ClipPlane
+    {
+        vcg::Point3f a;
+        float d;
+    };
+
+    // The planes bounding the window rectangle [x0, x1] x [y0, y1] between near and far, from
+    // x_clip >= ndc_x0 * w_clip and so on.
+    void regionPlanes(const PickingService::Camera &camera, float x0, float y0, float x1, float y1, ClipPlane planes[6])
+    {
+        const float *vp = camera.viewport;
+        float nx0 = 2 * (std::min(x0, x1) - vp[0]) / vp[2] - 1;
+        float nx1 = 2 * (std::max(x0, x1) - vp[0]) / vp[2] - 1;
+        float ny0 = 2 * (std::min(y0, y1) - vp[1]) / vp[3] - 1;
+        float ny1 = 2 * (std::max(y0, y1) - vp[1]) / vp[3] - 1;
+        // row coefficient, w coefficient of the 6 planes
+        const int rows[6] = {0, 0, 1, 1, 2, 2};
+        const float rowSign[6] = {1, -1, 1, -1, 1, -1};
+        const float wCoeff[6] = {-nx0, nx1, -ny0, ny1, 1, 1};
+
+        vcg::Matrix44f m = camera.projection * camera.modelview;
+        for (int i = 0; i < 6; ++i) {
+            float c[4];
+            for (int k = 0; k < 4; ++k) {
+                c[k] = rowSign[i] * m.ElementAt(rows[i], k) + wCoeff[i] * m.ElementAt(3, k);
+            }
+            planes[i].a = vcg::Point3f(c[0], c[1], c[2]);
+            planes[i].d = c[3];
+        }
+    }
+
+    // -1 out, 1 all inside, 0 crossing
+    int classifyBox(const ClipPlane planes[6], const vcg::Box3f &box)
+    {
+        bool inside = true;
+        for (int i = 0; i < 6; ++i) {
+            const vcg::Point3f &a = planes[i].a;
+            float maxD = planes[i].d, minD = planes[i].d;
+            for (int k = 0; k < 3; ++k) {
+                maxD += a[k] * (a[k] >= 0 ? box.max[k] : box.min[k]);
+                minD += a[k] * (a[k] >= 0 ? box.min[k] : box.max[k]);
+            }
+            if (maxD < 0) return -1;
+            if (minD < 0) inside = false;
+        }
+        return inside ? 1 : 0;
+    }
+
+    bool isInside(const ClipPlane planes[6], const vcg::Point3f &p)
+    {
+        for (int i = 0; i < 6; ++i) {
+            if (planes[i].a * p + planes[i].d < 0) return false;
+        }
+        return true;
+    }
+
+    // even-odd rule
+    bool isInPolygon(const std::vector<vcg::Point2f> &polygon, const vcg::Point2f &p)
+    {
+        bool in = false;
+        for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+            const vcg::Point2f &a = polygon[i], &b = polygon[j];
+            if ((a[1] > p[1]) != (b[1] > p[1]) && p[0] < a[0] + (b[0] - a[0]) * (p[1] - a[1]) / (b[1] - a[1])) {
+                in = !in;
+            }
+        }
+        return in;
+    }
+
+    vcg::Point2f toWindow(const vcg::Matrix44f &m, const float *vp, const vcg::Point3f &p)
+    {
+        vcg::Point4f c = m * vcg::Point4f(p[0], p[1], p[2], 1);
+        return vcg::Point2f(vp[0] + (c[0] / c[3] + 1) * vp[2] / 2, vp[1] + (c[1] / c[3] + 1) * vp[3] / 2);
+    }
+}
+
+PickingService::~PickingService()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    if (worker_.joinable()) worker_.join();
+}
+
+uint32_t PickingService::addMesh(const MeshBuffer &mesh)
+{
+    meshes_.emplace_back();
+    PickMesh &pm = meshes_.back();
+
+    size_t faceNb = mesh.indices.size() / 3;
+    pm.corners.resize(faceNb * 3);
+    std::vector<vcg::Box3f> boxes(faceNb);
+    for (size_t f = 0; f < faceNb; ++f) {
+        for (int j = 0; j < 3; ++j) {
+            const Point3D &p = mesh.vertices[mesh.indices[f*3+j]];
+            pm.corners[f*3+j] = vcg::Point3f(p.x, p.y, p.z);
+            boxes[f].Add(pm.corners[f*3+j]);
+        }
+    }
+    pm.bvh.Build(boxes);
+
+    return (uint32_t) (meshes_.size() - 1);
+}
+
+void PickingService::clear()
+{
+    meshes_.clear();
+}
+
+bool PickingService::pickRay(const vcg::Ray3f &ray, Hit &hit, float *distance) const
+{
+    std::vector<int> stack;
+    bool found = false;
+    float best = std::numeric_limits<float>::max();
+    for (uint32_t m = 0; m < meshes_.size(); ++m) {
+        const std::vector<vcg::Point3f> &c = meshes_[m].corners;
+        float dist = best;
+        int face = meshes_[m].bvh.RayQuery(ray, dist, [&](int f, float &t) {
+            float u, v;
+            return vcg::IntersectionRayTriangle(ray, c[f*3], c[f*3+1], c[f*3+2], t, u, v);
+        }, stack);
+        if (face >= 0) {
+            best = dist;
+            hit = Hit{m, (uint32_t) face};
+            found = true;
+        }
+    }
+    if (found && distance) *distance = best;
+    return found;
+}
+
+bool PickingService::pickPoint(const Camera &camera, float x, float y, Hit &hit, float *distance) const
+{
+    const float *vp = camera.viewport;
+    float nx = 2 * (x - vp[0]) / vp[2] - 1;
+    float ny = 2 * (y - vp[1]) / vp[3] - 1;
+    vcg::Matrix44f inv = vcg::Inverse(vcg::Matrix44f(camera.projection * camera.modelview));
+    vcg::Point4f n = inv * vcg::Point4f(nx, ny, -1, 1);
+    vcg::Point4f f = inv * vcg::Point4f(nx, ny, 1, 1);
+    vcg::Point3f pn(n[0] / n[3], n[1] / n[3], n[2] / n[3]);
+    vcg::Point3f pf(f[0] / f[3], f[1] / f[3], f[2] / f[3]);
+
+    // the near-far segment as direction: hits beyond the far plane are dropped
+    float dist;
+    if (!pickRay(vcg::Ray3f(pn, pf - pn), hit, &dist) || dist > 1) return false;
+    if (distance) *distance = dist;
+    return true;
+}
+
+void PickingService::pickRect(const Camera &camera, float x0, float y0, float x1, float y1, std::vector<Hit> &hits) const
+{
+    pickRegion(camera, x0, y0, x1, y1, nullptr, hits);
+}
+
+void PickingService::pickLasso(const Camera &camera, const std::vector<vcg::Point2f> &polygon, std::vector<Hit> &hits) const
+{
+    hits.clear();
+    if (polygon.size() < 3) return;
+    vcg::Box2f bounds;
+    for (const vcg::Point2f &p : polygon) {
+        bounds.Add(p);
+    }
+    pickRegion(camera, bounds.min[0], bounds.min[1], bounds.max[0], bounds.max[1], &polygon, hits);
+}
+
+void PickingService::pickRegion(const Camera &camera, float x0, float y0, float x1, float y1,
+                                const std::vector<vcg::Point2f> *polygon, std::vector<Hit> &hits) const
+{
+    hits.clear();
+    ClipPlane planes[6];
+    regionPlanes(camera, x0, y0, x1, y1, planes);
+    vcg::Matrix44f m = camera.projection * camera.modelview;
+
+    std::vector<int> stack;
+    for (uint32_t mi = 0; mi < meshes_.size(); ++mi) {
+        const std::vector<vcg::Point3f> &c = meshes_[mi].corners;
+        size_t first = hits.size();
+        meshes_[mi].bvh.RegionQuery([&](const vcg::Box3f &box) { return classifyBox(planes, box); },
+                                    [&](int f, bool inside) {
+            vcg::Point3f bary = (c[f*3] + c[f*3+1] + c[f*3+2]) / 3.0f;
+            if (!inside && !isInside(planes, bary)) return;
+            if (polygon && !isInPolygon(*polygon, toWindow(m, camera.viewport, bary))) return;
+            hits.push_back(Hit{mi, (uint32_t) f});
+        }, stack);
+        std::sort(hits.begin() + first, hits.end(), [](const Hit &a, const Hit &b) { return a.face < b.face; });
+    }
+}
+
+PickingService::Result PickingService::run(const Request &request) const
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    Result result;
+    result.kind = request.kind;
+    switch (request.kind) {
+    case Ray: {
+        Hit hit;
+        if (pickPoint(request.camera, request.x0, request.y0, hit, &result.distance)) {
+            result.hits.push_back(hit);
+        }
+        break;
+    }
+    case Rect:
+        pickRect(request.camera, request.x0, request.y0, request.x1, request.y1, result.hits);
+        break;
+    case Lasso:
+        pickLasso(request.camera, request.lasso, result.hits);
+        break;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    result.micros = std::chrono::duration<double, std::micro>(end - start).count();
+    return result;
+}
+
+uint64_t PickingService::submit(const Request &request)
+{
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!worker_.joinable()) {
+            worker_ = std::thread(&PickingService::workerLoop, this);
+        }
+        request_ = request;
+        hasRequest_ = true;
+        id = ++lastId_;
+    }
+    wake_.notify_one();
+    return id;
+}
+
+bool PickingService::poll(Result &result)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!hasResult_) return false;
+    result = std::move(result_);
+    hasResult_ = false;
+    return true;
+}
+
+bool PickingService::busy()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hasRequest_ || running_;
+}
+
+void PickingService::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stop_ || hasRequest_; });
+        if (stop_) return;
+
+        Request request = std::move(request_);
+        uint64_t id = lastId_;
+        hasRequest_ = false;
+        running_ = true;
+        lock.unlock();
+
+        Result result = run(request);
+        result.id = id;
+
+        lock.lock();
+        running_ = false;
+        result_ = std::move(result);
+        hasResult_ = true;
+    }
+}
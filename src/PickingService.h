@@ -0,0 +1,106 @@
+#ifndef PICKINGSERVICE_H
+#define PICKINGSERVICE_H
+
+#include <vector>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vcg/math/matrix44.h>
+#include <vcg/space/point2.h>
+#include <vcg/space/box2.h>
+#include <vcg/space/ray3.h>
+#include <vcg/space/index/box_bvh.h>
+#include "MeshBuffer.h"
+
+// Face picking on the CPU, without GL: each added mesh is copied and indexed by a vcg::BoxBVH once,
+// then ray, rectangle and lasso queries only visit the faces near the query instead of projecting the
+// whole mesh as vcg::GLPickTri does.
+// The queries run either synchronously (const, usable headless) or on a worker thread through
+// submit()/poll(), so that the GUI callbacks never wait on them. A submitted request replaces the one
+// still pending, e.g. the previous lasso of a drag that the worker did not start yet.
+// The meshes are snapshots: add them again after editing their vertices.
+class PickingService
+{
+public:
+    // Window coordinates have their origin at the bottom left, as in GL.
+    struct Camera
+    {
+        vcg::Matrix44f projection;
+        vcg::Matrix44f modelview;
+        float viewport[4];
+    };
+
+    struct Hit
+    {
+        uint32_t mesh, face;
+    };
+
+    enum Kind { Ray, Rect, Lasso };
+
+    struct Request
+    {
+        Kind kind = Ray;
+        Camera camera;
+        float x0 = 0, y0 = 0, x1 = 0, y1 = 0;  // Ray: (x0, y0); Rect: the corners
+        std::vector<vcg::Point2f> lasso;       // Lasso: the polygon
+    };
+
+    struct Result
+    {
+        uint64_t id = 0;
+        Kind kind = Ray;
+        std::vector<Hit> hits;   // Ray: the closest hit, if any
+        float distance = 0;      // Ray: along the near-far segment, in [0, 1]
+        double micros = 0;       // time spent in the query
+    };
+
+    PickingService() = default;
+    ~PickingService();
+    PickingService(const PickingService &) = delete;
+    PickingService &operator=(const PickingService &) = delete;
+
+    // Returns the id of the mesh in the hits. Must not run while a submitted request is in flight.
+    uint32_t addMesh(const MeshBuffer &mesh);
+    void clear();
+
+    // Closest face hit by the ray, at distance *distance in units of the ray direction.
+    bool pickRay(const vcg::Ray3f &ray, Hit &hit, float *distance = nullptr) const;
+    // Closest face under the window point.
+    bool pickPoint(const Camera &camera, float x, float y, Hit &hit, float *distance = nullptr) const;
+    // Faces whose barycenter projects inside the rectangle or the polygon, between the near and far planes.
+    void pickRect(const Camera &camera, float x0, float y0, float x1, float y1, std::vector<Hit> &hits) const;
+    void pickLasso(const Camera &camera, const std::vector<vcg::Point2f> &polygon, std::vector<Hit> &hits) const;
+
+    Result run(const Request &request) const;
+
+    // Returns the id that the result will carry.
+    uint64_t submit(const Request &request);
+    // Takes the latest finished result, if there is a new one.
+    bool poll(Result &result);
+    bool busy();
+
+private:
+    struct PickMesh
+    {
+        std::vector<vcg::Point3f> corners;   // 3 per face
+        vcg::BoxBVH<float> bvh;
+    };
+
+    void pickRegion(const Camera &camera, float x0, float y0, float x1, float y1,
+                    const std::vector<vcg::Point2f> *polygon, std::vector<Hit> &hits) const;
+    void workerLoop();
+
+    std::vector<PickMesh> meshes_;
+
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+    bool hasRequest_ = false, running_ = false, hasResult_ = false;
+    uint64_t lastId_ = 0;
+    Request request_;
+    Result result_;
+};
+
+#endif //PICKINGSERVICE_H
@@ -0,0 +1,37 @@
+#include "PointLOD.h"
+#include <algorithm>
+#include <cmath>
+#include "VCGLib_Helper/LODMaker.h"
+
+void PointLOD::build(MeshBuffer &cloud)
+{
+    levelEnds_.clear();
+    radii_.clear();
+    if (!cloud.isPointCloud()) return;
+
+    CMeshO mesh = VCG_CMesh0_Helper::constructCMesh(cloud.indices, cloud.vertices, std::vector<Point3D>());
+    std::vector<uint32_t> order;
+    LODMaker::sequentialPointOrder(mesh, order, levelEnds_, radii_);
+    if (order.size() != cloud.vertices.size()) {
+        levelEnds_.clear();
+        radii_.clear();
+        return;
+    }
+
+    std::vector<Point3D> sorted(order.size());
+    for (size_t i = 0; i < order.size(); ++i) sorted[i] = cloud.vertices[order[i]];
+    cloud.vertices.swap(sorted);
+    if (cloud.normals.size() == order.size()) {
+        for (size_t i = 0; i < order.size(); ++i) sorted[i] = cloud.normals[order[i]];
+        cloud.normals.swap(sorted);
+    }
+}
+
+float PointLOD::spacing(size_t count) const
+{
+    if (empty() || count == 0) return 0;
+    count = std::min(count, size());
+    size_t level = std::lower_bound(levelEnds_.begin(), levelEnds_.end(), (uint32_t) count) - levelEnds_.begin();
+    // inside a level, uniform on a surface: the spacing goes as one over the square root of the count
+    return radii_[level] * std::sqrt(float(levelEnds_[level]) / count);
+}
@@ -0,0 +1,36 @@
+#ifndef POINTLOD_H
+#define POINTLOD_H
+
+#include <vector>
+#include <cstdint>
+#include "MeshBuffer.h"
+
+// Sequential level of detail of a point cloud: build() reorders the points of a MeshBuffer, and their
+// normals, so that every prefix is a uniform subsample of the cloud (LODMaker::sequentialPointOrder,
+// Poisson disk levels of halving radius). A view then draws the first points only, as many as its
+// budget allows, and spacing() tells how far apart they are, the size their splats need.
+// build() after MeshBuffer::rebuild(): edits and rebuilds do not keep the order.
+class PointLOD
+{
+public:
+    PointLOD() = default;
+    PointLOD(const PointLOD &) = delete;
+    PointLOD &operator=(const PointLOD &) = delete;
+
+    void build(MeshBuffer &cloud);
+
+    bool empty() const { return levelEnds_.empty(); }
+    size_t size() const { return empty() ? 0 : levelEnds_.back(); }
+    size_t levelNb() const { return levelEnds_.size(); }
+    // Points of the levels 0 to level.
+    size_t levelEnd(size_t level) const { return levelEnds_[level]; }
+
+    // Distance between neighbouring points of the first count points.
+    float spacing(size_t count) const;
+
+private:
+    std::vector<uint32_t> levelEnds_;
+    std::vector<float> radii_;        // Poisson disk radius of each level
+};
+
+#endif //POINTLOD_H
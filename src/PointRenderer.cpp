@@ -0,0 +1,194 @@
+#include "PointRenderer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <GL/freeglut.h>
+#include "OffscreenContext.h"
+
+#ifndef GL_VERTEX_PROGRAM_POINT_SIZE
+#define GL_VERTEX_PROGRAM_POINT_SIZE 0x8642
+#endif
+#ifndef GL_POINT_SPRITE
+#define GL_POINT_SPRITE 0x8861
+#endif
+#ifndef GL_FRAGMENT_SHADER
+#define GL_FRAGMENT_SHADER 0x8b30
+#define GL_VERTEX_SHADER 0x8b31
+#define GL_COMPILE_STATUS 0x8b81
+#define GL_LINK_STATUS 0x8b82
+#endif
+
+namespace
+{
+    typedef GLuint (APIENTRY *CreateShaderProc)(GLenum type);
+    typedef void (APIENTRY *ShaderSourceProc)(GLuint shader, GLsizei count, const char *const *source, const GLint *length);
+    typedef void (APIENTRY *CompileShaderProc)(GLuint shader);
+    typedef void (APIENTRY *GetivProc)(GLuint object, GLenum name, GLint *value);
+    typedef void (APIENTRY *GetInfoLogProc)(GLuint object, GLsizei size, GLsizei *length, char *log);
+    typedef GLuint (APIENTRY *CreateProgramProc)(void);
+    typedef void (APIENTRY *AttachShaderProc)(GLuint program, GLuint shader);
+    typedef void (APIENTRY *DeleteShaderProc)(GLuint shader);
+    typedef void (APIENTRY *LinkProgramProc)(GLuint program);
+    typedef void (APIENTRY *UseProgramProc)(GLuint program);
+    typedef void (APIENTRY *DeleteProgramProc)(GLuint program);
+    typedef GLint (APIENTRY *GetUniformLocationProc)(GLuint program, const char *name);
+    typedef void (APIENTRY *Uniform1fProc)(GLint location, GLfloat value);
+
+    CreateShaderProc createShader;
+    ShaderSourceProc shaderSource;
+    CompileShaderProc compileShader;
+    GetivProc getShaderiv, getProgramiv;
+    GetInfoLogProc getShaderInfoLog;
+    CreateProgramProc createProgram;
+    AttachShaderProc attachShader;
+    DeleteShaderProc deleteShader;
+    LinkProgramProc linkProgram;
+    UseProgramProc useProgram;
+    DeleteProgramProc deleteProgram;
+    GetUniformLocationProc getUniformLocation;
+    Uniform1fProc uniform1f;
+
+    template <class PROC>
+    bool load(PROC &proc, const char *name)
+    {
+        proc = (PROC) OffscreenContext::procAddress(name);
+        return proc != nullptr;
+    }
+
+    // Lit as the fixed pipeline lights the points: GL_LIGHT0 directional, the material color diffuse. The
+    // normals of a scan have no consistent side, so both sides are lit.
+    const char *vertexShader =
+            "#version 120\n"
+            "uniform float radius;\n"
+            "uniform float pixelScale;\n"
+            "varying vec3 color;\n"
+            "void main()\n"
+            "{\n"
+            "    vec4 eye = gl_ModelViewMatrix * gl_Vertex;\n"
+            "    gl_Position = gl_ProjectionMatrix * eye;\n"
+            "    gl_PointSize = max(2.0 * radius * pixelScale / max(-eye.z, 1e-4), 1.0);\n"
+            "    vec3 n = normalize(gl_NormalMatrix * gl_Normal);\n"
+            "    float d = abs(dot(n, normalize(gl_LightSource[0].position.xyz)));\n"
+            "    color = gl_FrontMaterial.diffuse.rgb * (0.2 * gl_LightSource[0].ambient.rgb + d * gl_LightSource[0].diffuse.rgb);\n"
+            "}\n";
+    // a disc darkening toward its rim, as a sphere would
+    const char *fragmentShader =
+            "#version 120\n"
+            "varying vec3 color;\n"
+            "void main()\n"
+            "{\n"
+            "    vec2 p = gl_PointCoord * 2.0 - 1.0;\n"
+            "    float r2 = dot(p, p);\n"
+            "    if (r2 > 1.0) discard;\n"
+            "    gl_FragColor = vec4(color * (1.0 - 0.4 * r2), 1.0);\n"
+            "}\n";
+
+    GLuint compile(GLenum type, const char *source)
+    {
+        GLuint shader = createShader(type);
+        shaderSource(shader, 1, &source, nullptr);
+        compileShader(shader);
+        GLint ok = 0;
+        getShaderiv(shader, GL_COMPILE_STATUS, &ok);
+        if (!ok) {
+            char log[1024];
+            getShaderInfoLog(shader, sizeof log, nullptr, log);
+            printf("point splat shader: %s\n", log);
+            deleteShader(shader);
+            return 0;
+        }
+        return shader;
+    }
+}
+
+bool PointRenderer::initGL()
+{
+    glChecked_ = true;
+    const char *version = (const char *) glGetString(GL_VERSION);
+    int major = 0, minor = 0;
+    if (version) sscanf(version, "%d.%d", &major, &minor);
+    if (major < 2) return false;
+
+    if (!load(createShader, "glCreateShader") || !load(shaderSource, "glShaderSource") ||
+        !load(compileShader, "glCompileShader") || !load(getShaderiv, "glGetShaderiv") ||
+        !load(getProgramiv, "glGetProgramiv") || !load(getShaderInfoLog, "glGetShaderInfoLog") ||
+        !load(createProgram, "glCreateProgram") || !load(attachShader, "glAttachShader") ||
+        !load(deleteShader, "glDeleteShader") || !load(linkProgram, "glLinkProgram") ||
+        !load(useProgram, "glUseProgram") || !load(deleteProgram, "glDeleteProgram") ||
+        !load(getUniformLocation, "glGetUniformLocation") || !load(uniform1f, "glUniform1f")) {
+        return false;
+    }
+    GLuint vs = compile(GL_VERTEX_SHADER, vertexShader), fs = compile(GL_FRAGMENT_SHADER, fragmentShader);
+    if (!vs || !fs) return false;
+    program_ = createProgram();
+    attachShader(program_, vs);
+    attachShader(program_, fs);
+    linkProgram(program_);
+    deleteShader(vs);
+    deleteShader(fs);
+    GLint ok = 0;
+    getProgramiv(program_, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        printf("point splat program does not link\n");
+        deleteProgram(program_);
+        program_ = 0;
+        return false;
+    }
+    radiusLocation_ = getUniformLocation(program_, "radius");
+    pixelScaleLocation_ = getUniformLocation(program_, "pixelScale");
+    return true;
+}
+
+void PointRenderer::adapt(double frameMs, size_t pointNb)
+{
+    if (frameMs <= 0) return;
+    // halfway (geometrically) to the budget of the target, the frame time being about linear in the points
+    double scale = std::sqrt(std::min(4.0, std::max(0.25, targetMs / frameMs)));
+    budget = std::max(minBudget, std::min(pointNb, size_t(budget * scale)));
+}
+
+void PointRenderer::draw(const MeshBuffer &cloud, const PointLOD &lod, float pixelScale, Stats *stats)
+{
+    if (!glChecked_) {
+        hasSplats_ = initGL();
+        printf("point cloud: %s\n", hasSplats_ ? "splats available" : "no GL 2.0, points only");
+    }
+    Stats st;
+    st.points = cloud.vertices.size();
+    st.drawn = lod.empty() ? st.points : std::min(budget, st.points);
+    st.spacing = lod.spacing(st.drawn);
+    st.splats = splats && hasSplats_ && st.spacing > 0;
+    bool lit = cloud.normals.size() == cloud.vertices.size();
+
+    glPushAttrib(GL_ENABLE_BIT | GL_POINT_BIT);
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(Point3D), cloud.vertices.data());
+    if (lit) {
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_FLOAT, sizeof(Point3D), cloud.normals.data());
+    }
+    if (st.splats) {
+        glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+        glEnable(GL_POINT_SPRITE);
+        useProgram(program_);
+        uniform1f(radiusLocation_, st.spacing * splatScale);
+        uniform1f(pixelScaleLocation_, pixelScale);
+    } else {
+        if (!lit) glDisable(GL_LIGHTING);
+        glPointSize(2.0f);
+    }
+    glDrawArrays(GL_POINTS, 0, (GLsizei) st.drawn);
+    if (st.splats) useProgram(0);
+    glPopClientAttrib();
+    glPopAttrib();
+
+    if (stats) *stats = st;
+}
+
+void PointRenderer::releaseGL()
+{
+    if (program_) deleteProgram(program_);
+    program_ = 0;
+    glChecked_ = hasSplats_ = false;
+}
@@ -0,0 +1,51 @@
+#ifndef POINTRENDERER_H
+#define POINTRENDERER_H
+
+#include <cstddef>
+#include "MeshBuffer.h"
+#include "PointLOD.h"
+
+// Draws a point cloud ordered by PointLOD: the prefix the point budget allows, in one glDrawArrays from
+// client arrays. adapt() moves the budget toward targetMs per frame. With splats (GL 2.0 point sprites)
+// every point is a disc as wide as the spacing of the prefix drawn, sized by a small shader from its
+// depth and shaded as a sphere, which closes the holes of a subsample; without, the 2 pixel points the
+// viewer drew before. draw() needs a current context, and releaseGL() before it goes.
+class PointRenderer
+{
+public:
+    struct Stats
+    {
+        size_t points = 0;
+        size_t drawn = 0;
+        float spacing = 0;          // of the points drawn
+        bool splats = false;
+    };
+
+    // Points per frame.
+    size_t budget = 2000000;
+    float targetMs = 33;
+    bool splats = true;
+    // Splat radius over the spacing of the points drawn.
+    float splatScale = 1;
+
+    PointRenderer() = default;
+    PointRenderer(const PointRenderer &) = delete;
+    PointRenderer &operator=(const PointRenderer &) = delete;
+
+    // frameMs: the time of the last frame. Never below minBudget, nor above pointNb.
+    void adapt(double frameMs, size_t pointNb);
+    // pixelScale: pixels per unit at unit depth, projection(1, 1) * viewport height / 2.
+    void draw(const MeshBuffer &cloud, const PointLOD &lod, float pixelScale, Stats *stats = nullptr);
+    void releaseGL();
+
+    static constexpr size_t minBudget = 10000;
+
+private:
+    bool initGL();
+
+    bool glChecked_ = false, hasSplats_ = false;
+    unsigned int program_ = 0;
+    int radiusLocation_ = -1, pixelScaleLocation_ = -1;
+};
+
+#endif //POINTRENDERER_H
@@ -0,0 +1,274 @@
+#include "TextOverlay.h"
+#include <cstddef>
+#include <cstring>
+#include <GL/freeglut.h>
+#include "OffscreenContext.h"
+
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#endif
+#ifndef GL_DYNAMIC_DRAW
+#define GL_DYNAMIC_DRAW 0x88e8
+#endif
+
+namespace
+{
+    typedef void (APIENTRY *GenBuffersProc)(GLsizei n, GLuint *buffers);
+    typedef void (APIENTRY *DeleteBuffersProc)(GLsizei n, const GLuint *buffers);
+    typedef void (APIENTRY *BindBufferProc)(GLenum target, GLuint buffer);
+    typedef void (APIENTRY *BufferDataProc)(GLenum target, ptrdiff_t size, const void *data, GLenum usage);
+
+    GenBuffersProc genBuffers;
+    DeleteBuffersProc deleteBuffers;
+    BindBufferProc bindBuffer;
+    BufferDataProc bufferData;
+
+    template <class PROC>
+    bool load(PROC &proc, const char *name)
+    {
+        proc = (PROC) OffscreenContext::procAddress(name);
+        return proc != nullptr;
+    }
+
+    const int FirstChar = 32, CharNb = 95, BaselineY = 4;
+    const int AtlasWidth = 256, AtlasHeight = 128, AtlasColumns = 16;
+
+    // -misc-fixed-medium-r-normal--15-140-75-75-C-90-iso8859-1, as freeglut has it: rows bottom up,
+    // the leftmost pixel in bit 8.
+    const uint16_t glyphs[CharNb][TextOverlay::GlyphHeight] = {
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000},   // ' '
+    {0x000, 0x000, 0x000, 0x000, 0x010, 0x010, 0x000, 0x000, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x000},   // '!'
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x024, 0x024, 0x024, 0x000, 0x000},   // '"'
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x048, 0x048, 0x0fc, 0x048, 0x048, 0x0fc, 0x048, 0x048, 0x000, 0x000, 0x000},   // '#'
+    {0x000, 0x000, 0x000, 0x010, 0x07c, 0x092, 0x012, 0x012, 0x014, 0x038, 0x050, 0x090, 0x092, 0x07c, 0x010, 0x000},   // '$'
+    {0x000, 0x000, 0x000, 0x000, 0x084, 0x04a, 0x04a, 0x024, 0x010, 0x010, 0x048, 0x0a4, 0x0a4, 0x042, 0x000, 0x000},   // '%'
+    {0x000, 0x000, 0x000, 0x000, 0x062, 0x094, 0x088, 0x094, 0x062, 0x060, 0x090, 0x090, 0x090, 0x060, 0x000, 0x000},   // '&'
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x020, 0x010, 0x008, 0x00c, 0x000, 0x000},   // '\''
+    {0x000, 0x000, 0x000, 0x008, 0x010, 0x010, 0x020, 0x020, 0x020, 0x020, 0x020, 0x020, 0x010, 0x010, 0x008, 0x000},   // '('
+    {0x000, 0x000, 0x000, 0x020, 0x010, 0x010, 0x008, 0x008, 0x008, 0x008, 0x008, 0x008, 0x010, 0x010, 0x020, 0x000},   // ')'
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x010, 0x092, 0x054, 0x038, 0x054, 0x092, 0x010, 0x000, 0x000, 0x000, 0x000},   // '*'
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x010, 0x010, 0x010, 0x0fe, 0x010, 0x010, 0x010, 0x000, 0x000, 0x000, 0x000},   // '+'
+    {0x000, 0x010, 0x008, 0x008, 0x018, 0x018, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000},   // ','
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x0fe, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000},   // '-'
+    {0x000, 0x000, 0x000, 0x000, 0x018, 0x018, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000},   // '.'
+    {0x000, 0x000, 0x000, 0x000, 0x080, 0x040, 0x040, 0x020, 0x010, 0x010, 0x008, 0x004, 0x004, 0x002, 0x000, 0x000},   // '/'
+    {0x000, 0x000, 0x000, 0x000, 0x038, 0x044, 0x082, 0x082, 0x082, 0x082, 0x082, 0x082, 0x044, 0x038, 0x000, 0x000},   // '0'
+    {0x000, 0x000, 0x000, 0x000, 0x0fe, 0x010, 0x010, 0x010, 0x010, 0x010, 0x090, 0x050, 0x030, 0x010, 0x000, 0x000},   // '1'
+    {0x000, 0x000, 0x000, 0x000, 0x0fe, 0x080, 0x040, 0x020, 0x010, 0x008, 0x004, 0x082, 0x082, 0x07c, 0x000, 0x000},   // '2'
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x002, 0x002, 0x002, 0x01c, 0x008, 0x004, 0x002, 0x0fe, 0x000, 0x000},   // '3'
+    {0x000, 0x000, 0x000, 0x000, 0x004, 0x004, 0x004, 0x0fe, 0x084, 0x044, 0x024, 0x014, 0x00c, 0x004, 0x000, 0x000},   // '4'
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x002, 0x002, 0x002, 0x0c2, 0x0bc, 0x080, 0x080, 0x0fe, 0x000, 0x000},   // '5'
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x082, 0x082, 0x0c2, 0x0bc, 0x080, 0x080, 0x040, 0x03c, 0x000, 0x000},   // '6'
+    {0x000, 0x000, 0x000, 0x000, 0x040, 0x040, 0x020, 0x020, 0x010, 0x008, 0x004, 0x002, 0x002, 0x0fe, 0x000, 0x000},   // '7'
+    {0x000, 0x000, 0x000, 0x000, 0x038, 0x044, 0x082, 0x082, 0x044, 0x038, 0x044, 0x082, 0x044, 0x038, 0x000, 0x000},   // '8'
+    {0x000, 0x000, 0x000, 0x000, 0x078, 0x004, 0x002, 0x002, 0x07a, 0x086, 0x082, 0x082, 0x082, 0x07c, 0x000, 0x000},   // '9'
+    {0x000, 0x000, 0x000, 0x000, 0x018, 0x018, 0x000, 0x000, 0x000, 0x018, 0x018, 0x000, 0x000, 0x000, 0x000, 0x000},   // ':'
+    {0x000, 0x010, 0x008, 0x008, 0x018, 0x018, 0x000, 0x000, 0x000, 0x018, 0x018, 0x000, 0x000, 0x000, 0x000, 0x000},   // ';'
+    {0x000, 0x000, 0x000, 0x000, 0x004, 0x008, 0x010, 0x020, 0x040, 0x040, 0x020, 0x010, 0x008, 0x004, 0x000, 0x000},   // '<'
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x0fe, 0x000, 0x000, 0x0fe, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000},   // '='
+    {0x000, 0x000, 0x000, 0x000, 0x040, 0x020, 0x010, 0x008, 0x004, 0x004, 0x008, 0x010, 0x020, 0x040, 0x000, 0x000},   // '>'
+    {0x000, 0x000, 0x000, 0x000, 0x010, 0x000, 0x010, 0x010, 0x008, 0x004, 0x002, 0x082, 0x082, 0x07c, 0x000, 0x000},   // '?'
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x080, 0x080, 0x09a, 0x0a6, 0x0a2, 0x09e, 0x082, 0x082, 0x07c, 0x000, 0x000},   // '@'
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x082, 0x082, 0x0fe, 0x082, 0x082, 0x082, 0x044, 0x028, 0x010, 0x000, 0x000},   // 'A'
+    {0x000, 0x000, 0x000, 0x000, 0x0fc, 0x042, 0x042, 0x042, 0x042, 0x0fc, 0x042, 0x042, 0x042, 0x0fc, 0x000, 0x000},   // 'B'
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x080, 0x080, 0x080, 0x080, 0x080, 0x080, 0x082, 0x07c, 0x000, 0x000},   // 'C'
+    {0x000, 0x000, 0x000, 0x000, 0x0fc, 0x042, 0x042, 0x042, 0x042, 0x042, 0x042, 0x042, 0x042, 0x0fc, 0x000, 0x000},   // 'D'
+    {0x000, 0x000, 0x000, 0x000, 0x0fe, 0x040, 0x040, 0x040, 0x040, 0x078, 0x040, 0x040, 0x040, 0x0fe, 0x000, 0x000},   // 'E'
+    {0x000, 0x000, 0x000, 0x000, 0x040, 0x040, 0x040, 0x040, 0x040, 0x078, 0x040, 0x040, 0x040, 0x0fe, 0x000, 0x000},   // 'F'
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x082, 0x082, 0x08e, 0x080, 0x080, 0x080, 0x082, 0x07c, 0x000, 0x000},   // 'G'
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x082, 0x082, 0x082, 0x082, 0x0fe, 0x082, 0x082, 0x082, 0x082, 0x000, 0x000},   // 'H'
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x07c, 0x000, 0x000},   // 'I'
+    {0x000, 0x000, 0x000, 0x000, 0x078, 0x084, 0x004, 0x004, 0x004, 0x004, 0x004, 0x004, 0x004, 0x01f, 0x000, 0x000},   // 'J'
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x084, 0x088, 0x090, 0x0a0, 0x0e0, 0x090, 0x088, 0x084, 0x082, 0x000, 0x000},   // 'K'
+    {0x000, 0x000, 0x000, 0x000, 0x0fe, 0x080, 0x080, 0x080, 0x080, 0x080, 0x080, 0x080, 0x080, 0x080, 0x000, 0x000},   // 'L'
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x082, 0x082, 0x092, 0x092, 0x0aa, 0x0aa, 0x0c6, 0x082, 0x082, 0x000, 0x000},   // 'M'
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x082, 0x082, 0x086, 0x08a, 0x092, 0x0a2, 0x0c2, 0x082, 0x082, 0x000, 0x000},   // 'N'
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x082, 0x082, 0x082, 0x082, 0x082, 0x082, 0x082, 0x07c, 0x000, 0x000},   // 'O'
+    {0x000, 0x000, 0x000, 0x000, 0x080, 0x080, 0x080, 0x080, 0x080, 0x0fc, 0x082, 0x082, 0x082, 0x0fc, 0x000, 0x000},   // 'P'
+    {0x000, 0x000, 0x006, 0x008, 0x07c, 0x092, 0x0a2, 0x082, 0x082, 0x082, 0x082, 0x082, 0x082, 0x07c, 0x000, 0x000},   // 'Q'
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x082, 0x084, 0x088, 0x090, 0x0fc, 0x082, 0x082, 0x082, 0x0fc, 0x000, 0x000},   // 'R'
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x082, 0x002, 0x00c, 0x070, 0x080, 0x082, 0x082, 0x07c, 0x000, 0x000},   // 'S'
+    {0x000, 0x000, 0x000, 0x000, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x0fe, 0x000, 0x000},   // 'T'
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x082, 0x082, 0x082, 0x082, 0x082, 0x082, 0x082, 0x082, 0x000, 0x000},   // 'U'
+    {0x000, 0x000, 0x000, 0x000, 0x010, 0x028, 0x028, 0x028, 0x044, 0x044, 0x044, 0x082, 0x082, 0x082, 0x000, 0x000},   // 'V'
+    {0x000, 0x000, 0x000, 0x000, 0x044, 0x0aa, 0x092, 0x092, 0x092, 0x092, 0x082, 0x082, 0x082, 0x082, 0x000, 0x000},   // 'W'
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x082, 0x044, 0x028, 0x010, 0x010, 0x028, 0x044, 0x082, 0x082, 0x000, 0x000},   // 'X'
+    {0x000, 0x000, 0x000, 0x000, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x028, 0x044, 0x082, 0x082, 0x000, 0x000},   // 'Y'
+    {0x000, 0x000, 0x000, 0x000, 0x0fe, 0x080, 0x080, 0x040, 0x020, 0x010, 0x008, 0x004, 0x002, 0x0fe, 0x000, 0x000},   // 'Z'
+    {0x000, 0x000, 0x000, 0x03c, 0x020, 0x020, 0x020, 0x020, 0x020, 0x020, 0x020, 0x020, 0x020, 0x020, 0x03c, 0x000},   // '['
+    {0x000, 0x000, 0x000, 0x000, 0x002, 0x004, 0x004, 0x008, 0x010, 0x010, 0x020, 0x040, 0x040, 0x080, 0x000, 0x000},   // '\\'
+    {0x000, 0x000, 0x000, 0x078, 0x008, 0x008, 0x008, 0x008, 0x008, 0x008, 0x008, 0x008, 0x008, 0x008, 0x078, 0x000},   // ']'
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x082, 0x044, 0x028, 0x010, 0x000, 0x000},   // '^'
+    {0x000, 0x000, 0x000, 0x1fe, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000},   // '_'
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x008, 0x010, 0x020, 0x060, 0x000},   // '`'
+    {0x000, 0x000, 0x000, 0x000, 0x07a, 0x086, 0x082, 0x07e, 0x002, 0x002, 0x07c, 0x000, 0x000, 0x000, 0x000, 0x000},   // 'a'
+    {0x000, 0x000, 0x000, 0x000, 0x0bc, 0x0c2, 0x082, 0x082, 0x082, 0x0c2, 0x0bc, 0x080, 0x080, 0x080, 0x000, 0x000},   // 'b'
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x080, 0x080, 0x080, 0x082, 0x07c, 0x000, 0x000, 0x000, 0x000, 0x000},   // 'c'
+    {0x000, 0x000, 0x000, 0x000, 0x07a, 0x086, 0x082, 0x082, 0x082, 0x086, 0x07a, 0x002, 0x002, 0x002, 0x000, 0x000},   // 'd'
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x080, 0x080, 0x0fe, 0x082, 0x082, 0x07c, 0x000, 0x000, 0x000, 0x000, 0x000},   // 'e'
+    {0x000, 0x000, 0x000, 0x000, 0x020, 0x020, 0x020, 0x020, 0x0f8, 0x020, 0x020, 0x022, 0x022, 0x01c, 0x000, 0x000},   // 'f'
+    {0x000, 0x07c, 0x082, 0x082, 0x07c, 0x080, 0x078, 0x084, 0x084, 0x084, 0x07a, 0x000, 0x000, 0x000, 0x000, 0x000},   // 'g'
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x082, 0x082, 0x082, 0x082, 0x0c2, 0x0bc, 0x080, 0x080, 0x080, 0x000, 0x000},   // 'h'
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x010, 0x010, 0x010, 0x010, 0x010, 0x070, 0x000, 0x000, 0x030, 0x000, 0x000},   // 'i'
+    {0x000, 0x078, 0x084, 0x084, 0x084, 0x004, 0x004, 0x004, 0x004, 0x004, 0x01c, 0x000, 0x000, 0x00c, 0x000, 0x000},   // 'j'
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x08c, 0x0b0, 0x0c0, 0x0b0, 0x08c, 0x082, 0x080, 0x080, 0x080, 0x000, 0x000},   // 'k'
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x070, 0x000, 0x000},   // 'l'
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x092, 0x092, 0x092, 0x092, 0x092, 0x0ec, 0x000, 0x000, 0x000, 0x000, 0x000},   // 'm'
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x082, 0x082, 0x082, 0x082, 0x0c2, 0x0bc, 0x000, 0x000, 0x000, 0x000, 0x000},   // 'n'
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x082, 0x082, 0x082, 0x082, 0x07c, 0x000, 0x000, 0x000, 0x000, 0x000},   // 'o'
+    {0x000, 0x080, 0x080, 0x080, 0x0bc, 0x0c2, 0x082, 0x082, 0x082, 0x0c2, 0x0bc, 0x000, 0x000, 0x000, 0x000, 0x000},   // 'p'
+    {0x000, 0x002, 0x002, 0x002, 0x07a, 0x086, 0x082, 0x082, 0x082, 0x086, 0x07a, 0x000, 0x000, 0x000, 0x000, 0x000},   // 'q'
+    {0x000, 0x000, 0x000, 0x000, 0x040, 0x040, 0x040, 0x040, 0x042, 0x062, 0x09c, 0x000, 0x000, 0x000, 0x000, 0x000},   // 'r'
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x002, 0x07c, 0x080, 0x082, 0x07c, 0x000, 0x000, 0x000, 0x000, 0x000},   // 's'
+    {0x000, 0x000, 0x000, 0x000, 0x01c, 0x022, 0x020, 0x020, 0x020, 0x020, 0x0fc, 0x020, 0x020, 0x000, 0x000, 0x000},   // 't'
+    {0x000, 0x000, 0x000, 0x000, 0x07a, 0x084, 0x084, 0x084, 0x084, 0x084, 0x084, 0x000, 0x000, 0x000, 0x000, 0x000},   // 'u'
+    {0x000, 0x000, 0x000, 0x000, 0x010, 0x028, 0x028, 0x044, 0x044, 0x082, 0x082, 0x000, 0x000, 0x000, 0x000, 0x000},   // 'v'
+    {0x000, 0x000, 0x000, 0x000, 0x044, 0x0aa, 0x092, 0x092, 0x092, 0x082, 0x082, 0x000, 0x000, 0x000, 0x000, 0x000},   // 'w'
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x044, 0x028, 0x010, 0x028, 0x044, 0x082, 0x000, 0x000, 0x000, 0x000, 0x000},   // 'x'
+    {0x000, 0x078, 0x084, 0x004, 0x074, 0x08c, 0x084, 0x084, 0x084, 0x084, 0x084, 0x000, 0x000, 0x000, 0x000, 0x000},   // 'y'
+    {0x000, 0x000, 0x000, 0x000, 0x0fe, 0x040, 0x020, 0x010, 0x008, 0x004, 0x0fe, 0x000, 0x000, 0x000, 0x000, 0x000},   // 'z'
+    {0x000, 0x000, 0x000, 0x00e, 0x010, 0x010, 0x010, 0x008, 0x030, 0x030, 0x008, 0x010, 0x010, 0x010, 0x00e, 0x000},   // '{'
+    {0x000, 0x000, 0x000, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x000},   // '|'
+    {0x000, 0x000, 0x000, 0x0e0, 0x010, 0x010, 0x010, 0x020, 0x018, 0x018, 0x020, 0x010, 0x010, 0x010, 0x0e0, 0x000},   // '}'
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x08c, 0x092, 0x062, 0x000, 0x000},   // '~'
+    };
+}
+
+void TextOverlay::add(float x, float y, const char *text, float r, float g, float b)
+{
+    const uint8_t color[4] = {(uint8_t) (r * 255 + 0.5f), (uint8_t) (g * 255 + 0.5f), (uint8_t) (b * 255 + 0.5f), 255};
+    size_t k = count_++;
+    if (k < entries_.size()) {
+        Entry &e = entries_[k];
+        if (e.x == x && e.y == y && memcmp(e.color, color, sizeof color) == 0 && e.text == text) return;
+    } else {
+        entries_.emplace_back();
+    }
+    Entry &e = entries_[k];
+    e.text = text;
+    e.x = x;
+    e.y = y;
+    memcpy(e.color, color, sizeof color);
+    build(e);
+    e.quads.shrink_to_fit();
+    changed_ = true;
+    ++rebuilt_;
+}
+
+void TextOverlay::build(Entry &e)
+{
+    e.quads.clear();
+    float x = e.x, y = e.y - BaselineY;
+    for (char c : e.text) {
+        int glyph = (unsigned char) c - FirstChar;
+        if (glyph > 0 && glyph < CharNb) {   // nothing for the space and what the font has not
+            float u0 = float(glyph % AtlasColumns * GlyphWidth) / AtlasWidth, u1 = u0 + float(GlyphWidth) / AtlasWidth;
+            float v0 = float(glyph / AtlasColumns * GlyphHeight) / AtlasHeight, v1 = v0 + float(GlyphHeight) / AtlasHeight;
+            const float corners[4][4] = {{0, 0, u0, v0}, {GlyphWidth, 0, u1, v0}, {GlyphWidth, GlyphHeight, u1, v1}, {0, GlyphHeight, u0, v1}};
+            for (const float *k : corners) {
+                Vertex v;
+                v.u = k[2];
+                v.v = k[3];
+                memcpy(v.color, e.color, sizeof v.color);
+                v.x = x + k[0];
+                v.y = y + k[1];
+                v.z = 0;
+                e.quads.push_back(v);
+            }
+        }
+        x += GlyphWidth;
+    }
+}
+
+void TextOverlay::initGL()
+{
+    glChecked_ = true;
+
+    // one glyph per cell, rows bottom up as the font has them
+    std::vector<uint8_t> atlas(AtlasWidth * AtlasHeight, 0);
+    for (int glyph = 0; glyph < CharNb; ++glyph) {
+        int x0 = glyph % AtlasColumns * GlyphWidth, y0 = glyph / AtlasColumns * GlyphHeight;
+        for (int row = 0; row < GlyphHeight; ++row) {
+            for (int col = 0; col < GlyphWidth; ++col) {
+                if (glyphs[glyph][row] & (0x100 >> col)) atlas[(y0 + row) * AtlasWidth + x0 + col] = 255;
+            }
+        }
+    }
+    glGenTextures(1, &texture_);
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA8, AtlasWidth, AtlasHeight, 0, GL_ALPHA, GL_UNSIGNED_BYTE, atlas.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // without buffer objects (GL 1.5) the quads are drawn from client memory, still in one call
+    if (load(genBuffers, "glGenBuffers") && load(deleteBuffers, "glDeleteBuffers") &&
+        load(bindBuffer, "glBindBuffer") && load(bufferData, "glBufferData")) {
+        genBuffers(1, &buffer_);
+        hasBuffer_ = true;
+    }
+    changed_ = true;
+}
+
+void TextOverlay::draw(Stats *stats)
+{
+    if (entries_.size() > count_) {
+        entries_.resize(count_);
+        changed_ = true;
+    }
+    size_t rebuilt = rebuilt_;
+    count_ = 0;
+    rebuilt_ = 0;
+    if (!glChecked_) initGL();
+
+    Stats st;
+    st.strings = entries_.size();
+    st.rebuilt = rebuilt;
+    if (changed_) {
+        vertices_.clear();
+        for (const Entry &e : entries_) vertices_.insert(vertices_.end(), e.quads.begin(), e.quads.end());
+        if (hasBuffer_) {
+            bindBuffer(GL_ARRAY_BUFFER, buffer_);
+            bufferData(GL_ARRAY_BUFFER, vertices_.size() * sizeof(Vertex), vertices_.data(), GL_DYNAMIC_DRAW);
+            bindBuffer(GL_ARRAY_BUFFER, 0);
+            st.uploadedBytes = vertices_.size() * sizeof(Vertex);
+        }
+        changed_ = false;
+    }
+    st.glyphs = vertices_.size() / 4;
+
+    if (!vertices_.empty()) {
+        glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_TEXTURE_BIT);
+        glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+        glDisable(GL_LIGHTING);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, texture_);
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        if (hasBuffer_) bindBuffer(GL_ARRAY_BUFFER, buffer_);
+        glInterleavedArrays(GL_T2F_C4UB_V3F, 0, hasBuffer_ ? nullptr : vertices_.data());
+        glDrawArrays(GL_QUADS, 0, (GLsizei) vertices_.size());
+        if (hasBuffer_) bindBuffer(GL_ARRAY_BUFFER, 0);
+        st.drawCalls = 1;
+
+        glPopClientAttrib();
+        glPopAttrib();
+    }
+    if (stats) *stats = st;
+}
+
+void TextOverlay::releaseGL()
+{
+    if (texture_) glDeleteTextures(1, &texture_);
+    if (buffer_) deleteBuffers(1, &buffer_);
+    texture_ = buffer_ = 0;
+    glChecked_ = hasBuffer_ = false;
+    changed_ = true;
+}
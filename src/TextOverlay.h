@@ -0,0 +1,69 @@
+#ifndef TEXTOVERLAY_H
+#define TEXTOVERLAY_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Screen text in one draw call: the glyphs of the 9x15 fixed font (the one of GLUT_BITMAP_9_BY_15,
+// built in, so no GLUT is needed) are in an alpha texture atlas, and the strings of the frame are
+// textured quads in one vertex buffer. add() queues the strings, draw() draws them all. A string added
+// again unchanged (text, position, color) at the same rank as in the previous frame keeps its quads;
+// when no string changed the vertex buffer is not even uploaded.
+// draw() needs a current context, and releaseGL() before it goes; the rest is plain CPU.
+class TextOverlay
+{
+public:
+    // the advance, and the height of a glyph cell, its baseline 4 pixels up
+    static const int GlyphWidth = 9, GlyphHeight = 16;
+
+    struct Stats
+    {
+        size_t strings = 0;
+        size_t glyphs = 0;
+        size_t rebuilt = 0;         // strings whose quads were rebuilt
+        size_t uploadedBytes = 0;
+        size_t drawCalls = 0;
+    };
+
+    TextOverlay() = default;
+    TextOverlay(const TextOverlay &) = delete;
+    TextOverlay &operator=(const TextOverlay &) = delete;
+
+    // x, y: left end of the baseline, as glRasterPos2f takes it.
+    void add(float x, float y, const char *text, float r, float g, float b);
+    // Draws the strings added since the last draw() with the current projection and modelview (pixels,
+    // glOrtho(0, width, 0, height) for the glyphs to be sharp), over everything.
+    void draw(Stats *stats = nullptr);
+    void releaseGL();
+
+private:
+    // GL_T2F_C4UB_V3F, the interleaved layout of glInterleavedArrays
+    struct Vertex
+    {
+        float u, v;
+        uint8_t color[4];
+        float x, y, z;
+    };
+
+    struct Entry
+    {
+        std::string text;
+        float x, y;
+        uint8_t color[4];
+        std::vector<Vertex> quads;
+    };
+
+    void initGL();
+    static void build(Entry &e);
+
+    std::vector<Entry> entries_;        // of the previous frame, the first count_ ones of the current
+    size_t count_ = 0, rebuilt_ = 0;
+    bool changed_ = true;               // since the vertex buffer was uploaded
+    std::vector<Vertex> vertices_;
+
+    bool glChecked_ = false, hasBuffer_ = false;
+    unsigned int texture_ = 0, buffer_ = 0;
+};
+
+#endif //TEXTOVERLAY_H
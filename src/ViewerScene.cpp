@@ -0,0 +1,550 @@
+#include "ViewerScene.h"
+#include <GL/freeglut.h>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include "Point3D.h"
+#include "Point3D.inl.h"
+#include "VCGLib_Helper/LODMaker.h"
+
+#ifdef _MSC_VER
+#pragma warning (disable: 4305 4244)
+#endif
+
+MeshBuffer _mesh;
+MeshBuffer _mesh2;
+std::unique_ptr<MeshClusters> _clusters;
+std::unique_ptr<MeshClusters> _clusters2;
+std::unique_ptr<PointLOD> _pointLOD;
+
+MeshLoader _loader;
+bool pickerStale_ = false;
+
+FrameProfiler _profiler;
+TextOverlay _text;
+
+bool displayNormals_ = false;
+bool clusterCulling_ = true;
+ViewFrustum _frustum;
+
+PickingService _picker;
+std::vector<PickingService::Hit> _selection;
+int displayMode = 0;
+
+MultiResMesh _multiRes;
+MultiResMesh::Stats _multiResStats;
+
+InstancedScene _scene;
+InstancedScene::Stats _sceneStats;
+
+PointRenderer _points;
+PointRenderer::Stats _pointStats;
+
+size_t _drawnPrimitives;
+
+float lpos[] = {10, 10, 10, 0};
+float lAmbient[] = {0.2, 0.2, 0.2, 0};
+float lDiffuse[] = {1, 1, 1, 0};
+
+static const char *helpprompt[] = {"Press F1 for help", 0};
+static const char *helptext[] = {
+	"Rotate: left mouse drag",
+	" Scale: right mouse drag up/down",
+	"   Pan: middle mouse drag",
+	"  Pick: shift + left click",
+	"Select: shift + left drag (rectangle), ctrl + left drag (lasso)",
+	"Push selection out / in: e / E",
+	"",
+	"Toggle fullscreen: f",
+	"Toggle cluster culling: c",
+	"Multiresolution error: + / -",
+	"Toggle scene multi-draw indirect: b",
+	"Toggle point splats: s",
+	"Toggle frame profile: p",
+	"Toggle animation: space",
+	"Quit: escape",
+	0
+};
+
+int win_width, win_height;
+float cam_theta, cam_phi = 25, cam_dist = 8;
+float cam_pan[3];
+int help;
+
+const char *defaultModel = "../../objTUY/TUY_1071.obj";
+
+using v3f = Point3D;
+
+void drawSelection(void);
+
+void setMatColor(float r,float g,float b,float a){
+    GLfloat m[] = {r,g,b,a};
+    glMaterialfv(GL_FRONT, GL_DIFFUSE, m);
+    glColor3f(r,g,b);
+}
+
+void displayNormal(Point3D & pos, Point3D &normal, float scale)
+{
+    glLineWidth(1.0f);  // Set the line width for clarity
+    glDisable(GL_LIGHTING);
+
+    glColor3f(1,1,0);
+    glBegin(GL_LINES);
+    glVertex3f(pos[0], pos[1], pos[2]);
+    glVertex3f(pos[0]+ normal[0]*scale, pos[1]+normal[1]*scale, pos[2]+normal[2]*scale);
+    glEnd();
+
+    glEnable(GL_LIGHTING);
+    glLineWidth(1.0f);  // Reset the line width
+}
+
+// Faces faceIds[begin, end) (faces begin..end-1 without faceIds), with their normals when there are some.
+void displayFaces(const std::vector<uint32_t> &indices, const std::vector<v3f> &vertices, const std::vector<v3f> &normals,
+                  const uint32_t *faceIds, size_t begin, size_t end)
+{
+    bool hasNormals = !normals.empty();
+    _drawnPrimitives += end - begin;
+    glBegin(GL_TRIANGLES);
+    for(size_t k = begin; k < end; ++k) {
+        uint32_t i = faceIds ? faceIds[k] : (uint32_t) k;
+        if(hasNormals) glNormal3f(normals[i][0], normals[i][1], normals[i][2]);
+        for(int j = 0; j < 3; ++j) {
+            const v3f &v = vertices[indices[i*3+j]];
+            glVertex3f(v[0], v[1], v[2]);
+        }
+    }
+    glEnd();
+
+    if(hasNormals && displayNormals_){
+        for(size_t k = begin; k < end; ++k) {
+            uint32_t i = faceIds ? faceIds[k] : (uint32_t) k;
+            v3f pos = (vertices[indices[i*3]]+vertices[indices[i*3+1]]+vertices[indices[i*3+2]])/3;
+            v3f n = normals[i];
+            displayNormal(pos, n, 0.05);
+        }
+    }
+}
+
+void displayMesh(std::vector<uint32_t> &indices, std::vector<v3f> &vertices, std::vector<v3f> &normals, MeshClusters *clusters = nullptr)
+{
+    if(indices.empty())
+    {
+        // point cloud, lit only when it has its per vertex normals
+        bool lit = normals.size() == vertices.size();
+        if(!lit) glDisable(GL_LIGHTING);
+        glPointSize(2.0f);
+        _drawnPrimitives += vertices.size();
+        glBegin(GL_POINTS);
+        for(size_t i = 0; i < vertices.size(); ++i) {
+            if(lit) glNormal3f(normals[i][0], normals[i][1], normals[i][2]);
+            glVertex3f(vertices[i][0], vertices[i][1], vertices[i][2]);
+        }
+        glEnd();
+        glPointSize(1.0f);
+        if(!lit) glEnable(GL_LIGHTING);
+
+        if(lit && displayNormals_){
+            for(size_t i = 0; i < vertices.size(); ++i) {
+                displayNormal(vertices[i], normals[i], 0.01);
+            }
+        }
+    }
+    else if(clusterCulling_ && clusters && !clusters->empty())
+    {
+        static std::vector<MeshClusters::Range> ranges;
+        FrameProfiler::Phase previous = _profiler.enter(FrameProfiler::Cull);
+        clusters->cull(_frustum, glIsEnabled(GL_CULL_FACE), ranges);
+        _profiler.enter(previous);
+        for(const MeshClusters::Range &r : ranges) {
+            displayFaces(indices, vertices, normals, clusters->faces.data(), r.faceBegin, r.faceEnd);
+        }
+    }
+    else
+    {
+        displayFaces(indices, vertices, normals, nullptr, 0, indices.size()/3);
+    }
+}
+
+void drawCoordinateAxis() {
+    glLineWidth(2.0f);  // Set the line width for clarity
+
+    if(displayMode == 0){
+        glDisable(GL_LIGHTING);
+    }
+
+    // X-axis (red)
+    //setMatColor(1,0,0,0);
+    glColor3f(1,0,0);
+    glBegin(GL_LINES);
+    glVertex3f(-cam_pan[0], -cam_pan[1], -cam_pan[2]);
+    glVertex3f(-cam_pan[0]+1, -cam_pan[1], -cam_pan[2]);
+    glEnd();
+
+    // Y-axis (green)
+    glColor3f(0,1,0);
+    glBegin(GL_LINES);
+    glVertex3f(-cam_pan[0], -cam_pan[1], -cam_pan[2]);
+    glVertex3f(-cam_pan[0], -cam_pan[1]+1, -cam_pan[2]);
+    glEnd();
+
+    // Z-axis (blue)
+    glColor3f(0,0,1);
+    glBegin(GL_LINES);
+    glVertex3f(-cam_pan[0], -cam_pan[1], -cam_pan[2]);
+    glVertex3f(-cam_pan[0], -cam_pan[1], -cam_pan[2]+1);
+    glEnd();
+
+    if(displayMode == 0){
+        glEnable(GL_LIGHTING);
+    }
+    glLineWidth(1.0f);  // Reset the line width
+}
+
+#define ZNEAR	0.05f
+#define ZFAR	5000.0f
+
+// The camera matrices are built on the CPU (vcg row major layout) so that the cluster culling and the
+// headless report see exactly what GL draws.
+vcg::Matrix44f projectionMatrix(float aspect)
+{
+	float vsz = 0.4663f * ZNEAR;
+	float r = aspect * vsz, t = vsz;
+	vcg::Matrix44f m;
+	m.SetZero();
+	m.ElementAt(0, 0) = ZNEAR / r;
+	m.ElementAt(1, 1) = ZNEAR / t;
+	m.ElementAt(2, 2) = -(ZFAR + ZNEAR) / (ZFAR - ZNEAR);
+	m.ElementAt(2, 3) = -2 * ZFAR * ZNEAR / (ZFAR - ZNEAR);
+	m.ElementAt(3, 2) = -1;
+	return m;
+}
+
+vcg::Matrix44f modelviewMatrix(float theta, float phi, float dist, const float pan[3])
+{
+	vcg::Matrix44f t, rx, ry, p;
+	t.SetTranslate(0, 0, -dist);
+	rx.SetRotateDeg(phi, vcg::Point3f(1, 0, 0));
+	ry.SetRotateDeg(theta, vcg::Point3f(0, 1, 0));
+	p.SetTranslate(pan[0], pan[1], pan[2]);
+	return t * rx * ry * p;
+}
+
+void loadMatrix(const vcg::Matrix44f &m)
+{
+	vcg::Matrix44f gl = m;
+	vcg::Transpose(gl);
+	glLoadMatrixf(gl.V());
+}
+
+PickingService::Camera pickCamera(const vcg::Matrix44f &modelview, int width, int height)
+{
+	PickingService::Camera camera;
+	camera.projection = projectionMatrix((float)width / (float)height);
+	camera.modelview = modelview;
+	camera.viewport[0] = camera.viewport[1] = 0;
+	camera.viewport[2] = width;
+	camera.viewport[3] = height;
+	return camera;
+}
+
+vcg::Box3f sceneBox()
+{
+	if(!_scene.empty()) return _scene.bounds();
+	vcg::Box3f box;
+	for(const MeshBuffer *m : {&_mesh, &_mesh2}) {
+		if(m->vertices.empty()) continue;
+		box.Add(vcg::Point3f(m->bbMin.x, m->bbMin.y, m->bbMin.z));
+		box.Add(vcg::Point3f(m->bbMax.x, m->bbMax.y, m->bbMax.z));
+	}
+	return box;
+}
+
+void drawMultiRes(const vcg::Matrix44f &modelview)
+{
+	FrameProfiler::Phase previous = _profiler.enter(FrameProfiler::Cull);
+	_multiRes.update(projectionMatrix((float)win_width / (float)win_height), modelview, win_height, &_multiResStats);
+	_profiler.enter(previous);
+	for(const MultiResMesh::Patch *p : _multiRes.cut()) {
+		displayFaces(p->indices, p->vertices, p->normals, nullptr, 0, p->indices.size() / 3);
+	}
+}
+
+void drawInstancedScene(const vcg::Matrix44f &modelview)
+{
+	FrameProfiler::Phase previous = _profiler.enter(FrameProfiler::Cull);
+	_scene.cull(projectionMatrix((float)win_width / (float)win_height), modelview, win_height, &_sceneStats);
+	_profiler.enter(previous);
+	_scene.draw(&_sceneStats);
+	_drawnPrimitives += _sceneStats.faces;
+}
+
+void drawPointCloud(void)
+{
+	float pixelScale = projectionMatrix((float)win_width / (float)win_height).ElementAt(1, 1) * win_height / 2;
+	_points.draw(_mesh, *_pointLOD, pixelScale, &_pointStats);
+	_drawnPrimitives += _pointStats.drawn;
+	if(displayNormals_ && _mesh.normals.size() == _mesh.vertices.size()) {
+		for(size_t i = 0; i < _pointStats.drawn; ++i) {
+			displayNormal(_mesh.vertices[i], _mesh.normals[i], 0.01);
+		}
+	}
+}
+
+// Instances of the two meshes on a grid, randomly turned and scaled, with 8 materials. Each mesh is
+// an asset with up to 3 coarser levels, quadric decimated to a quarter of the faces of the previous one.
+void buildScene(int instances)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    _scene.clear();
+    std::vector<uint32_t> assets;
+    float spacing = 0;
+    for(const MeshBuffer *m : {&_mesh, &_mesh2}) {
+        if(m->indices.empty()) continue;
+        uint32_t asset = _scene.addAsset();
+        // centered: the instance transforms place the levels
+        MeshBuffer level = *m;
+        level.translate(Point3D(0,0,0) - (m->bbMin + m->bbMax) / 2);
+        _scene.addLevel(asset, level);
+        spacing = std::max(spacing, 1.5f * (float)Norm(m->bbMax - m->bbMin));
+
+        CMeshO cmesh = VCG_CMesh0_Helper::constructCMesh(level.indices, level.vertices, std::vector<Point3D>());
+        LODMaker::repairAndPrepareForDecimation(cmesh);
+        for(size_t faces = level.indices.size() / 12; faces >= 64 && _scene.levelNb(asset) < 4; faces /= 4) {
+            LODMaker::decimateMesh(faces, cmesh);
+            MeshBuffer coarse;
+            VCG_CMesh0_Helper::retrieveCMeshData(cmesh, coarse.indices, coarse.vertices, coarse.normals);
+            coarse.rebuild();
+            _scene.addLevel(asset, coarse);
+        }
+        assets.push_back(asset);
+    }
+    if(assets.empty()) {
+        printf("scene: no mesh with faces\n");
+        return;
+    }
+
+    static const float colors[8][3] = {{1, 1, 1}, {1, 0.8, 0.2}, {0.9, 0.3, 0.2}, {0.3, 0.8, 0.3},
+                                       {0.3, 0.5, 1}, {0.8, 0.4, 0.9}, {0.2, 0.8, 0.8}, {0.6, 0.6, 0.6}};
+    for(const float *c : colors) _scene.addMaterial(c[0], c[1], c[2]);
+    int side = (int)ceil(sqrt((double)instances));
+    srand(7);
+    for(int i = 0; i < instances; ++i) {
+        vcg::Matrix44f t, r, sc;
+        t.SetTranslate((i % side - (side - 1) / 2.0f) * spacing, 0, (i / side - (side - 1) / 2.0f) * spacing);
+        r.SetRotateDeg(rand() % 360, vcg::Point3f(0, 1, 0));
+        float k = 0.75f + 0.5f * rand() / (float)RAND_MAX;
+        sc.SetScale(k, k, k);
+        _scene.addInstance(assets[i % assets.size()], t * r * sc, rand() % 8);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    printf("scene: %d instances of %zu assets (%zu and %zu levels) built in %lld ms\n", instances, assets.size(),
+           _scene.levelNb(assets[0]), _scene.levelNb(assets.back()),
+           (long long)std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+}
+
+bool adoptMeshes()
+{
+    MeshBuffer *meshes[2] = {&_mesh, &_mesh2};
+    std::unique_ptr<MeshClusters> *clusters[2] = {&_clusters, &_clusters2};
+    bool changed = false;
+    for(int slot = 0; slot < 2; ++slot) {
+        std::unique_ptr<MeshLoader::Snapshot> snapshot = _loader.take(slot);
+        if(!snapshot) continue;
+        *meshes[slot] = std::move(snapshot->mesh);
+        *clusters[slot] = std::move(snapshot->clusters);
+        if(slot == 0) _pointLOD = std::move(snapshot->points);
+        printf("mesh %d %s: %zu faces, %zu vertices at %.0f ms\n", slot, snapshot->level == MeshLoader::Final ? "final" : "proxy",
+               meshes[slot]->indices.size() / 3, meshes[slot]->vertices.size(), snapshot->millis);
+        if(snapshot->level == MeshLoader::Final) pickerStale_ = true;
+        changed = true;
+    }
+    if(changed) _selection.clear();
+
+    // the picker copies the meshes: only rebuilt for the final ones, between two queries
+    if(pickerStale_ && !_picker.busy()) {
+        auto start = std::chrono::high_resolution_clock::now();
+        _picker.clear();
+        _picker.addMesh(_mesh);
+        _picker.addMesh(_mesh2);
+        auto end = std::chrono::high_resolution_clock::now();
+        printf("picking bvh built in %lld ms\n", (long long)std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+        pickerStale_ = false;
+    }
+    return changed;
+}
+
+// The edit goes through MeshBuffer::setVertex() and update(): only the normals of the faces around the
+// moved vertices and the bbox are refreshed. The clusters of an edited mesh are built again, the picker
+// is rebuilt by adoptMeshes() between two queries. The viewer draws from the CPU buffers, so the upload
+// ranges are only printed: what a GPU copy of the mesh would re-upload.
+size_t pushSelection(float distance)
+{
+    MeshBuffer *meshes[2] = {&_mesh, &_mesh2};
+    std::unique_ptr<MeshClusters> *clusters[2] = {&_clusters, &_clusters2};
+    size_t renormalized = 0;
+    for(uint32_t mi = 0; mi < 2; ++mi) {
+        MeshBuffer &mb = *meshes[mi];
+        std::vector<Point3D> push;
+        std::vector<uint32_t> moved;
+        for(const PickingService::Hit &h : _selection) {
+            if(h.mesh != mi) continue;
+            if(push.empty()) push.assign(mb.vertices.size(), Point3D(0, 0, 0));
+            for(int j = 0; j < 3; ++j) {
+                uint32_t v = mb.indices[h.face*3+j];
+                if(push[v] == Point3D(0, 0, 0)) moved.push_back(v);
+                push[v] += mb.normals[h.face];
+            }
+        }
+        if(moved.empty()) continue;
+
+        mb.clearUploadRanges();
+        for(uint32_t v : moved) {
+            Point3D n = push[v];
+            n.Normalize();
+            mb.setVertex(v, mb.vertices[v] + n * distance);
+        }
+        size_t faces = mb.update();
+        renormalized += faces;
+        if(*clusters[mi]) (*clusters[mi])->build(mb);
+
+        const MeshBuffer::DirtyRanges &upload = mb.uploadRanges();
+        size_t vertexNb = 0, faceNb = 0;
+        for(const MeshBuffer::Range &r : upload.vertices) vertexNb += r.end - r.begin;
+        for(const MeshBuffer::Range &r : upload.faces) faceNb += r.end - r.begin;
+        printf("mesh %u: %zu vertices moved, %zu normals recomputed; upload ranges: %zu vertices in %zu, %zu faces in %zu\n",
+               mi, moved.size(), faces, vertexNb, upload.vertices.size(), faceNb, upload.faces.size());
+        mb.clearUploadRanges();
+    }
+    if(renormalized) pickerStale_ = true;
+    return renormalized;
+}
+
+static bool endsWith(const char *s, const char *suffix)
+{
+    size_t n = strlen(s), m = strlen(suffix);
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+// An .obj without faces is shown as a point cloud, an .mrm is drawn view dependently.
+bool openModel(const char *model)
+{
+    if(endsWith(model, ".mrm")) {
+        if(!_multiRes.open(model)) {
+            std::cout << "can not read " << model << "\n";
+            return false;
+        }
+        cam_dist = 3 * _multiRes.radius();
+        for(int k = 0; k < 3; ++k) cam_pan[k] = -_multiRes.center()[k];
+    } else {
+        Point3D offsets[2] = {Point3D(-0.15,0,0), Point3D(0.15,0,0)};
+        _loader.start(model, offsets);
+    }
+    return true;
+}
+
+void initGLState(void)
+{
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+	glEnable(GL_LIGHTING);
+	glEnable(GL_LIGHT0);
+
+    glLightfv(GL_LIGHT0, GL_POSITION, lpos);
+    glLightfv(GL_LIGHT0, GL_AMBIENT, lAmbient);
+    glLightfv(GL_LIGHT0, GL_DIFFUSE, lDiffuse);
+    //glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
+    //glCullFace(GL_BACK);
+}
+
+// The scene without the overlays, no GLUT calls: the headless benchmark draws it too.
+void renderScene(const vcg::Matrix44f &modelview)
+{
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	_frustum.set(projectionMatrix((float)win_width / (float)win_height), modelview);
+
+	glMatrixMode(GL_MODELVIEW);
+	loadMatrix(modelview);
+
+
+    setMatColor(1,1,1,0);
+	glBegin(GL_QUADS);
+	glNormal3f(0, 1, 0);
+	glVertex3f(-5, -1.3, 5);
+	glVertex3f(5, -1.3, 5);
+	glVertex3f(5, -1.3, -5);
+	glVertex3f(-5, -1.3, -5);
+	glEnd();
+
+    setMatColor(1,1,1,0);
+    if(_multiRes.isOpen()) {
+        drawMultiRes(modelview);
+    } else if(!_scene.empty()) {
+        drawInstancedScene(modelview);
+    } else if(_pointLOD && !_pointLOD->empty()) {
+        drawPointCloud();
+    } else {
+        displayMesh(_mesh.indices, _mesh.vertices, _mesh.normals, _clusters.get());
+        setMatColor(1,0.8,0.2,0);
+        displayMesh(_mesh2.indices, _mesh2.vertices, _mesh2.normals, _clusters2.get());
+    }
+
+    drawSelection();
+    drawCoordinateAxis();
+}
+
+void drawSelection(void)
+{
+    if(_selection.empty()) return;
+    MeshBuffer *meshes[2] = {&_mesh, &_mesh2};
+
+    glPushAttrib(GL_ENABLE_BIT | GL_POLYGON_BIT | GL_DEPTH_BUFFER_BIT);
+    glDisable(GL_LIGHTING);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(-1, -1);
+    glDepthFunc(GL_LEQUAL);
+    glColor3f(1, 0.1, 0.1);
+    glBegin(GL_TRIANGLES);
+    for(const PickingService::Hit &h : _selection) {
+        const MeshBuffer &mb = *meshes[h.mesh];
+        for(int j = 0; j < 3; ++j) {
+            const v3f &v = mb.vertices[mb.indices[h.face*3+j]];
+            glVertex3f(v[0], v[1], v[2]);
+        }
+    }
+    glEnd();
+    glPopAttrib();
+}
+
+void print_help(void)
+{
+	int i;
+	const char **text;
+
+	glPushAttrib(GL_ENABLE_BIT);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_DEPTH_TEST);
+
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0, win_width, 0, win_height, -1, 1);
+
+	text = help ? helptext : helpprompt;
+
+	for(i=0; text[i]; i++) {
+		_text.add(7, win_height - (i + 1) * 20 - 2, text[i], 0, 0.1, 0);
+		_text.add(5, win_height - (i + 1) * 20, text[i], 0, 0.9, 0);
+	}
+	_text.draw();
+
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+
+	glPopAttrib();
+}
@@ -0,0 +1,83 @@
+#ifndef VIEWERSCENE_H
+#define VIEWERSCENE_H
+
+#include <memory>
+#include <vector>
+#include <cstdio>
+#include "MeshBuffer.h"
+#include "MeshClusters.h"
+#include "PickingService.h"
+#include "MultiResMesh.h"
+#include "MeshLoader.h"
+#include "FrameProfiler.h"
+#include "InstancedScene.h"
+#include "TextOverlay.h"
+#include "PointRenderer.h"
+
+// What the viewer draws and how, shared by the GLUT viewer (3dview.cpp) and the headless tools: the two
+// meshes of the loader, or the multiresolution mesh, the instanced scene or the point cloud that replace
+// them, the camera and the fixed function state. renderScene() and print_help() make no GLUT calls, so
+// the tools draw the frames of the viewer into an offscreen context.
+
+extern MeshBuffer _mesh;
+extern MeshBuffer _mesh2;
+extern std::unique_ptr<MeshClusters> _clusters;
+extern std::unique_ptr<MeshClusters> _clusters2;
+extern std::unique_ptr<PointLOD> _pointLOD;     // levels of _mesh when it is a final point cloud
+
+extern MeshLoader _loader;                      // fills the two meshes above, proxies first
+extern bool pickerStale_;                       // final meshes arrived, the picker still has the old ones
+
+extern FrameProfiler _profiler;
+extern TextOverlay _text;                       // help and profile text, one draw call
+
+extern bool displayNormals_;
+extern bool clusterCulling_;
+
+extern PickingService _picker;                  // _mesh is its mesh 0, _mesh2 its mesh 1
+extern std::vector<PickingService::Hit> _selection;
+extern int displayMode;
+
+extern MultiResMesh _multiRes;                  // replaces the two meshes when a .mrm file is given
+extern MultiResMesh::Stats _multiResStats;      // of the last cut drawn
+
+extern InstancedScene _scene;                   // instances of the two meshes drawn in their place
+extern InstancedScene::Stats _sceneStats;       // of the last frame
+
+extern PointRenderer _points;                   // draws _mesh by _pointLOD, a prefix sized to the frame time
+extern PointRenderer::Stats _pointStats;        // of the last frame
+
+extern size_t _drawnPrimitives;                 // triangles, or points of point clouds, submitted since the last reset
+
+extern float lpos[4];
+extern float lAmbient[4];
+extern float lDiffuse[4];
+
+extern int win_width, win_height;
+extern float cam_theta, cam_phi, cam_dist;
+extern float cam_pan[3];
+extern int help;
+
+extern const char *defaultModel;
+
+// An .mrm is opened as _multiRes with the camera on it; any other model starts loading into the two meshes.
+// Returns false when the .mrm can not be read.
+bool openModel(const char *model);
+// Takes the snapshots published by the loader. Returns true when a mesh changed.
+bool adoptMeshes();
+void buildScene(int instances);
+// Moves the vertices of the selected faces by distance along the mean normal of their selected faces. Returns
+// the number of faces whose normal was recomputed.
+size_t pushSelection(float distance);
+vcg::Box3f sceneBox();
+
+vcg::Matrix44f projectionMatrix(float aspect);
+vcg::Matrix44f modelviewMatrix(float theta, float phi, float dist, const float pan[3]);
+void loadMatrix(const vcg::Matrix44f &m);
+PickingService::Camera pickCamera(const vcg::Matrix44f &modelview, int width, int height);
+
+void initGLState(void);
+void renderScene(const vcg::Matrix44f &modelview);
+void print_help(void);
+
+#endif // VIEWERSCENE_H
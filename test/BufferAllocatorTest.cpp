@@ -0,0 +1,145 @@
+// Streams LOD levels of 4 KB to 2 MB in and out of a 64 MB BufferArena (some pinned, a third touched
+// per frame, one in 30 replaced, the others evicted when the arena is full) and 1 to 2 MB of instance
+// data per frame through a StreamRing of three frames. Checks the invariants of the arena every frame
+// and the content of every live block every 10 frames, on the mock backend, defragmenting in place
+// then into a second buffer, and on GL 4.4 offscreen when there is one.
+// Usage: BufferAllocatorTest [frames]. Fails on a corrupted block, a broken frame, a misuse of the
+// mock backend, a mock buffer left or a mock peak over the budget.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <map>
+#include <vector>
+#include "GpuBufferAllocator.h"
+#include "MockBufferBackend.h"
+#include "GLBufferBackend.h"
+#include "OffscreenContext.h"
+
+struct Result
+{
+    size_t corrupted = 0, broken = 0;
+};
+
+// headroom: the defragmentHeadroom of the arena, 0 defragments in place.
+Result streamLevels(GpuBufferBackend &backend, const char *name, int frames, size_t headroom)
+{
+    Result res;
+    BufferArena arena;
+    StreamRing ring;
+    if(!arena.init(&backend, 64u << 20) || !ring.init(&backend, 6u << 20)) {
+        printf("%s: can not create the buffers\n", name);
+        res.broken = 1;
+        return res;
+    }
+    arena.defragmentHeadroom = headroom;
+    struct Level
+    {
+        size_t size;
+        uint8_t seed;
+    };
+    std::map<BufferArena::Handle, Level> levels;
+    arena.onEvict = [&levels](BufferArena::Handle h) { levels.erase(h); };
+    auto pattern = [](uint8_t seed, size_t i) { return (uint8_t)(seed + i * 31); };
+
+    srand(1);
+    size_t streamed = 0;
+    float maxFragmentation = 0;
+    double allocMicros = 0;
+    size_t defragmentations = 0;
+    for(int frame = 0; frame < frames; ++frame) {
+        for(int k = 0; k < 4; ++k) {
+            size_t size = (256 + rand() % 256) << 10;
+            StreamRing::Span span = ring.allocate(size, 16);
+            if(span.data) memset(span.data, frame, size);
+        }
+        ring.endFrame();
+
+        // new levels, small ones more often
+        for(int k = 0; k < 6; ++k) {
+            size_t size = size_t(4096) << (rand() % 10);
+            uint8_t seed = (uint8_t)rand();
+            auto start = std::chrono::high_resolution_clock::now();
+            BufferArena::Handle h = arena.allocate(size, 24, rand() % 20 != 0);
+            allocMicros += std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+            if(!h) continue;
+            uint8_t *data = (uint8_t *)arena.data(h);
+            for(size_t i = 0; i < size; ++i) data[i] = pattern(seed, i);
+            levels[h] = Level{size, seed};
+            streamed += size;
+        }
+        std::vector<BufferArena::Handle> handles;
+        for(const auto &l : levels) handles.push_back(l.first);
+        for(BufferArena::Handle h : handles) {
+            int r = rand() % 30;
+            if(r < 10) arena.touch(h);
+            else if(r == 10) {
+                arena.free(h);
+                levels.erase(h);
+            }
+        }
+
+        if(!arena.check()) ++res.broken;
+        maxFragmentation = std::max(maxFragmentation, arena.fragmentation());
+        if(frame % 10 == 9) {
+            // the copies of a defragmentation run on the GPU: wait for them before reading
+            if(arena.stats().defragmentations != defragmentations) {
+                uint64_t fence = backend.fence();
+                backend.wait(fence);
+                backend.release(fence);
+            }
+            defragmentations = arena.stats().defragmentations;
+            for(const auto &l : levels) {
+                const uint8_t *data = (const uint8_t *)arena.data(l.first);
+                for(size_t i = 0; i < l.second.size; ++i) {
+                    if(data[i] != pattern(l.second.seed, i)) {
+                        ++res.corrupted;
+                        break;
+                    }
+                }
+            }
+        }
+        arena.endFrame();
+    }
+
+    BufferArena::Stats st = arena.stats();
+    printf("%s: %d frames, %.0f MB streamed, %zu allocations (%.2f us), %zu failed, %zu evictions\n", name, frames,
+           streamed / 1048576.0, st.allocations, st.allocations ? allocMicros / st.allocations : 0.0, st.failures, st.evictions);
+    printf("%s: %zu defragmentations moving %.0f MB, fragmentation max %.2f, %zu ring stalls, %zu corrupted blocks, %zu broken frames\n",
+           name, st.defragmentations, st.movedBytes / 1048576.0, maxFragmentation, ring.stats().stalls, res.corrupted, res.broken);
+    return res;
+}
+
+int main(int argc, char **argv)
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 300;
+    bool ok = true;
+
+    // in place within the 70 MB of the arena and the ring, then into a second buffer with 64 MB more
+    for(size_t headroom : {size_t(0), size_t(64) << 20}) {
+        MockBufferBackend mock;
+        const char *name = headroom ? "mock+headroom" : "mock";
+        size_t budget = (size_t(70) << 20) + headroom;
+        Result res = streamLevels(mock, name, frames, headroom);
+        printf("%s: peak %.0f MB in buffers of a %zu MB budget, %zu fence waits, %zu misuses, "
+               "%zu buffers and %zu fences left\n", name, mock.peakBytes() / 1048576.0, budget >> 20,
+               mock.waits(), mock.errors(), mock.liveBuffers(), mock.liveFences());
+        ok = ok && res.corrupted == 0 && res.broken == 0 && mock.errors() == 0 && mock.liveBuffers() == 0 &&
+             mock.liveFences() == 0 && mock.peakBytes() <= budget;
+    }
+
+    OffscreenContext context;
+    GLBufferBackend gl;
+    if(context.create(64, 64) && gl.init()) {
+        for(size_t headroom : {size_t(0), size_t(64) << 20}) {
+            Result res = streamLevels(gl, headroom ? "gl+headroom" : "gl", frames, headroom);
+            ok = ok && res.corrupted == 0 && res.broken == 0;
+        }
+    } else {
+        printf("gl: no GL 4.4 offscreen context\n");
+    }
+
+    printf(ok ? "passed\n" : "FAILED\n");
+    return ok ? 0 : 1;
+}
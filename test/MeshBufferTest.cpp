@@ -0,0 +1,130 @@
+// Edits a 200x200 vertex grid through MeshBuffer::setVertex()/update() and checks against a full
+// recomputation: the face normals, the bbox (grown, then shrunk by moving its extreme vertex back) and the
+// upload ranges (sorted, disjoint, covering every vertex moved and every face whose normal changed, and one
+// range per edited region when the regions are further than mergeGap apart).
+// Usage: MeshBufferTest. Fails when a check does not hold.
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include "MeshBuffer.h"
+
+static bool check(bool ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+    return ok;
+}
+
+static bool sameNormals(const MeshBuffer &mesh)
+{
+    std::vector<Point3D> normals;
+    NormalEngine::computeFaceNormals(mesh.indices, mesh.vertices, normals);
+    for(size_t f = 0; f < normals.size(); ++f) {
+        if(Norm(normals[f] - mesh.normals[f]) > 1e-5f) return false;
+    }
+    return true;
+}
+
+static bool sameBBox(const MeshBuffer &mesh)
+{
+    MeshBuffer full;
+    full.indices = mesh.indices;
+    full.vertices = mesh.vertices;
+    full.rebuild();
+    return full.bbMin == mesh.bbMin && full.bbMax == mesh.bbMax;
+}
+
+// Sorted, disjoint, and covering the items.
+static bool covers(const std::vector<MeshBuffer::Range> &ranges, const std::vector<uint32_t> &items)
+{
+    for(size_t i = 0; i < ranges.size(); ++i) {
+        if(ranges[i].begin >= ranges[i].end) return false;
+        if(i > 0 && ranges[i].begin <= ranges[i-1].end) return false;
+    }
+    for(uint32_t item : items) {
+        bool in = false;
+        for(const MeshBuffer::Range &r : ranges) in = in || (item >= r.begin && item < r.end);
+        if(!in) return false;
+    }
+    return true;
+}
+
+static size_t elements(const std::vector<MeshBuffer::Range> &ranges)
+{
+    size_t n = 0;
+    for(const MeshBuffer::Range &r : ranges) n += r.end - r.begin;
+    return n;
+}
+
+int main()
+{
+    const uint32_t side = 200;
+    MeshBuffer mesh;
+    for(uint32_t y = 0; y < side; ++y) {
+        for(uint32_t x = 0; x < side; ++x) {
+            mesh.vertices.push_back(Point3D(x, y, 0.1f * sin(0.3f * x) * cos(0.2f * y)));
+        }
+    }
+    for(uint32_t y = 0; y + 1 < side; ++y) {
+        for(uint32_t x = 0; x + 1 < side; ++x) {
+            uint32_t v = y * side + x;
+            mesh.indices.insert(mesh.indices.end(), {v, v + 1, v + side, v + 1, v + side + 1, v + side});
+        }
+    }
+    mesh.rebuild();
+    // the rows of a patch are side vertices apart: they merge into one range
+    mesh.mergeGap = 2 * side;
+    bool ok = check(mesh.uploadRanges().vertices.size() == 1 && elements(mesh.uploadRanges().vertices) == mesh.vertices.size() &&
+                    elements(mesh.uploadRanges().faces) == mesh.indices.size() / 3, "rebuild uploads everything");
+    mesh.clearUploadRanges();
+
+    // two 3x3 patches far apart, the second one raised above the bbox
+    std::vector<uint32_t> moved;
+    for(uint32_t y = 10; y < 13; ++y) {
+        for(uint32_t x = 10; x < 13; ++x) moved.push_back(y * side + x);
+    }
+    for(uint32_t y = 150; y < 153; ++y) {
+        for(uint32_t x = 150; x < 153; ++x) moved.push_back(y * side + x);
+    }
+    std::vector<Point3D> oldNormals = mesh.normals;
+    for(uint32_t v : moved) mesh.setVertex(v, mesh.vertices[v] + Point3D(0.1f, -0.2f, v > side * 100 ? 5.0f : 0.3f));
+    size_t renormalized = mesh.update();
+
+    std::vector<uint32_t> changed;
+    for(uint32_t f = 0; f < oldNormals.size(); ++f) {
+        if(!(oldNormals[f] == mesh.normals[f])) changed.push_back(f);
+    }
+    ok = check(sameNormals(mesh), "normals after the edit") && ok;
+    ok = check(renormalized >= changed.size() && renormalized < 200, "only the faces around the moved vertices recomputed") && ok;
+    ok = check(sameBBox(mesh) && mesh.bbMax.z > 5, "bbox grown by the edit") && ok;
+    const MeshBuffer::DirtyRanges &upload = mesh.uploadRanges();
+    ok = check(covers(upload.vertices, moved) && upload.vertices.size() == 2, "vertex ranges, one per patch") && ok;
+    ok = check(covers(upload.faces, changed) && upload.faces.size() == 2, "face ranges, one per patch") && ok;
+    ok = check(elements(upload.vertices) < mesh.vertices.size() / 10 && elements(upload.faces) < mesh.indices.size() / 30,
+               "ranges not spanning the mesh between the patches") && ok;
+
+    // the raised patch back down: the bbox shrinks, the ranges accumulate
+    for(uint32_t v : moved) {
+        if(v > side * 100) mesh.setVertex(v, mesh.vertices[v] - Point3D(0, 0, 5.0f));
+    }
+    mesh.update();
+    ok = check(sameNormals(mesh), "normals after the second edit") && ok;
+    ok = check(sameBBox(mesh) && mesh.bbMax.z < 1, "bbox shrunk by the second edit") && ok;
+    ok = check(covers(mesh.uploadRanges().vertices, moved) && mesh.uploadRanges().vertices.size() == 2,
+               "ranges accumulated over the two edits") && ok;
+
+    // a vertex next to the first patch joins its range
+    mesh.setVertex(13 * side + 14, mesh.vertices[13 * side + 14] + Point3D(0, 0, 0.5f));
+    mesh.update();
+    moved.push_back(13 * side + 14);
+    ok = check(sameNormals(mesh) && covers(mesh.uploadRanges().vertices, moved) && mesh.uploadRanges().vertices.size() == 2,
+               "an edit within mergeGap of a range merged into it") && ok;
+
+    mesh.clearUploadRanges();
+    mesh.translate(Point3D(1, 2, 3));
+    ok = check(sameBBox(mesh) && mesh.uploadRanges().vertices.size() == 1 &&
+               elements(mesh.uploadRanges().vertices) == mesh.vertices.size() && mesh.uploadRanges().faces.empty(),
+               "translate uploads the vertices only") && ok;
+
+    printf(ok ? "passed\n" : "FAILED\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+// Orbits both meshes of a model while dollying in from 2 to 0.25 bbox diagonals, and prints how many
+// clusters and faces the culling keeps per frame. No window is opened.
+// Usage: CullReport [model.obj] [frames]
+#include <cstdio>
+#include <cstdlib>
+#include "ViewerScene.h"
+
+void cullReport(int frames)
+{
+	vcg::Box3f box = sceneBox();
+	if(box.IsNull()) return;
+
+	float diag = box.Diag();
+	float pan[3] = {-box.Center()[0], -box.Center()[1], -box.Center()[2]};
+	vcg::Matrix44f proj = projectionMatrix(1600.0f / 900.0f);
+	frames = std::max(frames, 2);
+
+	MeshClusters *clusters[2] = {_clusters.get(), _clusters2.get()};
+	std::vector<MeshClusters::Range> ranges;
+	size_t totalFaces = 0, drawnFaces = 0, frustumCulled = 0, backfaceCulled = 0, clusterNb = 0;
+
+	printf("frame  dist  clusters  frustum-culled  backface-culled  drawn-faces / faces\n");
+	for(int i = 0; i < frames; ++i) {
+		float t = float(i) / (frames - 1);
+		float dist = diag * (2.0f - 1.75f * t);
+		ViewFrustum frustum;
+		frustum.set(proj, modelviewMatrix(360.0f * t, 25.0f, dist, pan));
+
+		MeshClusters::Stats frame;
+		size_t faceNb = 0;
+		for(MeshClusters *c : clusters) {
+			if(!c || c->empty()) continue;
+			MeshClusters::Stats st;
+			c->cull(frustum, true, ranges, &st);
+			frame.clusterNb += st.clusterNb;
+			frame.frustumCulled += st.frustumCulled;
+			frame.backfaceCulled += st.backfaceCulled;
+			frame.drawnFaces += st.drawnFaces;
+			faceNb += c->faces.size();
+		}
+		printf("%5d %5.2f %9zu %15zu %16zu %12zu / %zu\n", i, dist, frame.clusterNb, frame.frustumCulled,
+		       frame.backfaceCulled, frame.drawnFaces, faceNb);
+
+		clusterNb += frame.clusterNb;
+		frustumCulled += frame.frustumCulled;
+		backfaceCulled += frame.backfaceCulled;
+		drawnFaces += frame.drawnFaces;
+		totalFaces += faceNb;
+	}
+	printf("total: %zu/%zu clusters frustum culled, %zu backface culled, %zu/%zu faces drawn (%.1f%%)\n",
+	       frustumCulled, clusterNb, backfaceCulled, drawnFaces, totalFaces,
+	       totalFaces ? 100.0 * drawnFaces / totalFaces : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    if(!openModel(argc > 1 ? argv[1] : defaultModel)) return 1;
+    _loader.wait();
+    adoptMeshes();
+    cullReport(argc > 2 ? atoi(argv[2]) : 120);
+    return 0;
+}
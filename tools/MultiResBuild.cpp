@@ -0,0 +1,27 @@
+// Writes the multiresolution file of a mesh, for the viewer and MultiResReport.
+// Usage: MultiResBuild in.obj out.mrm [patchFaces]
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include "Point3D.h"
+#include "Point3D.inl.h"
+#include "ObjIO.h"
+#include "MultiResMesh.h"
+
+int main(int argc, char **argv)
+{
+    if(argc < 3) {
+        std::cout << "usage: MultiResBuild in.obj out.mrm [patchFaces]\n";
+        return 1;
+    }
+    std::vector<uint32_t> indices;
+    std::vector<Point3D> vertices;
+    ObjIO::readObj(argv[1], indices, vertices);
+    auto start = std::chrono::high_resolution_clock::now();
+    bool ok = MultiResBuilder::build(indices, vertices, argv[2], argc > 3 ? atoi(argv[3]) : 4096);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << (ok ? "written " : "can not write ") << argv[2] << " in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "\n";
+    return ok ? 0 : 1;
+}
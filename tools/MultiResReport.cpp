@@ -0,0 +1,49 @@
+// Dollies in from 4 to 0.05 radii of a multiresolution mesh, leaving the cache threads 10 ms per frame,
+// and prints the cut chosen per frame with the memory held by the caches. No window is opened.
+// Usage: MultiResReport model.mrm [frames]
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include "ViewerScene.h"
+
+void multiResReport(int frames)
+{
+	vcg::Point3f c = _multiRes.center();
+	float radius = _multiRes.radius();
+	float pan[3] = {-c[0], -c[1], -c[2]};
+	vcg::Matrix44f proj = projectionMatrix(1600.0f / 900.0f);
+	frames = std::max(frames, 2);
+
+	size_t missing = 0, maxFaces = 0;
+	uint64_t maxRam = 0, maxDraw = 0;
+	printf("frame  dist  nodes   faces  missing  limited  culled  ram KB  draw KB  error px\n");
+	for(int i = 0; i < frames; ++i) {
+		float t = float(i) / (frames - 1);
+		float dist = radius * (4.0f - 3.95f * t);
+		MultiResMesh::Stats st;
+		_multiRes.update(proj, modelviewMatrix(90.0f * t, 25.0f, dist, pan), 900, &st);
+		printf("%5d %5.2f %6zu %7zu %8zu %8zu %7zu %7llu %8llu %9.2f\n", i, dist, st.cutNodes, st.drawnFaces, st.missing,
+		       st.limited, st.culled, (unsigned long long)st.ramBytes >> 10, (unsigned long long)st.drawBytes >> 10, st.maxError);
+		missing += st.missing;
+		maxFaces = std::max(maxFaces, st.drawnFaces);
+		maxRam = std::max(maxRam, st.ramBytes);
+		maxDraw = std::max(maxDraw, st.drawBytes);
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	printf("max: %zu faces, %llu KB ram, %llu KB draw; %zu refinements waited for their patches\n", maxFaces,
+	       (unsigned long long)maxRam >> 10, (unsigned long long)maxDraw >> 10, missing);
+}
+
+int main(int argc, char **argv)
+{
+    const char *model = argc > 1 ? argv[1] : defaultModel;
+    if(!openModel(model)) return 1;
+    if(!_multiRes.isOpen()) {
+        std::cout << "MultiResReport needs an .mrm model, not " << model << "\n";
+        return 1;
+    }
+    multiResReport(argc > 2 ? atoi(argv[2]) : 120);
+    return 0;
+}
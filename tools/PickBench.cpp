@@ -0,0 +1,135 @@
+// Random clicks, rectangles and lassos on a 1600x900 view of both meshes of a model, answered by the
+// picking service and by a linear scan of all the faces as vcg::GLPickTri does. Prints the timings and
+// the number of queries whose answers differ. No window is opened.
+// Usage: PickBench [model.obj] [queries]
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <vcg/space/intersection3.h>
+#include "Point3D.h"
+#include "Point3D.inl.h"
+#include "ViewerScene.h"
+
+#ifndef M_PI
+#define M_PI	3.14159265358979323846
+#endif
+
+void pickBench(int queries)
+{
+	vcg::Box3f box = sceneBox();
+	if(box.IsNull()) return;
+
+	const int w = 1600, h = 900;
+	float pan[3] = {-box.Center()[0], -box.Center()[1], -box.Center()[2]};
+	MeshBuffer *meshes[2] = {&_mesh, &_mesh2};
+	srand(1);
+	auto rnd = [](float range) { return range * rand() / (float)RAND_MAX; };
+
+	double bvhMicros[3] = {0, 0, 0}, scanMicros[3] = {0, 0, 0}, asyncMicros = 0;
+	int mismatches[3] = {0, 0, 0};
+	size_t selected = 0;
+	for(int q = 0; q < queries; ++q) {
+		PickingService::Camera camera = pickCamera(modelviewMatrix(rnd(360), rnd(120) - 60, box.Diag() * (0.5f + rnd(1.5f)), pan), w, h);
+		vcg::Matrix44f m = camera.projection * camera.modelview;
+
+		PickingService::Request request;
+		request.kind = (PickingService::Kind)(q % 3);
+		request.camera = camera;
+		request.x0 = rnd(w); request.y0 = rnd(h);
+		request.x1 = request.x0 + rnd(w / 4); request.y1 = request.y0 + rnd(h / 4);
+		if(request.kind == PickingService::Lasso) {
+			for(int k = 0; k < 16; ++k) {
+				float a = 2 * M_PI * k / 16;
+				float r = 0.5f + 0.5f * (k % 2);
+				request.lasso.push_back(vcg::Point2f(request.x0 + r * (request.x1 - request.x0) * cos(a),
+				                                     request.y0 + r * (request.y1 - request.y0) * sin(a)));
+			}
+		}
+
+		PickingService::Result result = _picker.run(request);
+		bvhMicros[request.kind] += result.micros;
+		selected += result.hits.size();
+
+		// the linear scan: every face per query
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<PickingService::Hit> scan;
+		vcg::Matrix44f inv = vcg::Inverse(m);
+		float nx = 2 * request.x0 / w - 1, ny = 2 * request.y0 / h - 1;
+		vcg::Point4f n4 = inv * vcg::Point4f(nx, ny, -1, 1), f4 = inv * vcg::Point4f(nx, ny, 1, 1);
+		vcg::Point3f pn(n4[0] / n4[3], n4[1] / n4[3], n4[2] / n4[3]);
+		vcg::Ray3f ray(pn, vcg::Point3f(f4[0] / f4[3], f4[1] / f4[3], f4[2] / f4[3]) - pn);
+		float best = 1;
+		for(uint32_t mi = 0; mi < 2; ++mi) {
+			const MeshBuffer &mb = *meshes[mi];
+			for(uint32_t f = 0; f < mb.indices.size() / 3; ++f) {
+				vcg::Point3f c[3];
+				for(int j = 0; j < 3; ++j) {
+					const Point3D &p = mb.vertices[mb.indices[f*3+j]];
+					c[j] = vcg::Point3f(p.x, p.y, p.z);
+				}
+				if(request.kind == PickingService::Ray) {
+					float t = best, u, v;
+					if(vcg::IntersectionRayTriangle(ray, c[0], c[1], c[2], t, u, v) && t < best) {
+						best = t;
+						scan.assign(1, PickingService::Hit{mi, f});
+					}
+					continue;
+				}
+				vcg::Point3f b = (c[0] + c[1] + c[2]) / 3.0f;
+				vcg::Point4f p = m * vcg::Point4f(b[0], b[1], b[2], 1);
+				if(p[3] <= 0 || fabs(p[2]) > p[3]) continue;
+				vcg::Point2f wp((p[0] / p[3] + 1) * w / 2, (p[1] / p[3] + 1) * h / 2);
+				if(request.kind == PickingService::Rect) {
+					if(wp[0] < request.x0 || wp[0] > request.x1 || wp[1] < request.y0 || wp[1] > request.y1) continue;
+				} else {
+					bool in = false;
+					const std::vector<vcg::Point2f> &l = request.lasso;
+					for(size_t i = 0, j = l.size() - 1; i < l.size(); j = i++) {
+						if((l[i][1] > wp[1]) != (l[j][1] > wp[1]) &&
+						   wp[0] < l[i][0] + (l[j][0] - l[i][0]) * (wp[1] - l[i][1]) / (l[j][1] - l[i][1])) in = !in;
+					}
+					if(!in) continue;
+				}
+				scan.push_back(PickingService::Hit{mi, f});
+			}
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		scanMicros[request.kind] += std::chrono::duration<double, std::micro>(end - start).count();
+
+		bool same = scan.size() == result.hits.size();
+		for(size_t i = 0; same && i < scan.size(); ++i) {
+			same = scan[i].mesh == result.hits[i].mesh && scan[i].face == result.hits[i].face;
+		}
+		if(!same) ++mismatches[request.kind];
+
+		// the same query through the worker thread, submit to poll
+		start = std::chrono::high_resolution_clock::now();
+		uint64_t id = _picker.submit(request);
+		PickingService::Result async;
+		while(!_picker.poll(async) || async.id != id) {
+			std::this_thread::yield();
+		}
+		end = std::chrono::high_resolution_clock::now();
+		asyncMicros += std::chrono::duration<double, std::micro>(end - start).count();
+	}
+
+	static const char *names[3] = {"ray", "rectangle", "lasso"};
+	for(int k = 0; k < 3; ++k) {
+		int nb = queries / 3 + (k < queries % 3 ? 1 : 0);
+		if(nb == 0) continue;
+		printf("%-9s : bvh %9.1f us, linear scan %9.1f us, %d/%d mismatches\n", names[k],
+		       bvhMicros[k] / nb, scanMicros[k] / nb, mismatches[k], nb);
+	}
+	printf("worker round trip : %.1f us, %zu faces selected\n", queries ? asyncMicros / queries : 0.0, selected);
+}
+
+int main(int argc, char **argv)
+{
+    if(!openModel(argc > 1 ? argv[1] : defaultModel)) return 1;
+    _loader.wait();
+    adoptMeshes();
+    pickBench(argc > 2 ? atoi(argv[2]) : 300);
+    return 0;
+}
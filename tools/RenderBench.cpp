@@ -0,0 +1,177 @@
+// Renders a camera path of the viewer offscreen and prints the frame times.
+// Usage: RenderBench [model] [frames] [-path file] [-images dir] [-backend full|clusters|direct|points]
+//                    [-points budget] [-scene instances]
+// The path is the generated orbit or the cameras of file (the viewer writes them with -record). direct draws
+// a -scene one instance at a time instead of with multi-draw indirect, points a point cloud without splats.
+// -points draws the first budget points of a point cloud, -scene a grid of instances of the two meshes.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <GL/freeglut.h>
+#include "ViewerScene.h"
+#include "OffscreenContext.h"
+
+struct CameraKey
+{
+    float theta, phi, dist, pan[3];
+};
+
+// One camera per line, "theta phi dist panx pany panz" as -record writes them; '#' starts a comment.
+bool readCameraPath(const char *path, std::vector<CameraKey> &keys)
+{
+    FILE *file = fopen(path, "r");
+    if(!file) return false;
+    char line[256];
+    while(fgets(line, sizeof line, file)) {
+        CameraKey k;
+        if(line[0] == '#') continue;
+        if(sscanf(line, "%f %f %f %f %f %f", &k.theta, &k.phi, &k.dist, &k.pan[0], &k.pan[1], &k.pan[2]) == 6) keys.push_back(k);
+    }
+    fclose(file);
+    return !keys.empty();
+}
+
+// The orbit and dolly of CullReport, around the meshes or the multiresolution mesh.
+std::vector<CameraKey> orbitPath(int frames)
+{
+    vcg::Point3f c;
+    float diag;
+    if(_multiRes.isOpen()) {
+        c = _multiRes.center();
+        diag = 2 * _multiRes.radius();
+    } else {
+        vcg::Box3f box = sceneBox();
+        c = box.IsNull() ? vcg::Point3f(0, 0, 0) : box.Center();
+        diag = box.IsNull() ? 1 : box.Diag();
+    }
+    frames = std::max(frames, 2);
+    std::vector<CameraKey> keys(frames);
+    for(int i = 0; i < frames; ++i) {
+        float t = float(i) / (frames - 1);
+        keys[i] = CameraKey{360.0f * t, 25.0f, diag * (2.0f - 1.75f * t), {-c[0], -c[1], -c[2]}};
+    }
+    return keys;
+}
+
+// Headless: renders frames of the camera path (looped) into a 1600x900 offscreen framebuffer and prints the
+// throughput with the frame time percentiles. glFinish() ends every frame, so the times include the
+// rasterization. The multiresolution cut of every camera is settled before its frame is timed, and the
+// only overlay is the help text, the same every frame: the runs are repeatable. Frame images go to
+// imageDir as PPM files when given.
+bool renderBench(int frames, const std::vector<CameraKey> &path, const char *imageDir)
+{
+    OffscreenContext context;
+    if(!context.create(1600, 900)) {
+        printf("no offscreen context: %s\n", context.error().c_str());
+        return false;
+    }
+    win_width = context.width();
+    win_height = context.height();
+    initGLState();
+    glMatrixMode(GL_PROJECTION);
+    vcg::Matrix44f proj = projectionMatrix((float)win_width / (float)win_height);
+    loadMatrix(proj);
+    printf("renderer: %s, %s\n", context.renderer().c_str(), _multiRes.isOpen() ? "multiresolution" :
+           !_scene.empty() ? (_scene.indirect ? "instanced scene" : "instanced scene, direct") :
+           _pointLOD && !_pointLOD->empty() ? (_points.splats ? "point splats" : "points") :
+           clusterCulling_ ? "cluster culling" : "full meshes");
+
+    _profiler = FrameProfiler(frames);
+    size_t primitives = 0, drawCalls = 0, stateChanges = 0, visible = 0, uploaded = 0, fallbacks = 0;
+    double totalMs = 0;
+    for(int i = 0; i < frames; ++i) {
+        const CameraKey &k = path[i % path.size()];
+        cam_theta = k.theta;
+        cam_phi = k.phi;
+        cam_dist = k.dist;
+        for(int j = 0; j < 3; ++j) cam_pan[j] = k.pan[j];
+        vcg::Matrix44f modelview = modelviewMatrix(cam_theta, cam_phi, cam_dist, cam_pan);
+
+        if(_multiRes.isOpen()) {
+            MultiResMesh::Stats st;
+            for(int wait = 0; wait < 500; ++wait) {
+                _multiRes.update(proj, modelview, win_height, &st);
+                if(st.missing == 0) break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+        }
+
+        _drawnPrimitives = 0;
+        _profiler.beginFrame();
+        renderScene(modelview);
+        _profiler.enter(FrameProfiler::Overlay);
+        print_help();
+        _profiler.enter(FrameProfiler::Swap);
+        glFinish();
+        _profiler.endFrame();
+        primitives += _drawnPrimitives;
+        totalMs += _profiler.frame(0).cpu;
+        drawCalls += _sceneStats.drawCalls;
+        stateChanges += _sceneStats.stateChanges;
+        visible += _sceneStats.visible;
+        uploaded += _sceneStats.uploadedBytes;
+        fallbacks += _sceneStats.fallbacks;
+
+        if(imageDir) {
+            char name[64];
+            snprintf(name, sizeof name, "/frame%04d.ppm", i);
+            if(!context.writePPM(imageDir + std::string(name))) {
+                printf("can not write %s%s\n", imageDir, name);
+                imageDir = nullptr;
+            }
+        }
+    }
+
+    printf("%d frames in %.0f ms: %.1f fps, %.2f M primitives/s, %.0f primitives/frame\n", frames, totalMs,
+           totalMs > 0 ? frames * 1000 / totalMs : 0.0, totalMs > 0 ? primitives / totalMs / 1000 : 0.0,
+           (double)primitives / frames);
+    if(!_scene.empty()) {
+        printf("scene per frame: %.0f/%zu instances, %.1f draw calls, %.1f state changes\n", (double)visible / frames,
+               _sceneStats.instances, (double)drawCalls / frames, (double)stateChanges / frames);
+        printf("scene buffers: %.1f MB uploaded, %.1f MB resident, %zu evictions, %.1f fallback instances/frame\n",
+               uploaded / 1048576.0, _sceneStats.residentBytes / 1048576.0, _sceneStats.evictions, (double)fallbacks / frames);
+        _scene.releaseGL();
+    }
+    if(_pointLOD && !_pointLOD->empty()) {
+        printf("points per frame: %zu of %zu in %zu levels, spacing %.3g\n", _pointStats.drawn, _pointStats.points,
+               _pointLOD->levelNb(), _pointStats.spacing);
+        _points.releaseGL();
+    }
+    _profiler.print(stdout);
+    _text.releaseGL();
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if(!openModel(argc > 1 && argv[1][0] != '-' ? argv[1] : defaultModel)) return 1;
+
+    int frames = argc > 2 && argv[1][0] != '-' && argv[2][0] != '-' ? atoi(argv[2]) : -1;
+    const char *pathFile = nullptr, *imageDir = nullptr;
+    int sceneInstances = 0;
+    for(int i = 1; i + 1 < argc; ++i) {
+        if(strcmp(argv[i], "-path") == 0) pathFile = argv[i+1];
+        if(strcmp(argv[i], "-images") == 0) imageDir = argv[i+1];
+        if(strcmp(argv[i], "-backend") == 0) {
+            clusterCulling_ = strcmp(argv[i+1], "full") != 0;
+            _scene.indirect = strcmp(argv[i+1], "direct") != 0;
+            _points.splats = strcmp(argv[i+1], "points") != 0;
+        }
+        if(strcmp(argv[i], "-points") == 0) _points.budget = std::max(PointRenderer::minBudget, (size_t)atoll(argv[i+1]));
+        if(strcmp(argv[i], "-scene") == 0) sceneInstances = atoi(argv[i+1]);
+    }
+
+    _loader.wait();
+    adoptMeshes();
+    if(sceneInstances > 0) buildScene(sceneInstances);
+    std::vector<CameraKey> path;
+    if(pathFile && !readCameraPath(pathFile, path)) {
+        printf("can not read a camera path from %s\n", pathFile);
+        return 1;
+    }
+    if(path.empty()) path = orbitPath(frames > 0 ? frames : 120);
+    return renderBench(frames > 0 ? frames : (int)path.size(), path, imageDir) ? 0 : 1;
+}